@@ -0,0 +1,389 @@
+#include "../src/Sqlite.h"
+#include "../src/ConnectionPool.h"
+#include "../src/StatementRegistry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * microbenchmarks of the wrapper.
+ *
+ * usage: mainbench [--rows N] [--json FILE]
+ *   --rows N     rows in the benchmark table. default 100000.
+ *   --json FILE  also write the results as JSON to FILE, e.g. to
+ *                compare two versions.
+ */
+
+const char* BENCH_DB_FILENAME = "bench.db";
+const char* BENCH_CSV_FILENAME = "bench.csv";
+
+typedef std::chrono::steady_clock Clock;
+
+
+/***********/
+/* results */
+/***********/
+/**
+ * throughput and latency of one benchmark
+ */
+struct BenchResult {
+  std::string name;
+  unsigned long long ops = 0;
+  std::size_t threads = 1;
+  double seconds = 0;
+  double p50Micros = 0;
+  double p90Micros = 0;
+  double p99Micros = 0;
+  double maxMicros = 0;
+
+  double opsPerSecond() const {
+    return seconds > 0 ? ops / seconds : 0;
+  }
+};
+
+/**
+ * @param sorted latencies, sorted ascending
+ * @param percentile 0 to 100
+ * @return the latency below which percentile percent of the samples are
+ */
+static double percentile(const std::vector<double>& sorted, double percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  std::size_t index = static_cast<std::size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+ * @param name benchmark name
+ * @param latencies one sample per operation in microseconds. sorted in place.
+ * @param seconds wall time of all operations
+ */
+static BenchResult makeResult(const std::string& name, std::vector<double>& latencies, double seconds) {
+  std::sort(latencies.begin(), latencies.end());
+  BenchResult result;
+  result.name = name;
+  result.ops = latencies.size();
+  result.seconds = seconds;
+  result.p50Micros = percentile(latencies, 50);
+  result.p90Micros = percentile(latencies, 90);
+  result.p99Micros = percentile(latencies, 99);
+  result.maxMicros = latencies.empty() ? 0 : latencies.back();
+  return result;
+}
+
+/**
+ * run operation count times and time each call
+ * @param operation gets the number of the call, 0 to count - 1
+ */
+static BenchResult measure(const std::string& name, std::size_t count,
+                           const std::function<void(std::size_t)>& operation) {
+  std::vector<double> latencies;
+  latencies.reserve(count);
+  Clock::time_point start = Clock::now();
+  for (std::size_t i = 0; i < count; i++) {
+    Clock::time_point before = Clock::now();
+    operation(i);
+    latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return makeResult(name, latencies, seconds);
+}
+
+static void printResult(const BenchResult& result) {
+  std::printf("%-18s %2zu threads %10llu ops %12.0f ops/s   p50 %9.1f us   p90 %9.1f us   p99 %9.1f us   max %10.1f us\n",
+              result.name.c_str(), result.threads, result.ops, result.opsPerSecond(),
+              result.p50Micros, result.p90Micros, result.p99Micros, result.maxMicros);
+  std::fflush(stdout);
+}
+
+static void writeJson(const char* filename, const std::vector<BenchResult>& results, std::size_t rows) {
+  std::ofstream file(filename);
+  file << "{\n"
+       << "  \"sqliteVersion\": \"" << sqlite3_libversion() << "\",\n"
+       << "  \"rows\": " << rows << ",\n"
+       << "  \"benchmarks\": [\n";
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const BenchResult& result = results[i];
+    file << "    {\"name\": \"" << result.name << "\""
+         << ", \"threads\": " << result.threads
+         << ", \"ops\": " << result.ops
+         << ", \"seconds\": " << result.seconds
+         << ", \"opsPerSecond\": " << result.opsPerSecond()
+         << ", \"p50Micros\": " << result.p50Micros
+         << ", \"p90Micros\": " << result.p90Micros
+         << ", \"p99Micros\": " << result.p99Micros
+         << ", \"maxMicros\": " << result.maxMicros
+         << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  file << "  ]\n"
+       << "}\n";
+}
+
+
+/**************/
+/* benchmarks */
+/**************/
+static void createTable(gre90r::Sqlite& db) {
+  db.execute("drop table if exists bench");
+  db.execute("create table bench(id integer primary key, name text, value real)");
+}
+
+/**
+ * one autocommit transaction per row
+ */
+static BenchResult insertSingle(gre90r::Sqlite& db, std::size_t rows) {
+  createTable(db);
+  return measure("insertSingle", rows, [&db](std::size_t i) {
+    db.execute("insert into bench values (?, ?, ?)", static_cast<long long>(i), "name", i * 0.5);
+  });
+}
+
+/**
+ * rows through a BulkInserter. the latency includes the commits
+ * of the batches.
+ */
+static BenchResult insertBatched(gre90r::Sqlite& db, std::size_t rows) {
+  createTable(db);
+  gre90r::BulkInserter inserter = db.bulkInsert("bench", { "id", "name", "value" });
+  BenchResult result = measure("insertBatched", rows, [&inserter](std::size_t i) {
+    inserter.insert(static_cast<long long>(i), "name", i * 0.5);
+  });
+  inserter.finish();
+  return result;
+}
+
+/**
+ * import a CSV file of rows records. one op is one row, the latency
+ * is the whole import.
+ */
+static BenchResult importCsv(gre90r::Sqlite& db, std::size_t rows) {
+  {
+    std::ofstream file(BENCH_CSV_FILENAME);
+    file << "id,name,value\n";
+    for (std::size_t i = 0; i < rows; i++) {
+      file << i << ",\"name, " << i << "\"," << i * 0.5 << "\n";
+    }
+  }
+  createTable(db);
+  gre90r::CsvImportProgress progress;
+  BenchResult result = measure("importCsv", 1, [&db, &progress](std::size_t) {
+    db.importCsv(BENCH_CSV_FILENAME, "bench", gre90r::CsvImportOptions(), &progress);
+  });
+  std::remove(BENCH_CSV_FILENAME);
+  result.ops = progress.rows;
+  return result;
+}
+
+/**
+ * select one row by primary key
+ */
+static BenchResult pointSelect(gre90r::Sqlite& db, std::size_t rows, std::size_t count) {
+  return measure("pointSelect", count, [&db, rows](std::size_t i) {
+    long long id = static_cast<long long>((i * 7919) % rows);
+    for (const gre90r::Row& row : db.query("select name from bench where id = ?", id)) {
+      (void)row.getText(0);
+    }
+  });
+}
+
+/**
+ * the statements of pointSelectRegistered, compiled once per connection
+ */
+struct BenchSelectName : gre90r::SqlStatement<gre90r::Params<long long>, gre90r::Columns<std::string_view> > {
+  static constexpr const char* sql = "select name from bench where id = ?";
+};
+typedef gre90r::StatementRegistry<BenchSelectName> BenchStatements;
+
+/**
+ * pointSelect through a StatementRegistry slot instead of the statement cache
+ */
+static BenchResult pointSelectRegistered(gre90r::Sqlite& db, std::size_t rows, std::size_t count) {
+  gre90r::PreparedStatements<BenchStatements> statements(db);
+  return measure("pointSelectSlot", count, [&statements, rows](std::size_t i) {
+    long long id = static_cast<long long>((i * 7919) % rows);
+    for (const auto& row : statements.query<BenchSelectName>(id)) {
+      (void)row.get<0>();
+    }
+  });
+}
+
+/**
+ * pointSelect with statement metrics collected, to see their overhead
+ */
+static BenchResult pointSelectInstrumented(gre90r::Sqlite& db, std::size_t rows, std::size_t count) {
+  db.setInstrumentation(true);
+  BenchResult result = pointSelect(db, rows, count);
+  result.name = "pointSelectInstr";
+  db.setInstrumentation(false);
+  return result;
+}
+
+/**
+ * stream 100 consecutive rows through a Cursor
+ */
+static BenchResult rangeScan(gre90r::Sqlite& db, std::size_t rows, std::size_t count) {
+  const long long width = 100;
+  return measure("rangeScan", count, [&db, rows, width](std::size_t i) {
+    long long from = static_cast<long long>((i * 7919) % rows);
+    double sum = 0;
+    for (const gre90r::Row& row : db.query("select value from bench where id >= ? and id < ?",
+                                           from, from + width)) {
+      sum += row.get<double>(0);
+    }
+    (void)sum;
+  });
+}
+
+/**
+ * copy the whole table into an SqlResult
+ */
+static BenchResult selectAll(gre90r::Sqlite& db, std::size_t count) {
+  return measure("selectAll", count, [&db](std::size_t) {
+    gre90r::SqlResult result = db.select("select id, name, value from bench");
+    (void)result.size();
+  });
+}
+
+/**
+ * a dashboard aggregate over the whole table, repeated with the same sql
+ */
+static BenchResult aggregate(gre90r::Sqlite& db, std::size_t count, const char* name) {
+  return measure(name, count, [&db](std::size_t i) {
+    gre90r::SqlResult result;
+    db.select("select count(*), avg(value) from bench where id % 10 = ?", result,
+              static_cast<long long>(i % 10));
+    (void)result.size();
+  });
+}
+
+/**
+ * aggregate answered from the result cache
+ */
+static BenchResult aggregateCached(gre90r::Sqlite& db, std::size_t count) {
+  db.setResultCache(true);
+  BenchResult result = aggregate(db, count, "aggregateCached");
+  db.setResultCache(false);
+  return result;
+}
+
+/**
+ * point selects from one thread per core, each on its own pooled connection
+ */
+static BenchResult concurrentReaders(std::size_t rows, std::size_t countPerThread) {
+  std::size_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+  gre90r::ConnectionPoolOptions options;
+  options.minSize = threadCount;
+  options.maxSize = threadCount;
+  options.openFlags = SQLITE_OPEN_READONLY;
+  gre90r::ConnectionPool pool(BENCH_DB_FILENAME, options);
+
+  std::vector<std::vector<double> > latencies(threadCount);
+  std::vector<std::thread> threads;
+  Clock::time_point start = Clock::now();
+  for (std::size_t t = 0; t < threadCount; t++) {
+    threads.push_back(std::thread([&pool, &latencies, t, rows, countPerThread] {
+      gre90r::PooledConnection db = pool.acquire();
+      latencies[t].reserve(countPerThread);
+      for (std::size_t i = 0; i < countPerThread; i++) {
+        Clock::time_point before = Clock::now();
+        long long id = static_cast<long long>((i * 7919 + t) % rows);
+        for (const gre90r::Row& row : db->query("select name from bench where id = ?", id)) {
+          (void)row.getText(0);
+        }
+        latencies[t].push_back(std::chrono::duration<double, std::micro>(Clock::now() - before).count());
+      }
+    }));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::vector<double> all;
+  for (const std::vector<double>& samples : latencies) {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  BenchResult result = makeResult("concurrentReaders", all, seconds);
+  result.threads = threadCount;
+  return result;
+}
+
+
+/********/
+/* main */
+/********/
+int main(int argc, char** argv) {
+  std::size_t rows = 100000;
+  const char* jsonFilename = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+      rows = std::max(1000ul, std::strtoul(argv[++i], NULL, 10));
+    }
+    else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      jsonFilename = argv[++i];
+    }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--rows N] [--json FILE]" << std::endl;
+      return 1;
+    }
+  }
+
+  // keep connect messages out of the results
+  gre90r::Log::setLevel(gre90r::LogLevel::Warning);
+  std::remove(BENCH_DB_FILENAME);
+
+  std::vector<BenchResult> results;
+  {
+    // WAL with synchronous=NORMAL, as the readers and writers of an application would use it
+    gre90r::OpenOptions options;
+    options.journalMode = gre90r::JournalMode::Wal;
+    options.synchronous = gre90r::SynchronousMode::Normal;
+    gre90r::Sqlite db(BENCH_DB_FILENAME, options);
+    if (!db.isConnected()) {
+      std::cerr << "cannot open " << BENCH_DB_FILENAME << std::endl;
+      return 1;
+    }
+
+    results.push_back(insertSingle(db, std::min<std::size_t>(rows / 10, 10000)));
+    printResult(results.back());
+    results.push_back(importCsv(db, rows));
+    printResult(results.back());
+    results.push_back(insertBatched(db, rows));
+    printResult(results.back());
+    results.push_back(pointSelect(db, rows, rows));
+    printResult(results.back());
+    results.push_back(pointSelectRegistered(db, rows, rows));
+    printResult(results.back());
+    results.push_back(pointSelectInstrumented(db, rows, rows));
+    printResult(results.back());
+    results.push_back(rangeScan(db, rows, rows / 10));
+    printResult(results.back());
+    results.push_back(selectAll(db, 10));
+    printResult(results.back());
+    results.push_back(aggregate(db, 100, "aggregate"));
+    printResult(results.back());
+    results.push_back(aggregateCached(db, 100));
+    printResult(results.back());
+  }
+  results.push_back(concurrentReaders(rows, rows));
+  printResult(results.back());
+
+  if (jsonFilename != NULL) {
+    writeJson(jsonFilename, results, rows);
+    std::cout << "results written to " << jsonFilename << std::endl;
+  }
+
+  std::remove(BENCH_DB_FILENAME);
+  std::remove((std::string(BENCH_DB_FILENAME) + "-wal").c_str());
+  std::remove((std::string(BENCH_DB_FILENAME) + "-shm").c_str());
+  return 0;
+}
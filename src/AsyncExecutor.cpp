@@ -0,0 +1,137 @@
+#include "AsyncExecutor.h"
+#include "Sqlite.h"
+#include <algorithm>
+
+
+gre90r::AsyncExecutor::AsyncExecutor(const char* filename, const AsyncExecutorOptions& options)
+: m_filename(filename ? filename : ""),
+  m_options(options),
+  m_stopping(false),
+  m_completed(0)
+{
+	if (this->m_options.workers == 0) {
+		this->m_options.workers = 1;
+	}
+	if (this->m_options.maxPipeline == 0) {
+		this->m_options.maxPipeline = 1;
+	}
+
+	// a worker without a connection still answers its requests,
+	// with -3 (not connected to database)
+	for (std::size_t i = 0; i < this->m_options.workers; i++) {
+		// Sqlite keeps the pointer to the name, m_filename outlives it
+		this->m_connections.emplace_back(new Sqlite(filename ? this->m_filename.c_str() : NULL,
+		                                            this->m_options.openFlags));
+	}
+	for (std::size_t i = 0; i < this->m_options.workers; i++) {
+		this->m_workers.push_back(std::thread(&AsyncExecutor::run, this,
+		                                      std::ref(*this->m_connections[i])));
+	}
+}
+
+
+gre90r::AsyncExecutor::~AsyncExecutor() {
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_stopping = true;
+	}
+	this->m_wakeup.notify_all();
+	for (std::thread& worker : this->m_workers) {
+		worker.join();
+	}
+}
+
+
+bool gre90r::AsyncExecutor::isValid() const {
+	for (const std::unique_ptr<Sqlite>& connection : this->m_connections) {
+		if (!connection->isConnected()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+std::future<int> gre90r::AsyncExecutor::executeAsync(const std::string& query) {
+	return this->submit([query](Sqlite& db) {
+		return db.execute(query.c_str());
+	});
+}
+
+
+void gre90r::AsyncExecutor::executeAsync(const std::string& query, ExecuteCallback callback) {
+	this->post([query, callback](Sqlite& db) {
+		callback(db.execute(query.c_str()));
+	});
+}
+
+
+std::future<gre90r::SqlResult> gre90r::AsyncExecutor::selectAsync(const std::string& query) {
+	return this->submit([query](Sqlite& db) {
+		return db.select(query.c_str());
+	});
+}
+
+
+void gre90r::AsyncExecutor::selectAsync(const std::string& query, SelectCallback callback) {
+	this->post([query, callback](Sqlite& db) {
+		SqlResult result;
+		int rc = db.select(query.c_str(), result);
+		callback(rc, std::move(result));
+	});
+}
+
+
+void gre90r::AsyncExecutor::post(Task task) {
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_queue.push_back(std::move(task));
+	}
+	this->m_wakeup.notify_one();
+}
+
+
+std::size_t gre90r::AsyncExecutor::getPending() const {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	return this->m_queue.size();
+}
+
+
+unsigned long long gre90r::AsyncExecutor::getCompleted() const {
+	return this->m_completed.load();
+}
+
+
+void gre90r::AsyncExecutor::run(Sqlite& db) {
+	std::vector<Task> batch;
+	batch.reserve(this->m_options.maxPipeline);
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+			this->m_wakeup.wait(lock, [this] { return !this->m_queue.empty() || this->m_stopping; });
+			if (this->m_queue.empty()) {
+				return; // stopping and nothing left to do
+			}
+
+			// take the pipelined requests in one go, but leave a share
+			// for each of the other workers
+			std::size_t take = this->m_queue.size() / this->m_options.workers;
+			take = std::min(std::max<std::size_t>(take, 1), this->m_options.maxPipeline);
+			while (batch.size() < take) {
+				batch.push_back(std::move(this->m_queue.front()));
+				this->m_queue.pop_front();
+			}
+			// leave the rest to the other workers
+			if (!this->m_queue.empty()) {
+				this->m_wakeup.notify_one();
+			}
+		}
+
+		for (Task& task : batch) {
+			task(db);
+			this->m_completed++;
+		}
+		batch.clear();
+	}
+}
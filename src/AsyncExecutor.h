@@ -0,0 +1,203 @@
+#ifndef SQLITEASYNCEXECUTOR_H
+#define SQLITEASYNCEXECUTOR_H
+
+#include <sqlite3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "SqlResult.h"
+
+
+namespace gre90r {
+
+	class Sqlite;
+
+	/**
+	 * connections and queue of an AsyncExecutor
+	 */
+	struct AsyncExecutorOptions {
+		/**
+		 * worker threads, each owns one connection. with 1 worker all
+		 * requests run in the order they were queued. more workers only
+		 * pay off for reads, e.g. on a database in WAL mode. an in-memory
+		 * database (filename NULL) is private to each worker.
+		 */
+		std::size_t workers = 1;
+
+		/**
+		 * sqlite3_open_v2() flags of each connection
+		 */
+		int openFlags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+		/**
+		 * max number of queued requests a worker takes at once. the queue
+		 * lock is taken once per batch instead of once per request.
+		 */
+		std::size_t maxPipeline = 64;
+	};
+
+	/**
+	 * runs queries on its own worker threads, so the calling thread
+	 * (e.g. an event loop) never waits for the database or the disk.
+	 *
+	 * requests are queued and answered through a std::future or a
+	 * completion callback. callers may queue many requests without
+	 * waiting for the previous ones (pipelining). the workers own
+	 * their connections, the callers never touch them.
+	 *
+	 * completion callbacks run on the worker thread. they should only
+	 * hand the result over to the caller's thread and must not throw.
+	 *
+	 * usage:
+	 *   gre90r::AsyncExecutor executor("app.db");
+	 *   std::future<int> rc = executor.executeAsync("insert into log values ('started')");
+	 *   executor.selectAsync("select * from log", [](int rc, gre90r::SqlResult result) {
+	 *     // post result to the event loop
+	 *   });
+	 */
+	class AsyncExecutor {
+	public:
+		/**
+		 * a request, run on a worker with the worker's connection
+		 */
+		typedef std::function<void(Sqlite& db)> Task;
+
+		/**
+		 * completion of executeAsync(). rc is the sql error code, 0 is ok.
+		 */
+		typedef std::function<void(int rc)> ExecuteCallback;
+
+		/**
+		 * completion of selectAsync(). rc is the sql error code, 0 is ok.
+		 */
+		typedef std::function<void(int rc, SqlResult result)> SelectCallback;
+
+		/**
+		 * forbid standard constructor
+		 */
+		AsyncExecutor() = delete;
+
+		/**
+		 * open the connections and start the workers
+		 * @param filename database file. NULL: in-memory database.
+		 */
+		explicit AsyncExecutor(const char* filename,
+		                       const AsyncExecutorOptions& options = AsyncExecutorOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		AsyncExecutor(const AsyncExecutor&) = delete;
+
+		/**
+		 * runs all queued requests, then stops the workers
+		 */
+		virtual ~AsyncExecutor();
+
+		/**
+		 * forbid assignment operator
+		 */
+		AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+		/**
+		 * @return true: all worker connections are open
+		 */
+		bool isValid() const;
+
+		/**
+		 * queue a query. thread-safe.
+		 * @return sql error code once the query ran. @see Sqlite::execute()
+		 */
+		std::future<int> executeAsync(const std::string& query);
+
+		/**
+		 * queue a query and call callback on the worker when it ran. thread-safe.
+		 */
+		void executeAsync(const std::string& query, ExecuteCallback callback);
+
+		/**
+		 * queue a select. thread-safe.
+		 * @return all rows once the select ran. empty on failure.
+		 */
+		std::future<SqlResult> selectAsync(const std::string& query);
+
+		/**
+		 * queue a select and call callback on the worker with its rows. thread-safe.
+		 */
+		void selectAsync(const std::string& query, SelectCallback callback);
+
+		/**
+		 * queue any work on a connection, e.g. queries with parameters or
+		 * a Transaction. thread-safe.
+		 * @param work callable taking Sqlite&. must not throw.
+		 * @return the value returned by work
+		 */
+		template<typename Work>
+		std::future<typename std::invoke_result<Work, Sqlite&>::type> submit(Work work);
+
+		/**
+		 * queue a task without a result. thread-safe.
+		 */
+		void post(Task task);
+
+		/**
+		 * @return number of requests queued and not yet taken by a worker
+		 */
+		std::size_t getPending() const;
+
+		/**
+		 * @return number of requests run so far
+		 */
+		unsigned long long getCompleted() const;
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		std::string m_filename;
+		AsyncExecutorOptions m_options;
+		std::vector<std::unique_ptr<Sqlite> > m_connections; // one per worker
+		std::vector<std::thread> m_workers;
+		mutable std::mutex m_mutex; // protects the members below
+		std::condition_variable m_wakeup;
+		std::deque<Task> m_queue;
+		bool m_stopping;
+		std::atomic<unsigned long long> m_completed;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * worker thread: run queued tasks on db until stopped
+		 */
+		void run(Sqlite& db);
+	};
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename Work>
+	std::future<typename std::invoke_result<Work, Sqlite&>::type> AsyncExecutor::submit(Work work) {
+		typedef typename std::invoke_result<Work, Sqlite&>::type Result;
+
+		// std::function needs a copyable target, the task is shared
+		std::shared_ptr<std::packaged_task<Result(Sqlite&)> > task =
+			std::make_shared<std::packaged_task<Result(Sqlite&)> >(std::move(work));
+		std::future<Result> result = task->get_future();
+		this->post([task](Sqlite& db) { (*task)(db); });
+		return result;
+	}
+
+}
+
+#endif
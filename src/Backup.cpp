@@ -0,0 +1,154 @@
+#include "Backup.h"
+#include "Log.h"
+#include <thread>
+
+
+/******************/
+/* BackupProgress */
+/******************/
+double gre90r::BackupProgress::getFraction() const {
+	if (this->totalPages <= 0) {
+		return 0.0;
+	}
+	return static_cast<double>(this->totalPages - this->remainingPages) / this->totalPages;
+}
+
+
+/**********/
+/* Backup */
+/**********/
+gre90r::Backup::Backup(sqlite3* destination, sqlite3* source, const BackupOptions& options,
+                       const char* destinationName, const char* sourceName)
+: m_destination(destination), m_backup(NULL), m_options(options), m_errorCode(SQLITE_OK),
+  m_copiedPages(0), m_start(std::chrono::steady_clock::now())
+{
+	if (destination == NULL || source == NULL) {
+		this->m_errorCode = SQLITE_MISUSE;
+		return;
+	}
+	this->m_backup = sqlite3_backup_init(destination, destinationName, source, sourceName);
+	if (this->m_backup == NULL) {
+		// the error is stored in the destination connection
+		this->m_errorCode = sqlite3_errcode(destination);
+		GRE90R_LOG(LogLevel::Error, "backup: cannot start. rc = " << this->m_errorCode << ". "
+		           << "sqlite error message: " << sqlite3_errmsg(destination));
+	}
+}
+
+
+gre90r::Backup::~Backup() {
+	if (this->m_backup != NULL) {
+		sqlite3_backup_finish(this->m_backup);
+	}
+}
+
+
+int gre90r::Backup::step() {
+	if (this->m_backup == NULL) {
+		return this->m_errorCode != SQLITE_OK ? this->m_errorCode : SQLITE_DONE;
+	}
+
+	int rc = sqlite3_backup_step(this->m_backup, this->m_options.pagesPerStep);
+	this->m_progress.steps++;
+	this->m_progress.seconds =
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - this->m_start).count();
+	if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+		this->m_progress.busyRetries++;
+		return rc;
+	}
+	if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+		GRE90R_LOG(LogLevel::Error, "backup: step failed. rc = " << rc << ". "
+		           << "sqlite error message: " << sqlite3_errstr(rc));
+		return this->finish(rc);
+	}
+
+	this->m_progress.totalPages = sqlite3_backup_pagecount(this->m_backup);
+	this->m_progress.remainingPages = sqlite3_backup_remaining(this->m_backup);
+	// sqlite starts over from the first page if another connection wrote to the source
+	int copied = this->m_progress.totalPages - this->m_progress.remainingPages;
+	if (copied < this->m_copiedPages) {
+		this->m_progress.restarts++;
+	}
+	this->m_copiedPages = copied;
+
+	bool proceed = !this->m_options.progress || this->m_options.progress(this->m_progress);
+	if (rc == SQLITE_DONE) {
+		rc = this->finish(SQLITE_OK);
+		GRE90R_LOG(LogLevel::Debug, "backup: " << this->m_progress.totalPages << " pages in "
+		           << this->m_progress.steps << " steps, " << this->m_progress.restarts << " restarts, "
+		           << this->m_progress.seconds << " s.");
+		return rc == SQLITE_OK ? SQLITE_DONE : rc;
+	}
+	if (!proceed) {
+		GRE90R_LOG(LogLevel::Info, "backup: stopped by the progress callback.");
+		return this->finish(SQLITE_ABORT);
+	}
+	if (this->m_options.maxRestarts > 0 && this->m_progress.restarts > this->m_options.maxRestarts) {
+		GRE90R_LOG(LogLevel::Error, "backup: gave up after " << this->m_progress.restarts << " restarts. "
+		           << "the source is changed too often.");
+		return this->finish(SQLITE_BUSY);
+	}
+	return SQLITE_OK;
+}
+
+
+int gre90r::Backup::run() {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point busySince;
+	bool busy = false;
+	int rc = this->step();
+	// only SQLITE_OK and a locked database leave the backup unfinished
+	while (!this->isFinished()) {
+		if (rc != SQLITE_OK) {
+			Clock::time_point now = Clock::now();
+			if (!busy) {
+				busy = true;
+				busySince = now;
+			}
+			else if (now - busySince >= this->m_options.busyTimeout) {
+				GRE90R_LOG(LogLevel::Error, "backup: database is locked. gave up after "
+				           << this->m_options.busyTimeout.count() << " ms.");
+				return this->finish(rc);
+			}
+		}
+		else {
+			busy = false;
+		}
+		// a locked database is retried after at least 1 ms
+		std::chrono::milliseconds delay = this->m_options.stepDelay;
+		if (rc != SQLITE_OK && delay.count() < 1) {
+			delay = std::chrono::milliseconds(1);
+		}
+		if (delay.count() > 0) {
+			std::this_thread::sleep_for(delay);
+		}
+		rc = this->step();
+	}
+	return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+
+bool gre90r::Backup::isFinished() const {
+	return this->m_backup == NULL;
+}
+
+
+int gre90r::Backup::getErrorCode() const {
+	return this->m_errorCode;
+}
+
+
+const gre90r::BackupProgress& gre90r::Backup::getProgress() const {
+	return this->m_progress;
+}
+
+
+int gre90r::Backup::finish(int rc) {
+	if (this->m_backup == NULL) {
+		return this->m_errorCode;
+	}
+	int finishRc = sqlite3_backup_finish(this->m_backup);
+	this->m_backup = NULL;
+	this->m_errorCode = rc != SQLITE_OK ? rc : finishRc;
+	return this->m_errorCode;
+}
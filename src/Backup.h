@@ -0,0 +1,175 @@
+#ifndef SQLITEBACKUP_H
+#define SQLITEBACKUP_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <functional>
+
+
+namespace gre90r {
+
+	/**
+	 * how far a backup has come. passed to the progress callback and
+	 * returned as the result of the backup.
+	 */
+	struct BackupProgress {
+		int totalPages = 0; // pages of the source, as of the last step
+		int remainingPages = 0;
+		unsigned long long steps = 0;
+		unsigned long long restarts = 0; // times another connection changed the source and copying started over
+		unsigned long long busyRetries = 0; // steps which found the source or destination locked
+		double seconds = 0;
+
+		/**
+		 * @return copied part of the source, 0.0 to 1.0
+		 */
+		double getFraction() const;
+	};
+
+	/**
+	 * how fast a backup copies
+	 */
+	struct BackupOptions {
+		/**
+		 * pages copied per step. the source is read locked only while a step
+		 * runs, so small steps let writers in between. < 0: all pages in one
+		 * step, which blocks writers of the source until the copy is done.
+		 */
+		int pagesPerStep = 256;
+
+		/**
+		 * pause between two steps, so writers of the source are not starved
+		 */
+		std::chrono::milliseconds stepDelay = std::chrono::milliseconds(10);
+
+		/**
+		 * give up with SQLITE_BUSY if the source or destination stays locked
+		 * for this long
+		 */
+		std::chrono::milliseconds busyTimeout = std::chrono::milliseconds(30000);
+
+		/**
+		 * give up with SQLITE_BUSY after this many restarts. 0: no limit.
+		 */
+		unsigned int maxRestarts = 0;
+
+		/**
+		 * called after every step. return false to stop the backup, it
+		 * fails with SQLITE_ABORT then.
+		 */
+		std::function<bool(const BackupProgress&)> progress;
+	};
+
+	/**
+	 * copies a live database page by page into another one with
+	 * sqlite3_backup_step(). works for files and in-memory databases
+	 * in both directions.
+	 *
+	 * between two steps the source is not locked, so it stays writable
+	 * while the backup runs:
+	 * 	- changes made through the source connection are written to the
+	 * 	  copy as well, the backup goes on.
+	 * 	- changes made by another connection or process restart the copy
+	 * 	  from the first page with the next step. this is counted in
+	 * 	  BackupProgress::restarts.
+	 * the result is always a consistent snapshot of the source.
+	 *
+	 * the destination is write locked from the first step until the
+	 * backup is finished. its old content is replaced.
+	 *
+	 * run() copies to the end, sleeping stepDelay between the steps.
+	 * step() copies one chunk and returns, for callers which drive the
+	 * backup from their own loop.
+	 *
+	 * usage:
+	 *   gre90r::Backup backup(copy.getHandle(), db.getHandle());
+	 *   int rc = backup.run();
+	 */
+	class Backup {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		Backup() = delete;
+
+		/**
+		 * start a backup of the database sourceName of source into the
+		 * database destinationName of destination. check getErrorCode().
+		 * @param destination must not have an open transaction
+		 */
+		Backup(sqlite3* destination, sqlite3* source, const BackupOptions& options = BackupOptions(),
+		       const char* destinationName = "main", const char* sourceName = "main");
+
+		/**
+		 * forbid copy constructor
+		 */
+		Backup(const Backup&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		Backup& operator=(const Backup&) = delete;
+
+		/**
+		 * stops an unfinished backup. the destination is left as it was
+		 * before, unless it is an in-memory database.
+		 */
+		virtual ~Backup();
+
+		/**
+		 * copy the next pagesPerStep pages
+		 * @return SQLITE_OK: more pages to copy. SQLITE_DONE: finished.
+		 * 				 SQLITE_BUSY or SQLITE_LOCKED: a database is locked, try again
+		 * 				 later (unless isFinished()). other codes: the backup failed.
+		 */
+		int step();
+
+		/**
+		 * step until done, with stepDelay between the steps. retries while
+		 * locked, up to busyTimeout.
+		 * @return sql error code. 0 is ok. SQLITE_ABORT if stopped by the
+		 * 				 progress callback.
+		 */
+		int run();
+
+		/**
+		 * @return true: done or failed, step() does nothing anymore
+		 */
+		bool isFinished() const;
+
+		/**
+		 * @return sql error code of the backup. 0 is ok.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * @return progress of the backup
+		 */
+		const BackupProgress& getProgress() const;
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		sqlite3* m_destination;
+		sqlite3_backup* m_backup; // NULL when finished
+		BackupOptions m_options;
+		BackupProgress m_progress;
+		int m_errorCode;
+		int m_copiedPages; // as of the last step, to detect restarts
+		std::chrono::steady_clock::time_point m_start;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * release the backup
+		 * @param rc reason to stop. SQLITE_OK: the backup is done.
+		 * @return sql error code of the backup. 0 is ok.
+		 */
+		int finish(int rc);
+	};
+
+}
+
+#endif
@@ -0,0 +1,189 @@
+#include "BlobStream.h"
+#include "Log.h"
+#include "Sqlite.h"
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+
+gre90r::BlobStream::BlobStream(Sqlite& db, const std::string& table, const std::string& column,
+                               sqlite3_int64 rowid, bool writable, const char* database)
+: m_blob(NULL), m_errorCode(SQLITE_OK), m_position(0)
+{
+	if (!db.isConnected()) {
+		GRE90R_LOG(LogLevel::Error, "cannot open blob. not connected to DB.");
+		this->m_errorCode = SQLITE_MISUSE;
+		return;
+	}
+
+	this->m_errorCode = sqlite3_blob_open(db.getHandle(), database, table.c_str(), column.c_str(),
+	                                      rowid, writable ? 1 : 0, &this->m_blob);
+	if (this->m_errorCode != SQLITE_OK) {
+		GRE90R_LOG(LogLevel::Error, "failed to open blob " << table << "." << column << " of row "
+		           << rowid << ": " << sqlite3_errmsg(db.getHandle()) << ". rc = " << this->m_errorCode << ".");
+		// sqlite3_blob_open sets the handle to NULL on failure
+		this->m_blob = NULL;
+	}
+}
+
+
+gre90r::BlobStream::BlobStream(BlobStream&& other)
+: m_blob(other.m_blob),
+  m_errorCode(other.m_errorCode),
+  m_position(other.m_position),
+  m_buffer(std::move(other.m_buffer))
+{
+	other.m_blob = NULL;
+}
+
+
+gre90r::BlobStream& gre90r::BlobStream::operator=(BlobStream&& other) {
+	if (this != &other) {
+		this->close();
+		this->m_blob = other.m_blob;
+		this->m_errorCode = other.m_errorCode;
+		this->m_position = other.m_position;
+		this->m_buffer = std::move(other.m_buffer);
+		other.m_blob = NULL;
+	}
+	return *this;
+}
+
+
+gre90r::BlobStream::~BlobStream() {
+	this->close();
+}
+
+
+bool gre90r::BlobStream::isOpen() const {
+	return this->m_blob != NULL;
+}
+
+
+int gre90r::BlobStream::getErrorCode() const {
+	return this->m_errorCode;
+}
+
+
+int gre90r::BlobStream::getSize() const {
+	return this->m_blob != NULL ? sqlite3_blob_bytes(this->m_blob) : 0;
+}
+
+
+int gre90r::BlobStream::tell() const {
+	return this->m_position;
+}
+
+
+int gre90r::BlobStream::seek(int position) {
+	if (position < 0 || position > this->getSize()) {
+		return this->m_errorCode = SQLITE_RANGE;
+	}
+	this->m_position = position;
+	return this->m_errorCode = SQLITE_OK;
+}
+
+
+int gre90r::BlobStream::readAt(void* buffer, int size, int offset) {
+	if (this->m_blob == NULL) {
+		return this->m_errorCode = SQLITE_MISUSE;
+	}
+	// copies straight from the database pages into the caller's buffer
+	return this->m_errorCode = sqlite3_blob_read(this->m_blob, buffer, size, offset);
+}
+
+
+int gre90r::BlobStream::writeAt(const void* data, int size, int offset) {
+	if (this->m_blob == NULL) {
+		return this->m_errorCode = SQLITE_MISUSE;
+	}
+	return this->m_errorCode = sqlite3_blob_write(this->m_blob, data, size, offset);
+}
+
+
+int gre90r::BlobStream::read(void* buffer, int size) {
+	int count = std::min(size, this->getSize() - this->m_position);
+	if (count <= 0) {
+		return this->m_blob != NULL ? 0 : -SQLITE_MISUSE;
+	}
+	int rc = this->readAt(buffer, count, this->m_position);
+	if (rc != SQLITE_OK) {
+		return -rc;
+	}
+	this->m_position += count;
+	return count;
+}
+
+
+int gre90r::BlobStream::write(const void* data, int size) {
+	int rc = this->writeAt(data, size, this->m_position);
+	if (rc == SQLITE_OK) {
+		this->m_position += size;
+	}
+	return rc;
+}
+
+
+int gre90r::BlobStream::readTo(std::ostream& out, std::size_t chunkSize) {
+	this->m_buffer.resize(std::max<std::size_t>(chunkSize, 1));
+	int count;
+	while ((count = this->read(this->m_buffer.data(), static_cast<int>(this->m_buffer.size()))) > 0) {
+		if (!out.write(this->m_buffer.data(), count)) {
+			return this->m_errorCode = SQLITE_IOERR;
+		}
+	}
+	return count < 0 ? -count : SQLITE_OK;
+}
+
+
+int gre90r::BlobStream::writeFrom(std::istream& in, std::size_t chunkSize) {
+	if (this->m_blob == NULL) {
+		return this->m_errorCode = SQLITE_MISUSE;
+	}
+	this->m_buffer.resize(std::max<std::size_t>(chunkSize, 1));
+	while (this->m_position < this->getSize()) {
+		std::streamsize wanted = std::min<std::streamsize>(
+			static_cast<std::streamsize>(this->m_buffer.size()), this->getSize() - this->m_position);
+		in.read(this->m_buffer.data(), wanted);
+		std::streamsize count = in.gcount();
+		if (count > 0) {
+			int rc = this->write(this->m_buffer.data(), static_cast<int>(count));
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+		}
+		if (count < wanted) {
+			// the rest of the blob keeps its content
+			return this->m_errorCode = SQLITE_IOERR;
+		}
+	}
+	return this->m_errorCode = SQLITE_OK;
+}
+
+
+int gre90r::BlobStream::reopen(sqlite3_int64 rowid) {
+	if (this->m_blob == NULL) {
+		return this->m_errorCode = SQLITE_MISUSE;
+	}
+	this->m_position = 0;
+	this->m_errorCode = sqlite3_blob_reopen(this->m_blob, rowid);
+	if (this->m_errorCode != SQLITE_OK) {
+		// the handle can not be used any more, only closed
+		GRE90R_LOG(LogLevel::Error, "failed to reopen blob on row " << rowid
+		           << ". rc = " << this->m_errorCode << ".");
+		sqlite3_blob_close(this->m_blob);
+		this->m_blob = NULL;
+	}
+	return this->m_errorCode;
+}
+
+
+int gre90r::BlobStream::close() {
+	if (this->m_blob == NULL) {
+		return SQLITE_OK;
+	}
+	int rc = sqlite3_blob_close(this->m_blob);
+	this->m_blob = NULL;
+	this->m_position = 0;
+	return rc;
+}
@@ -0,0 +1,158 @@
+#ifndef SQLITEBLOBSTREAM_H
+#define SQLITEBLOBSTREAM_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+
+namespace gre90r {
+
+	class Sqlite;
+
+	/**
+	 * reads and writes one blob in chunks, without holding the whole
+	 * value in memory. wraps sqlite3_blob_open() and friends.
+	 *
+	 * the size of a blob can not be changed through the stream. to
+	 * write a new value, insert the row with a ZeroBlob of the final
+	 * size first, then fill it chunk by chunk.
+	 *
+	 * if the row is changed or deleted by another statement while the
+	 * stream is open, all further reads and writes fail with SQLITE_ABORT.
+	 * movable, not copyable.
+	 *
+	 * usage:
+	 *   db.execute("insert into files(name, data) values (?, ?)", "video", gre90r::ZeroBlob{ size });
+	 *   gre90r::BlobStream blob(db, "files", "data", db.getLastInsertRowId(), true);
+	 *   blob.writeFrom(file);
+	 */
+	class BlobStream {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		BlobStream() = delete;
+
+		/**
+		 * open the blob in column of the row with rowid
+		 * @param writable false: read only
+		 * @param database "main", "temp" or the name of an attached database
+		 */
+		BlobStream(Sqlite& db, const std::string& table, const std::string& column,
+		           sqlite3_int64 rowid, bool writable = false, const char* database = "main");
+
+		/**
+		 * take over the open blob of other
+		 */
+		BlobStream(BlobStream&& other);
+		BlobStream& operator=(BlobStream&& other);
+
+		/**
+		 * forbid copy constructor
+		 */
+		BlobStream(const BlobStream&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		BlobStream& operator=(const BlobStream&) = delete;
+
+		/**
+		 * closes the blob
+		 */
+		virtual ~BlobStream();
+
+		/**
+		 * @return true: the blob is open
+		 */
+		bool isOpen() const;
+
+		/**
+		 * @return sql error code of the last operation. 0 is ok.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * @return size of the blob in bytes. 0 if not open.
+		 */
+		int getSize() const;
+
+		/**
+		 * @return position of the next read() or write()
+		 */
+		int tell() const;
+
+		/**
+		 * move the position of the next read() or write()
+		 * @return sql error code. SQLITE_RANGE if position is outside of the blob.
+		 */
+		int seek(int position);
+
+		/**
+		 * read bytes at offset into buffer. the position is not changed.
+		 * @return sql error code. SQLITE_ERROR if the range is outside of the blob.
+		 */
+		int readAt(void* buffer, int size, int offset);
+
+		/**
+		 * write bytes at offset. the position is not changed.
+		 * @return sql error code. SQLITE_ERROR if the range is outside of the blob,
+		 * 				 SQLITE_READONLY if not opened writable.
+		 */
+		int writeAt(const void* data, int size, int offset);
+
+		/**
+		 * read the next chunk into buffer
+		 * @param size max bytes to read
+		 * @return number of bytes read. 0 at the end of the blob, < 0 on error:
+		 * 				 the negated sql error code.
+		 */
+		int read(void* buffer, int size);
+
+		/**
+		 * write data at the position and move it
+		 * @return sql error code. SQLITE_ERROR if the blob is too small.
+		 */
+		int write(const void* data, int size);
+
+		/**
+		 * copy the blob from the position to the end into out, chunkSize bytes at a time
+		 * @return sql error code. 0 is ok. SQLITE_IOERR if out failed.
+		 */
+		int readTo(std::ostream& out, std::size_t chunkSize = 65536);
+
+		/**
+		 * fill the blob from the position to the end from in, chunkSize bytes at a time
+		 * @return sql error code. 0 is ok. SQLITE_IOERR if in ended before the blob.
+		 */
+		int writeFrom(std::istream& in, std::size_t chunkSize = 65536);
+
+		/**
+		 * move to the same column of another row, e.g. the next row of a
+		 * result. faster than opening a new stream. the position is reset to 0.
+		 * @return sql error code. the stream is closed on failure.
+		 */
+		int reopen(sqlite3_int64 rowid);
+
+		/**
+		 * close the blob. done by the destructor.
+		 * @return sql error code of closing. 0 is ok.
+		 */
+		int close();
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		sqlite3_blob* m_blob;
+		int m_errorCode;
+		int m_position;
+		std::vector<char> m_buffer; // chunk buffer of readTo() and writeFrom()
+	};
+
+}
+
+#endif
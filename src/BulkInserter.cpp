@@ -0,0 +1,159 @@
+#include "BulkInserter.h"
+#include "Log.h"
+#include "Sqlite.h"
+
+
+gre90r::BulkInserter::BulkInserter(Sqlite& db, const std::string& table,
+                                   const std::vector<std::string>& columns,
+                                   const BulkInsertOptions& options)
+: m_db(db), m_columnCount(columns.size()), m_options(options),
+  m_inBatch(false), m_batchRows(0), m_batchBytes(0),
+  m_rows(0), m_batches(0), m_finished(false)
+{
+	// insert into "table" ("a", "b") values (?, ?)
+	std::string query = "insert into " + quoteIdentifier(table) + " (";
+	std::string values = ") values (";
+	for (std::size_t i = 0; i < columns.size(); i++) {
+		if (i > 0) {
+			query += ", ";
+			values += ", ";
+		}
+		query += quoteIdentifier(columns[i]);
+		values += "?";
+	}
+	query += values + ")";
+
+	this->m_insert = this->m_db.prepare(query.c_str());
+}
+
+
+gre90r::BulkInserter::~BulkInserter() {
+	this->finish();
+}
+
+
+bool gre90r::BulkInserter::isValid() const {
+	return this->m_insert && this->m_insert->isValid() && this->m_columnCount > 0;
+}
+
+
+int gre90r::BulkInserter::flush() {
+	if (!this->m_inBatch) {
+		// rows are part of the caller's transaction
+		this->m_batchRows = 0;
+		this->m_batchBytes = 0;
+		return SQLITE_OK;
+	}
+
+	int rc = this->m_db.execute("COMMIT;");
+	if (rc != SQLITE_OK) {
+		GRE90R_LOG(LogLevel::Error, "bulk insert: failed to commit batch. rc = " << rc << ".");
+		return rc;
+	}
+	this->m_inBatch = false;
+	this->m_batchRows = 0;
+	this->m_batchBytes = 0;
+	this->m_batches++;
+	return SQLITE_OK;
+}
+
+
+int gre90r::BulkInserter::finish() {
+	int rc = this->flush();
+	if (!this->m_finished && this->m_rows > 0) {
+		this->m_endTime = Clock::now();
+		this->m_finished = true;
+		GRE90R_LOG(LogLevel::Debug, "bulk insert: " << this->m_rows << " rows in "
+		           << this->m_batches << " batches, " << this->getRowsPerSecond() << " rows/s.");
+	}
+	return rc;
+}
+
+
+int gre90r::BulkInserter::rollback() {
+	if (!this->m_inBatch) {
+		return SQLITE_OK;
+	}
+
+	int rc = this->m_db.execute("ROLLBACK;");
+	this->m_inBatch = false;
+	this->m_rows -= this->m_batchRows;
+	this->m_batchRows = 0;
+	this->m_batchBytes = 0;
+	return rc;
+}
+
+
+unsigned long long gre90r::BulkInserter::getRowCount() const {
+	return this->m_rows;
+}
+
+
+unsigned long long gre90r::BulkInserter::getBatchCount() const {
+	return this->m_batches;
+}
+
+
+double gre90r::BulkInserter::getElapsedSeconds() const {
+	if (this->m_rows == 0 && !this->m_finished) {
+		return 0.0;
+	}
+	Clock::time_point end = this->m_finished ? this->m_endTime : Clock::now();
+	return std::chrono::duration<double>(end - this->m_startTime).count();
+}
+
+
+double gre90r::BulkInserter::getRowsPerSecond() const {
+	double seconds = this->getElapsedSeconds();
+	if (seconds <= 0.0) {
+		return 0.0;
+	}
+	return static_cast<double>(this->m_rows) / seconds;
+}
+
+
+int gre90r::BulkInserter::beginRow() {
+	if (this->m_rows == 0 && this->m_batchRows == 0 && !this->m_inBatch) {
+		this->m_startTime = Clock::now();
+		this->m_finished = false;
+	}
+
+	// rows become part of a transaction the caller opened
+	if (this->m_inBatch || this->m_db.isInTransaction()) {
+		return SQLITE_OK;
+	}
+
+	int rc = this->m_db.execute("BEGIN TRANSACTION;");
+	if (rc != SQLITE_OK) {
+		GRE90R_LOG(LogLevel::Error, "bulk insert: failed to begin batch. rc = " << rc << ".");
+		return rc;
+	}
+	this->m_inBatch = true;
+	return SQLITE_OK;
+}
+
+
+int gre90r::BulkInserter::stepRow() {
+	int rc = this->m_insert->step();
+	this->m_insert->reset();
+	if (rc != SQLITE_DONE) {
+		GRE90R_LOG(LogLevel::Error, "bulk insert: failed to insert row " << this->m_rows + 1
+		           << ". rc = " << rc << ".");
+		return rc;
+	}
+	return SQLITE_OK;
+}
+
+
+int gre90r::BulkInserter::endRow(std::size_t bytes) {
+	this->m_rows++;
+	this->m_batchRows++;
+	this->m_batchBytes += bytes;
+
+	bool full = (this->m_options.batchRows > 0 && this->m_batchRows >= this->m_options.batchRows)
+	         || (this->m_options.batchBytes > 0 && this->m_batchBytes >= this->m_options.batchBytes);
+	if (full) {
+		return this->flush();
+	}
+	return SQLITE_OK;
+}
@@ -0,0 +1,304 @@
+#ifndef SQLITEBULKINSERTER_H
+#define SQLITEBULKINSERTER_H
+
+#include <chrono>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Statement.h"
+
+
+namespace gre90r {
+
+	class Sqlite;
+
+	/**
+	 * when a BulkInserter commits its current batch
+	 */
+	struct BulkInsertOptions {
+		/**
+		 * commit after this many rows. 0: no limit.
+		 */
+		std::size_t batchRows = 10000;
+
+		/**
+		 * commit after about this many bytes of values. 0: no limit.
+		 */
+		std::size_t batchBytes = 0;
+	};
+
+	/**
+	 * inserts many rows into one table.
+	 *
+	 * one prepared INSERT is reused for every row and the rows are grouped
+	 * into transactions of BulkInsertOptions::batchRows rows or batchBytes
+	 * bytes, so there is one commit (and one fsync) per batch instead of
+	 * one per row. if a transaction is already open, the rows become part
+	 * of it and no batches are committed.
+	 *
+	 * usage:
+	 *   gre90r::BulkInserter inserter(sqlite, "employee", { "id", "name" });
+	 *   inserter.insert(1, "John Paul");
+	 *   inserter.finish();
+	 */
+	class BulkInserter {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		BulkInserter() = delete;
+
+		/**
+		 * prepare the insert statement
+		 * @param db connected database
+		 * @param table the table to insert into
+		 * @param columns the columns which get a value in each row
+		 * @param options batch sizes
+		 */
+		BulkInserter(Sqlite& db, const std::string& table,
+		             const std::vector<std::string>& columns,
+		             const BulkInsertOptions& options = BulkInsertOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		BulkInserter(const BulkInserter&) = delete;
+
+		/**
+		 * commits the rows of the current batch
+		 */
+		virtual ~BulkInserter();
+
+		/**
+		 * forbid assignment operator
+		 */
+		BulkInserter& operator=(const BulkInserter&) = delete;
+
+		/**
+		 * @return true: insert statement compiled, rows can be inserted
+		 */
+		bool isValid() const;
+
+		/**
+		 * insert one row. one value per column, bound with Statement::bind().
+		 * @return sql error code. 0 is ok. SQLITE_RANGE if the number of values
+		 * 				 does not match the columns.
+		 */
+		template<typename... Args>
+		int insert(const Args&... values);
+
+		/**
+		 * insert one row from a tuple or pair
+		 */
+		template<typename Tuple>
+		int insertTuple(const Tuple& row);
+
+		/**
+		 * insert one row from a range of values, e.g. a std::vector whose size
+		 * is only known at run time. the values are bound in order.
+		 * @return sql error code. 0 is ok. SQLITE_RANGE if the number of values
+		 * 				 does not match the columns.
+		 */
+		template<typename Range>
+		int insertRow(const Range& values);
+
+		/**
+		 * insert every element of rows. each element is a tuple or pair.
+		 * stops at the first error.
+		 * @return sql error code. 0 is ok.
+		 */
+		template<typename Range>
+		int insertAll(const Range& rows);
+
+		/**
+		 * commit the current batch now
+		 * @return sql error code. 0 is ok.
+		 */
+		int flush();
+
+		/**
+		 * commit the current batch. same as flush(), marks the end of the import.
+		 * @return sql error code. 0 is ok.
+		 */
+		int finish();
+
+		/**
+		 * discard the rows of the current batch
+		 * @return sql error code. 0 is ok.
+		 */
+		int rollback();
+
+		/**
+		 * @return number of rows inserted so far
+		 */
+		unsigned long long getRowCount() const;
+
+		/**
+		 * @return number of batches committed so far
+		 */
+		unsigned long long getBatchCount() const;
+
+		/**
+		 * @return seconds from the first inserted row until finish(), or until now
+		 * 				 if not finished yet
+		 */
+		double getElapsedSeconds() const;
+
+		/**
+		 * @return inserted rows per second. 0 if no row has been inserted.
+		 */
+		double getRowsPerSecond() const;
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		/**************/
+		/* Attributes */
+		/**************/
+		Sqlite& m_db;
+		std::shared_ptr<Statement> m_insert;
+		std::size_t m_columnCount;
+		BulkInsertOptions m_options;
+		bool m_inBatch; // a transaction has been opened by this inserter
+		std::size_t m_batchRows; // rows in the current batch
+		std::size_t m_batchBytes; // bytes in the current batch
+		unsigned long long m_rows;
+		unsigned long long m_batches;
+		Clock::time_point m_startTime;
+		Clock::time_point m_endTime;
+		bool m_finished;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * opens a transaction for a new batch if needed
+		 */
+		int beginRow();
+
+		/**
+		 * runs the bound insert statement
+		 */
+		int stepRow();
+
+		/**
+		 * counts the row and commits if the batch is full
+		 */
+		int endRow(std::size_t bytes);
+
+		/**
+		 * @return approximate size of a value in bytes
+		 */
+		template<typename T>
+		static std::size_t valueSize(const T& value);
+	};
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename... Args>
+	int BulkInserter::insert(const Args&... values) {
+		if (!this->isValid()) {
+			return SQLITE_MISUSE;
+		}
+		if (sizeof...(Args) != this->m_columnCount) {
+			return SQLITE_RANGE;
+		}
+
+		int rc = this->beginRow();
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		rc = this->m_insert->bindAll(values...);
+		if (rc != SQLITE_OK) {
+			this->m_insert->clearBindings();
+			return rc;
+		}
+		rc = this->stepRow();
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		return this->endRow((std::size_t(0) + ... + valueSize(values)));
+	}
+
+
+	template<typename Tuple>
+	int BulkInserter::insertTuple(const Tuple& row) {
+		return std::apply([this](const auto&... values) {
+			return this->insert(values...);
+		}, row);
+	}
+
+
+	template<typename Range>
+	int BulkInserter::insertRow(const Range& values) {
+		if (!this->isValid()) {
+			return SQLITE_MISUSE;
+		}
+		if (static_cast<std::size_t>(std::distance(std::begin(values), std::end(values))) != this->m_columnCount) {
+			return SQLITE_RANGE;
+		}
+
+		int rc = this->beginRow();
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		std::size_t bytes = 0;
+		int index = 0;
+		for (const auto& value : values) {
+			rc = this->m_insert->bind(++index, value);
+			if (rc != SQLITE_OK) {
+				this->m_insert->clearBindings();
+				return rc;
+			}
+			bytes += valueSize(value);
+		}
+		rc = this->stepRow();
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		return this->endRow(bytes);
+	}
+
+
+	template<typename Range>
+	int BulkInserter::insertAll(const Range& rows) {
+		for (const auto& row : rows) {
+			int rc = this->insertTuple(row);
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+		}
+		return SQLITE_OK;
+	}
+
+
+	template<typename T>
+	std::size_t BulkInserter::valueSize(const T& value) {
+		if constexpr (std::is_same<T, BlobView>::value) {
+			return value.size;
+		}
+		else if constexpr (std::is_same<T, StaticText>::value) {
+			return value.text.size();
+		}
+		else if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+			return value ? std::string_view(value).size() : 0;
+		}
+		else if constexpr (std::is_convertible<const T&, std::string_view>::value) {
+			return std::string_view(value).size();
+		}
+		else if constexpr (IsOptional<T>::value) {
+			return value ? valueSize(*value) : 0;
+		}
+		else {
+			return sizeof(sqlite3_int64); // numbers and NULL
+		}
+	}
+
+}
+
+#endif
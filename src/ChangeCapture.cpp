@@ -0,0 +1,393 @@
+#include "ChangeCapture.h"
+#include "Log.h"
+#include <thread>
+
+
+namespace {
+
+	/**
+	 * number of times wait() polls before it sleeps
+	 */
+	const int WAIT_SPINS = 64;
+
+	gre90r::ChangeOperation toOperation(int operation) {
+		switch (operation) {
+		case SQLITE_DELETE:
+			return gre90r::ChangeOperation::Delete;
+		case SQLITE_UPDATE:
+			return gre90r::ChangeOperation::Update;
+		default:
+			return gre90r::ChangeOperation::Insert;
+		}
+	}
+
+#ifdef SQLITE_ENABLE_PREUPDATE_HOOK
+	gre90r::ChangeValue toChangeValue(sqlite3_value* value) {
+		gre90r::ChangeValue result;
+		result.type = value != NULL ? sqlite3_value_type(value) : SQLITE_NULL;
+		switch (result.type) {
+		case SQLITE_INTEGER:
+			result.integer = sqlite3_value_int64(value);
+			break;
+		case SQLITE_FLOAT:
+			result.real = sqlite3_value_double(value);
+			break;
+		case SQLITE_TEXT:
+			result.bytes.assign(reinterpret_cast<const char*>(sqlite3_value_text(value)),
+			                    static_cast<std::size_t>(sqlite3_value_bytes(value)));
+			break;
+		case SQLITE_BLOB:
+			// sqlite3_value_blob() is NULL for an empty blob
+			result.bytes.assign(static_cast<const char*>(sqlite3_value_blob(value)),
+			                    static_cast<std::size_t>(sqlite3_value_bytes(value)));
+			break;
+		default:
+			break;
+		}
+		return result;
+	}
+#endif
+
+}
+
+
+/****************/
+/* ChangeStream */
+/****************/
+gre90r::ChangeStream::ChangeStream(std::size_t capacity, ChangeOverflow overflow)
+: m_mask(0), m_overflow(overflow), m_head(0), m_tail(0), m_transactions(0), m_published(0), m_dropped(0),
+  m_producerWaits(0), m_batches(0), m_highWatermark(0), m_sleeping(false)
+{
+	std::size_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	this->m_mask = size - 1;
+	this->m_slots.reset(new Slot[size]);
+	for (std::size_t i = 0; i < size; ++i) {
+		this->m_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+
+gre90r::ChangeStream::~ChangeStream() {
+}
+
+
+bool gre90r::ChangeStream::publish(ChangeEvent&& event) {
+	if (this->tryPublish(event)) {
+		return true;
+	}
+	if (this->m_overflow == ChangeOverflow::Drop) {
+		this->m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	this->m_producerWaits.fetch_add(1, std::memory_order_relaxed);
+	// the consumer has to run to make room
+	this->notify();
+	while (!this->tryPublish(event)) {
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+
+void gre90r::ChangeStream::notify() {
+	// pairs with the fence in wait(): either the consumer sees the events
+	// or this sees it sleeping
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (this->m_sleeping.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_wakeup.notify_one();
+	}
+}
+
+
+std::size_t gre90r::ChangeStream::poll(std::vector<ChangeEvent>& batch, std::size_t maxEvents) {
+	std::size_t position = this->m_tail.load(std::memory_order_relaxed);
+	std::size_t count = 0;
+	while (count < maxEvents) {
+		Slot& slot = this->m_slots[position & this->m_mask];
+		if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+			break;
+		}
+		batch.push_back(std::move(slot.event));
+		// free for the producer of the position one round later
+		slot.sequence.store(position + this->m_mask + 1, std::memory_order_release);
+		++position;
+		++count;
+	}
+	if (count > 0) {
+		this->m_tail.store(position, std::memory_order_release);
+		this->m_batches.fetch_add(1, std::memory_order_relaxed);
+	}
+	return count;
+}
+
+
+std::size_t gre90r::ChangeStream::wait(std::vector<ChangeEvent>& batch, std::size_t maxEvents,
+                                       std::chrono::microseconds timeout)
+{
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+	std::size_t count = this->poll(batch, maxEvents);
+	for (int spin = 0; count == 0 && maxEvents > 0 && spin < WAIT_SPINS; ++spin) {
+		std::this_thread::yield();
+		count = this->poll(batch, maxEvents);
+	}
+	if (count > 0 || maxEvents == 0) {
+		return count;
+	}
+
+	std::unique_lock<std::mutex> lock(this->m_mutex);
+	for (;;) {
+		this->m_sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		count = this->poll(batch, maxEvents);
+		if (count > 0) {
+			break;
+		}
+		if (this->m_wakeup.wait_until(lock, deadline) == std::cv_status::timeout) {
+			count = this->poll(batch, maxEvents);
+			break;
+		}
+	}
+	this->m_sleeping.store(false, std::memory_order_relaxed);
+	return count;
+}
+
+
+gre90r::ChangeStreamStats gre90r::ChangeStream::getStats() const {
+	ChangeStreamStats stats;
+	stats.published = this->m_published.load(std::memory_order_relaxed);
+	stats.consumed = this->m_tail.load(std::memory_order_relaxed);
+	stats.dropped = this->m_dropped.load(std::memory_order_relaxed);
+	stats.producerWaits = this->m_producerWaits.load(std::memory_order_relaxed);
+	stats.batches = this->m_batches.load(std::memory_order_relaxed);
+	stats.size = stats.published > stats.consumed ? static_cast<std::size_t>(stats.published - stats.consumed) : 0;
+	stats.highWatermark = this->m_highWatermark.load(std::memory_order_relaxed);
+	stats.capacity = this->getCapacity();
+	return stats;
+}
+
+
+std::size_t gre90r::ChangeStream::getCapacity() const {
+	return this->m_mask + 1;
+}
+
+
+std::uint64_t gre90r::ChangeStream::nextTransaction() {
+	return this->m_transactions.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+
+bool gre90r::ChangeStream::tryPublish(ChangeEvent& event) {
+	std::size_t position = this->m_head.load(std::memory_order_relaxed);
+	for (;;) {
+		Slot& slot = this->m_slots[position & this->m_mask];
+		std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence == position) {
+			// the slot is free, claim the position
+			if (this->m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				slot.event = std::move(event);
+				slot.sequence.store(position + 1, std::memory_order_release);
+				break;
+			}
+		}
+		else if (static_cast<std::ptrdiff_t>(sequence - position) < 0) {
+			// the consumer has not read the slot of the last round yet
+			return false;
+		}
+		else {
+			// another producer took the position
+			position = this->m_head.load(std::memory_order_relaxed);
+		}
+	}
+
+	this->m_published.fetch_add(1, std::memory_order_relaxed);
+	std::size_t tail = this->m_tail.load(std::memory_order_relaxed);
+	std::size_t size = position + 1 > tail ? position + 1 - tail : 0;
+	std::size_t high = this->m_highWatermark.load(std::memory_order_relaxed);
+	while (size > high && !this->m_highWatermark.compare_exchange_weak(high, size, std::memory_order_relaxed)) {
+	}
+	return true;
+}
+
+
+/*****************/
+/* ChangeCapture */
+/*****************/
+gre90r::ChangeCapture::ChangeCapture(sqlite3* db, const std::shared_ptr<ChangeStream>& stream,
+                                     const ChangeCaptureOptions& options)
+: m_db(db), m_stream(stream), m_options(options), m_unconfirmed(0)
+{
+#ifndef SQLITE_ENABLE_PREUPDATE_HOOK
+	if (this->m_options.rowImages) {
+		GRE90R_LOG(LogLevel::Warning, "change capture: row images need a build with SQLITE_ENABLE_PREUPDATE_HOOK.");
+		this->m_options.rowImages = false;
+	}
+#endif
+	this->installHooks();
+}
+
+
+gre90r::ChangeCapture::~ChangeCapture() {
+	this->publishCommitted();
+	sqlite3_set_authorizer(this->m_db, NULL, NULL);
+	sqlite3_update_hook(this->m_db, NULL, NULL);
+	sqlite3_commit_hook(this->m_db, NULL, NULL);
+	sqlite3_rollback_hook(this->m_db, NULL, NULL);
+#ifdef SQLITE_ENABLE_PREUPDATE_HOOK
+	sqlite3_preupdate_hook(this->m_db, NULL, NULL);
+#endif
+}
+
+
+const std::shared_ptr<gre90r::ChangeStream>& gre90r::ChangeCapture::getStream() const {
+	return this->m_stream;
+}
+
+
+std::size_t gre90r::ChangeCapture::getPending() const {
+	return this->m_pending.size();
+}
+
+
+void gre90r::ChangeCapture::discardPending(std::size_t count) {
+	if (count < this->m_pending.size()) {
+		this->m_pending.resize(count);
+	}
+	if (this->m_unconfirmed > this->m_pending.size()) {
+		this->m_unconfirmed = 0;
+	}
+}
+
+
+void gre90r::ChangeCapture::publishCommitted() {
+	// a COMMIT which failed left the transaction open, one which was rolled back dropped the events
+	if (this->m_staged.empty() || sqlite3_get_autocommit(this->m_db) == 0) {
+		return;
+	}
+	for (ChangeEvent& event : this->m_staged) {
+		this->m_stream->publish(std::move(event));
+	}
+	this->m_staged.clear();
+	this->m_stream->notify();
+}
+
+
+void gre90r::ChangeCapture::installHooks() {
+	sqlite3_set_authorizer(this->m_db, authorizer, this);
+	sqlite3_update_hook(this->m_db, updateHook, this);
+	sqlite3_commit_hook(this->m_db, commitHook, this);
+	sqlite3_rollback_hook(this->m_db, rollbackHook, this);
+#ifdef SQLITE_ENABLE_PREUPDATE_HOOK
+	sqlite3_preupdate_hook(this->m_db, this->m_options.rowImages ? preupdateHook : NULL, this);
+#endif
+}
+
+
+int gre90r::ChangeCapture::authorizer(void* capture, int action, const char* arg1, const char* arg2,
+                                      const char* database, const char* trigger)
+{
+	(void)arg2;
+	(void)database;
+	(void)trigger;
+	return static_cast<ChangeCapture*>(capture)->m_truncateGuard.authorize(action, arg1);
+}
+
+
+void gre90r::ChangeCapture::updateHook(void* capture, int operation, const char* database, const char* table,
+                                       sqlite3_int64 rowid)
+{
+	ChangeCapture* self = static_cast<ChangeCapture*>(capture);
+	self->publishCommitted();
+	if (self->m_options.rowImages) {
+		// the preupdate hook has recorded the row, only rowid tables get here
+		if (self->m_unconfirmed > 0) {
+			self->m_pending[self->m_unconfirmed - 1].rowid = rowid;
+			self->m_unconfirmed = 0;
+		}
+		return;
+	}
+	ChangeEvent event;
+	event.database = database;
+	event.table = table;
+	event.operation = toOperation(operation);
+	event.rowid = rowid;
+	self->m_pending.push_back(std::move(event));
+}
+
+
+void gre90r::ChangeCapture::preupdateHook(void* capture, sqlite3* db, int operation, const char* database,
+                                          const char* table, sqlite3_int64 oldRowid, sqlite3_int64 newRowid)
+{
+#ifdef SQLITE_ENABLE_PREUPDATE_HOOK
+	if (sqlite3_strnicmp(table, "sqlite_", 7) == 0) {
+		return;
+	}
+	ChangeCapture* self = static_cast<ChangeCapture*>(capture);
+	self->publishCommitted();
+	// the row before had no update hook call, it is in a WITHOUT ROWID table
+	if (self->m_unconfirmed > 0) {
+		self->m_pending[self->m_unconfirmed - 1].rowid = 0;
+	}
+
+	ChangeEvent event;
+	event.database = database;
+	event.table = table;
+	event.operation = toOperation(operation);
+	event.rowid = operation == SQLITE_DELETE ? oldRowid : newRowid;
+	int columns = sqlite3_preupdate_count(db);
+	sqlite3_value* value;
+	if (operation != SQLITE_INSERT) {
+		for (int i = 0; i < columns; ++i) {
+			event.oldRow.push_back(toChangeValue(sqlite3_preupdate_old(db, i, &value) == SQLITE_OK ? value : NULL));
+		}
+	}
+	if (operation != SQLITE_DELETE) {
+		for (int i = 0; i < columns; ++i) {
+			event.newRow.push_back(toChangeValue(sqlite3_preupdate_new(db, i, &value) == SQLITE_OK ? value : NULL));
+		}
+	}
+	self->m_pending.push_back(std::move(event));
+	self->m_unconfirmed = self->m_pending.size();
+#else
+	(void)capture;
+	(void)db;
+	(void)operation;
+	(void)database;
+	(void)table;
+	(void)oldRowid;
+	(void)newRowid;
+#endif
+}
+
+
+int gre90r::ChangeCapture::commitHook(void* capture) {
+	ChangeCapture* self = static_cast<ChangeCapture*>(capture);
+	if (self->m_unconfirmed > 0) {
+		self->m_pending[self->m_unconfirmed - 1].rowid = 0;
+		self->m_unconfirmed = 0;
+	}
+	if (self->m_pending.empty() || !self->m_stream) {
+		self->m_pending.clear();
+		return 0;
+	}
+	// published when the commit has finished, see publishCommitted()
+	std::uint64_t transaction = self->m_stream->nextTransaction();
+	for (ChangeEvent& event : self->m_pending) {
+		event.transaction = transaction;
+		self->m_staged.push_back(std::move(event));
+	}
+	self->m_pending.clear();
+	// 0 lets the commit go on
+	return 0;
+}
+
+
+void gre90r::ChangeCapture::rollbackHook(void* capture) {
+	ChangeCapture* self = static_cast<ChangeCapture*>(capture);
+	self->m_pending.clear();
+	self->m_staged.clear();
+	self->m_unconfirmed = 0;
+}
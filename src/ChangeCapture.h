@@ -0,0 +1,331 @@
+#ifndef SQLITECHANGECAPTURE_H
+#define SQLITECHANGECAPTURE_H
+
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "TruncateGuard.h"
+
+
+namespace gre90r {
+
+	/**
+	 * kind of change of a ChangeEvent
+	 */
+	enum class ChangeOperation {
+		Insert,
+		Update,
+		Delete
+	};
+
+	/**
+	 * a column value of a row image
+	 */
+	struct ChangeValue {
+		int type = SQLITE_NULL;
+		sqlite3_int64 integer = 0;
+		double real = 0;
+		std::string bytes; // text or blob
+	};
+
+	/**
+	 * a row changed by a committed transaction
+	 */
+	struct ChangeEvent {
+		std::string database; // main, temp or the name of an attached database
+		std::string table;
+		ChangeOperation operation = ChangeOperation::Insert;
+		sqlite3_int64 rowid = 0; // of the deleted row, else of the new row
+		std::uint64_t transaction = 0; // the events of one commit share this number
+		std::vector<ChangeValue> oldRow; // deleted and updated rows. only with ChangeCaptureOptions::rowImages.
+		std::vector<ChangeValue> newRow; // inserted and updated rows. only with ChangeCaptureOptions::rowImages.
+	};
+
+	/**
+	 * what a ChangeStream does with events which do not fit into it
+	 */
+	enum class ChangeOverflow {
+		Wait, // the committing thread waits until the consumer made room
+		Drop // the events are dropped and counted in ChangeStreamStats::dropped
+	};
+
+	/**
+	 * counters of a ChangeStream
+	 */
+	struct ChangeStreamStats {
+		unsigned long long published = 0; // events put into the stream
+		unsigned long long consumed = 0; // events read by the consumer
+		unsigned long long dropped = 0; // events which did not fit, see ChangeOverflow::Drop
+		unsigned long long producerWaits = 0; // events which had to wait for room, see ChangeOverflow::Wait
+		unsigned long long batches = 0; // non-empty batches read by the consumer
+		std::size_t size = 0; // events waiting to be read
+		std::size_t highWatermark = 0; // max events waiting at once
+		std::size_t capacity = 0;
+	};
+
+	/**
+	 * bounded queue of ChangeEvents from one or more connections to one
+	 * consumer. the events are kept in a ring of slots, each with a sequence
+	 * number telling whether it is free or filled (Vyukov's bounded queue),
+	 * so publishing and reading take no lock. the consumer only takes a
+	 * mutex when wait() has to sleep on an empty stream.
+	 *
+	 * publish() is thread-safe. poll() and wait() must be called from one
+	 * consumer thread at a time. with ChangeOverflow::Wait the consumer must
+	 * not be the thread which commits, it would wait for itself.
+	 *
+	 * usage:
+	 *   std::shared_ptr<gre90r::ChangeStream> stream = std::make_shared<gre90r::ChangeStream>(4096);
+	 *   db.setChangeCapture(stream);
+	 *   // consumer thread
+	 *   std::vector<gre90r::ChangeEvent> batch;
+	 *   while (running) {
+	 *     batch.clear();
+	 *     stream->wait(batch, 256, std::chrono::milliseconds(100));
+	 *     for (const gre90r::ChangeEvent& event : batch) { ... }
+	 *   }
+	 */
+	class ChangeStream {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		ChangeStream() = delete;
+
+		/**
+		 * @param capacity max number of events waiting to be read. rounded up to
+		 * 				a power of 2.
+		 */
+		explicit ChangeStream(std::size_t capacity, ChangeOverflow overflow = ChangeOverflow::Wait);
+
+		/**
+		 * forbid copy constructor
+		 */
+		ChangeStream(const ChangeStream&) = delete;
+
+		virtual ~ChangeStream();
+
+		/**
+		 * forbid assignment operator
+		 */
+		ChangeStream& operator=(const ChangeStream&) = delete;
+
+		/**
+		 * put event into the stream. thread-safe.
+		 * @return true: published. false: dropped, the stream is full.
+		 */
+		bool publish(ChangeEvent&& event);
+
+		/**
+		 * wake up the consumer if it sleeps in wait(). called once after
+		 * publishing the events of a commit.
+		 */
+		void notify();
+
+		/**
+		 * read the waiting events without blocking. consumer only.
+		 * @param batch receives the events. events are appended.
+		 * @param maxEvents max number of events to read
+		 * @return number of events read
+		 */
+		std::size_t poll(std::vector<ChangeEvent>& batch, std::size_t maxEvents = static_cast<std::size_t>(-1));
+
+		/**
+		 * like poll(), but waits up to timeout for the first event. spins
+		 * briefly before it sleeps, so events are seen within microseconds.
+		 * consumer only.
+		 * @return number of events read. 0: timeout.
+		 */
+		std::size_t wait(std::vector<ChangeEvent>& batch, std::size_t maxEvents, std::chrono::microseconds timeout);
+
+		/**
+		 * @return counters. may be called from any thread.
+		 */
+		ChangeStreamStats getStats() const;
+
+		/**
+		 * @return max number of events waiting to be read
+		 */
+		std::size_t getCapacity() const;
+
+		/**
+		 * @return a new number for the events of a commit. thread-safe.
+		 */
+		std::uint64_t nextTransaction();
+
+	private:
+		/**
+		 * a place for one event. sequence == position: free for the producer
+		 * of position. sequence == position + 1: filled for the consumer.
+		 */
+		struct Slot {
+			std::atomic<std::size_t> sequence;
+			ChangeEvent event;
+		};
+
+		/**************/
+		/* Attributes */
+		/**************/
+		std::unique_ptr<Slot[]> m_slots;
+		std::size_t m_mask; // capacity - 1
+		ChangeOverflow m_overflow;
+		alignas(64) std::atomic<std::size_t> m_head; // next position to publish
+		alignas(64) std::atomic<std::size_t> m_tail; // next position to read
+		alignas(64) std::atomic<std::uint64_t> m_transactions;
+		std::atomic<unsigned long long> m_published;
+		std::atomic<unsigned long long> m_dropped;
+		std::atomic<unsigned long long> m_producerWaits;
+		std::atomic<unsigned long long> m_batches;
+		std::atomic<std::size_t> m_highWatermark;
+		std::atomic<bool> m_sleeping; // the consumer sleeps in wait()
+		std::mutex m_mutex;
+		std::condition_variable m_wakeup;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * @return true: event is in the stream. false: the stream is full.
+		 */
+		bool tryPublish(ChangeEvent& event);
+	};
+
+	/**
+	 * options of a ChangeCapture
+	 */
+	struct ChangeCaptureOptions {
+		/**
+		 * true: ChangeEvent::oldRow and newRow hold the column values, read
+		 * with the preupdate hook. also captures WITHOUT ROWID tables, whose
+		 * rowid is 0. needs a build with SQLITE_ENABLE_PREUPDATE_HOOK and an
+		 * sqlite library which has it. without, the events have no images.
+		 */
+		bool rowImages = false;
+	};
+
+	/**
+	 * publishes the rows changed through one connection to a ChangeStream,
+	 * so caches and search indexes can follow the writes instead of polling.
+	 * used by Sqlite::setChangeCapture().
+	 *
+	 * the update hook collects the changed rows of the open transaction,
+	 * the commit hook stages them and the rollback hook drops them. a
+	 * Savepoint which is rolled back drops the events since it was created.
+	 * several connections may publish into the same stream.
+	 *
+	 * the commit hook runs before the commit is written, so staged events
+	 * are published only once the connection has left the transaction:
+	 * after the COMMIT or the writing statement returned SQLITE_DONE. a
+	 * COMMIT which fails with SQLITE_BUSY keeps the transaction open and
+	 * its events staged until it is retried or rolled back. Sqlite
+	 * publishes after each statement it runs. statements stepped outside
+	 * of it, e.g. through a Cursor or PreparedStatements, are published
+	 * with the next statement Sqlite prepares or the next change.
+	 *
+	 * not seen are changes of virtual tables, changes made by another
+	 * connection, pages replaced by a restore or a loaded snapshot, and
+	 * WITHOUT ROWID tables unless rowImages is set. rows undone by a failing
+	 * statement inside a transaction or by a ROLLBACK TO which is not run
+	 * through Savepoint are published with the commit.
+	 *
+	 * the capture installs the authorizer, update, commit, rollback and
+	 * preupdate hook of the connection, they must not be set by others
+	 * while it exists. see Sqlite::installHooks() for how it shares them
+	 * with a ResultCache. the authorizer turns off the truncate
+	 * optimization of DELETE without WHERE, see TruncateGuard.
+	 *
+	 * not thread-safe. used from the thread which uses the connection.
+	 */
+	class ChangeCapture {
+		friend class Sqlite; // shares the hooks with the result cache
+
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		ChangeCapture() = delete;
+
+		/**
+		 * install the hooks on db
+		 */
+		ChangeCapture(sqlite3* db, const std::shared_ptr<ChangeStream>& stream,
+		              const ChangeCaptureOptions& options = ChangeCaptureOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		ChangeCapture(const ChangeCapture&) = delete;
+
+		/**
+		 * remove the hooks. events of a finished commit are published, events
+		 * of the open transaction are dropped.
+		 */
+		virtual ~ChangeCapture();
+
+		/**
+		 * forbid assignment operator
+		 */
+		ChangeCapture& operator=(const ChangeCapture&) = delete;
+
+		/**
+		 * @return the stream the events are published to
+		 */
+		const std::shared_ptr<ChangeStream>& getStream() const;
+
+		/**
+		 * @return number of events of the open transaction, not published yet
+		 */
+		std::size_t getPending() const;
+
+		/**
+		 * drop the events of the open transaction after the first count,
+		 * because their changes were rolled back to a savepoint
+		 */
+		void discardPending(std::size_t count);
+
+		/**
+		 * publish the events staged by the commit hook if their commit has
+		 * finished, i.e. the connection is in autocommit mode again
+		 */
+		void publishCommitted();
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		sqlite3* m_db;
+		std::shared_ptr<ChangeStream> m_stream;
+		ChangeCaptureOptions m_options;
+		std::vector<ChangeEvent> m_pending; // changes of the open transaction
+		std::vector<ChangeEvent> m_staged; // changes of a commit which has not finished yet
+		std::size_t m_unconfirmed; // 1 + index of the row image whose rowid the update hook has not reported yet. 0: none.
+		TruncateGuard m_truncateGuard;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * install the hooks of this capture on the connection
+		 */
+		void installHooks();
+
+		static int authorizer(void* capture, int action, const char* arg1, const char* arg2,
+		                      const char* database, const char* trigger);
+		static void updateHook(void* capture, int operation, const char* database, const char* table,
+		                       sqlite3_int64 rowid);
+		static void preupdateHook(void* capture, sqlite3* db, int operation, const char* database,
+		                          const char* table, sqlite3_int64 oldRowid, sqlite3_int64 newRowid);
+		static int commitHook(void* capture);
+		static void rollbackHook(void* capture);
+	};
+
+}
+
+#endif
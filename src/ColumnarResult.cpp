@@ -0,0 +1,695 @@
+#include "ColumnarResult.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Statement.h"
+#include <cstring>
+#include <fstream>
+#include <ostream>
+
+
+namespace {
+
+	const char MAGIC[8] = { 'G', 'R', 'E', 'C', 'O', 'L', '0', '1' };
+	const std::uint32_t VERSION = 1;
+	const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+	const std::size_t HEADER_SIZE = 32;
+	const std::size_t DESCRIPTOR_SIZE = 96;
+	const std::size_t BUFFERS = 5; // name, validity, values, offsets, data
+
+	/**
+	 * a buffer of a column as written to the file
+	 */
+	struct BufferRef {
+		const void* data;
+		std::uint64_t length;
+	};
+
+	std::uint64_t alignUp(std::uint64_t position) {
+		return (position + 7) & ~std::uint64_t(7);
+	}
+
+	template<typename T>
+	void writeValue(std::ostream& out, const T& value) {
+		out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	template<typename T>
+	T readValue(const char* position) {
+		T value;
+		std::memcpy(&value, position, sizeof(value));
+		return value;
+	}
+
+	bool isBytes(gre90r::ColumnType type) {
+		return type == gre90r::ColumnType::Text || type == gre90r::ColumnType::Blob;
+	}
+
+	bool isValid(const std::vector<std::uint8_t>& validity, std::size_t row) {
+		return (validity[row >> 3] >> (row & 7)) & 1;
+	}
+
+	/**
+	 * @return the buffers of column in file order
+	 */
+	void getBuffers(const gre90r::ColumnarColumn& column, BufferRef* buffers) {
+		std::uint64_t rows = column.size();
+		buffers[0] = { column.getName().data(), column.getName().size() };
+		buffers[1] = { column.getValidity(), column.getValidity() != NULL ? (rows + 7) / 8 : 0 };
+		buffers[2] = { NULL, 0 };
+		buffers[3] = { NULL, 0 };
+		buffers[4] = { NULL, 0 };
+		if (column.getType() == gre90r::ColumnType::Integer) {
+			buffers[2] = { column.getIntegers(), rows * sizeof(std::int64_t) };
+		}
+		else if (column.getType() == gre90r::ColumnType::Real) {
+			buffers[2] = { column.getReals(), rows * sizeof(double) };
+		}
+		else if (isBytes(column.getType())) {
+			bool dictionary = column.getEncoding() == gre90r::ColumnEncoding::Dictionary;
+			std::uint64_t count = dictionary ? column.getDictionarySize() : rows;
+			if (dictionary) {
+				buffers[2] = { column.getIndices(), rows * sizeof(std::int32_t) };
+			}
+			buffers[3] = { column.getOffsets(), (count + 1) * sizeof(std::int64_t) };
+			buffers[4] = { column.getData(), static_cast<std::uint64_t>(column.getOffsets()[count]) };
+		}
+	}
+
+}
+
+
+const char* gre90r::toString(ColumnType type) {
+	switch (type) {
+	case ColumnType::Null: return "null";
+	case ColumnType::Integer: return "integer";
+	case ColumnType::Real: return "real";
+	case ColumnType::Text: return "text";
+	case ColumnType::Blob: return "blob";
+	}
+	return NULL;
+}
+
+
+/******************/
+/* ColumnarColumn */
+/******************/
+gre90r::ColumnarColumn::ColumnarColumn()
+: m_type(ColumnType::Null), m_encoding(ColumnEncoding::Plain), m_size(0), m_nullCount(0),
+  m_validity(NULL), m_values(NULL), m_offsets(NULL), m_data(NULL), m_dictionarySize(0)
+{
+}
+
+
+std::string_view gre90r::ColumnarColumn::getName() const {
+	return this->m_name;
+}
+
+
+gre90r::ColumnType gre90r::ColumnarColumn::getType() const {
+	return this->m_type;
+}
+
+
+gre90r::ColumnEncoding gre90r::ColumnarColumn::getEncoding() const {
+	return this->m_encoding;
+}
+
+
+std::size_t gre90r::ColumnarColumn::size() const {
+	return this->m_size;
+}
+
+
+std::size_t gre90r::ColumnarColumn::getNullCount() const {
+	return this->m_nullCount;
+}
+
+
+const std::uint8_t* gre90r::ColumnarColumn::getValidity() const {
+	return this->m_validity;
+}
+
+
+const std::int64_t* gre90r::ColumnarColumn::getIntegers() const {
+	return this->m_type == ColumnType::Integer ? static_cast<const std::int64_t*>(this->m_values) : NULL;
+}
+
+
+const double* gre90r::ColumnarColumn::getReals() const {
+	return this->m_type == ColumnType::Real ? static_cast<const double*>(this->m_values) : NULL;
+}
+
+
+const std::int32_t* gre90r::ColumnarColumn::getIndices() const {
+	if (this->m_encoding != ColumnEncoding::Dictionary) {
+		return NULL;
+	}
+	return static_cast<const std::int32_t*>(this->m_values);
+}
+
+
+const std::int64_t* gre90r::ColumnarColumn::getOffsets() const {
+	return this->m_offsets;
+}
+
+
+const char* gre90r::ColumnarColumn::getData() const {
+	return this->m_data;
+}
+
+
+std::size_t gre90r::ColumnarColumn::getDictionarySize() const {
+	return this->m_dictionarySize;
+}
+
+
+bool gre90r::ColumnarColumn::isNull(std::size_t row) const {
+	return this->m_validity != NULL && !((this->m_validity[row >> 3] >> (row & 7)) & 1);
+}
+
+
+std::int64_t gre90r::ColumnarColumn::getInteger(std::size_t row) const {
+	return this->m_type == ColumnType::Integer ? static_cast<const std::int64_t*>(this->m_values)[row] : 0;
+}
+
+
+double gre90r::ColumnarColumn::getReal(std::size_t row) const {
+	if (this->m_type == ColumnType::Real) {
+		return static_cast<const double*>(this->m_values)[row];
+	}
+	return static_cast<double>(this->getInteger(row));
+}
+
+
+std::string_view gre90r::ColumnarColumn::getText(std::size_t row) const {
+	if (!isBytes(this->m_type) || this->isNull(row)) {
+		return std::string_view();
+	}
+	std::size_t index = row;
+	if (this->m_encoding == ColumnEncoding::Dictionary) {
+		index = static_cast<std::size_t>(static_cast<const std::int32_t*>(this->m_values)[row]);
+	}
+	return std::string_view(this->m_data + this->m_offsets[index],
+	                        static_cast<std::size_t>(this->m_offsets[index + 1] - this->m_offsets[index]));
+}
+
+
+/******************/
+/* ColumnarResult */
+/******************/
+gre90r::ColumnarResult::ColumnarResult(const ColumnarOptions& options)
+: m_options(options), m_rows(0)
+{
+}
+
+
+gre90r::ColumnarResult::ColumnarResult(ColumnarResult&& other)
+: m_options(other.m_options),
+  m_rows(other.m_rows),
+  m_builders(std::move(other.m_builders)),
+  m_columns(std::move(other.m_columns))
+{
+	other.clear();
+}
+
+
+gre90r::ColumnarResult& gre90r::ColumnarResult::operator=(ColumnarResult&& other) {
+	if (this != &other) {
+		this->m_options = other.m_options;
+		this->m_rows = other.m_rows;
+		this->m_builders = std::move(other.m_builders);
+		this->m_columns = std::move(other.m_columns);
+		other.clear();
+	}
+	return *this;
+}
+
+
+gre90r::ColumnarResult::~ColumnarResult() {
+}
+
+
+int gre90r::ColumnarResult::load(Statement& statement) {
+	this->clear();
+	if (!statement.isValid()) {
+		return SQLITE_MISUSE;
+	}
+
+	sqlite3_stmt* handle = statement.getHandle();
+	int columnCount = sqlite3_column_count(handle);
+	for (int column = 0; column < columnCount; column++) {
+		this->m_builders.push_back(std::unique_ptr<Builder>(new Builder()));
+		const char* name = sqlite3_column_name(handle, column);
+		this->m_builders.back()->name = name != NULL ? name : "";
+	}
+
+	int rc;
+	while ((rc = statement.step()) == SQLITE_ROW) {
+		for (int column = 0; column < columnCount; column++) {
+			this->append(*this->m_builders[column], handle, column);
+		}
+		this->m_rows++;
+	}
+	statement.reset();
+	if (rc != SQLITE_DONE) {
+		GRE90R_LOG(LogLevel::Error, "columnar select failed after " << this->m_rows << " rows. rc = " << rc << ".");
+		this->clear();
+		return rc;
+	}
+
+	this->finish();
+	return SQLITE_OK;
+}
+
+
+std::size_t gre90r::ColumnarResult::size() const {
+	return this->m_rows;
+}
+
+
+std::size_t gre90r::ColumnarResult::getColumnCount() const {
+	return this->m_columns.size();
+}
+
+
+const gre90r::ColumnarColumn& gre90r::ColumnarResult::getColumn(std::size_t column) const {
+	return this->m_columns[column];
+}
+
+
+int gre90r::ColumnarResult::getColumnIndex(std::string_view name) const {
+	for (std::size_t i = 0; i < this->m_columns.size(); i++) {
+		if (this->m_columns[i].getName() == name) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+
+bool gre90r::ColumnarResult::writeTo(std::ostream& out) const {
+	// place the buffers behind the header and the descriptors
+	std::size_t columnCount = this->m_columns.size();
+	std::vector<BufferRef> buffers(columnCount * BUFFERS);
+	std::vector<std::uint64_t> offsets(columnCount * BUFFERS);
+	std::uint64_t position = HEADER_SIZE + columnCount * DESCRIPTOR_SIZE;
+	for (std::size_t i = 0; i < buffers.size(); i++) {
+		if (i % BUFFERS == 0) {
+			getBuffers(this->m_columns[i / BUFFERS], &buffers[i]);
+		}
+		position = alignUp(position);
+		offsets[i] = position;
+		position += buffers[i].length;
+	}
+
+	out.write(MAGIC, sizeof(MAGIC));
+	writeValue(out, VERSION);
+	writeValue(out, BYTE_ORDER_MARK);
+	writeValue(out, static_cast<std::uint64_t>(this->m_rows));
+	writeValue(out, static_cast<std::uint64_t>(columnCount));
+	for (std::size_t column = 0; column < columnCount; column++) {
+		const ColumnarColumn& current = this->m_columns[column];
+		const char reserved[6] = { 0 };
+		writeValue(out, static_cast<std::uint8_t>(current.getType()));
+		writeValue(out, static_cast<std::uint8_t>(current.getEncoding()));
+		out.write(reserved, sizeof(reserved));
+		writeValue(out, static_cast<std::uint64_t>(current.getNullCount()));
+		for (std::size_t buffer = 0; buffer < BUFFERS; buffer++) {
+			writeValue(out, offsets[column * BUFFERS + buffer]);
+			writeValue(out, buffers[column * BUFFERS + buffer].length);
+		}
+	}
+
+	std::uint64_t written = HEADER_SIZE + columnCount * DESCRIPTOR_SIZE;
+	const char padding[8] = { 0 };
+	for (std::size_t i = 0; i < buffers.size(); i++) {
+		out.write(padding, static_cast<std::streamsize>(offsets[i] - written));
+		out.write(static_cast<const char*>(buffers[i].data), static_cast<std::streamsize>(buffers[i].length));
+		written = offsets[i] + buffers[i].length;
+	}
+	return static_cast<bool>(out);
+}
+
+
+int gre90r::ColumnarResult::writeFile(const char* filename) const {
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		GRE90R_LOG(LogLevel::Error, "cannot create columnar file " << filename << ".");
+		return SQLITE_CANTOPEN;
+	}
+	if (!this->writeTo(file) || !file.flush()) {
+		GRE90R_LOG(LogLevel::Error, "failed to write columnar file " << filename << ".");
+		return SQLITE_IOERR;
+	}
+	return SQLITE_OK;
+}
+
+
+void gre90r::ColumnarResult::clear() {
+	this->m_rows = 0;
+	this->m_builders.clear();
+	this->m_columns.clear();
+}
+
+
+void gre90r::ColumnarResult::append(Builder& builder, sqlite3_stmt* statement, int column) {
+	std::size_t row = this->m_rows;
+	if ((row & 7) == 0) {
+		builder.validity.push_back(0);
+	}
+
+	int sqlType = sqlite3_column_type(statement, column);
+	if (sqlType == SQLITE_NULL) {
+		builder.nullCount++;
+		this->appendNull(builder);
+		return;
+	}
+	builder.validity.back() |= static_cast<std::uint8_t>(1 << (row & 7));
+
+	ColumnType type = sqlType == SQLITE_INTEGER ? ColumnType::Integer
+	                : sqlType == SQLITE_FLOAT ? ColumnType::Real
+	                : sqlType == SQLITE_TEXT ? ColumnType::Text
+	                : ColumnType::Blob;
+	if (builder.type == ColumnType::Null
+	    || (builder.type == ColumnType::Integer && type != ColumnType::Integer)
+	    || (builder.type == ColumnType::Real && isBytes(type))) {
+		this->convert(builder, type);
+	}
+	else if (builder.type == ColumnType::Text && type == ColumnType::Blob) {
+		builder.type = ColumnType::Blob;
+	}
+
+	switch (builder.type) {
+	case ColumnType::Integer:
+		builder.integers.push_back(sqlite3_column_int64(statement, column));
+		break;
+	case ColumnType::Real:
+		builder.reals.push_back(sqlite3_column_double(statement, column));
+		break;
+	case ColumnType::Text:
+	case ColumnType::Blob: {
+		// numbers in a Text column are converted by sqlite
+		const void* bytes = sqlType == SQLITE_BLOB ? sqlite3_column_blob(statement, column)
+		                                           : static_cast<const void*>(sqlite3_column_text(statement, column));
+		std::size_t length = static_cast<std::size_t>(sqlite3_column_bytes(statement, column));
+		this->appendBytes(builder, std::string_view(static_cast<const char*>(bytes), length));
+		break;
+	}
+	case ColumnType::Null:
+		break;
+	}
+}
+
+
+void gre90r::ColumnarResult::appendBytes(Builder& builder, std::string_view value) {
+	if (builder.encoding == ColumnEncoding::Dictionary) {
+		std::unordered_map<std::string_view, std::int32_t>::const_iterator found = builder.dictionary.find(value);
+		if (found != builder.dictionary.end()) {
+			builder.indices.push_back(found->second);
+			return;
+		}
+		if (builder.dictionary.size() < this->m_options.maxDictionarySize) {
+			std::int32_t index = static_cast<std::int32_t>(builder.dictionary.size());
+			builder.distinct.emplace_back(value);
+			builder.dictionary.emplace(builder.distinct.back(), index);
+			builder.data.insert(builder.data.end(), value.begin(), value.end());
+			builder.offsets.push_back(static_cast<std::int64_t>(builder.data.size()));
+			builder.indices.push_back(index);
+			return;
+		}
+		// too many distinct values
+		this->removeDictionary(builder);
+	}
+	builder.data.insert(builder.data.end(), value.begin(), value.end());
+	builder.offsets.push_back(static_cast<std::int64_t>(builder.data.size()));
+}
+
+
+void gre90r::ColumnarResult::appendNull(Builder& builder) {
+	switch (builder.type) {
+	case ColumnType::Null:
+		// placeholders are added when the type is known
+		break;
+	case ColumnType::Integer:
+		builder.integers.push_back(0);
+		break;
+	case ColumnType::Real:
+		builder.reals.push_back(0.0);
+		break;
+	case ColumnType::Text:
+	case ColumnType::Blob:
+		if (builder.encoding == ColumnEncoding::Dictionary) {
+			builder.indices.push_back(0);
+		}
+		else {
+			builder.offsets.push_back(static_cast<std::int64_t>(builder.data.size()));
+		}
+		break;
+	}
+}
+
+
+void gre90r::ColumnarResult::convert(Builder& builder, ColumnType type) {
+	ColumnType from = builder.type;
+	builder.type = type;
+	if (isBytes(type)) {
+		builder.encoding = this->m_options.dictionary ? ColumnEncoding::Dictionary : ColumnEncoding::Plain;
+		builder.offsets.assign(1, 0);
+	}
+
+	if (from == ColumnType::Null) {
+		for (std::size_t row = 0; row < this->m_rows; row++) {
+			this->appendNull(builder);
+		}
+	}
+	else if (type == ColumnType::Real) {
+		builder.reals.assign(builder.integers.begin(), builder.integers.end());
+		std::vector<std::int64_t>().swap(builder.integers);
+	}
+	else {
+		// numbers to text, formatted the way sqlite does
+		std::vector<std::int64_t> integers;
+		std::vector<double> reals;
+		integers.swap(builder.integers);
+		reals.swap(builder.reals);
+		char text[32];
+		for (std::size_t row = 0; row < this->m_rows; row++) {
+			if (!isValid(builder.validity, row)) {
+				this->appendNull(builder);
+				continue;
+			}
+			if (from == ColumnType::Integer) {
+				sqlite3_snprintf(sizeof(text), text, "%lld", static_cast<sqlite3_int64>(integers[row]));
+			}
+			else {
+				sqlite3_snprintf(sizeof(text), text, "%!.15g", reals[row]);
+			}
+			this->appendBytes(builder, text);
+		}
+	}
+}
+
+
+void gre90r::ColumnarResult::removeDictionary(Builder& builder) {
+	std::vector<std::int64_t> offsets;
+	std::vector<char> data;
+	offsets.reserve(builder.indices.size() + 1);
+	offsets.push_back(0);
+	for (std::size_t row = 0; row < builder.indices.size(); row++) {
+		if (isValid(builder.validity, row)) {
+			std::int32_t index = builder.indices[row];
+			data.insert(data.end(), builder.data.begin() + builder.offsets[index],
+			            builder.data.begin() + builder.offsets[index + 1]);
+		}
+		offsets.push_back(static_cast<std::int64_t>(data.size()));
+	}
+	builder.offsets.swap(offsets);
+	builder.data.swap(data);
+	std::vector<std::int32_t>().swap(builder.indices);
+	builder.dictionary.clear();
+	builder.distinct.clear();
+	builder.encoding = ColumnEncoding::Plain;
+}
+
+
+void gre90r::ColumnarResult::finish() {
+	this->m_columns.resize(this->m_builders.size());
+	for (std::size_t i = 0; i < this->m_builders.size(); i++) {
+		Builder& builder = *this->m_builders[i];
+		if (builder.encoding == ColumnEncoding::Dictionary) {
+			double values = static_cast<double>(this->m_rows - builder.nullCount);
+			if (builder.dictionary.size() > this->m_options.maxDictionaryRatio * values) {
+				this->removeDictionary(builder);
+			}
+			builder.dictionary.clear();
+			builder.distinct.clear();
+		}
+		if (builder.nullCount == 0) {
+			builder.validity.clear();
+		}
+
+		ColumnarColumn& column = this->m_columns[i];
+		column.m_name = builder.name;
+		column.m_type = builder.type;
+		column.m_encoding = builder.encoding;
+		column.m_size = this->m_rows;
+		column.m_nullCount = builder.nullCount;
+		column.m_validity = builder.validity.empty() ? NULL : builder.validity.data();
+		column.m_values = builder.type == ColumnType::Integer ? static_cast<const void*>(builder.integers.data())
+		                : builder.type == ColumnType::Real ? static_cast<const void*>(builder.reals.data())
+		                : builder.encoding == ColumnEncoding::Dictionary ? builder.indices.data() : NULL;
+		column.m_offsets = isBytes(builder.type) ? builder.offsets.data() : NULL;
+		column.m_data = builder.data.data();
+		column.m_dictionarySize = builder.encoding == ColumnEncoding::Dictionary ? builder.offsets.size() - 1 : 0;
+	}
+}
+
+
+/****************/
+/* ColumnarFile */
+/****************/
+gre90r::ColumnarFile::ColumnarFile(const char* filename)
+: m_file(new MappedFile(filename)), m_errorCode(SQLITE_OK), m_rows(0)
+{
+	if (!this->m_file->isOpen()) {
+		GRE90R_LOG(LogLevel::Error, "cannot read columnar file " << filename << ".");
+		this->m_errorCode = SQLITE_CANTOPEN;
+		return;
+	}
+	this->m_errorCode = this->parse();
+	if (this->m_errorCode != SQLITE_OK) {
+		GRE90R_LOG(LogLevel::Error, filename << " is not a valid columnar file.");
+		this->m_rows = 0;
+		this->m_columns.clear();
+	}
+}
+
+
+gre90r::ColumnarFile::~ColumnarFile() {
+}
+
+
+int gre90r::ColumnarFile::getErrorCode() const {
+	return this->m_errorCode;
+}
+
+
+std::size_t gre90r::ColumnarFile::size() const {
+	return this->m_rows;
+}
+
+
+std::size_t gre90r::ColumnarFile::getColumnCount() const {
+	return this->m_columns.size();
+}
+
+
+const gre90r::ColumnarColumn& gre90r::ColumnarFile::getColumn(std::size_t column) const {
+	return this->m_columns[column];
+}
+
+
+int gre90r::ColumnarFile::getColumnIndex(std::string_view name) const {
+	for (std::size_t i = 0; i < this->m_columns.size(); i++) {
+		if (this->m_columns[i].getName() == name) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+
+int gre90r::ColumnarFile::parse() {
+	const char* file = this->m_file->getData();
+	std::uint64_t fileSize = this->m_file->getSize();
+	if (fileSize < HEADER_SIZE || std::memcmp(file, MAGIC, sizeof(MAGIC)) != 0
+	    || readValue<std::uint32_t>(file + 8) != VERSION || readValue<std::uint32_t>(file + 12) != BYTE_ORDER_MARK) {
+		return SQLITE_CORRUPT;
+	}
+	std::uint64_t rows = readValue<std::uint64_t>(file + 16);
+	std::uint64_t columnCount = readValue<std::uint64_t>(file + 24);
+	// every column needs at least a bit per row
+	if (columnCount > (fileSize - HEADER_SIZE) / DESCRIPTOR_SIZE || (columnCount > 0 && rows / 8 > fileSize)) {
+		return SQLITE_CORRUPT;
+	}
+	this->m_rows = static_cast<std::size_t>(rows);
+
+	this->m_columns.resize(static_cast<std::size_t>(columnCount));
+	for (std::size_t i = 0; i < this->m_columns.size(); i++) {
+		const char* descriptor = file + HEADER_SIZE + i * DESCRIPTOR_SIZE;
+		std::uint8_t type = readValue<std::uint8_t>(descriptor);
+		std::uint8_t encoding = readValue<std::uint8_t>(descriptor + 1);
+		std::uint64_t nullCount = readValue<std::uint64_t>(descriptor + 8);
+		if (type > static_cast<std::uint8_t>(ColumnType::Blob)
+		    || encoding > static_cast<std::uint8_t>(ColumnEncoding::Dictionary) || nullCount > rows) {
+			return SQLITE_CORRUPT;
+		}
+		BufferRef buffers[BUFFERS];
+		for (std::size_t buffer = 0; buffer < BUFFERS; buffer++) {
+			std::uint64_t offset = readValue<std::uint64_t>(descriptor + 16 + buffer * 16);
+			std::uint64_t length = readValue<std::uint64_t>(descriptor + 24 + buffer * 16);
+			if (offset % 8 != 0 || offset > fileSize || length > fileSize - offset) {
+				return SQLITE_CORRUPT;
+			}
+			buffers[buffer] = { file + offset, length };
+		}
+
+		ColumnarColumn& column = this->m_columns[i];
+		column.m_name = std::string_view(static_cast<const char*>(buffers[0].data), buffers[0].length);
+		column.m_type = static_cast<ColumnType>(type);
+		column.m_encoding = isBytes(column.m_type) ? static_cast<ColumnEncoding>(encoding) : ColumnEncoding::Plain;
+		column.m_size = this->m_rows;
+		column.m_nullCount = static_cast<std::size_t>(nullCount);
+
+		// validity
+		if (buffers[1].length != (nullCount > 0 ? (rows + 7) / 8 : 0)) {
+			return SQLITE_CORRUPT;
+		}
+		column.m_validity = nullCount > 0 ? static_cast<const std::uint8_t*>(buffers[1].data) : NULL;
+
+		// values
+		bool dictionary = column.m_encoding == ColumnEncoding::Dictionary;
+		std::uint64_t valueSize = column.m_type == ColumnType::Integer || column.m_type == ColumnType::Real ? 8
+		                        : dictionary ? 4 : 0;
+		if (buffers[2].length != rows * valueSize) {
+			return SQLITE_CORRUPT;
+		}
+		column.m_values = valueSize > 0 ? buffers[2].data : NULL;
+
+		// offsets and data
+		if (!isBytes(column.m_type)) {
+			if (buffers[3].length != 0 || buffers[4].length != 0) {
+				return SQLITE_CORRUPT;
+			}
+			continue;
+		}
+		if (buffers[3].length < 8 || buffers[3].length % 8 != 0) {
+			return SQLITE_CORRUPT;
+		}
+		std::uint64_t count = buffers[3].length / 8 - 1;
+		if ((!dictionary && count != rows) || count > static_cast<std::uint64_t>(INT32_MAX)) {
+			return SQLITE_CORRUPT;
+		}
+		const std::int64_t* offsets = static_cast<const std::int64_t*>(buffers[3].data);
+		if (offsets[0] != 0 || static_cast<std::uint64_t>(offsets[count]) != buffers[4].length) {
+			return SQLITE_CORRUPT;
+		}
+		for (std::uint64_t j = 0; j < count; j++) {
+			if (offsets[j] > offsets[j + 1]) {
+				return SQLITE_CORRUPT;
+			}
+		}
+		column.m_offsets = offsets;
+		column.m_data = static_cast<const char*>(buffers[4].data);
+		column.m_dictionarySize = dictionary ? static_cast<std::size_t>(count) : 0;
+		if (dictionary) {
+			const std::int32_t* indices = static_cast<const std::int32_t*>(column.m_values);
+			for (std::size_t row = 0; row < this->m_rows; row++) {
+				if (!column.isNull(row) && (indices[row] < 0 || static_cast<std::uint64_t>(indices[row]) >= count)) {
+					return SQLITE_CORRUPT;
+				}
+			}
+		}
+	}
+	return SQLITE_OK;
+}
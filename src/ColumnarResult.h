@@ -0,0 +1,426 @@
+#ifndef SQLITECOLUMNARRESULT_H
+#define SQLITECOLUMNARRESULT_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace gre90r {
+
+	class MappedFile;
+	class Statement;
+
+	/**
+	 * type of all values of a column
+	 */
+	enum class ColumnType : std::uint8_t {
+		Null = 0, // every value is NULL
+		Integer = 1, // std::int64_t
+		Real = 2, // double
+		Text = 3, // UTF-8, not NUL terminated
+		Blob = 4
+	};
+
+	/**
+	 * how the values of a Text or Blob column are stored
+	 */
+	enum class ColumnEncoding : std::uint8_t {
+		Plain = 0, // offsets and data per row
+		Dictionary = 1 // an index per row into offsets and data of the distinct values
+	};
+
+	/**
+	 * @return name of type, e.g. "integer"
+	 */
+	const char* toString(ColumnType type);
+
+	/**
+	 * when text and blob columns are dictionary encoded
+	 */
+	struct ColumnarOptions {
+		/**
+		 * false: never dictionary encode
+		 */
+		bool dictionary = true;
+
+		/**
+		 * a column with more distinct values is stored plain
+		 */
+		std::size_t maxDictionarySize = 65536;
+
+		/**
+		 * a column whose distinct values are more than this part of its
+		 * values is stored plain, the dictionary would not save space
+		 */
+		double maxDictionaryRatio = 0.5;
+	};
+
+	/**
+	 * one column of a ColumnarResult or ColumnarFile. all buffers are
+	 * column-major arrays with one entry per row, owned by the result or
+	 * file the column belongs to:
+	 * 	validity: bit (row % 8) of byte (row / 8) is set if the value is not NULL.
+	 * 		NULL if the column has no NULL values.
+	 * 	Integer: getIntegers(), Real: getReals(). NULL values are 0.
+	 * 	Text and Blob, plain: the value of row is getData()[getOffsets()[row] .. getOffsets()[row + 1]).
+	 * 	Text and Blob, dictionary: getIndices()[row] is the number of the distinct value,
+	 * 		which is stored in getOffsets() and getData() the same way.
+	 * NULL text and blob values are empty.
+	 */
+	class ColumnarColumn {
+	public:
+		ColumnarColumn();
+
+		std::string_view getName() const;
+		ColumnType getType() const;
+		ColumnEncoding getEncoding() const;
+
+		/**
+		 * @return number of rows
+		 */
+		std::size_t size() const;
+
+		/**
+		 * @return number of NULL values
+		 */
+		std::size_t getNullCount() const;
+
+		/**
+		 * @return validity bitmap. NULL if no value is NULL.
+		 */
+		const std::uint8_t* getValidity() const;
+
+		/**
+		 * @return the values of an Integer column. NULL for other types.
+		 */
+		const std::int64_t* getIntegers() const;
+
+		/**
+		 * @return the values of a Real column. NULL for other types.
+		 */
+		const double* getReals() const;
+
+		/**
+		 * @return the dictionary index of each row of a dictionary encoded column.
+		 * 				 NULL if the column is plain.
+		 */
+		const std::int32_t* getIndices() const;
+
+		/**
+		 * @return size() + 1 offsets of a plain column, getDictionarySize() + 1
+		 * 				 offsets of a dictionary column. NULL for numbers.
+		 */
+		const std::int64_t* getOffsets() const;
+
+		/**
+		 * @return bytes of the text or blob values
+		 */
+		const char* getData() const;
+
+		/**
+		 * @return number of distinct values of a dictionary encoded column. 0 if plain.
+		 */
+		std::size_t getDictionarySize() const;
+
+		/**
+		 * @return true: the value of row is NULL
+		 */
+		bool isNull(std::size_t row) const;
+
+		/**
+		 * @return value of row. 0 if NULL or not an Integer column.
+		 */
+		std::int64_t getInteger(std::size_t row) const;
+
+		/**
+		 * @return value of row. Integer values are converted. 0 if NULL or not a number.
+		 */
+		double getReal(std::size_t row) const;
+
+		/**
+		 * @return text or blob of row, dictionary resolved. empty if NULL or a number.
+		 */
+		std::string_view getText(std::size_t row) const;
+
+	private:
+		friend class ColumnarResult;
+		friend class ColumnarFile;
+
+		/**************/
+		/* Attributes */
+		/**************/
+		std::string_view m_name;
+		ColumnType m_type;
+		ColumnEncoding m_encoding;
+		std::size_t m_size;
+		std::size_t m_nullCount;
+		const std::uint8_t* m_validity;
+		const void* m_values; // integers, reals or indices
+		const std::int64_t* m_offsets;
+		const char* m_data;
+		std::size_t m_dictionarySize;
+	};
+
+	/**
+	 * the result of a select as typed column-major buffers, for analytics
+	 * tools which read columns, e.g. through Apache Arrow. filled straight
+	 * from the statement with sqlite3_column_int64() and friends, so numbers
+	 * are never turned into text.
+	 *
+	 * the type of a column is the type of its first non NULL value. an
+	 * Integer column becomes Real if a Real value follows, a number column
+	 * becomes Text if a Text or Blob value follows (earlier numbers are
+	 * converted the way sqlite converts them) and Text becomes Blob.
+	 * Real columns store later integers as doubles, Text columns store
+	 * later numbers as their text.
+	 *
+	 * writeTo() stores the result in the file format below, which
+	 * ColumnarFile maps into memory without parsing any value.
+	 *
+	 * file layout, all numbers in native byte order (little endian on
+	 * all supported platforms), every buffer starts at a multiple of 8:
+	 * 	header, 32 bytes:
+	 * 		char magic[8]            "GRECOL01"
+	 * 		uint32 version           1
+	 * 		uint32 byteOrder         0x01020304 as written by the producer
+	 * 		uint64 rowCount
+	 * 		uint64 columnCount
+	 * 	columnCount column descriptors, 96 bytes each:
+	 * 		uint8 type               ColumnType
+	 * 		uint8 encoding           ColumnEncoding
+	 * 		uint8 reserved[6]
+	 * 		uint64 nullCount
+	 * 		5 buffers, each uint64 offset from the start of the file and uint64 length in bytes:
+	 * 			name                 UTF-8
+	 * 			validity             (rowCount + 7) / 8 bytes. length 0 if there are no NULL values.
+	 * 			values               int64[rowCount], double[rowCount] or dictionary int32[rowCount]
+	 * 			offsets              int64[n + 1], n = rowCount or the dictionary size. length 0 for numbers.
+	 * 			data                 text or blob bytes
+	 * 	the buffers
+	 *
+	 * usage:
+	 *   gre90r::ColumnarResult result;
+	 *   db.selectColumnar("select id, name from employee where age > ?", result, 30);
+	 *   result.writeFile("employees.col");
+	 *   ...
+	 *   gre90r::ColumnarFile file("employees.col");
+	 *   const std::int64_t* ids = file.getColumn(0).getIntegers();
+	 */
+	class ColumnarResult {
+	public:
+		explicit ColumnarResult(const ColumnarOptions& options = ColumnarOptions());
+
+		/**
+		 * take over the buffers of other. the columns of other stay valid
+		 * as columns of this result.
+		 */
+		ColumnarResult(ColumnarResult&& other);
+		ColumnarResult& operator=(ColumnarResult&& other);
+
+		/**
+		 * forbid copy constructor
+		 */
+		ColumnarResult(const ColumnarResult&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		ColumnarResult& operator=(const ColumnarResult&) = delete;
+
+		virtual ~ColumnarResult();
+
+		/**
+		 * replace the content by all rows of statement. the statement has to be
+		 * bound and is reset afterwards.
+		 * @return sql error code. 0 is ok.
+		 */
+		int load(Statement& statement);
+
+		/**
+		 * @return number of rows
+		 */
+		std::size_t size() const;
+
+		/**
+		 * @return number of columns
+		 */
+		std::size_t getColumnCount() const;
+
+		/**
+		 * @param column has to be < getColumnCount()
+		 */
+		const ColumnarColumn& getColumn(std::size_t column) const;
+
+		/**
+		 * @return index of the first column with that name. -1 if there is none.
+		 */
+		int getColumnIndex(std::string_view name) const;
+
+		/**
+		 * write the result in the file format
+		 * @return true: written
+		 */
+		bool writeTo(std::ostream& out) const;
+
+		/**
+		 * write the result in the file format to filename
+		 * @return sql error code. 0 is ok. SQLITE_CANTOPEN or SQLITE_IOERR if writing failed.
+		 */
+		int writeFile(const char* filename) const;
+
+		/**
+		 * remove all rows and columns
+		 */
+		void clear();
+
+	private:
+		/**
+		 * the buffers of one column while it is filled
+		 */
+		struct Builder {
+			std::string name;
+			ColumnType type = ColumnType::Null;
+			ColumnEncoding encoding = ColumnEncoding::Plain;
+			std::size_t nullCount = 0;
+			std::vector<std::uint8_t> validity;
+			std::vector<std::int64_t> integers;
+			std::vector<double> reals;
+			std::vector<std::int32_t> indices;
+			std::vector<std::int64_t> offsets;
+			std::vector<char> data;
+			// distinct values of a dictionary column while loading. the keys point into distinct
+			std::unordered_map<std::string_view, std::int32_t> dictionary;
+			std::deque<std::string> distinct;
+		};
+
+		/**************/
+		/* Attributes */
+		/**************/
+		ColumnarOptions m_options;
+		std::size_t m_rows;
+		std::vector<std::unique_ptr<Builder> > m_builders; // unique_ptr: buffers stay put on move
+		std::vector<ColumnarColumn> m_columns;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * append the value of column of the current row of statement
+		 */
+		void append(Builder& builder, sqlite3_stmt* statement, int column);
+
+		/**
+		 * append a text or blob value to a Text or Blob column
+		 */
+		void appendBytes(Builder& builder, std::string_view value);
+
+		/**
+		 * append the placeholder of a NULL value of the column's type
+		 */
+		void appendNull(Builder& builder);
+
+		/**
+		 * change the type of the column, converting the values so far
+		 */
+		void convert(Builder& builder, ColumnType type);
+
+		/**
+		 * store a dictionary column plain
+		 */
+		void removeDictionary(Builder& builder);
+
+		/**
+		 * drop loading state and point m_columns to the buffers
+		 */
+		void finish();
+	};
+
+	/**
+	 * a file written by ColumnarResult::writeTo(), memory mapped. the
+	 * columns point straight into the mapping, values are read from
+	 * disk on first access and never parsed or copied.
+	 *
+	 * the layout is checked when opening, including offsets and
+	 * dictionary indices, so a damaged file can not make a column
+	 * read outside of the mapping.
+	 */
+	class ColumnarFile {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		ColumnarFile() = delete;
+
+		/**
+		 * map and check filename. check getErrorCode().
+		 */
+		explicit ColumnarFile(const char* filename);
+
+		/**
+		 * forbid copy constructor
+		 */
+		ColumnarFile(const ColumnarFile&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		ColumnarFile& operator=(const ColumnarFile&) = delete;
+
+		virtual ~ColumnarFile();
+
+		/**
+		 * @return sql error code. 0 is ok. SQLITE_CANTOPEN if the file cannot
+		 * 				 be read, SQLITE_CORRUPT if it is not a valid columnar file.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * @return number of rows
+		 */
+		std::size_t size() const;
+
+		/**
+		 * @return number of columns
+		 */
+		std::size_t getColumnCount() const;
+
+		/**
+		 * @param column has to be < getColumnCount()
+		 */
+		const ColumnarColumn& getColumn(std::size_t column) const;
+
+		/**
+		 * @return index of the first column with that name. -1 if there is none.
+		 */
+		int getColumnIndex(std::string_view name) const;
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		std::unique_ptr<MappedFile> m_file;
+		int m_errorCode;
+		std::size_t m_rows;
+		std::vector<ColumnarColumn> m_columns;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * check the layout and point m_columns into the mapping
+		 * @return sql error code. 0 is ok.
+		 */
+		int parse();
+	};
+
+}
+
+#endif
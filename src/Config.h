@@ -4,4 +4,7 @@
 namespace Config
 {
   static const char* DB_NAME = "gre90rSqlite.db";
+
+  // tuning profile: default, bulk-load, read-heavy, durable or in-memory-cache
+  static const char* DB_PROFILE = "default";
 };
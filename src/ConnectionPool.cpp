@@ -0,0 +1,248 @@
+#include "ConnectionPool.h"
+#include "Log.h"
+#include "Sqlite.h"
+#include <utility>
+
+
+/********************/
+/* PooledConnection */
+/********************/
+gre90r::PooledConnection::PooledConnection()
+: m_pool(NULL), m_connection(NULL)
+{
+}
+
+
+gre90r::PooledConnection::PooledConnection(ConnectionPool* pool, Sqlite* connection)
+: m_pool(pool), m_connection(connection)
+{
+}
+
+
+gre90r::PooledConnection::PooledConnection(PooledConnection&& other)
+: m_pool(other.m_pool), m_connection(other.m_connection)
+{
+	other.m_pool = NULL;
+	other.m_connection = NULL;
+}
+
+
+gre90r::PooledConnection& gre90r::PooledConnection::operator=(PooledConnection&& other) {
+	if (this != &other) {
+		this->release();
+		std::swap(this->m_pool, other.m_pool);
+		std::swap(this->m_connection, other.m_connection);
+	}
+	return *this;
+}
+
+
+gre90r::PooledConnection::~PooledConnection() {
+	this->release();
+}
+
+
+bool gre90r::PooledConnection::isValid() const {
+	return this->m_connection != NULL;
+}
+
+
+gre90r::Sqlite* gre90r::PooledConnection::get() const {
+	return this->m_connection;
+}
+
+
+gre90r::Sqlite* gre90r::PooledConnection::operator->() const {
+	return this->m_connection;
+}
+
+
+gre90r::Sqlite& gre90r::PooledConnection::operator*() const {
+	return *this->m_connection;
+}
+
+
+void gre90r::PooledConnection::release() {
+	if (this->m_pool != NULL && this->m_connection != NULL) {
+		this->m_pool->giveBack(this->m_connection);
+	}
+	this->m_pool = NULL;
+	this->m_connection = NULL;
+}
+
+
+/******************/
+/* ConnectionPool */
+/******************/
+gre90r::ConnectionPool::ConnectionPool(const char* filename, const ConnectionPoolOptions& options)
+: m_filename(filename ? filename : ""),
+  m_options(options),
+  m_opening(0),
+  m_acquires(0),
+  m_waits(0),
+  m_timeouts(0),
+  m_totalWaitMicros(0),
+  m_maxWaitMicros(0)
+{
+	if (this->m_options.maxSize < this->m_options.minSize) {
+		this->m_options.maxSize = this->m_options.minSize;
+	}
+	if (this->m_options.maxSize == 0) {
+		this->m_options.maxSize = 1;
+	}
+
+	for (std::size_t i = 0; i < this->m_options.minSize; i++) {
+		std::unique_ptr<Sqlite> connection = this->open();
+		if (!connection) {
+			break;
+		}
+		this->m_idle.push_back(connection.get());
+		this->m_connections.push_back(std::move(connection));
+	}
+}
+
+
+gre90r::ConnectionPool::~ConnectionPool() {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	if (this->m_idle.size() != this->m_connections.size()) {
+		GRE90R_LOG(LogLevel::Error, "connection pool destroyed while "
+		           << this->m_connections.size() - this->m_idle.size() << " connections are leased.");
+	}
+}
+
+
+gre90r::PooledConnection gre90r::ConnectionPool::acquire() {
+	return this->lease(true);
+}
+
+
+gre90r::PooledConnection gre90r::ConnectionPool::tryAcquire() {
+	return this->lease(false);
+}
+
+
+std::size_t gre90r::ConnectionPool::size() const {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	return this->m_connections.size();
+}
+
+
+gre90r::ConnectionPoolStats gre90r::ConnectionPool::getStats() const {
+	ConnectionPoolStats stats;
+	stats.acquires = this->m_acquires.load();
+	stats.waits = this->m_waits.load();
+	stats.timeouts = this->m_timeouts.load();
+	stats.totalWaitMicros = this->m_totalWaitMicros.load();
+	stats.maxWaitMicros = this->m_maxWaitMicros.load();
+
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	stats.size = this->m_connections.size();
+	stats.idle = this->m_idle.size();
+	return stats;
+}
+
+
+std::unique_ptr<gre90r::Sqlite> gre90r::ConnectionPool::open() {
+	// Sqlite keeps the pointer to the name, m_filename outlives it
+	std::unique_ptr<Sqlite> connection(new Sqlite(this->m_filename.c_str(), this->m_options.openFlags));
+	if (!connection->isConnected()) {
+		return std::unique_ptr<Sqlite>();
+	}
+
+	// compile the warm statements into the statement cache
+	for (const std::string& query : this->m_options.warmStatements) {
+		connection->prepare(query.c_str());
+	}
+	if (this->m_options.enableResultCache) {
+		connection->setResultCache(true, this->m_options.resultCache);
+	}
+	return connection;
+}
+
+
+gre90r::PooledConnection gre90r::ConnectionPool::lease(bool wait) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point deadline = start + this->m_options.acquireTimeout;
+	bool waited = false;
+
+	std::unique_lock<std::mutex> lock(this->m_mutex);
+	for (;;) {
+		// take the warmest idle connection
+		if (!this->m_idle.empty()) {
+			Sqlite* connection = this->m_idle.back();
+			this->m_idle.pop_back();
+			lock.unlock();
+
+			this->m_acquires++;
+			if (waited) {
+				this->recordWait(std::chrono::steady_clock::now() - start);
+			}
+			return PooledConnection(this, connection);
+		}
+
+		// elastic: open another connection. the slot is reserved while
+		// the lock is released for opening.
+		if (this->m_connections.size() + this->m_opening < this->m_options.maxSize) {
+			this->m_opening++;
+			lock.unlock();
+			std::unique_ptr<Sqlite> connection = this->open();
+			lock.lock();
+			this->m_opening--;
+
+			if (!connection) {
+				lock.unlock();
+				// the slot is free again, let a waiting thread try
+				this->m_released.notify_one();
+				GRE90R_LOG(LogLevel::Error, "connection pool failed to open a connection.");
+				return PooledConnection();
+			}
+			Sqlite* raw = connection.get();
+			this->m_connections.push_back(std::move(connection));
+			lock.unlock();
+
+			this->m_acquires++;
+			return PooledConnection(this, raw);
+		}
+
+		if (!wait) {
+			return PooledConnection();
+		}
+
+		waited = true;
+		if (this->m_released.wait_until(lock, deadline) == std::cv_status::timeout
+		    && this->m_idle.empty()) {
+			lock.unlock();
+			this->m_timeouts++;
+			this->recordWait(std::chrono::steady_clock::now() - start);
+			return PooledConnection();
+		}
+	}
+}
+
+
+void gre90r::ConnectionPool::giveBack(Sqlite* connection) {
+	// do not hand out a connection with an unfinished transaction
+	if (connection->isInTransaction()) {
+		GRE90R_LOG(LogLevel::Warning, "connection returned to pool with open transaction. rolling back.");
+		connection->execute("ROLLBACK;");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_idle.push_back(connection);
+	}
+	this->m_released.notify_one();
+}
+
+
+void gre90r::ConnectionPool::recordWait(std::chrono::steady_clock::duration waited) {
+	unsigned long long micros = static_cast<unsigned long long>(
+		std::chrono::duration_cast<std::chrono::microseconds>(waited).count());
+	this->m_waits++;
+	this->m_totalWaitMicros += micros;
+
+	unsigned long long max = this->m_maxWaitMicros.load();
+	while (micros > max && !this->m_maxWaitMicros.compare_exchange_weak(max, micros)) {
+		// max has been reloaded, try again
+	}
+}
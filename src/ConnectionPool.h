@@ -0,0 +1,245 @@
+#ifndef SQLITECONNECTIONPOOL_H
+#define SQLITECONNECTIONPOOL_H
+
+#include <sqlite3.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ResultCache.h"
+
+
+namespace gre90r {
+
+	class Sqlite;
+	class ConnectionPool;
+
+	/**
+	 * size and warm-up of a ConnectionPool
+	 */
+	struct ConnectionPoolOptions {
+		/**
+		 * connections opened when the pool is created
+		 */
+		std::size_t minSize = 4;
+
+		/**
+		 * max number of connections. if greater than minSize, the pool
+		 * opens more connections on demand (elastic size).
+		 */
+		std::size_t maxSize = 4;
+
+		/**
+		 * how long acquire() waits for a free connection
+		 */
+		std::chrono::milliseconds acquireTimeout = std::chrono::milliseconds(30000);
+
+		/**
+		 * sqlite3_open_v2() flags of each connection, e.g. SQLITE_OPEN_READONLY
+		 */
+		int openFlags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+		/**
+		 * statements which are prepared on every new connection, so
+		 * its statement cache is warm before the first lease
+		 */
+		std::vector<std::string> warmStatements;
+
+		/**
+		 * true: every connection caches select() results with resultCache.
+		 * each connection has its own cache, commits of the others are
+		 * detected through PRAGMA data_version.
+		 * @see Sqlite::setResultCache()
+		 */
+		bool enableResultCache = false;
+		ResultCacheOptions resultCache;
+	};
+
+	/**
+	 * wait-time metrics of a ConnectionPool
+	 */
+	struct ConnectionPoolStats {
+		unsigned long long acquires = 0; // successful leases
+		unsigned long long waits = 0; // acquire() calls which had to wait, including timeouts
+		unsigned long long timeouts = 0; // acquire() calls which gave up
+		unsigned long long totalWaitMicros = 0; // time spent waiting in acquire()
+		unsigned long long maxWaitMicros = 0; // longest single wait
+		std::size_t size = 0; // open connections
+		std::size_t idle = 0; // connections not leased
+	};
+
+	/**
+	 * a connection leased from a ConnectionPool. it goes back to the
+	 * pool when the lease is destroyed or release() is called.
+	 * movable, not copyable.
+	 */
+	class PooledConnection {
+	public:
+		/**
+		 * an empty lease
+		 */
+		PooledConnection();
+
+		/**
+		 * take over the lease of other
+		 */
+		PooledConnection(PooledConnection&& other);
+		PooledConnection& operator=(PooledConnection&& other);
+
+		/**
+		 * forbid copy constructor
+		 */
+		PooledConnection(const PooledConnection&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		PooledConnection& operator=(const PooledConnection&) = delete;
+
+		/**
+		 * give the connection back to the pool
+		 */
+		virtual ~PooledConnection();
+
+		/**
+		 * @return true: holds a connection
+		 */
+		bool isValid() const;
+
+		/**
+		 * @return the leased connection. NULL for an empty lease.
+		 */
+		Sqlite* get() const;
+		Sqlite* operator->() const;
+		Sqlite& operator*() const;
+
+		/**
+		 * give the connection back to the pool now
+		 */
+		void release();
+
+	private:
+		friend class ConnectionPool;
+		PooledConnection(ConnectionPool* pool, Sqlite* connection);
+
+		ConnectionPool* m_pool;
+		Sqlite* m_connection;
+	};
+
+	/**
+	 * thread-safe pool of connections to one database file.
+	 *
+	 * every worker thread leases its own connection instead of opening
+	 * one per request. each connection keeps its own statement cache.
+	 * idle connections are kept in a LIFO free list, so the most recently
+	 * used (warmest) connection is handed out next. the lock is only
+	 * held to push or pop the free list.
+	 *
+	 * usage:
+	 *   gre90r::ConnectionPool pool("app.db");
+	 *   gre90r::PooledConnection db = pool.acquire();
+	 *   db->select("select name from employee");
+	 */
+	class ConnectionPool {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		ConnectionPool() = delete;
+
+		/**
+		 * open options.minSize connections to filename
+		 */
+		explicit ConnectionPool(const char* filename,
+		                        const ConnectionPoolOptions& options = ConnectionPoolOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		ConnectionPool(const ConnectionPool&) = delete;
+
+		/**
+		 * close all connections. all leases have to be given back before.
+		 */
+		virtual ~ConnectionPool();
+
+		/**
+		 * forbid assignment operator
+		 */
+		ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+		/**
+		 * lease a connection. waits up to acquireTimeout if all are in use.
+		 * @return the lease. empty if the timeout expired or no connection could be opened.
+		 */
+		PooledConnection acquire();
+
+		/**
+		 * lease a connection without waiting
+		 * @return the lease. empty if all connections are in use.
+		 */
+		PooledConnection tryAcquire();
+
+		/**
+		 * @return number of open connections
+		 */
+		std::size_t size() const;
+
+		/**
+		 * @return snapshot of the wait-time metrics
+		 */
+		ConnectionPoolStats getStats() const;
+
+	private:
+		friend class PooledConnection;
+
+		/**************/
+		/* Attributes */
+		/**************/
+		std::string m_filename;
+		ConnectionPoolOptions m_options;
+		mutable std::mutex m_mutex; // protects the members below
+		std::condition_variable m_released;
+		std::vector<std::unique_ptr<Sqlite> > m_connections; // all open connections
+		std::vector<Sqlite*> m_idle; // free list, last one is the warmest
+		std::size_t m_opening; // connections being opened right now
+
+		std::atomic<unsigned long long> m_acquires;
+		std::atomic<unsigned long long> m_waits;
+		std::atomic<unsigned long long> m_timeouts;
+		std::atomic<unsigned long long> m_totalWaitMicros;
+		std::atomic<unsigned long long> m_maxWaitMicros;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * open and warm up a connection
+		 * @return the connection. NULL if it could not be opened.
+		 */
+		std::unique_ptr<Sqlite> open();
+
+		/**
+		 * lease a connection
+		 * @param wait false: do not wait if all are in use
+		 */
+		PooledConnection lease(bool wait);
+
+		/**
+		 * put a connection back into the free list
+		 */
+		void giveBack(Sqlite* connection);
+
+		/**
+		 * add a wait to the metrics
+		 */
+		void recordWait(std::chrono::steady_clock::duration waited);
+	};
+
+}
+
+#endif
@@ -0,0 +1,336 @@
+#include "CsvImport.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "Sqlite.h"
+#include <chrono>
+#include <optional>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/*********************/
+/* CsvImportProgress */
+/*********************/
+double gre90r::CsvImportProgress::getBytesPerSecond() const {
+	return this->seconds > 0.0 ? this->bytesRead / this->seconds : 0.0;
+}
+
+
+double gre90r::CsvImportProgress::getRowsPerSecond() const {
+	return this->seconds > 0.0 ? this->rows / this->seconds : 0.0;
+}
+
+
+/*************/
+/* CsvReader */
+/*************/
+gre90r::CsvReader::CsvReader(const char* data, std::size_t size, char delimiter, char quote)
+: m_begin(data), m_position(data), m_end(data + size),
+  m_delimiter(delimiter), m_quote(quote), m_malformed(false), m_unescapedUsed(0)
+{
+	if (size >= 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF') {
+		this->m_position += 3;
+	}
+}
+
+
+bool gre90r::CsvReader::next(std::vector<std::string_view>& fields) {
+	fields.clear();
+	this->m_malformed = false;
+	this->m_unescapedUsed = 0;
+
+	// skip empty lines
+	while (this->m_position < this->m_end && (*this->m_position == '\n' || *this->m_position == '\r')) {
+		this->m_position++;
+	}
+	if (this->m_position >= this->m_end) {
+		return false;
+	}
+
+	for (;;) {
+		if (this->m_quote != '\0' && *this->m_position == this->m_quote) {
+			this->m_position++;
+			fields.push_back(this->readQuoted());
+			if (this->m_position < this->m_end && *this->m_position != this->m_delimiter
+			    && *this->m_position != '\n' && *this->m_position != '\r') {
+				// text after the closing quote is dropped
+				this->m_malformed = true;
+				this->m_position = find(this->m_position, this->m_end, this->m_delimiter, '\n', '\r');
+			}
+		}
+		else {
+			const char* fieldEnd = find(this->m_position, this->m_end, this->m_delimiter, '\n', '\r');
+			fields.emplace_back(this->m_position, static_cast<std::size_t>(fieldEnd - this->m_position));
+			this->m_position = fieldEnd;
+		}
+
+		if (this->m_position >= this->m_end) {
+			return true;
+		}
+		if (*this->m_position == this->m_delimiter) {
+			this->m_position++;
+			if (this->m_position >= this->m_end) {
+				// a delimiter at the very end is followed by an empty field
+				fields.emplace_back();
+				return true;
+			}
+			continue;
+		}
+		// line break: \n, \r\n or \r
+		if (*this->m_position == '\r' && this->m_position + 1 < this->m_end && this->m_position[1] == '\n') {
+			this->m_position++;
+		}
+		this->m_position++;
+		return true;
+	}
+}
+
+
+bool gre90r::CsvReader::isMalformed() const {
+	return this->m_malformed;
+}
+
+
+std::size_t gre90r::CsvReader::getPosition() const {
+	return static_cast<std::size_t>(this->m_position - this->m_begin);
+}
+
+
+std::string_view gre90r::CsvReader::readQuoted() {
+	const char* segment = this->m_position;
+	std::string* unescaped = NULL;
+	for (;;) {
+		const char* quote = find(this->m_position, this->m_end, this->m_quote, this->m_quote, this->m_quote);
+		if (quote == this->m_end) {
+			// not closed: the field runs to the end of the input
+			this->m_malformed = true;
+			this->m_position = this->m_end;
+			if (unescaped == NULL) {
+				return std::string_view(segment, static_cast<std::size_t>(quote - segment));
+			}
+			unescaped->append(segment, quote);
+			return *unescaped;
+		}
+		if (quote + 1 < this->m_end && quote[1] == this->m_quote) {
+			// doubled quote: keep one of them
+			if (unescaped == NULL) {
+				unescaped = &this->unescapeBuffer();
+			}
+			unescaped->append(segment, quote + 1);
+			this->m_position = segment = quote + 2;
+			continue;
+		}
+		this->m_position = quote + 1;
+		if (unescaped == NULL) {
+			return std::string_view(segment, static_cast<std::size_t>(quote - segment));
+		}
+		unescaped->append(segment, quote);
+		return *unescaped;
+	}
+}
+
+
+std::string& gre90r::CsvReader::unescapeBuffer() {
+	if (this->m_unescapedUsed == this->m_unescaped.size()) {
+		this->m_unescaped.emplace_back();
+	}
+	std::string& buffer = this->m_unescaped[this->m_unescapedUsed++];
+	// keeps its capacity from earlier records
+	buffer.clear();
+	return buffer;
+}
+
+
+const char* gre90r::CsvReader::find(const char* from, const char* to, char a, char b, char c) {
+#ifdef __SSE2__
+	// compare 16 bytes against all three characters at once
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	const __m128i vc = _mm_set1_epi8(c);
+	while (to - from >= 16) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from));
+		__m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+		                            _mm_cmpeq_epi8(chunk, vc));
+		int mask = _mm_movemask_epi8(hits);
+		if (mask != 0) {
+			return from + __builtin_ctz(static_cast<unsigned int>(mask));
+		}
+		from += 16;
+	}
+#endif
+	for (; from < to; from++) {
+		if (*from == a || *from == b || *from == c) {
+			return from;
+		}
+	}
+	return to;
+}
+
+
+/***************/
+/* CsvImporter */
+/***************/
+gre90r::CsvImporter::CsvImporter(Sqlite& db, const std::string& table, const CsvImportOptions& options)
+: m_db(db), m_table(table), m_options(options)
+{
+}
+
+
+int gre90r::CsvImporter::importFile(const char* filename) {
+	this->m_progress = CsvImportProgress();
+	if (filename == NULL) {
+		return -2;
+	}
+	MappedFile file(filename, true);
+	if (!file.isOpen()) {
+		GRE90R_LOG(LogLevel::Error, "csv import: cannot read " << filename << ".");
+		return SQLITE_CANTOPEN;
+	}
+	int rc = this->import(file.getData(), file.getSize(), [&file](std::size_t offset) {
+		file.release(offset);
+	});
+	GRE90R_LOG(LogLevel::Debug, "csv import: " << this->m_progress.rows << " rows from " << filename
+	           << " in " << this->m_progress.seconds << " s, "
+	           << this->m_progress.getBytesPerSecond() / (1024 * 1024) << " MiB/s.");
+	return rc;
+}
+
+
+int gre90r::CsvImporter::importText(std::string_view text) {
+	this->m_progress = CsvImportProgress();
+	return this->import(text.data(), text.size(), std::function<void(std::size_t)>());
+}
+
+
+const gre90r::CsvImportProgress& gre90r::CsvImporter::getProgress() const {
+	return this->m_progress;
+}
+
+
+int gre90r::CsvImporter::import(const char* data, std::size_t size,
+                                const std::function<void(std::size_t)>& release)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	this->m_progress.bytesTotal = size;
+
+	if (!this->m_db.isConnected()) {
+		GRE90R_LOG(LogLevel::Error, "csv import: not connected to DB.");
+		return SQLITE_MISUSE;
+	}
+
+	CsvReader reader(data, size, this->m_options.delimiter, this->m_options.quote);
+	std::vector<std::string_view> fields;
+	std::vector<std::string> columns = this->m_options.columns;
+	if (this->m_options.header && reader.next(fields) && columns.empty()) {
+		columns.assign(fields.begin(), fields.end());
+	}
+	if (this->m_options.createTable && !columns.empty()) {
+		int rc = this->createTable(columns);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+	}
+	if (columns.empty()) {
+		columns = this->getTableColumns();
+	}
+	if (columns.empty()) {
+		GRE90R_LOG(LogLevel::Error, "csv import: no columns to import into " << this->m_table << ".");
+		return SQLITE_ERROR;
+	}
+
+	BulkInserter inserter(this->m_db, this->m_table, columns, this->m_options.batch);
+	if (!inserter.isValid()) {
+		return SQLITE_ERROR;
+	}
+
+	// fields are bound in place, sqlite reads them while inserting the row
+	std::vector<std::optional<StaticText> > values(columns.size());
+	std::size_t nextReport = this->m_options.progressBytes;
+	int rc = SQLITE_OK;
+	while (reader.next(fields)) {
+		if (fields.size() != columns.size() || reader.isMalformed()) {
+			// the first one is logged, the others are counted
+			if (this->m_progress.malformedRows++ == 0 || this->m_options.onMalformed == CsvMalformed::Abort) {
+				GRE90R_LOG(LogLevel::Warning, "csv import: record "
+				           << this->m_progress.rows + this->m_progress.malformedRows << " has " << fields.size()
+				           << " fields, expected " << columns.size()
+				           << (reader.isMalformed() ? ", or bad quoting." : "."));
+			}
+			if (this->m_options.onMalformed == CsvMalformed::Abort) {
+				inserter.rollback();
+				rc = SQLITE_MISMATCH;
+				break;
+			}
+			if (this->m_options.onMalformed == CsvMalformed::Skip) {
+				continue;
+			}
+		}
+		for (std::size_t i = 0; i < values.size(); i++) {
+			if (i < fields.size() && !(this->m_options.emptyIsNull && fields[i].empty())) {
+				values[i] = StaticText{ fields[i] };
+			}
+			else {
+				values[i].reset();
+			}
+		}
+		rc = inserter.insertRow(values);
+		if (rc != SQLITE_OK) {
+			inserter.rollback();
+			break;
+		}
+		this->m_progress.rows++;
+
+		if (this->m_options.progressBytes > 0 && reader.getPosition() >= nextReport) {
+			nextReport = reader.getPosition() + this->m_options.progressBytes;
+			if (release) {
+				release(reader.getPosition());
+			}
+			if (this->m_options.progress) {
+				this->m_progress.bytesRead = reader.getPosition();
+				this->m_progress.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+				if (!this->m_options.progress(this->m_progress)) {
+					rc = SQLITE_ABORT;
+					break;
+				}
+			}
+		}
+	}
+
+	int finishRc = inserter.finish();
+	if (rc == SQLITE_OK) {
+		rc = finishRc;
+	}
+	this->m_progress.rows = inserter.getRowCount();
+	this->m_progress.bytesRead = reader.getPosition();
+	this->m_progress.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	if (rc == SQLITE_OK && this->m_options.progress) {
+		this->m_options.progress(this->m_progress);
+	}
+	return rc;
+}
+
+
+std::vector<std::string> gre90r::CsvImporter::getTableColumns() {
+	std::vector<std::string> columns;
+	for (const Row& row : this->m_db.query("select name from pragma_table_info(?)", this->m_table)) {
+		columns.push_back(row.getText(0));
+	}
+	return columns;
+}
+
+
+int gre90r::CsvImporter::createTable(const std::vector<std::string>& columns) {
+	std::string query = "create table if not exists " + quoteIdentifier(this->m_table) + " (";
+	for (std::size_t i = 0; i < columns.size(); i++) {
+		query += (i > 0 ? ", " : "") + quoteIdentifier(columns[i]) + " TEXT";
+	}
+	query += ");";
+	int rc = this->m_db.execute(query.c_str());
+	if (rc != SQLITE_OK) {
+		GRE90R_LOG(LogLevel::Error, "csv import: failed to create table " << this->m_table
+		           << ". rc = " << rc << ".");
+	}
+	return rc;
+}
@@ -0,0 +1,283 @@
+#ifndef SQLITECSVIMPORT_H
+#define SQLITECSVIMPORT_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BulkInserter.h"
+
+
+namespace gre90r {
+
+	class Sqlite;
+
+	/**
+	 * how far an import has come. passed to the progress callback and
+	 * returned as the result of the import.
+	 */
+	struct CsvImportProgress {
+		std::size_t bytesRead = 0; // of the input, including the header
+		std::size_t bytesTotal = 0;
+		unsigned long long rows = 0; // inserted records, without the header
+		unsigned long long malformedRows = 0; // records with too few or too many fields, or bad quoting, see CsvMalformed
+		double seconds = 0;
+
+		/**
+		 * @return input bytes per second. 0 before the first record.
+		 */
+		double getBytesPerSecond() const;
+
+		/**
+		 * @return inserted rows per second. 0 before the first record.
+		 */
+		double getRowsPerSecond() const;
+	};
+
+	/**
+	 * what an import does with a record which has too few or too many
+	 * fields, or a quoted field which is not closed or followed by other
+	 * characters
+	 */
+	enum class CsvMalformed {
+		Abort, // stop, roll back the uncommitted batch and return SQLITE_MISMATCH. committed batches are kept.
+		Skip, // leave the record out
+		Pad // insert it, missing fields as NULL, extra fields dropped
+	};
+
+	/**
+	 * format of the input and how it is written to the table
+	 */
+	struct CsvImportOptions {
+		/**
+		 * field separator. ',' for CSV, '\t' for TSV.
+		 */
+		char delimiter = ',';
+
+		/**
+		 * fields starting with this character are quoted. a doubled quote
+		 * inside is one quote. '\0': fields are never quoted.
+		 */
+		char quote = '"';
+
+		/**
+		 * true: the first record holds the column names
+		 */
+		bool header = true;
+
+		/**
+		 * columns to fill, in the order of the fields. empty: the names of
+		 * the header, or all columns of the table if there is no header.
+		 */
+		std::vector<std::string> columns;
+
+		/**
+		 * create the table with TEXT columns if it does not exist
+		 */
+		bool createTable = false;
+
+		/**
+		 * true: empty fields are inserted as NULL instead of ''
+		 */
+		bool emptyIsNull = false;
+
+		/**
+		 * what to do with malformed records. they are counted in
+		 * CsvImportProgress::malformedRows.
+		 */
+		CsvMalformed onMalformed = CsvMalformed::Abort;
+
+		/**
+		 * rows or bytes per committed transaction
+		 */
+		BulkInsertOptions batch;
+
+		/**
+		 * called about every progressBytes bytes of input and once at the end.
+		 * return false to stop the import. the rows inserted so far are kept.
+		 */
+		std::function<bool(const CsvImportProgress&)> progress;
+		std::size_t progressBytes = 16 * 1024 * 1024;
+	};
+
+	/**
+	 * splits CSV or TSV text in memory into records, following RFC 4180:
+	 * fields may be quoted, quoted fields may contain delimiters, line breaks
+	 * and doubled quotes. records end with \n, \r\n or \r. empty lines are skipped.
+	 *
+	 * fields point into the input and are not copied. only quoted fields
+	 * with doubled quotes are unescaped into an internal buffer. the next
+	 * delimiter, quote or line break is searched 16 bytes at a time with
+	 * SSE2 where available.
+	 */
+	class CsvReader {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		CsvReader() = delete;
+
+		/**
+		 * @param data the input. has to stay valid while reading.
+		 * @param size length of data in bytes. a leading UTF-8 byte order mark is skipped.
+		 */
+		CsvReader(const char* data, std::size_t size, char delimiter = ',', char quote = '"');
+
+		/**
+		 * forbid copy constructor
+		 */
+		CsvReader(const CsvReader&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		CsvReader& operator=(const CsvReader&) = delete;
+
+		/**
+		 * read the next record
+		 * @param fields receives the fields. valid until the next call or
+		 * 				 until the input is released.
+		 * @return false at the end of the input
+		 */
+		bool next(std::vector<std::string_view>& fields);
+
+		/**
+		 * @return true: the last record had a quoted field which was not
+		 * 				 closed, or characters after the closing quote
+		 */
+		bool isMalformed() const;
+
+		/**
+		 * @return number of bytes consumed so far
+		 */
+		std::size_t getPosition() const;
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		const char* m_begin;
+		const char* m_position;
+		const char* m_end;
+		char m_delimiter;
+		char m_quote;
+		bool m_malformed;
+		std::deque<std::string> m_unescaped; // deque: fields keep pointing to their string when it grows
+		std::size_t m_unescapedUsed; // strings of m_unescaped in use by the current record
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * read a quoted field. m_position is after the opening quote.
+		 */
+		std::string_view readQuoted();
+
+		/**
+		 * @return a cleared buffer for an unescaped field of the current record
+		 */
+		std::string& unescapeBuffer();
+
+		/**
+		 * @return first of a, b or c in [from, to). to if there is none.
+		 */
+		static const char* find(const char* from, const char* to, char a, char b, char c);
+	};
+
+	/**
+	 * imports a CSV or TSV file into a table.
+	 *
+	 * the file is memory mapped and read sequentially, pages which have been
+	 * imported are released again, so files larger than memory can be imported.
+	 * each record is bound field by field to one reused insert statement without
+	 * copying the text and inserted in batched transactions, see BulkInserter.
+	 * sqlite converts the text to the affinity of the column, so numbers end
+	 * up as numbers in INTEGER and REAL columns.
+	 *
+	 * a record with missing or extra fields stops the import by default,
+	 * CsvImportOptions::onMalformed can skip it or pad it with NULL instead.
+	 *
+	 * usage:
+	 *   gre90r::CsvImportOptions options;
+	 *   options.delimiter = '\t';
+	 *   gre90r::CsvImportProgress result;
+	 *   int rc = db.importCsv("people.tsv", "people", options, &result);
+	 */
+	class CsvImporter {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		CsvImporter() = delete;
+
+		/**
+		 * @param db the database to import into. has to stay open while importing.
+		 * @param table the table to insert into
+		 */
+		CsvImporter(Sqlite& db, const std::string& table,
+		            const CsvImportOptions& options = CsvImportOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		CsvImporter(const CsvImporter&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		CsvImporter& operator=(const CsvImporter&) = delete;
+
+		/**
+		 * import a file
+		 * @return sql error code. 0 is ok. SQLITE_CANTOPEN if the file cannot be read,
+		 * 				 SQLITE_ABORT if stopped by the progress callback,
+		 * 				 SQLITE_MISMATCH if a record is malformed and CsvMalformed::Abort is set,
+		 * 				 SQLITE_ERROR if there are no columns to fill. -2: filename is NULL.
+		 */
+		int importFile(const char* filename);
+
+		/**
+		 * import text which is already in memory
+		 * @return same as importFile()
+		 */
+		int importText(std::string_view text);
+
+		/**
+		 * @return progress of the running or last import
+		 */
+		const CsvImportProgress& getProgress() const;
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		Sqlite& m_db;
+		std::string m_table;
+		CsvImportOptions m_options;
+		CsvImportProgress m_progress;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * @param release called with the number of bytes imported so far, so
+		 * 				their memory can be given back. may be empty.
+		 */
+		int import(const char* data, std::size_t size, const std::function<void(std::size_t)>& release);
+
+		/**
+		 * @return names of the columns of the table. empty if it does not exist.
+		 */
+		std::vector<std::string> getTableColumns();
+
+		/**
+		 * create the table with TEXT columns if it does not exist
+		 */
+		int createTable(const std::vector<std::string>& columns);
+	};
+
+}
+
+#endif
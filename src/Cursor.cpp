@@ -0,0 +1,169 @@
+#include "Cursor.h"
+#include <utility>
+
+
+/*******/
+/* Row */
+/*******/
+gre90r::Row::Row(sqlite3_stmt* stmt)
+: m_stmt(stmt)
+{
+}
+
+
+int gre90r::Row::getColumnCount() const {
+	return sqlite3_column_count(this->m_stmt);
+}
+
+
+const char* gre90r::Row::getColumnName(int column) const {
+	return sqlite3_column_name(this->m_stmt, column);
+}
+
+
+int gre90r::Row::getType(int column) const {
+	return sqlite3_column_type(this->m_stmt, column);
+}
+
+
+bool gre90r::Row::isNull(int column) const {
+	return this->getType(column) == SQLITE_NULL;
+}
+
+
+const char* gre90r::Row::getText(int column) const {
+	return reinterpret_cast<const char*>(sqlite3_column_text(this->m_stmt, column));
+}
+
+
+std::size_t gre90r::Row::getLength(int column) const {
+	return static_cast<std::size_t>(sqlite3_column_bytes(this->m_stmt, column));
+}
+
+
+std::string gre90r::Row::toString(int column) const {
+	const char* text = this->getText(column);
+	if (text == NULL) {
+		return std::string();
+	}
+	return std::string(text, this->getLength(column));
+}
+
+
+/********************/
+/* Cursor::Iterator */
+/********************/
+gre90r::Cursor::Iterator::Iterator(Cursor* cursor)
+: m_cursor(cursor)
+{
+}
+
+
+const gre90r::Row& gre90r::Cursor::Iterator::operator*() const {
+	return this->m_cursor->getRow();
+}
+
+
+const gre90r::Row* gre90r::Cursor::Iterator::operator->() const {
+	return &this->m_cursor->getRow();
+}
+
+
+gre90r::Cursor::Iterator& gre90r::Cursor::Iterator::operator++() {
+	if (!this->m_cursor->next()) {
+		this->m_cursor = NULL; // reached the end
+	}
+	return *this;
+}
+
+
+bool gre90r::Cursor::Iterator::operator==(const Iterator& other) const {
+	return this->m_cursor == other.m_cursor;
+}
+
+
+bool gre90r::Cursor::Iterator::operator!=(const Iterator& other) const {
+	return this->m_cursor != other.m_cursor;
+}
+
+
+/**********/
+/* Cursor */
+/**********/
+gre90r::Cursor::Cursor(std::shared_ptr<Statement> statement)
+: m_statement(statement),
+  m_row(statement ? statement->getHandle() : NULL),
+  m_rc(SQLITE_OK)
+{
+}
+
+
+gre90r::Cursor::Cursor(std::shared_ptr<Statement> statement, int errorCode)
+: m_statement(statement),
+  m_row(statement ? statement->getHandle() : NULL),
+  m_rc(errorCode)
+{
+}
+
+
+gre90r::Cursor::Cursor(Cursor&& other)
+: m_statement(std::move(other.m_statement)), m_row(other.m_row), m_rc(other.m_rc)
+{
+}
+
+
+gre90r::Cursor::~Cursor() {
+	this->close();
+}
+
+
+bool gre90r::Cursor::isValid() const {
+	return this->m_statement && this->m_statement->isValid();
+}
+
+
+bool gre90r::Cursor::next() {
+	if (!this->isValid()) {
+		this->m_rc = this->m_statement ? this->m_statement->getErrorCode() : SQLITE_MISUSE;
+		return false;
+	}
+	if (this->m_rc != SQLITE_OK && this->m_rc != SQLITE_ROW) {
+		return false; // finished or failed before
+	}
+
+	this->m_rc = this->m_statement->step();
+	if (this->m_rc != SQLITE_ROW) {
+		// release locks as soon as the last row has been read
+		this->m_statement->reset();
+		return false;
+	}
+	return true;
+}
+
+
+const gre90r::Row& gre90r::Cursor::getRow() const {
+	return this->m_row;
+}
+
+
+int gre90r::Cursor::getErrorCode() const {
+	return this->m_rc;
+}
+
+
+void gre90r::Cursor::close() {
+	if (this->m_statement) {
+		this->m_statement->reset();
+		this->m_statement.reset(); // give the statement back to the cache
+	}
+}
+
+
+gre90r::Cursor::Iterator gre90r::Cursor::begin() {
+	return Iterator(this->next() ? this : NULL);
+}
+
+
+gre90r::Cursor::Iterator gre90r::Cursor::end() {
+	return Iterator(NULL);
+}
@@ -0,0 +1,248 @@
+#ifndef SQLITECURSOR_H
+#define SQLITECURSOR_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include "Statement.h"
+
+
+namespace gre90r {
+
+	/**
+	 * view of the current row of a running statement.
+	 *
+	 * nothing is copied. text returned by getText() points straight into
+	 * sqlite's column buffers and is valid until the statement steps to
+	 * the next row. use toString() to keep a value.
+	 */
+	class Row {
+	public:
+		/**
+		 * @param stmt the statement whose current row is read
+		 */
+		explicit Row(sqlite3_stmt* stmt);
+
+		/**
+		 * @return number of columns
+		 */
+		int getColumnCount() const;
+
+		/**
+		 * @return name of column
+		 */
+		const char* getColumnName(int column) const;
+
+		/**
+		 * @return SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_NULL
+		 */
+		int getType(int column) const;
+
+		/**
+		 * @return true: the value is sql NULL
+		 */
+		bool isNull(int column) const;
+
+		/**
+		 * @return text of column, not copied. NULL if the value is sql NULL.
+		 */
+		const char* getText(int column) const;
+
+		/**
+		 * @return number of bytes of the value. call it after getText(),
+		 * 				 so the value is not converted again.
+		 */
+		std::size_t getLength(int column) const;
+
+		/**
+		 * @return copy of the text of column. empty for sql NULL.
+		 */
+		std::string toString(int column) const;
+
+		/**
+		 * read a column as T. the sqlite3_column_* function is picked at compile time:
+		 * 	integers and bool -> int / int64, floating point -> double,
+		 * 	std::string_view and const char* -> text without copying,
+		 * 	std::string -> copy of the text, BlobView -> blob without copying,
+		 * 	std::optional<T> -> std::nullopt for sql NULL.
+		 * otherwise sql NULL reads as 0, empty text or an empty blob.
+		 * views are valid until the statement steps to the next row.
+		 */
+		template<typename T>
+		T get(int column) const;
+
+	protected:
+		sqlite3_stmt* m_stmt;
+	};
+
+
+	/**
+	 * streams the rows of a statement one by one with sqlite3_step().
+	 * only the current row is held in memory.
+	 *
+	 * usage:
+	 *   for (const gre90r::Row& row : sqlite.query("select name from employee")) {
+	 *     row.getText(0);
+	 *   }
+	 *
+	 * the statement is reset when the cursor is destroyed, so it does not
+	 * keep the database locked.
+	 */
+	class Cursor {
+	public:
+		/**
+		 * input iterator over the rows. advancing it steps the statement.
+		 */
+		class Iterator {
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef const Row value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const Row* pointer;
+			typedef const Row& reference;
+
+			explicit Iterator(Cursor* cursor);
+			const Row& operator*() const;
+			const Row* operator->() const;
+			Iterator& operator++();
+			bool operator==(const Iterator& other) const;
+			bool operator!=(const Iterator& other) const;
+		private:
+			Cursor* m_cursor; // NULL for the end iterator
+		};
+
+		/**
+		 * forbid standard constructor
+		 */
+		Cursor() = delete;
+
+		/**
+		 * @param statement compiled statement with its parameters already bound
+		 */
+		explicit Cursor(std::shared_ptr<Statement> statement);
+
+		/**
+		 * cursor which failed before its first step, e.g. binding a parameter.
+		 * it has no rows, getErrorCode() returns errorCode.
+		 */
+		Cursor(std::shared_ptr<Statement> statement, int errorCode);
+
+		/**
+		 * move constructor
+		 */
+		Cursor(Cursor&& other);
+
+		/**
+		 * forbid copy constructor
+		 */
+		Cursor(const Cursor&) = delete;
+
+		/**
+		 * reset the statement
+		 */
+		virtual ~Cursor();
+
+		/**
+		 * forbid assignment operator
+		 */
+		Cursor& operator=(const Cursor&) = delete;
+
+		/**
+		 * @return true: statement is valid and can be stepped
+		 */
+		bool isValid() const;
+
+		/**
+		 * step to the next row
+		 * @return true: a row is available with getRow().
+		 * 				 false: no more rows or an error. check getErrorCode().
+		 */
+		bool next();
+
+		/**
+		 * @return the current row. only valid after next() returned true.
+		 */
+		const Row& getRow() const;
+
+		/**
+		 * @return result of the last step. SQLITE_ROW while rows are read,
+		 * 				 SQLITE_DONE when all rows have been read. anything else is
+		 * 				 an sql error code.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * stop reading rows and reset the statement
+		 */
+		void close();
+
+		/**
+		 * steps to the first row
+		 */
+		Iterator begin();
+		Iterator end();
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		std::shared_ptr<Statement> m_statement;
+		Row m_row;
+		int m_rc; // result of the last step
+	};
+
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename T>
+	T Row::get(int column) const {
+		constexpr ValueKind kind = getValueKind<T>();
+		if constexpr (kind == ValueKind::Optional) {
+			if (this->isNull(column)) {
+				return std::nullopt;
+			}
+			return this->get<typename T::value_type>(column);
+		}
+		else if constexpr (kind == ValueKind::Bool) {
+			return sqlite3_column_int(this->m_stmt, column) != 0;
+		}
+		else if constexpr (kind == ValueKind::Int) {
+			return static_cast<T>(sqlite3_column_int(this->m_stmt, column));
+		}
+		else if constexpr (kind == ValueKind::Int64) {
+			return static_cast<T>(sqlite3_column_int64(this->m_stmt, column));
+		}
+		else if constexpr (kind == ValueKind::Real) {
+			return static_cast<T>(sqlite3_column_double(this->m_stmt, column));
+		}
+		else if constexpr (std::is_same<T, const char*>::value) {
+			return this->getText(column);
+		}
+		else if constexpr (std::is_same<T, std::string_view>::value) {
+			const char* text = this->getText(column);
+			if (text == NULL) {
+				return std::string_view();
+			}
+			return std::string_view(text, this->getLength(column));
+		}
+		else if constexpr (std::is_same<T, std::string>::value) {
+			return this->toString(column);
+		}
+		else if constexpr (kind == ValueKind::Blob) {
+			// sqlite3_column_blob before sqlite3_column_bytes, so the value is not converted
+			const void* data = sqlite3_column_blob(this->m_stmt, column);
+			BlobView blob = { data, this->getLength(column) };
+			return blob;
+		}
+		else {
+			static_assert(UnsupportedType<T>::value, "type cannot be read from an sql column");
+		}
+	}
+
+}
+
+#endif
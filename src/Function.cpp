@@ -0,0 +1,31 @@
+#include "Function.h"
+#include <exception>
+#include <new>
+
+
+void gre90r::FunctionAdapter::setError(sqlite3_context* context) {
+	try {
+		throw;
+	}
+	catch (const std::bad_alloc&) {
+		sqlite3_result_error_nomem(context);
+	}
+	catch (const std::exception& e) {
+		sqlite3_result_error(context, e.what(), -1);
+	}
+	catch (...) {
+		sqlite3_result_error(context, "unknown exception in function", -1);
+	}
+}
+
+
+int gre90r::FunctionAdapter::getFlags(const FunctionOptions& options) {
+	int flags = SQLITE_UTF8;
+	if (options.deterministic) {
+		flags |= SQLITE_DETERMINISTIC;
+	}
+	if (options.directOnly) {
+		flags |= SQLITE_DIRECTONLY;
+	}
+	return flags;
+}
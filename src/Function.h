@@ -0,0 +1,401 @@
+#ifndef SQLITEFUNCTION_H
+#define SQLITEFUNCTION_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "Statement.h"
+
+
+namespace gre90r {
+
+	/**
+	 * how sqlite may use a function registered with Sqlite::registerFunction()
+	 * or Sqlite::registerAggregate()
+	 */
+	struct FunctionOptions {
+		/**
+		 * true: the result only depends on the arguments (SQLITE_DETERMINISTIC).
+		 * sqlite may then call the function once for constant arguments, use it
+		 * in indexes and generated columns, and the result cache caches the
+		 * queries calling it.
+		 */
+		bool deterministic = false;
+
+		/**
+		 * true: the function can only be called from top-level sql, not from
+		 * triggers, views or schema (SQLITE_DIRECTONLY). for functions with
+		 * side effects, so a crafted database file cannot call them.
+		 */
+		bool directOnly = false;
+	};
+
+	/**
+	 * result and argument types of a function pointer, lambda or functor.
+	 * the arguments are decayed, so const std::string& reads as std::string.
+	 */
+	template<typename F>
+	struct FunctionTraits : FunctionTraits<decltype(&F::operator())> {};
+
+	template<typename R, typename... A>
+	struct FunctionTraits<R(*)(A...)> {
+		typedef R Result;
+		typedef std::tuple<typename std::decay<A>::type...> Arguments;
+		static const std::size_t arity = sizeof...(A);
+	};
+
+	template<typename R, typename... A>
+	struct FunctionTraits<R(A...)> : FunctionTraits<R(*)(A...)> {};
+
+	template<typename C, typename R, typename... A>
+	struct FunctionTraits<R(C::*)(A...)> : FunctionTraits<R(*)(A...)> {};
+
+	template<typename C, typename R, typename... A>
+	struct FunctionTraits<R(C::*)(A...) const> : FunctionTraits<R(*)(A...)> {};
+
+	/**
+	 * true for aggregates with inverse() and value(), which can be used
+	 * as window functions
+	 */
+	template<typename A, typename = void>
+	struct IsWindowFunction : std::false_type {};
+	template<typename A>
+	struct IsWindowFunction<A, std::void_t<decltype(&A::inverse), decltype(&A::value)> > : std::true_type {};
+
+	/**
+	 * the callbacks sqlite calls for functions registered with
+	 * Sqlite::registerFunction() and Sqlite::registerAggregate().
+	 * the sqlite3_value_* and sqlite3_result_* calls are picked at
+	 * compile time from the C++ types:
+	 * 	arguments: integers and bool -> int / int64, floating point -> double,
+	 * 		std::string_view and const char* -> text without copying,
+	 * 		std::string -> copy of the text, BlobView -> blob without copying,
+	 * 		std::optional<T> -> std::nullopt for sql NULL, sqlite3_value* -> the value itself.
+	 * 		otherwise sql NULL reads as 0, empty text or an empty blob.
+	 * 	results: the types Statement::bind() accepts, std::nullopt and nullptr
+	 * 		are sql NULL, a void function returns NULL.
+	 * an exception thrown by the function becomes the sql error of the
+	 * statement, it never reaches sqlite.
+	 */
+	class FunctionAdapter {
+	public:
+		/**
+		 * @return argument value as T
+		 */
+		template<typename T>
+		static T getValue(sqlite3_value* value);
+
+		/**
+		 * set result as the result of the function
+		 */
+		template<typename T>
+		static void setResult(sqlite3_context* context, const T& result);
+
+		/**
+		 * report the exception being handled as the error of the function.
+		 * has to be called in a catch block.
+		 */
+		static void setError(sqlite3_context* context);
+
+		/**
+		 * @return text encoding and SQLITE_DETERMINISTIC / SQLITE_DIRECTONLY
+		 */
+		static int getFlags(const FunctionOptions& options);
+
+		/**
+		 * xFunc of a scalar function. the user data is an F.
+		 */
+		template<typename F>
+		static void call(sqlite3_context* context, int argc, sqlite3_value** argv);
+
+		/**
+		 * xStep, xInverse, xValue and xFinal of an aggregate. the user data
+		 * is the prototype A, each group works on its own copy of it.
+		 */
+		template<typename A>
+		static void step(sqlite3_context* context, int argc, sqlite3_value** argv);
+		template<typename A>
+		static void inverse(sqlite3_context* context, int argc, sqlite3_value** argv);
+		template<typename A>
+		static void value(sqlite3_context* context);
+		template<typename A>
+		static void finalize(sqlite3_context* context);
+
+		/**
+		 * xDestroy. deletes the user data.
+		 */
+		template<typename T>
+		static void destroy(void* data);
+
+	private:
+		/**
+		 * call function with the arguments read from argv
+		 */
+		template<typename F, std::size_t... I>
+		static void invoke(sqlite3_context* context, F& function, sqlite3_value** argv, std::index_sequence<I...>);
+
+		/**
+		 * call aggregate.step() or aggregate.inverse() with the arguments read from argv
+		 */
+		template<typename A, std::size_t... I>
+		static void invokeStep(A& aggregate, bool inverse, sqlite3_value** argv, std::index_sequence<I...>);
+
+		/**
+		 * @param create true: copy the prototype for the group if it has no state yet
+		 * @return state of the current group. NULL if none or out of memory.
+		 */
+		template<typename A>
+		static A* getState(sqlite3_context* context, bool create);
+	};
+
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename T>
+	T FunctionAdapter::getValue(sqlite3_value* value) {
+		constexpr ValueKind kind = getValueKind<T>();
+		if constexpr (kind == ValueKind::Optional) {
+			if (sqlite3_value_type(value) == SQLITE_NULL) {
+				return std::nullopt;
+			}
+			return getValue<typename T::value_type>(value);
+		}
+		else if constexpr (std::is_same<T, sqlite3_value*>::value) {
+			return value;
+		}
+		else if constexpr (kind == ValueKind::Bool) {
+			return sqlite3_value_int(value) != 0;
+		}
+		else if constexpr (kind == ValueKind::Int) {
+			return static_cast<T>(sqlite3_value_int(value));
+		}
+		else if constexpr (kind == ValueKind::Int64) {
+			return static_cast<T>(sqlite3_value_int64(value));
+		}
+		else if constexpr (kind == ValueKind::Real) {
+			return static_cast<T>(sqlite3_value_double(value));
+		}
+		else if constexpr (std::is_same<T, const char*>::value) {
+			return reinterpret_cast<const char*>(sqlite3_value_text(value));
+		}
+		else if constexpr (std::is_same<T, std::string_view>::value || std::is_same<T, std::string>::value) {
+			// sqlite3_value_text before sqlite3_value_bytes, so the length is the one of the text
+			const char* text = reinterpret_cast<const char*>(sqlite3_value_text(value));
+			if (text == NULL) {
+				return T();
+			}
+			return T(text, static_cast<std::size_t>(sqlite3_value_bytes(value)));
+		}
+		else if constexpr (kind == ValueKind::Blob) {
+			const void* data = sqlite3_value_blob(value);
+			BlobView blob = { data, static_cast<std::size_t>(sqlite3_value_bytes(value)) };
+			return blob;
+		}
+		else {
+			static_assert(UnsupportedType<T>::value, "type cannot be read from a function argument");
+		}
+	}
+
+
+	template<typename T>
+	void FunctionAdapter::setResult(sqlite3_context* context, const T& result) {
+		constexpr ValueKind kind = getValueKind<T>();
+		if constexpr (kind == ValueKind::Null) {
+			sqlite3_result_null(context);
+		}
+		else if constexpr (kind == ValueKind::Bool) {
+			sqlite3_result_int(context, result ? 1 : 0);
+		}
+		else if constexpr (kind == ValueKind::Int) {
+			sqlite3_result_int(context, static_cast<int>(result));
+		}
+		else if constexpr (kind == ValueKind::Int64) {
+			sqlite3_result_int64(context, static_cast<sqlite3_int64>(result));
+		}
+		else if constexpr (kind == ValueKind::Real) {
+			sqlite3_result_double(context, static_cast<double>(result));
+		}
+		else if constexpr (kind == ValueKind::CString) {
+			if (result == NULL) {
+				sqlite3_result_null(context);
+			}
+			else {
+				sqlite3_result_text(context, result, -1, SQLITE_TRANSIENT);
+			}
+		}
+		else if constexpr (kind == ValueKind::Text) {
+			std::string_view text(result);
+			sqlite3_result_text64(context, text.data(), text.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+		}
+		else if constexpr (kind == ValueKind::StaticText) {
+			sqlite3_result_text64(context, result.text.data(), result.text.size(), SQLITE_STATIC, SQLITE_UTF8);
+		}
+		else if constexpr (kind == ValueKind::Blob) {
+			sqlite3_result_blob64(context, result.data, result.size, SQLITE_TRANSIENT);
+		}
+		else if constexpr (kind == ValueKind::ZeroBlob) {
+			sqlite3_result_zeroblob64(context, result.size);
+		}
+		else if constexpr (kind == ValueKind::Optional) {
+			if (!result) {
+				sqlite3_result_null(context);
+			}
+			else {
+				setResult(context, *result);
+			}
+		}
+		else {
+			static_assert(UnsupportedType<T>::value, "type cannot be returned from a function");
+		}
+	}
+
+
+	template<typename F>
+	void FunctionAdapter::call(sqlite3_context* context, int argc, sqlite3_value** argv) {
+		(void)argc; // registered with the arity of F
+		F& function = *static_cast<F*>(sqlite3_user_data(context));
+		try {
+			invoke(context, function, argv, std::make_index_sequence<FunctionTraits<F>::arity>());
+		}
+		catch (...) {
+			setError(context);
+		}
+	}
+
+
+	template<typename A>
+	void FunctionAdapter::step(sqlite3_context* context, int argc, sqlite3_value** argv) {
+		(void)argc;
+		try {
+			A* state = getState<A>(context, true);
+			if (state == NULL) {
+				sqlite3_result_error_nomem(context);
+				return;
+			}
+			invokeStep(*state, false, argv, std::make_index_sequence<FunctionTraits<decltype(&A::step)>::arity>());
+		}
+		catch (...) {
+			setError(context);
+		}
+	}
+
+
+	template<typename A>
+	void FunctionAdapter::inverse(sqlite3_context* context, int argc, sqlite3_value** argv) {
+		(void)argc;
+		try {
+			A* state = getState<A>(context, true);
+			if (state == NULL) {
+				sqlite3_result_error_nomem(context);
+				return;
+			}
+			invokeStep(*state, true, argv, std::make_index_sequence<FunctionTraits<decltype(&A::step)>::arity>());
+		}
+		catch (...) {
+			setError(context);
+		}
+	}
+
+
+	template<typename A>
+	void FunctionAdapter::value(sqlite3_context* context) {
+		try {
+			A* state = getState<A>(context, false);
+			if (state != NULL) {
+				setResult(context, state->value());
+			}
+			else {
+				// no row in the frame
+				A empty(*static_cast<A*>(sqlite3_user_data(context)));
+				setResult(context, empty.value());
+			}
+		}
+		catch (...) {
+			setError(context);
+		}
+	}
+
+
+	template<typename A>
+	void FunctionAdapter::finalize(sqlite3_context* context) {
+		A** slot = static_cast<A**>(sqlite3_aggregate_context(context, 0));
+		std::unique_ptr<A> state(slot != NULL ? *slot : NULL);
+		if (slot != NULL) {
+			*slot = NULL;
+		}
+		try {
+			if (state) {
+				setResult(context, state->finalize());
+			}
+			else {
+				// the group has no rows, e.g. an aggregate over an empty table
+				A empty(*static_cast<A*>(sqlite3_user_data(context)));
+				setResult(context, empty.finalize());
+			}
+		}
+		catch (...) {
+			setError(context);
+		}
+	}
+
+
+	template<typename T>
+	void FunctionAdapter::destroy(void* data) {
+		delete static_cast<T*>(data);
+	}
+
+
+	template<typename F, std::size_t... I>
+	void FunctionAdapter::invoke(sqlite3_context* context, F& function, sqlite3_value** argv,
+	                             std::index_sequence<I...>)
+	{
+		(void)argv; // unused without arguments
+		typedef typename FunctionTraits<F>::Arguments Arguments;
+		if constexpr (std::is_void<typename FunctionTraits<F>::Result>::value) {
+			function(getValue<typename std::tuple_element<I, Arguments>::type>(argv[I])...);
+			sqlite3_result_null(context);
+		}
+		else {
+			setResult(context, function(getValue<typename std::tuple_element<I, Arguments>::type>(argv[I])...));
+		}
+	}
+
+
+	template<typename A, std::size_t... I>
+	void FunctionAdapter::invokeStep(A& aggregate, bool inverse, sqlite3_value** argv, std::index_sequence<I...>) {
+		(void)argv;
+		typedef typename FunctionTraits<decltype(&A::step)>::Arguments Arguments;
+		if constexpr (IsWindowFunction<A>::value) {
+			if (inverse) {
+				aggregate.inverse(getValue<typename std::tuple_element<I, Arguments>::type>(argv[I])...);
+				return;
+			}
+		}
+		aggregate.step(getValue<typename std::tuple_element<I, Arguments>::type>(argv[I])...);
+	}
+
+
+	template<typename A>
+	A* FunctionAdapter::getState(sqlite3_context* context, bool create) {
+		// sqlite keeps a zeroed pointer per group, freed after finalize()
+		A** slot = static_cast<A**>(sqlite3_aggregate_context(context, create ? sizeof(A*) : 0));
+		if (slot == NULL) {
+			return NULL;
+		}
+		if (*slot == NULL && create) {
+			*slot = new A(*static_cast<A*>(sqlite3_user_data(context)));
+		}
+		return *slot;
+	}
+
+}
+
+#endif
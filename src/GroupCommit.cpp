@@ -0,0 +1,162 @@
+#include "GroupCommit.h"
+#include "Log.h"
+#include "Sqlite.h"
+
+
+gre90r::GroupCommit::GroupCommit(const char* filename, const GroupCommitOptions& options)
+: m_filename(filename ? filename : ""),
+  m_options(options),
+  m_stopping(false),
+  m_commits(0),
+  m_works(0)
+{
+	// Sqlite keeps the pointer to the name, m_filename outlives it
+	this->m_db.reset(new Sqlite(this->m_filename.c_str()));
+	if (this->m_options.maxGroupSize == 0) {
+		this->m_options.maxGroupSize = 1;
+	}
+	this->m_writer = std::thread(&GroupCommit::run, this);
+}
+
+
+gre90r::GroupCommit::~GroupCommit() {
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_stopping = true;
+	}
+	this->m_wakeup.notify_all();
+	this->m_writer.join();
+}
+
+
+bool gre90r::GroupCommit::isValid() const {
+	return this->m_db->isConnected();
+}
+
+
+std::future<int> gre90r::GroupCommit::submit(Work work) {
+	return this->enqueue(std::move(work), false);
+}
+
+
+std::future<int> gre90r::GroupCommit::submitStandalone(Work work) {
+	return this->enqueue(std::move(work), true);
+}
+
+
+std::future<int> gre90r::GroupCommit::enqueue(Work work, bool standalone) {
+	Job job;
+	job.work = std::move(work);
+	job.standalone = standalone;
+	std::future<int> result = job.result.get_future();
+
+	if (!this->isValid()) {
+		job.result.set_value(-3); // not connected to database
+		return result;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		this->m_queue.push_back(std::move(job));
+	}
+	this->m_wakeup.notify_one();
+	return result;
+}
+
+
+unsigned long long gre90r::GroupCommit::getCommitCount() const {
+	return this->m_commits.load();
+}
+
+
+unsigned long long gre90r::GroupCommit::getWorkCount() const {
+	return this->m_works.load();
+}
+
+
+void gre90r::GroupCommit::run() {
+	std::vector<Job> group;
+	group.reserve(this->m_options.maxGroupSize);
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(this->m_mutex);
+			this->m_wakeup.wait(lock, [this] { return !this->m_queue.empty() || this->m_stopping; });
+			if (this->m_queue.empty()) {
+				return; // stopping and nothing left to do
+			}
+
+			// standalone work runs on its own, outside of a transaction
+			if (this->m_queue.front().standalone) {
+				Job job = std::move(this->m_queue.front());
+				this->m_queue.pop_front();
+				lock.unlock();
+				job.result.set_value(job.work(*this->m_db));
+				continue;
+			}
+
+			// the first work opens the window. wait for more work until the
+			// window closes or the group is full.
+			std::chrono::steady_clock::time_point deadline =
+				std::chrono::steady_clock::now() + this->m_options.window;
+			this->m_wakeup.wait_until(lock, deadline, [this] {
+				return this->m_queue.size() >= this->m_options.maxGroupSize || this->m_stopping;
+			});
+
+			while (!this->m_queue.empty() && group.size() < this->m_options.maxGroupSize
+			       && !this->m_queue.front().standalone) {
+				group.push_back(std::move(this->m_queue.front()));
+				this->m_queue.pop_front();
+			}
+		}
+
+		this->commitGroup(group);
+		group.clear();
+	}
+}
+
+
+void gre90r::GroupCommit::commitGroup(std::vector<Job>& group) {
+	std::vector<int> results(group.size(), SQLITE_OK);
+
+	Transaction transaction(*this->m_db, this->m_options.mode);
+	if (!transaction.isActive()) {
+		for (std::size_t i = 0; i < group.size(); i++) {
+			group[i].result.set_value(transaction.getErrorCode());
+		}
+		return;
+	}
+
+	for (std::size_t i = 0; i < group.size(); i++) {
+		// each work in its own savepoint, so a failing work
+		// does not discard the others
+		Savepoint savepoint(*this->m_db);
+		if (!savepoint.isActive()) {
+			// without its savepoint a failing work could not be undone
+			results[i] = savepoint.getErrorCode();
+			continue;
+		}
+		results[i] = group[i].work(*this->m_db);
+		if (results[i] == SQLITE_OK) {
+			savepoint.release();
+		}
+		else {
+			savepoint.rollback();
+		}
+		this->m_works++;
+	}
+
+	int rc = transaction.commit();
+	if (rc != SQLITE_OK) {
+		GRE90R_LOG(LogLevel::Error, "group commit of " << group.size()
+		           << " writes failed. rc = " << rc << ".");
+		transaction.rollback();
+	}
+	else {
+		this->m_commits++;
+	}
+
+	for (std::size_t i = 0; i < group.size(); i++) {
+		group[i].result.set_value(rc != SQLITE_OK && results[i] == SQLITE_OK ? rc : results[i]);
+	}
+}
@@ -0,0 +1,173 @@
+#ifndef SQLITEGROUPCOMMIT_H
+#define SQLITEGROUPCOMMIT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Transaction.h"
+
+
+namespace gre90r {
+
+	class Sqlite;
+
+	/**
+	 * how GroupCommit merges work into transactions
+	 */
+	struct GroupCommitOptions {
+		/**
+		 * after the first work of a group arrives, wait this long for more
+		 * work before committing. this is the latency added to each write.
+		 */
+		std::chrono::microseconds window = std::chrono::microseconds(2000);
+
+		/**
+		 * commit early once this many works have been collected
+		 */
+		std::size_t maxGroupSize = 256;
+
+		/**
+		 * mode of the merged transactions
+		 */
+		TransactionMode mode = TransactionMode::Immediate;
+	};
+
+	/**
+	 * merges small write transactions from many threads into one
+	 * transaction, so they share a single commit and fsync.
+	 *
+	 * owns its own connection and a writer thread. every work submitted
+	 * runs inside its own savepoint: if the work fails only its changes
+	 * are rolled back, the rest of the group is committed. the future
+	 * of a work is ready once its group has been committed.
+	 *
+	 * usage:
+	 *   gre90r::GroupCommit writer("app.db");
+	 *   std::future<int> rc = writer.submit([](gre90r::Sqlite& db) {
+	 *     return db.execute("insert into log values (?)", "message");
+	 *   });
+	 *   rc.get(); // 0 once committed
+	 */
+	class GroupCommit {
+	public:
+		/**
+		 * a write. returns an sql error code, 0 is ok. must not throw and
+		 * must not start or finish transactions itself, savepoints are fine.
+		 */
+		typedef std::function<int(Sqlite& db)> Work;
+
+		/**
+		 * forbid standard constructor
+		 */
+		GroupCommit() = delete;
+
+		/**
+		 * open the connection and start the writer thread
+		 * @param filename database file
+		 * @param options commit window and group size
+		 */
+		explicit GroupCommit(const char* filename,
+		                     const GroupCommitOptions& options = GroupCommitOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		GroupCommit(const GroupCommit&) = delete;
+
+		/**
+		 * commits all work submitted so far, then stops the writer thread
+		 */
+		virtual ~GroupCommit();
+
+		/**
+		 * forbid assignment operator
+		 */
+		GroupCommit& operator=(const GroupCommit&) = delete;
+
+		/**
+		 * @return true: connection is open and work can be submitted
+		 */
+		bool isValid() const;
+
+		/**
+		 * queue a write. thread-safe.
+		 * @param work the write to run on the writer connection
+		 * @return sql error code of the work once its group has been committed.
+		 * 				 if the commit fails, its error code. -3 if not connected.
+		 */
+		std::future<int> submit(Work work);
+
+		/**
+		 * queue work which runs on the writer connection on its own, between
+		 * two groups and outside of any transaction. e.g. checkpoints or
+		 * connection settings. thread-safe.
+		 * @param work runs once all work submitted before has been committed
+		 * @return sql error code of the work. -3 if not connected.
+		 */
+		std::future<int> submitStandalone(Work work);
+
+		/**
+		 * @return number of commits, one per group
+		 */
+		unsigned long long getCommitCount() const;
+
+		/**
+		 * @return number of works run
+		 */
+		unsigned long long getWorkCount() const;
+
+	private:
+		/**
+		 * a queued write and where its result goes
+		 */
+		struct Job {
+			Work work;
+			std::promise<int> result;
+			bool standalone; // runs outside of a group transaction
+		};
+
+		/**************/
+		/* Attributes */
+		/**************/
+		std::string m_filename;
+		GroupCommitOptions m_options;
+		std::unique_ptr<Sqlite> m_db; // only used by the writer thread
+		std::mutex m_mutex; // protects m_queue and m_stopping
+		std::condition_variable m_wakeup;
+		std::deque<Job> m_queue;
+		bool m_stopping;
+		std::atomic<unsigned long long> m_commits;
+		std::atomic<unsigned long long> m_works;
+		std::thread m_writer;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * add a job to the queue
+		 */
+		std::future<int> enqueue(Work work, bool standalone);
+
+		/**
+		 * writer thread: collects groups and commits them
+		 */
+		void run();
+
+		/**
+		 * run all jobs of a group in one transaction and fulfill their futures
+		 */
+		void commitGroup(std::vector<Job>& group);
+	};
+
+}
+
+#endif
@@ -0,0 +1,344 @@
+#include "Instrumentation.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+
+/********************/
+/* LatencyHistogram */
+/********************/
+gre90r::LatencyHistogram::LatencyHistogram()
+: m_buckets(BUCKETS, 0), m_count(0), m_max(0)
+{
+}
+
+
+void gre90r::LatencyHistogram::record(std::uint64_t nanos) {
+	this->m_buckets[bucketOf(nanos)]++;
+	this->m_count++;
+	this->m_max = std::max(this->m_max, nanos);
+}
+
+
+std::uint64_t gre90r::LatencyHistogram::getCount() const {
+	return this->m_count;
+}
+
+
+std::uint64_t gre90r::LatencyHistogram::getMax() const {
+	return this->m_max;
+}
+
+
+std::uint64_t gre90r::LatencyHistogram::getPercentile(double percentile) const {
+	if (this->m_count == 0) {
+		return 0;
+	}
+	// rank of the sample, 1-based
+	std::uint64_t rank = static_cast<std::uint64_t>(percentile / 100.0 * this->m_count + 0.5);
+	rank = std::min(std::max<std::uint64_t>(rank, 1), this->m_count);
+
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < this->m_buckets.size(); i++) {
+		seen += this->m_buckets[i];
+		if (seen >= rank) {
+			return std::min(upperBoundOf(i), this->m_max);
+		}
+	}
+	return this->m_max;
+}
+
+
+void gre90r::LatencyHistogram::clear() {
+	std::fill(this->m_buckets.begin(), this->m_buckets.end(), 0);
+	this->m_count = 0;
+	this->m_max = 0;
+}
+
+
+std::size_t gre90r::LatencyHistogram::bucketOf(std::uint64_t nanos) {
+	// small values have a bucket each
+	if (nanos < (2u << SUB_BITS)) {
+		return static_cast<std::size_t>(nanos);
+	}
+	// power of two, then the next SUB_BITS bits below the highest one
+	int exponent = 63 - __builtin_clzll(nanos);
+	std::size_t sub = static_cast<std::size_t>(nanos >> (exponent - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+	return static_cast<std::size_t>(exponent - SUB_BITS - 1) * (1u << SUB_BITS) + (2u << SUB_BITS) + sub;
+}
+
+
+std::uint64_t gre90r::LatencyHistogram::upperBoundOf(std::size_t bucket) {
+	if (bucket < (2u << SUB_BITS)) {
+		return bucket;
+	}
+	std::size_t index = bucket - (2u << SUB_BITS);
+	int exponent = static_cast<int>(index >> SUB_BITS) + SUB_BITS + 1;
+	std::uint64_t sub = index & ((1u << SUB_BITS) - 1);
+	std::uint64_t width = std::uint64_t(1) << (exponent - SUB_BITS);
+	std::uint64_t lower = ((std::uint64_t(1) << SUB_BITS) + sub) << (exponent - SUB_BITS);
+	return lower + (width - 1);
+}
+
+
+/*********************/
+/* ConnectionMetrics */
+/*********************/
+/**
+ * @return text as a JSON string literal
+ */
+static std::string jsonString(const std::string& text) {
+	std::string result = "\"";
+	for (char c : text) {
+		switch (c) {
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				result += escaped;
+			}
+			else {
+				result += c;
+			}
+		}
+	}
+	return result + "\"";
+}
+
+
+std::string gre90r::ConnectionMetrics::toJson() const {
+	std::ostringstream json;
+	json << "{\"cacheHits\":" << this->cacheHits
+	     << ",\"cacheMisses\":" << this->cacheMisses
+	     << ",\"cacheWrites\":" << this->cacheWrites
+	     << ",\"cacheUsedBytes\":" << this->cacheUsedBytes
+	     << ",\"statements\":[";
+	for (std::size_t i = 0; i < this->statements.size(); i++) {
+		const StatementMetrics& statement = this->statements[i];
+		json << (i > 0 ? "," : "")
+		     << "{\"sql\":" << jsonString(statement.sql)
+		     << ",\"calls\":" << statement.calls
+		     << ",\"rows\":" << statement.rows
+		     << ",\"totalNanos\":" << statement.totalNanos
+		     << ",\"p50Nanos\":" << statement.p50Nanos
+		     << ",\"p99Nanos\":" << statement.p99Nanos
+		     << ",\"maxNanos\":" << statement.maxNanos
+		     << ",\"fullscanSteps\":" << statement.fullscanSteps
+		     << ",\"sorts\":" << statement.sorts
+		     << ",\"autoindexes\":" << statement.autoindexes
+		     << ",\"vmSteps\":" << statement.vmSteps
+		     << "}";
+	}
+	json << "]}";
+	return json.str();
+}
+
+
+/*******************/
+/* Instrumentation */
+/*******************/
+gre90r::Instrumentation::Instrumentation(sqlite3* db)
+: m_db(db), m_lastStatement(NULL), m_lastSql(NULL), m_lastEntry(NULL)
+{
+	sqlite3_trace_v2(this->m_db, SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, trace, this);
+}
+
+
+gre90r::Instrumentation::~Instrumentation() {
+	sqlite3_trace_v2(this->m_db, 0, NULL, NULL);
+}
+
+
+gre90r::ConnectionMetrics gre90r::Instrumentation::getMetrics() const {
+	ConnectionMetrics metrics;
+	int current = 0;
+	int highwater = 0;
+	if (sqlite3_db_status(this->m_db, SQLITE_DBSTATUS_CACHE_HIT, &current, &highwater, 0) == SQLITE_OK) {
+		metrics.cacheHits = current;
+	}
+	if (sqlite3_db_status(this->m_db, SQLITE_DBSTATUS_CACHE_MISS, &current, &highwater, 0) == SQLITE_OK) {
+		metrics.cacheMisses = current;
+	}
+	if (sqlite3_db_status(this->m_db, SQLITE_DBSTATUS_CACHE_WRITE, &current, &highwater, 0) == SQLITE_OK) {
+		metrics.cacheWrites = current;
+	}
+	if (sqlite3_db_status(this->m_db, SQLITE_DBSTATUS_CACHE_USED, &current, &highwater, 0) == SQLITE_OK) {
+		metrics.cacheUsedBytes = current;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->m_mutex);
+		metrics.statements.reserve(this->m_entries.size());
+		for (const auto& item : this->m_entries) {
+			const Entry& entry = *item.second;
+			StatementMetrics statement;
+			statement.sql = entry.sql;
+			statement.calls = entry.calls;
+			statement.rows = entry.rows;
+			statement.totalNanos = entry.totalNanos;
+			statement.p50Nanos = entry.latency.getPercentile(50);
+			statement.p99Nanos = entry.latency.getPercentile(99);
+			statement.maxNanos = entry.latency.getMax();
+			statement.fullscanSteps = entry.fullscanSteps;
+			statement.sorts = entry.sorts;
+			statement.autoindexes = entry.autoindexes;
+			statement.vmSteps = entry.vmSteps;
+			metrics.statements.push_back(statement);
+		}
+	}
+
+	std::sort(metrics.statements.begin(), metrics.statements.end(),
+	          [](const StatementMetrics& a, const StatementMetrics& b) { return a.totalNanos > b.totalNanos; });
+	return metrics;
+}
+
+
+void gre90r::Instrumentation::reset() {
+	std::lock_guard<std::mutex> lock(this->m_mutex);
+	this->m_bindings.clear();
+	this->m_entries.clear();
+	this->m_lastStatement = NULL;
+	this->m_lastSql = NULL;
+	this->m_lastEntry = NULL;
+}
+
+
+std::string gre90r::Instrumentation::normalize(const char* sql) {
+	std::string result;
+	if (sql == NULL) {
+		return result;
+	}
+	result.reserve(std::strlen(sql));
+
+	const char* c = sql;
+	while (*c != '\0') {
+		unsigned char current = static_cast<unsigned char>(*c);
+		if (std::isspace(current)) {
+			// collapse whitespace into one blank
+			while (std::isspace(static_cast<unsigned char>(*c))) {
+				c++;
+			}
+			if (!result.empty() && *c != '\0') {
+				result += ' ';
+			}
+		}
+		else if (current == '\'') {
+			// string literal, '' is an escaped quote
+			c++;
+			while (*c != '\0' && !(*c == '\'' && c[1] != '\'')) {
+				c += (*c == '\'') ? 2 : 1;
+			}
+			if (*c != '\0') {
+				c++;
+			}
+			result += '?';
+		}
+		else if (current == '"' || current == '`' || current == '[') {
+			// quoted identifier, copied as it is
+			char close = current == '[' ? ']' : static_cast<char>(current);
+			result += *c++;
+			while (*c != '\0' && *c != close) {
+				result += *c++;
+			}
+			if (*c != '\0') {
+				result += *c++;
+			}
+		}
+		else if (std::isdigit(current) || (current == '.' && std::isdigit(static_cast<unsigned char>(c[1])))) {
+			// a number, unless it is part of a name like t1 or ?1
+			char previous = result.empty() ? ' ' : result.back();
+			bool partOfName = std::isalnum(static_cast<unsigned char>(previous)) || previous == '_'
+			                  || previous == '?' || previous == '$' || previous == ':' || previous == '@';
+			if (partOfName) {
+				result += *c++;
+			}
+			else {
+				while (std::isalnum(static_cast<unsigned char>(*c)) || *c == '.'
+				       || ((*c == '+' || *c == '-') && (c[-1] == 'e' || c[-1] == 'E'))) {
+					c++;
+				}
+				result += '?';
+			}
+		}
+		else {
+			result += *c++;
+		}
+	}
+	return result;
+}
+
+
+int gre90r::Instrumentation::trace(unsigned int type, void* context, void* statement, void* detail) {
+	Instrumentation* self = static_cast<Instrumentation*>(context);
+	sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(statement);
+
+	std::lock_guard<std::mutex> lock(self->m_mutex);
+	Entry* entry = self->entryOf(stmt);
+	if (type == SQLITE_TRACE_ROW) {
+		entry->rows++;
+	}
+	else if (type == SQLITE_TRACE_PROFILE) {
+		std::uint64_t nanos = static_cast<std::uint64_t>(*static_cast<sqlite3_int64*>(detail));
+		entry->calls++;
+		entry->totalNanos += nanos;
+		entry->latency.record(nanos);
+		// reset the counters, so the next run only reports its own work
+		entry->fullscanSteps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+		entry->sorts += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+		entry->autoindexes += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+		entry->vmSteps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+	}
+	return 0;
+}
+
+
+gre90r::Instrumentation::Entry* gre90r::Instrumentation::entryOf(sqlite3_stmt* statement) {
+	const char* sql = sqlite3_sql(statement);
+	if (sql == NULL) {
+		sql = "";
+	}
+
+	// the events of one run, and often the next runs, are for the same
+	// statement. a finalized handle can be reused at the same address,
+	// but hardly with its sql text at the same address as well.
+	if (statement == this->m_lastStatement && sql == this->m_lastSql) {
+		return this->m_lastEntry;
+	}
+
+	auto binding = this->m_bindings.find(statement);
+	if (binding == this->m_bindings.end() || binding->second.rawSql != sql) {
+		// handles of finalized statements pile up, start over now and then
+		if (this->m_bindings.size() >= 4 * MAX_STATEMENTS) {
+			this->m_bindings.clear();
+		}
+		std::string normalized = normalize(sql);
+		auto found = this->m_entries.find(normalized);
+		if (found == this->m_entries.end()) {
+			if (this->m_entries.size() >= MAX_STATEMENTS) {
+				normalized = "<other>";
+				found = this->m_entries.find(normalized);
+			}
+			if (found == this->m_entries.end()) {
+				std::unique_ptr<Entry> entry(new Entry());
+				entry->sql = normalized;
+				found = this->m_entries.emplace(normalized, std::move(entry)).first;
+			}
+		}
+		Binding& target = this->m_bindings[statement];
+		target.rawSql = sql;
+		target.entry = found->second.get();
+		binding = this->m_bindings.find(statement);
+	}
+
+	this->m_lastStatement = statement;
+	this->m_lastSql = sql;
+	this->m_lastEntry = binding->second.entry;
+	return this->m_lastEntry;
+}
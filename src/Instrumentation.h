@@ -0,0 +1,216 @@
+#ifndef SQLITEINSTRUMENTATION_H
+#define SQLITEINSTRUMENTATION_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace gre90r {
+
+	/**
+	 * latency histogram with log-linear buckets: 8 buckets per power
+	 * of two, so a percentile is off by at most 12.5%. recording is
+	 * a few instructions and does not allocate.
+	 */
+	class LatencyHistogram {
+	public:
+		LatencyHistogram();
+
+		/**
+		 * add a sample
+		 */
+		void record(std::uint64_t nanos);
+
+		/**
+		 * @return number of samples
+		 */
+		std::uint64_t getCount() const;
+
+		/**
+		 * @return largest sample, exact
+		 */
+		std::uint64_t getMax() const;
+
+		/**
+		 * @param percentile 0 to 100
+		 * @return upper bound of the bucket holding the percentile, at most getMax().
+		 * 				 0 if there are no samples.
+		 */
+		std::uint64_t getPercentile(double percentile) const;
+
+		/**
+		 * remove all samples
+		 */
+		void clear();
+
+	private:
+		static const int SUB_BITS = 3; // 2^3 buckets per power of two
+		static const std::size_t BUCKETS = (64 - SUB_BITS - 1) * (1 << SUB_BITS) + (2 << SUB_BITS);
+
+		std::vector<std::uint64_t> m_buckets;
+		std::uint64_t m_count;
+		std::uint64_t m_max;
+
+		static std::size_t bucketOf(std::uint64_t nanos);
+		static std::uint64_t upperBoundOf(std::size_t bucket);
+	};
+
+	/**
+	 * metrics of all runs of one normalized sql statement
+	 */
+	struct StatementMetrics {
+		std::string sql; // normalized: literals replaced by ?, whitespace collapsed
+		std::uint64_t calls = 0; // completed runs
+		std::uint64_t rows = 0; // rows returned
+		std::uint64_t totalNanos = 0;
+		std::uint64_t p50Nanos = 0;
+		std::uint64_t p99Nanos = 0;
+		std::uint64_t maxNanos = 0;
+
+		// sqlite3_stmt_status() counters, summed over all runs
+		std::uint64_t fullscanSteps = 0; // steps of full table scans, an index may help
+		std::uint64_t sorts = 0; // sorts without an index
+		std::uint64_t autoindexes = 0; // rows inserted into automatic indexes
+		std::uint64_t vmSteps = 0; // virtual machine instructions, a measure of work
+	};
+
+	/**
+	 * snapshot of the metrics of a connection
+	 */
+	struct ConnectionMetrics {
+		// sqlite3_db_status() page cache counters since the connection was opened
+		long long cacheHits = 0;
+		long long cacheMisses = 0;
+		long long cacheWrites = 0;
+		long long cacheUsedBytes = 0;
+
+		std::vector<StatementMetrics> statements; // slowest total time first
+
+		/**
+		 * @return the snapshot as a JSON object, e.g. for a metrics scraper
+		 */
+		std::string toJson() const;
+	};
+
+	/**
+	 * collects per statement latency, rows and sqlite3_stmt_status()
+	 * counters of a connection through a sqlite3_trace_v2() hook.
+	 *
+	 * the hook gets the run time of each finished statement from sqlite
+	 * and the statement is looked up by its handle. an event costs a lock,
+	 * plus a hash lookup if it is for another statement than the event
+	 * before. the sql text is only normalized the first time a statement
+	 * is seen. the overhead on a point select is within a few percent,
+	 * see pointSelectInstr in 'make bench'.
+	 *
+	 * created by Sqlite::setInstrumentation(true). the connection has to
+	 * stay open while this object exists.
+	 */
+	class Instrumentation {
+	public:
+		/**
+		 * max number of different normalized statements. the runs of
+		 * any further statements are counted under "<other>".
+		 */
+		static const std::size_t MAX_STATEMENTS = 1024;
+
+		/**
+		 * forbid standard constructor
+		 */
+		Instrumentation() = delete;
+
+		/**
+		 * install the trace hook on db
+		 */
+		explicit Instrumentation(sqlite3* db);
+
+		/**
+		 * forbid copy constructor
+		 */
+		Instrumentation(const Instrumentation&) = delete;
+
+		/**
+		 * remove the trace hook
+		 */
+		virtual ~Instrumentation();
+
+		/**
+		 * forbid assignment operator
+		 */
+		Instrumentation& operator=(const Instrumentation&) = delete;
+
+		/**
+		 * @return the metrics collected so far. thread-safe.
+		 */
+		ConnectionMetrics getMetrics() const;
+
+		/**
+		 * forget the statement metrics collected so far. thread-safe.
+		 */
+		void reset();
+
+		/**
+		 * replace string and number literals by ? and collapse whitespace,
+		 * so statements which only differ in their values share metrics
+		 */
+		static std::string normalize(const char* sql);
+
+	private:
+		/**
+		 * metrics of one normalized statement while collecting
+		 */
+		struct Entry {
+			std::string sql;
+			std::uint64_t calls = 0;
+			std::uint64_t rows = 0;
+			std::uint64_t totalNanos = 0;
+			LatencyHistogram latency;
+			std::uint64_t fullscanSteps = 0;
+			std::uint64_t sorts = 0;
+			std::uint64_t autoindexes = 0;
+			std::uint64_t vmSteps = 0;
+		};
+
+		/**
+		 * the entry a statement handle belongs to. handles are reused
+		 * after finalize, so the sql text is compared as well.
+		 */
+		struct Binding {
+			std::string rawSql;
+			Entry* entry;
+		};
+
+		/**************/
+		/* Attributes */
+		/**************/
+		sqlite3* m_db;
+		mutable std::mutex m_mutex; // protects the members below
+		std::unordered_map<std::string, std::unique_ptr<Entry> > m_entries; // by normalized sql
+		std::unordered_map<sqlite3_stmt*, Binding> m_bindings;
+		sqlite3_stmt* m_lastStatement; // fast path for repeated events of one statement
+		const char* m_lastSql; // sqlite3_sql() of m_lastStatement
+		Entry* m_lastEntry;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * sqlite3_trace_v2() callback for SQLITE_TRACE_PROFILE and SQLITE_TRACE_ROW
+		 */
+		static int trace(unsigned int type, void* context, void* statement, void* detail);
+
+		/**
+		 * find or create the entry of statement. m_mutex has to be locked.
+		 */
+		Entry* entryOf(sqlite3_stmt* statement);
+	};
+
+}
+
+#endif
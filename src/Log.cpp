@@ -0,0 +1,72 @@
+#include "Log.h"
+#include <iostream>
+#include <mutex>
+
+
+namespace {
+
+	/**
+	 * protects the sink. only locked for enabled messages.
+	 */
+	std::mutex& sinkMutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	gre90r::LogSink& sink() {
+		static gre90r::LogSink currentSink;
+		return currentSink;
+	}
+
+	/**
+	 * writes "[LEVEL] message". no flush, the stream buffers.
+	 */
+	void defaultSink(gre90r::LogLevel level, const std::string& message) {
+		std::ostream& out = level >= gre90r::LogLevel::Warning ? std::cerr : std::cout;
+		out << '[' << gre90r::Log::toString(level) << "] " << message << '\n';
+	}
+
+}
+
+
+std::atomic<int> gre90r::Log::s_level(static_cast<int>(gre90r::LogLevel::Info));
+
+
+void gre90r::Log::setLevel(LogLevel level) {
+	s_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+
+gre90r::LogLevel gre90r::Log::getLevel() {
+	return static_cast<LogLevel>(s_level.load(std::memory_order_relaxed));
+}
+
+
+void gre90r::Log::setSink(const LogSink& newSink) {
+	std::lock_guard<std::mutex> lock(sinkMutex());
+	sink() = newSink;
+}
+
+
+void gre90r::Log::write(LogLevel level, const std::string& message) {
+	std::lock_guard<std::mutex> lock(sinkMutex());
+	if (sink()) {
+		sink()(level, message);
+	}
+	else {
+		defaultSink(level, message);
+	}
+}
+
+
+const char* gre90r::Log::toString(LogLevel level) {
+	switch (level) {
+		case LogLevel::Trace: return "TRACE";
+		case LogLevel::Debug: return "DEBUG";
+		case LogLevel::Info: return "INFO";
+		case LogLevel::Warning: return "WARNING";
+		case LogLevel::Error: return "ERROR";
+		case LogLevel::Off: return "OFF";
+	}
+	return "UNKNOWN";
+}
@@ -0,0 +1,93 @@
+#ifndef SQLITELOG_H
+#define SQLITELOG_H
+
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include <string>
+
+
+/**
+ * write a log message if level is enabled. the message is only
+ * formatted if the level is enabled, otherwise this is just a
+ * load of an atomic and a branch.
+ * usage: GRE90R_LOG(gre90r::LogLevel::Info, "rc = " << rc);
+ */
+#define GRE90R_LOG(level, s) { \
+	if (gre90r::Log::isEnabled(level)) { \
+		std::ostringstream gre90rLogStream; \
+		gre90rLogStream << s; \
+		gre90r::Log::write(level, gre90rLogStream.str()); \
+	} \
+}
+
+
+namespace gre90r {
+
+	/**
+	 * severity of a log message. a level enables itself and all levels above.
+	 */
+	enum class LogLevel {
+		Trace = 0, // every row of every query
+		Debug,
+		Info, // connect, disconnect
+		Warning,
+		Error,
+		Off // nothing is logged
+	};
+
+	/**
+	 * receives every enabled log message. is called from the thread which
+	 * logs, so it has to be thread-safe if connections are used by several threads.
+	 * @param level severity of the message
+	 * @param message the message without level prefix and without newline
+	 */
+	typedef std::function<void(LogLevel level, const std::string& message)> LogSink;
+
+	/**
+	 * process-wide logging used by all gre90r classes.
+	 * default: level Info, written to std::cout and errors to std::cerr.
+	 */
+	class Log {
+	public:
+		/**
+		 * forbid standard constructor. there are only static methods.
+		 */
+		Log() = delete;
+
+		/**
+		 * @return true: messages of level are written
+		 */
+		static bool isEnabled(LogLevel level) {
+			return static_cast<int>(level) >= s_level.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * enable level and all levels above it. LogLevel::Off disables logging.
+		 */
+		static void setLevel(LogLevel level);
+		static LogLevel getLevel();
+
+		/**
+		 * install a sink which receives all enabled messages.
+		 * @param sink the new sink. an empty sink restores the default sink.
+		 */
+		static void setSink(const LogSink& sink);
+
+		/**
+		 * pass a message to the sink. does not check the level, use GRE90R_LOG.
+		 */
+		static void write(LogLevel level, const std::string& message);
+
+		/**
+		 * @return name of level, e.g. "ERROR"
+		 */
+		static const char* toString(LogLevel level);
+
+	private:
+		static std::atomic<int> s_level; // lowest enabled level
+	};
+
+}
+
+#endif
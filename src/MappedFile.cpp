@@ -0,0 +1,90 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+gre90r::MappedFile::MappedFile(const char* filename, bool sequential)
+: m_data(NULL), m_size(0), m_open(false)
+{
+#ifdef _WIN32
+	(void)sequential;
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		return;
+	}
+	this->m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	this->m_data = this->m_buffer.data();
+	this->m_size = this->m_buffer.size();
+	this->m_open = true;
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat info;
+	if (::fstat(fd, &info) != 0) {
+		::close(fd);
+		return;
+	}
+	this->m_size = static_cast<std::size_t>(info.st_size);
+	if (this->m_size > 0) {
+		void* data = ::mmap(NULL, this->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			::close(fd);
+			this->m_size = 0;
+			return;
+		}
+		this->m_data = static_cast<const char*>(data);
+		if (sequential) {
+			::madvise(data, this->m_size, MADV_SEQUENTIAL);
+		}
+	}
+	// the mapping keeps the file alive
+	::close(fd);
+	this->m_open = true;
+#endif
+}
+
+
+gre90r::MappedFile::~MappedFile() {
+#ifndef _WIN32
+	if (this->m_data != NULL) {
+		::munmap(const_cast<char*>(this->m_data), this->m_size);
+	}
+#endif
+}
+
+
+bool gre90r::MappedFile::isOpen() const {
+	return this->m_open;
+}
+
+
+const char* gre90r::MappedFile::getData() const {
+	return this->m_data;
+}
+
+
+std::size_t gre90r::MappedFile::getSize() const {
+	return this->m_size;
+}
+
+
+void gre90r::MappedFile::release(std::size_t offset) {
+#ifndef _WIN32
+	long pageSize = ::sysconf(_SC_PAGESIZE);
+	std::size_t length = pageSize > 0 ? offset - offset % static_cast<std::size_t>(pageSize) : 0;
+	if (this->m_data != NULL && length > 0) {
+		::madvise(const_cast<char*>(this->m_data), length, MADV_DONTNEED);
+	}
+#else
+	(void)offset;
+#endif
+}
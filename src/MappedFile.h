@@ -0,0 +1,78 @@
+#ifndef SQLITEMAPPEDFILE_H
+#define SQLITEMAPPEDFILE_H
+
+#include <cstddef>
+#include <vector>
+
+
+namespace gre90r {
+
+	/**
+	 * read-only memory mapping of a whole file. the pages are loaded
+	 * by the kernel when they are first touched, nothing is copied.
+	 * on Windows the file is read into memory instead.
+	 */
+	class MappedFile {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		MappedFile() = delete;
+
+		/**
+		 * map filename. check isOpen().
+		 * @param sequential true: the file is read front to back once, read ahead aggressively
+		 */
+		explicit MappedFile(const char* filename, bool sequential = false);
+
+		/**
+		 * forbid copy constructor
+		 */
+		MappedFile(const MappedFile&) = delete;
+
+		/**
+		 * unmaps the file
+		 */
+		virtual ~MappedFile();
+
+		/**
+		 * forbid assignment operator
+		 */
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		 * @return true: the file could be read. an empty file is open with size 0.
+		 */
+		bool isOpen() const;
+
+		/**
+		 * @return the content. NULL if the file is empty or not open.
+		 */
+		const char* getData() const;
+
+		/**
+		 * @return size of the file in bytes
+		 */
+		std::size_t getSize() const;
+
+		/**
+		 * drop the pages before offset from memory. reading them again
+		 * faults them back in from the file.
+		 */
+		void release(std::size_t offset);
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		const char* m_data;
+		std::size_t m_size;
+		bool m_open;
+#ifdef _WIN32
+		std::vector<char> m_buffer;
+#endif
+	};
+
+}
+
+#endif
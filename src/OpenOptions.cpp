@@ -0,0 +1,100 @@
+#include "OpenOptions.h"
+#include <cstring>
+
+
+gre90r::OpenOptions gre90r::OpenOptions::forProfile(OpenProfile profile) {
+	OpenOptions options;
+	switch (profile) {
+	case OpenProfile::BulkLoad:
+		// a crash while loading can corrupt the file, load into a new one
+		options.flags |= SQLITE_OPEN_NOMUTEX;
+		options.journalMode = JournalMode::Memory;
+		options.synchronous = SynchronousMode::Off;
+		options.cacheSize = -262144; // 256 MiB
+		options.tempStore = TempStore::Memory;
+		break;
+	case OpenProfile::ReadHeavy:
+		options.flags |= SQLITE_OPEN_NOMUTEX;
+		options.journalMode = JournalMode::Wal;
+		options.synchronous = SynchronousMode::Normal;
+		options.cacheSize = -65536; // 64 MiB
+		options.mmapSize = 1LL << 30; // 1 GiB
+		options.tempStore = TempStore::Memory;
+		break;
+	case OpenProfile::Durable:
+		options.journalMode = JournalMode::Wal;
+		options.synchronous = SynchronousMode::Full;
+		break;
+	case OpenProfile::InMemoryCache:
+		options.flags |= SQLITE_OPEN_MEMORY | SQLITE_OPEN_NOMUTEX;
+		options.journalMode = JournalMode::Memory;
+		options.synchronous = SynchronousMode::Off;
+		options.cacheSize = -65536; // 64 MiB
+		options.tempStore = TempStore::Memory;
+		break;
+	case OpenProfile::Default:
+		break;
+	}
+	return options;
+}
+
+
+bool gre90r::OpenOptions::forProfile(const char* name, OpenOptions& options) {
+	static const struct {
+		const char* name;
+		OpenProfile profile;
+	} profiles[] = {
+		{ "default", OpenProfile::Default },
+		{ "bulk-load", OpenProfile::BulkLoad },
+		{ "read-heavy", OpenProfile::ReadHeavy },
+		{ "durable", OpenProfile::Durable },
+		{ "in-memory-cache", OpenProfile::InMemoryCache }
+	};
+
+	if (name == NULL) {
+		return false;
+	}
+	for (const auto& entry : profiles) {
+		if (std::strcmp(entry.name, name) == 0) {
+			options = forProfile(entry.profile);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+const char* gre90r::toString(JournalMode mode) {
+	switch (mode) {
+	case JournalMode::Delete: return "DELETE";
+	case JournalMode::Truncate: return "TRUNCATE";
+	case JournalMode::Persist: return "PERSIST";
+	case JournalMode::Memory: return "MEMORY";
+	case JournalMode::Wal: return "WAL";
+	case JournalMode::Off: return "OFF";
+	case JournalMode::Keep: break;
+	}
+	return NULL;
+}
+
+
+const char* gre90r::toString(SynchronousMode mode) {
+	switch (mode) {
+	case SynchronousMode::Off: return "OFF";
+	case SynchronousMode::Normal: return "NORMAL";
+	case SynchronousMode::Full: return "FULL";
+	case SynchronousMode::Extra: return "EXTRA";
+	case SynchronousMode::Keep: break;
+	}
+	return NULL;
+}
+
+
+const char* gre90r::toString(TempStore store) {
+	switch (store) {
+	case TempStore::File: return "FILE";
+	case TempStore::Memory: return "MEMORY";
+	case TempStore::Keep: break;
+	}
+	return NULL;
+}
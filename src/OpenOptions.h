@@ -0,0 +1,145 @@
+#ifndef SQLITEOPENOPTIONS_H
+#define SQLITEOPENOPTIONS_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <string>
+
+
+namespace gre90r {
+
+	/**
+	 * what a connection does when the database is locked by another
+	 * connection. instead of failing with SQLITE_BUSY right away, it
+	 * retries with exponentially growing, randomized sleeps until
+	 * maxWait has passed.
+	 */
+	struct BusyPolicy {
+		/**
+		 * max total wait for one lock. 0: fail with SQLITE_BUSY right away.
+		 */
+		std::chrono::milliseconds maxWait = std::chrono::milliseconds(5000);
+
+		/**
+		 * sleep before the first retry
+		 */
+		std::chrono::microseconds initialBackoff = std::chrono::microseconds(500);
+
+		/**
+		 * upper bound of a single sleep
+		 */
+		std::chrono::microseconds maxBackoff = std::chrono::microseconds(100000);
+
+		/**
+		 * the sleep grows by this factor with each retry
+		 */
+		double backoffFactor = 2.0;
+
+		/**
+		 * up to this fraction of each sleep is taken off at random, so
+		 * connections waiting for the same lock do not retry in lockstep.
+		 * 0: no jitter, 1: sleep anywhere between 0 and the full backoff.
+		 */
+		double jitter = 0.5;
+	};
+
+	/**
+	 * PRAGMA journal_mode. Keep leaves the mode of the database file as it is.
+	 */
+	enum class JournalMode { Keep, Delete, Truncate, Persist, Memory, Wal, Off };
+
+	/**
+	 * PRAGMA synchronous. Keep leaves sqlite's default (FULL).
+	 */
+	enum class SynchronousMode { Keep, Off, Normal, Full, Extra };
+
+	/**
+	 * PRAGMA temp_store. Keep leaves sqlite's default (FILE on most builds).
+	 */
+	enum class TempStore { Keep, File, Memory };
+
+	/**
+	 * named sets of OpenOptions
+	 */
+	enum class OpenProfile {
+		Default, // sqlite's defaults
+		BulkLoad, // "bulk-load": fast writes, no crash safety while loading
+		ReadHeavy, // "read-heavy": WAL, big cache and memory-mapped reads
+		Durable, // "durable": WAL with a sync on every commit
+		InMemoryCache // "in-memory-cache": database lives in memory only
+	};
+
+	/**
+	 * how a connection is opened and tuned. the PRAGMAs are run right
+	 * after opening. settings left at Keep or 0 are not touched.
+	 *
+	 * usage:
+	 *   gre90r::Sqlite db("app.db", gre90r::OpenOptions::forProfile(gre90r::OpenProfile::ReadHeavy));
+	 *   db.getSettings().journalMode; // "wal"
+	 */
+	struct OpenOptions {
+		/**
+		 * sqlite3_open_v2() flags, e.g. SQLITE_OPEN_READONLY or
+		 * SQLITE_OPEN_NOMUTEX for connections used by one thread at a time
+		 */
+		int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+		JournalMode journalMode = JournalMode::Keep;
+		SynchronousMode synchronous = SynchronousMode::Keep;
+
+		/**
+		 * PRAGMA cache_size. > 0: pages, < 0: KiB. 0: keep.
+		 */
+		long long cacheSize = 0;
+
+		/**
+		 * PRAGMA mmap_size in bytes. < 0: keep.
+		 */
+		long long mmapSize = -1;
+
+		TempStore tempStore = TempStore::Keep;
+
+		/**
+		 * PRAGMA page_size in bytes, a power of two from 512 to 65536.
+		 * only takes effect on a new database. 0: keep.
+		 */
+		int pageSize = 0;
+
+		BusyPolicy busyPolicy;
+
+		/**
+		 * @return the options of profile
+		 */
+		static OpenOptions forProfile(OpenProfile profile);
+
+		/**
+		 * look up a profile by name, e.g. from a config file
+		 * @param name "default", "bulk-load", "read-heavy", "durable" or "in-memory-cache"
+		 * @param options receives the options of the profile
+		 * @return false: unknown name, options is unchanged
+		 */
+		static bool forProfile(const char* name, OpenOptions& options);
+	};
+
+	/**
+	 * the tuning settings of an open connection, as reported by sqlite
+	 */
+	struct OpenSettings {
+		std::string journalMode; // lower case, e.g. "wal"
+		int synchronous = -1; // 0 OFF, 1 NORMAL, 2 FULL, 3 EXTRA
+		long long cacheSize = 0; // same unit as OpenOptions::cacheSize
+		long long mmapSize = -1;
+		int tempStore = -1; // 0 default, 1 FILE, 2 MEMORY
+		int pageSize = 0;
+	};
+
+	/**
+	 * @return PRAGMA value of mode, e.g. "WAL". NULL for Keep.
+	 */
+	const char* toString(JournalMode mode);
+	const char* toString(SynchronousMode mode);
+	const char* toString(TempStore store);
+
+}
+
+#endif
@@ -0,0 +1,367 @@
+#include "ResultCache.h"
+#include "Log.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+
+
+namespace {
+
+	/**
+	 * max number of sql texts whose analysis is kept
+	 */
+	const std::size_t MAX_QUERIES = 4096;
+
+	/**
+	 * built-in functions whose result can change between two runs
+	 * with the same arguments and the same data
+	 */
+	const char* const VOLATILE_FUNCTIONS[] = {
+		"random", "randomblob", "changes", "total_changes", "last_insert_rowid",
+		"date", "time", "datetime", "julianday", "unixepoch", "strftime", "timediff",
+		"current_date", "current_time", "current_timestamp", "sqlite_offset"
+	};
+
+	bool isVolatile(const char* function) {
+		for (const char* name : VOLATILE_FUNCTIONS) {
+			if (sqlite3_stricmp(name, function) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * @return true: only whitespace and semicolons follow
+	 */
+	bool isEnd(const char* tail) {
+		for (; tail != NULL && *tail != '\0'; tail++) {
+			if (!std::isspace(static_cast<unsigned char>(*tail)) && *tail != ';') {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * function names are case insensitive
+	 */
+	std::string toLower(const char* text) {
+		std::string lower(text);
+		for (char& c : lower) {
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+		return lower;
+	}
+
+}
+
+
+gre90r::ResultCache::ResultCache(sqlite3* db, const ResultCacheOptions& options)
+: m_db(db), m_options(options), m_dataVersion(NULL), m_lastDataVersion(-1),
+  m_lastChanged(NULL), m_schemaChanged(false), m_collecting(NULL), m_bytes(0)
+{
+	if (this->m_options.detectExternalChanges) {
+		int rc = sqlite3_prepare_v3(this->m_db, "PRAGMA data_version;", -1, SQLITE_PREPARE_PERSISTENT,
+		                            &this->m_dataVersion, NULL);
+		if (rc != SQLITE_OK) {
+			GRE90R_LOG(LogLevel::Warning, "result cache: cannot detect changes of other connections. rc = "
+			           << rc << ".");
+			sqlite3_finalize(this->m_dataVersion);
+			this->m_dataVersion = NULL;
+		}
+		this->checkExternalChanges();
+	}
+	this->installHooks();
+}
+
+
+gre90r::ResultCache::~ResultCache() {
+	sqlite3_set_authorizer(this->m_db, NULL, NULL);
+	sqlite3_update_hook(this->m_db, NULL, NULL);
+	sqlite3_rollback_hook(this->m_db, NULL, NULL);
+	sqlite3_finalize(this->m_dataVersion);
+}
+
+
+void gre90r::ResultCache::installHooks() {
+	sqlite3_set_authorizer(this->m_db, authorizer, this);
+	sqlite3_update_hook(this->m_db, updateHook, this);
+	sqlite3_rollback_hook(this->m_db, rollbackHook, this);
+}
+
+
+bool gre90r::ResultCache::lookup(const std::string& key, SqlResult& result) {
+	this->checkExternalChanges();
+
+	std::unordered_map<std::string_view, LruList::iterator>::iterator found = this->m_index.find(key);
+	if (found == this->m_index.end()) {
+		this->m_stats.misses++;
+		return false;
+	}
+	LruList::iterator entry = found->second;
+	for (const std::pair<std::string, std::uint64_t>& table : entry->tables) {
+		if (this->getVersion(table.first) != table.second) {
+			this->erase(entry);
+			this->m_stats.stale++;
+			this->m_stats.misses++;
+			return false;
+		}
+	}
+
+	this->m_lru.splice(this->m_lru.begin(), this->m_lru, entry);
+	this->m_stats.hits++;
+	result = *entry->result;
+	return true;
+}
+
+
+bool gre90r::ResultCache::store(const std::string& key, const char* query, const SqlResult& result) {
+	if (sqlite3_get_autocommit(this->m_db)) {
+		// the last transaction is over, its changes are committed
+		this->m_changedInTransaction.clear();
+		this->m_schemaChanged = false;
+	}
+	// the next change has to bump a version again, it is newer than this result
+	this->m_lastChanged = NULL;
+
+	const QueryInfo& info = this->analyze(query);
+	if (!info.cacheable) {
+		return false;
+	}
+	std::size_t bytes = sizeof(Entry) + 2 * key.size() + result.getMemoryUsage();
+	for (const std::string& table : info.tables) {
+		if (this->m_changedInTransaction.count(table) > 0) {
+			return false;
+		}
+		bytes += sizeof(std::pair<std::string, std::uint64_t>) + table.size();
+	}
+	if (bytes > this->m_options.maxBytes) {
+		return false;
+	}
+
+	std::unordered_map<std::string_view, LruList::iterator>::iterator found = this->m_index.find(key);
+	if (found != this->m_index.end()) {
+		this->erase(found->second);
+	}
+	this->m_lru.emplace_front();
+	Entry& entry = this->m_lru.front();
+	entry.key = key;
+	entry.result = std::make_shared<const SqlResult>(result);
+	for (const std::string& table : info.tables) {
+		entry.tables.emplace_back(table, this->getVersion(table));
+	}
+	entry.bytes = bytes;
+	this->m_index.emplace(entry.key, this->m_lru.begin());
+	this->m_bytes += bytes;
+	this->evict();
+	return true;
+}
+
+
+void gre90r::ResultCache::invalidate(const char* table) {
+	this->m_tableVersions[table]++;
+}
+
+
+void gre90r::ResultCache::clear() {
+	this->m_index.clear();
+	this->m_lru.clear();
+	this->m_bytes = 0;
+}
+
+
+void gre90r::ResultCache::addVolatileFunction(const std::string& name) {
+	this->m_volatileFunctions.insert(toLower(name.c_str()));
+	// queries analyzed and cached so far may call it
+	this->m_queries.clear();
+	this->clear();
+}
+
+
+gre90r::ResultCacheStats gre90r::ResultCache::getStats() const {
+	ResultCacheStats stats = this->m_stats;
+	stats.entries = this->m_lru.size();
+	stats.bytes = this->m_bytes;
+	return stats;
+}
+
+
+const gre90r::ResultCache::QueryInfo& gre90r::ResultCache::analyze(const char* query) {
+	std::unordered_map<std::string, QueryInfo>::iterator found = this->m_queries.find(query);
+	if (found != this->m_queries.end()) {
+		return found->second;
+	}
+
+	// compile the query once more, the authorizer collects the tables it reads
+	QueryInfo info;
+	info.cacheable = true;
+	sqlite3_stmt* statement = NULL;
+	const char* tail = NULL;
+	this->m_collecting = &info;
+	int rc = sqlite3_prepare_v2(this->m_db, query, -1, &statement, &tail);
+	this->m_collecting = NULL;
+	if (rc != SQLITE_OK || statement == NULL || !sqlite3_stmt_readonly(statement) || !isEnd(tail)) {
+		info.cacheable = false;
+	}
+	sqlite3_finalize(statement);
+
+	// changes of virtual and WITHOUT ROWID tables are not reported by the update hook
+	sqlite3_stmt* tableList = NULL;
+	if (info.cacheable && sqlite3_prepare_v2(this->m_db, "select 1 from pragma_table_list "
+	                                         "where name = ?1 and (type = 'virtual' or wr != 0)",
+	                                         -1, &tableList, NULL) == SQLITE_OK) {
+		for (const std::string& table : info.tables) {
+			sqlite3_bind_text(tableList, 1, table.c_str(), -1, SQLITE_STATIC);
+			if (sqlite3_step(tableList) == SQLITE_ROW) {
+				info.cacheable = false;
+			}
+			sqlite3_reset(tableList);
+		}
+	}
+	sqlite3_finalize(tableList);
+
+	if (this->m_queries.size() >= MAX_QUERIES) {
+		this->m_queries.clear();
+	}
+	return this->m_queries.emplace(query, std::move(info)).first->second;
+}
+
+
+std::uint64_t gre90r::ResultCache::getVersion(const std::string& table) const {
+	std::unordered_map<std::string, std::uint64_t>::const_iterator found = this->m_tableVersions.find(table);
+	return found != this->m_tableVersions.end() ? found->second : 0;
+}
+
+
+void gre90r::ResultCache::erase(LruList::iterator entry) {
+	this->m_bytes -= entry->bytes;
+	this->m_index.erase(entry->key);
+	this->m_lru.erase(entry);
+}
+
+
+void gre90r::ResultCache::evict() {
+	while (!this->m_lru.empty()
+	       && (this->m_bytes > this->m_options.maxBytes
+	           || (this->m_options.maxEntries > 0 && this->m_lru.size() > this->m_options.maxEntries))) {
+		this->erase(std::prev(this->m_lru.end()));
+		this->m_stats.evictions++;
+	}
+}
+
+
+void gre90r::ResultCache::checkExternalChanges() {
+	if (this->m_dataVersion == NULL) {
+		return;
+	}
+	long long version = this->m_lastDataVersion;
+	if (sqlite3_step(this->m_dataVersion) == SQLITE_ROW) {
+		version = sqlite3_column_int64(this->m_dataVersion, 0);
+	}
+	sqlite3_reset(this->m_dataVersion);
+	if (version != this->m_lastDataVersion) {
+		// which tables changed is not known
+		this->clear();
+		this->m_lastDataVersion = version;
+	}
+}
+
+
+void gre90r::ResultCache::appendBytes(std::string& key, char type, const void* data, std::size_t size) {
+	std::uint64_t length = size;
+	key += type;
+	key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+	key.append(static_cast<const char*>(data), size);
+}
+
+
+int gre90r::ResultCache::authorizer(void* cache, int action, const char* arg1, const char* arg2,
+                                    const char* database, const char* trigger)
+{
+	(void)database;
+	(void)trigger;
+	ResultCache* self = static_cast<ResultCache*>(cache);
+	if (self->m_truncateGuard.authorize(action, arg1) == SQLITE_IGNORE) {
+		return SQLITE_IGNORE;
+	}
+	switch (action) {
+	case SQLITE_READ:
+		// arg1: table, arg2: column
+		if (self->m_collecting != NULL && arg1 != NULL) {
+			std::vector<std::string>& tables = self->m_collecting->tables;
+			if (std::find(tables.begin(), tables.end(), arg1) == tables.end()) {
+				tables.push_back(arg1);
+			}
+		}
+		break;
+	case SQLITE_FUNCTION:
+		// arg2: function name
+		if (self->m_collecting != NULL && arg2 != NULL
+		    && (isVolatile(arg2) || self->m_volatileFunctions.count(toLower(arg2)) > 0)) {
+			self->m_collecting->cacheable = false;
+		}
+		break;
+	case SQLITE_DROP_TABLE:
+	case SQLITE_DROP_TEMP_TABLE:
+	case SQLITE_DROP_VIEW:
+	case SQLITE_DROP_TEMP_VIEW:
+	case SQLITE_DROP_VTABLE:
+	case SQLITE_CREATE_INDEX:
+	case SQLITE_CREATE_TABLE:
+	case SQLITE_CREATE_TEMP_INDEX:
+	case SQLITE_CREATE_TEMP_TABLE:
+	case SQLITE_CREATE_TEMP_TRIGGER:
+	case SQLITE_CREATE_TEMP_VIEW:
+	case SQLITE_CREATE_TRIGGER:
+	case SQLITE_CREATE_VIEW:
+	case SQLITE_CREATE_VTABLE:
+	case SQLITE_DROP_INDEX:
+	case SQLITE_DROP_TEMP_INDEX:
+	case SQLITE_DROP_TEMP_TRIGGER:
+	case SQLITE_DROP_TRIGGER:
+	case SQLITE_ALTER_TABLE:
+	case SQLITE_ATTACH:
+	case SQLITE_DETACH:
+		// views and triggers change which tables a query reads
+		self->clear();
+		self->m_queries.clear();
+		self->m_lastChanged = NULL;
+		self->m_schemaChanged = true;
+		break;
+	default:
+		break;
+	}
+	return SQLITE_OK;
+}
+
+
+void gre90r::ResultCache::updateHook(void* cache, int operation, const char* database, const char* table,
+                                     sqlite3_int64 rowid)
+{
+	(void)operation;
+	(void)database;
+	(void)rowid;
+	ResultCache* self = static_cast<ResultCache*>(cache);
+	// sqlite passes the same name pointer for every row of a table
+	if (table == self->m_lastChanged) {
+		return;
+	}
+	self->m_lastChanged = table;
+	self->m_tableVersions[table]++;
+	self->m_changedInTransaction.insert(table);
+}
+
+
+void gre90r::ResultCache::rollbackHook(void* cache) {
+	ResultCache* self = static_cast<ResultCache*>(cache);
+	if (self->m_schemaChanged) {
+		// results of tables created in the transaction
+		self->clear();
+		self->m_queries.clear();
+	}
+	self->m_changedInTransaction.clear();
+	self->m_lastChanged = NULL;
+	self->m_schemaChanged = false;
+}
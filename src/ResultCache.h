@@ -0,0 +1,313 @@
+#ifndef SQLITERESULTCACHE_H
+#define SQLITERESULTCACHE_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "SqlResult.h"
+#include "Statement.h"
+#include "TruncateGuard.h"
+
+
+namespace gre90r {
+
+	/**
+	 * size of a ResultCache and how it detects changes
+	 */
+	struct ResultCacheOptions {
+		/**
+		 * max memory of all cached results together. least recently used
+		 * results are dropped first.
+		 */
+		std::size_t maxBytes = 16 * 1024 * 1024;
+
+		/**
+		 * max number of cached results. 0: no limit.
+		 */
+		std::size_t maxEntries = 1024;
+
+		/**
+		 * true: run PRAGMA data_version before each lookup and drop all results
+		 * if another connection or process has committed. false: only changes
+		 * made through this connection are seen, e.g. for in-memory databases.
+		 */
+		bool detectExternalChanges = true;
+	};
+
+	/**
+	 * counters of a ResultCache
+	 */
+	struct ResultCacheStats {
+		unsigned long long hits = 0;
+		unsigned long long misses = 0;
+		unsigned long long stale = 0; // results dropped because a table they read changed
+		unsigned long long evictions = 0; // results dropped for memory or count
+		std::size_t entries = 0;
+		std::size_t bytes = 0;
+	};
+
+	/**
+	 * caches the results of read only queries of one connection, keyed by
+	 * sql text and bound values. used by Sqlite::select() if enabled with
+	 * Sqlite::setResultCache().
+	 *
+	 * the tables a query reads are collected once per sql text with an
+	 * authorizer while compiling it, views resolved. each table has a
+	 * version which the update hook increments for every changed row, so
+	 * a cached result is valid as long as the versions of its tables are
+	 * the ones it was stored with. a hit costs a hash lookup per table
+	 * and never touches the database, apart from PRAGMA data_version if
+	 * detectExternalChanges is set.
+	 *
+	 * not cached are: queries which write, more than one statement, queries
+	 * calling functions whose result changes over time (random(), date and
+	 * time functions, changes(), ...), queries reading virtual or WITHOUT
+	 * ROWID tables, whose changes the update hook does not report, and
+	 * results of tables changed in the open transaction, which a ROLLBACK
+	 * TO a savepoint could undo. application-defined functions only keep a
+	 * query cacheable if they were registered with
+	 * FunctionOptions::deterministic, Sqlite::functionRegistered() marks
+	 * all others as volatile.
+	 *
+	 * the cache installs the authorizer, update and rollback hook of the
+	 * connection, they must not be set by others while it exists. see
+	 * Sqlite::installHooks() for how it shares them with a ChangeCapture.
+	 * the authorizer turns off the truncate optimization of DELETE without
+	 * WHERE, see TruncateGuard. a statement which changes the schema drops
+	 * all results when it is compiled.
+	 *
+	 * not thread-safe. used from the thread which uses the connection.
+	 */
+	class ResultCache {
+		friend class Sqlite; // shares the hooks with the change capture
+
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		ResultCache() = delete;
+
+		/**
+		 * install the hooks on db
+		 */
+		ResultCache(sqlite3* db, const ResultCacheOptions& options = ResultCacheOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		ResultCache(const ResultCache&) = delete;
+
+		/**
+		 * remove the hooks
+		 */
+		virtual ~ResultCache();
+
+		/**
+		 * forbid assignment operator
+		 */
+		ResultCache& operator=(const ResultCache&) = delete;
+
+		/**
+		 * @param key made by makeKey()
+		 * @param result receives a copy of the cached result
+		 * @return true: hit. false: not cached or outdated.
+		 */
+		bool lookup(const std::string& key, SqlResult& result);
+
+		/**
+		 * cache result, unless the query can not be cached
+		 * @param key made by makeKey()
+		 * @param query the sql text the result was read with
+		 * @return true: cached
+		 */
+		bool store(const std::string& key, const char* query, const SqlResult& result);
+
+		/**
+		 * drop all results which read table
+		 */
+		void invalidate(const char* table);
+
+		/**
+		 * drop all results
+		 */
+		void clear();
+
+		/**
+		 * @return counters
+		 */
+		ResultCacheStats getStats() const;
+
+		/**
+		 * do not cache queries which call the function name, e.g. an
+		 * application-defined function whose result changes over time
+		 */
+		void addVolatileFunction(const std::string& name);
+
+		/**
+		 * @return cache key of query run with args. the args are encoded
+		 * 				 with their type, so 1 and '1' are different keys.
+		 */
+		template<typename... Args>
+		static std::string makeKey(const char* query, const Args&... args);
+
+	private:
+		/**
+		 * what is known about an sql text
+		 */
+		struct QueryInfo {
+			bool cacheable = false;
+			std::vector<std::string> tables; // read by the query
+		};
+
+		/**
+		 * a cached result with the versions of the tables it read
+		 */
+		struct Entry {
+			std::string key;
+			std::shared_ptr<const SqlResult> result;
+			std::vector<std::pair<std::string, std::uint64_t> > tables;
+			std::size_t bytes;
+		};
+		typedef std::list<Entry> LruList;
+
+		/**************/
+		/* Attributes */
+		/**************/
+		sqlite3* m_db;
+		ResultCacheOptions m_options;
+		sqlite3_stmt* m_dataVersion; // PRAGMA data_version. NULL if not detecting external changes.
+		long long m_lastDataVersion;
+		LruList m_lru; // most recently used first
+		std::unordered_map<std::string_view, LruList::iterator> m_index; // keys point into m_lru
+		std::unordered_map<std::string, QueryInfo> m_queries; // by sql text
+		std::unordered_map<std::string, std::uint64_t> m_tableVersions;
+		std::unordered_set<std::string> m_volatileFunctions; // application-defined, lower case
+		std::unordered_set<std::string> m_changedInTransaction; // tables changed since the last commit
+		const char* m_lastChanged; // table name of the last update hook call, to skip repeated rows
+		bool m_schemaChanged; // a schema changing statement was compiled in the open transaction
+		QueryInfo* m_collecting; // the query being analyzed by the authorizer. NULL if none.
+		TruncateGuard m_truncateGuard;
+		std::size_t m_bytes;
+		ResultCacheStats m_stats;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * install the hooks of this cache on the connection
+		 */
+		void installHooks();
+
+		/**
+		 * find out if query can be cached and which tables it reads
+		 */
+		const QueryInfo& analyze(const char* query);
+
+		/**
+		 * @return version of table
+		 */
+		std::uint64_t getVersion(const std::string& table) const;
+
+		/**
+		 * remove an entry
+		 */
+		void erase(LruList::iterator entry);
+
+		/**
+		 * drop least recently used entries until the limits are met
+		 */
+		void evict();
+
+		/**
+		 * drop everything if another connection committed
+		 */
+		void checkExternalChanges();
+
+		/**
+		 * encode one bound value into key
+		 */
+		template<typename T>
+		static void appendKey(std::string& key, const T& value);
+
+		static void appendBytes(std::string& key, char type, const void* data, std::size_t size);
+
+		static int authorizer(void* cache, int action, const char* arg1, const char* arg2,
+		                      const char* database, const char* trigger);
+		static void updateHook(void* cache, int operation, const char* database, const char* table,
+		                       sqlite3_int64 rowid);
+		static void rollbackHook(void* cache);
+	};
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename... Args>
+	std::string ResultCache::makeKey(const char* query, const Args&... args) {
+		std::string key(query);
+		// the sql text can not contain a NUL, so the values can not be confused with it
+		key += '\0';
+		(appendKey(key, args), ...);
+		return key;
+	}
+
+
+	template<typename T>
+	void ResultCache::appendKey(std::string& key, const T& value) {
+		if constexpr (std::is_same<T, std::nullptr_t>::value) {
+			key += 'n';
+		}
+		else if constexpr (std::is_integral<T>::value) {
+			sqlite3_int64 number = static_cast<sqlite3_int64>(value);
+			appendBytes(key, 'i', &number, sizeof(number));
+		}
+		else if constexpr (std::is_floating_point<T>::value) {
+			double number = static_cast<double>(value);
+			appendBytes(key, 'r', &number, sizeof(number));
+		}
+		else if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+			if (value == NULL) {
+				key += 'n';
+			}
+			else {
+				std::string_view text(value);
+				appendBytes(key, 't', text.data(), text.size());
+			}
+		}
+		else if constexpr (std::is_convertible<const T&, std::string_view>::value) {
+			std::string_view text(value);
+			appendBytes(key, 't', text.data(), text.size());
+		}
+		else if constexpr (std::is_same<T, StaticText>::value) {
+			appendBytes(key, 't', value.text.data(), value.text.size());
+		}
+		else if constexpr (std::is_same<T, BlobView>::value) {
+			appendBytes(key, 'b', value.data, value.size);
+		}
+		else if constexpr (std::is_same<T, ZeroBlob>::value) {
+			appendBytes(key, 'z', &value.size, sizeof(value.size));
+		}
+		else if constexpr (IsOptional<T>::value) {
+			if (!value) {
+				key += 'n';
+			}
+			else {
+				appendKey(key, *value);
+			}
+		}
+		else {
+			static_assert(UnsupportedType<T>::value, "type cannot be bound to an sql parameter");
+		}
+	}
+
+}
+
+#endif
@@ -0,0 +1,423 @@
+#include "ShardedDatabase.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <queue>
+
+#define logError(s) GRE90R_LOG(gre90r::LogLevel::Error, s)
+
+
+namespace {
+
+	/**
+	 * @return value as a number, for adding it to a sum
+	 */
+	double toReal(const gre90r::ShardValue& value) {
+		if (value.type == SQLITE_INTEGER) {
+			return static_cast<double>(value.integer);
+		}
+		if (value.type == SQLITE_FLOAT) {
+			return value.real;
+		}
+		return std::strtod(value.bytes.c_str(), NULL);
+	}
+
+	/**
+	 * add value to the partial sum total. integers stay integers unless
+	 * they overflow, like in sqlite's total().
+	 */
+	void add(gre90r::ShardValue& total, const gre90r::ShardValue& value) {
+		if (value.type == SQLITE_NULL) {
+			return;
+		}
+		if (total.type == SQLITE_NULL) {
+			total = value;
+			if (total.type == SQLITE_TEXT || total.type == SQLITE_BLOB) {
+				total.real = toReal(value);
+				total.type = SQLITE_FLOAT;
+			}
+			return;
+		}
+		sqlite3_int64 sum;
+		if (total.type == SQLITE_INTEGER && value.type == SQLITE_INTEGER
+		    && !__builtin_add_overflow(total.integer, value.integer, &sum)) {
+			total.integer = sum;
+			return;
+		}
+		total.real = toReal(total) + toReal(value);
+		total.type = SQLITE_FLOAT;
+	}
+
+	/**
+	 * @return value as sqlite shows it as text. empty for NULL.
+	 */
+	std::string toText(const gre90r::ShardValue& value) {
+		if (value.type == SQLITE_INTEGER) {
+			return std::to_string(value.integer);
+		}
+		if (value.type == SQLITE_FLOAT) {
+			char text[32];
+			sqlite3_snprintf(sizeof(text), text, "%!.15g", value.real);
+			return text;
+		}
+		return value.bytes;
+	}
+
+	/**
+	 * orders the group keys of ShardedDatabase::combine()
+	 */
+	struct KeyLess {
+		bool operator()(const std::vector<gre90r::ShardValue>& a, const std::vector<gre90r::ShardValue>& b) const {
+			for (std::size_t i = 0; i < a.size() && i < b.size(); ++i) {
+				int order = gre90r::ShardValue::compare(a[i], b[i]);
+				if (order != 0) {
+					return order < 0;
+				}
+			}
+			return a.size() < b.size();
+		}
+	};
+
+	/**
+	 * copy the column names of the first shard with columns into result
+	 */
+	void copyColumns(const std::vector<gre90r::ShardRows>& shards, gre90r::SqlResult& result) {
+		if (result.getColumnCount() != 0) {
+			return;
+		}
+		for (const gre90r::ShardRows& shard : shards) {
+			std::size_t columns = shard.rows.getColumnCount();
+			if (columns == 0) {
+				continue;
+			}
+			std::vector<char*> names(columns);
+			for (std::size_t i = 0; i < columns; ++i) {
+				names[i] = const_cast<char*>(shard.rows.getColumnName(i).c_str());
+			}
+			result.setColumns(static_cast<int>(columns), names.data());
+			return;
+		}
+	}
+
+	/**
+	 * append row of shard to result
+	 */
+	void appendRow(const gre90r::SqlResult& shard, std::size_t row, gre90r::SqlResult& result) {
+		std::size_t columns = shard.getColumnCount();
+		std::vector<const char*> values(columns);
+		std::vector<std::size_t> lengths(columns);
+		for (std::size_t i = 0; i < columns; ++i) {
+			values[i] = shard.getValue(row, i);
+			lengths[i] = shard.getLength(row, i);
+		}
+		result.appendRow(static_cast<int>(columns), values.data(), lengths.data());
+	}
+
+}
+
+
+int gre90r::ShardValue::compare(const ShardValue& a, const ShardValue& b) {
+	// NULL, numbers, text, blobs
+	int rankA = a.type == SQLITE_NULL ? 0 : a.type == SQLITE_TEXT ? 2 : a.type == SQLITE_BLOB ? 3 : 1;
+	int rankB = b.type == SQLITE_NULL ? 0 : b.type == SQLITE_TEXT ? 2 : b.type == SQLITE_BLOB ? 3 : 1;
+	if (rankA != rankB) {
+		return rankA < rankB ? -1 : 1;
+	}
+	if (rankA == 0) {
+		return 0;
+	}
+	if (rankA == 1) {
+		if (a.type == SQLITE_INTEGER && b.type == SQLITE_INTEGER) {
+			return a.integer < b.integer ? -1 : (a.integer > b.integer ? 1 : 0);
+		}
+		double x = toReal(a);
+		double y = toReal(b);
+		return x < y ? -1 : (x > y ? 1 : 0);
+	}
+	return a.bytes.compare(b.bytes) < 0 ? -1 : (a.bytes == b.bytes ? 0 : 1);
+}
+
+
+gre90r::ShardedDatabase::ShardedDatabase(const std::vector<std::string>& filenames,
+                                         const ShardedDatabaseOptions& options)
+{
+	AsyncExecutorOptions executorOptions;
+	executorOptions.workers = options.workersPerShard;
+	executorOptions.openFlags = options.openFlags;
+	for (const std::string& filename : filenames) {
+		this->m_shards.emplace_back(new AsyncExecutor(filename.c_str(), executorOptions));
+		if (!this->m_shards.back()->isValid()) {
+			logError("cannot open shard " << filename << ".");
+		}
+	}
+}
+
+
+gre90r::ShardedDatabase::~ShardedDatabase() {
+}
+
+
+bool gre90r::ShardedDatabase::isValid() const {
+	if (this->m_shards.empty()) {
+		return false;
+	}
+	for (const std::unique_ptr<AsyncExecutor>& shard : this->m_shards) {
+		if (!shard->isValid()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+std::size_t gre90r::ShardedDatabase::getShardCount() const {
+	return this->m_shards.size();
+}
+
+
+int gre90r::ShardedDatabase::executeAll(const char* query) {
+	if (query == NULL) {
+		return -2;
+	}
+	if (this->m_shards.empty()) {
+		return -3;
+	}
+	std::vector<std::future<int> > done;
+	for (std::size_t i = 0; i < this->m_shards.size(); ++i) {
+		done.push_back(this->submit(i, [query](Sqlite& db) {
+			return db.execute(query);
+		}));
+	}
+	int rc = SQLITE_OK;
+	for (std::future<int>& shard : done) {
+		int shardRc = shard.get();
+		rc = rc == SQLITE_OK ? shardRc : rc;
+	}
+	return rc;
+}
+
+
+std::size_t gre90r::ShardedDatabase::getShardOfHash(std::uint64_t hash) const {
+	return this->m_shards.empty() ? 0 : static_cast<std::size_t>(hash % this->m_shards.size());
+}
+
+
+void gre90r::ShardedDatabase::readRows(Cursor& cursor, const std::vector<std::size_t>& keyColumns, bool allKeys,
+                                       std::size_t limit, ShardRows& shard)
+{
+	std::vector<const char*> values;
+	std::vector<std::size_t> lengths;
+	std::vector<std::size_t> keys = keyColumns;
+	// with a limit the rows after it are not stepped to, the merge does not need them
+	while ((limit == 0 || shard.rows.size() < limit) && cursor.next()) {
+		const Row& row = cursor.getRow();
+		int columns = row.getColumnCount();
+		if (shard.rows.getColumnCount() == 0) {
+			std::vector<char*> names(static_cast<std::size_t>(columns));
+			for (int i = 0; i < columns; ++i) {
+				names[i] = const_cast<char*>(row.getColumnName(i));
+			}
+			shard.rows.setColumns(columns, names.data());
+			values.resize(names.size());
+			lengths.resize(names.size());
+			if (allKeys) {
+				keys.clear();
+				for (std::size_t i = 0; i < names.size(); ++i) {
+					keys.push_back(i);
+				}
+			}
+			for (std::size_t key : keys) {
+				if (key >= names.size()) {
+					logError("key column " << key << " is not in the result.");
+					shard.rc = SQLITE_RANGE;
+					return;
+				}
+			}
+		}
+
+		// the typed keys first, getText() may convert the values
+		for (std::size_t key : keys) {
+			ShardValue value;
+			value.type = row.getType(static_cast<int>(key));
+			if (value.type == SQLITE_INTEGER) {
+				value.integer = row.get<sqlite3_int64>(static_cast<int>(key));
+			}
+			else if (value.type == SQLITE_FLOAT) {
+				value.real = row.get<double>(static_cast<int>(key));
+			}
+			else if (value.type == SQLITE_BLOB) {
+				BlobView blob = row.get<BlobView>(static_cast<int>(key));
+				value.bytes.assign(static_cast<const char*>(blob.data), blob.size);
+			}
+			else if (value.type == SQLITE_TEXT) {
+				value.bytes = row.toString(static_cast<int>(key));
+			}
+			shard.keys.push_back(std::move(value));
+		}
+		for (int i = 0; i < columns; ++i) {
+			values[i] = row.getText(i);
+			lengths[i] = row.getLength(i);
+		}
+		if (!shard.rows.appendRow(columns, values.data(), lengths.data())) {
+			shard.rc = SQLITE_ABORT;
+			return;
+		}
+	}
+	int rc = cursor.getErrorCode();
+	shard.rc = rc == SQLITE_DONE || rc == SQLITE_ROW ? SQLITE_OK : rc;
+}
+
+
+int gre90r::ShardedDatabase::getErrorCode(const std::vector<ShardRows>& shards) {
+	for (const ShardRows& shard : shards) {
+		if (shard.rc != SQLITE_OK) {
+			return shard.rc;
+		}
+	}
+	return SQLITE_OK;
+}
+
+
+void gre90r::ShardedDatabase::merge(const std::vector<ShardRows>& shards, const std::vector<OrderBy>& orderBy,
+                                    std::size_t limit, SqlResult& result)
+{
+	copyColumns(shards, result);
+	std::size_t remaining = limit == 0 ? static_cast<std::size_t>(-1) : limit;
+	if (orderBy.empty()) {
+		for (const ShardRows& shard : shards) {
+			for (std::size_t row = 0; row < shard.rows.size() && remaining > 0; ++row, --remaining) {
+				appendRow(shard.rows, row, result);
+			}
+		}
+		return;
+	}
+
+	// the next row of each shard in a heap, the smallest on top.
+	// equal rows are taken in shard order.
+	typedef std::pair<std::size_t, std::size_t> Position; // shard, row
+	std::size_t keys = orderBy.size();
+	std::function<bool(const Position&, const Position&)> after =
+		[&shards, &orderBy, keys](const Position& a, const Position& b) {
+			for (std::size_t i = 0; i < keys; ++i) {
+				int order = ShardValue::compare(shards[a.first].keys[a.second * keys + i],
+				                                shards[b.first].keys[b.second * keys + i]);
+				if (order != 0) {
+					return orderBy[i].descending ? order < 0 : order > 0;
+				}
+			}
+			return a.first > b.first;
+		};
+	std::priority_queue<Position, std::vector<Position>, std::function<bool(const Position&, const Position&)> >
+		next(after);
+	for (std::size_t i = 0; i < shards.size(); ++i) {
+		if (!shards[i].rows.empty()) {
+			next.push(Position(i, 0));
+		}
+	}
+	while (!next.empty() && remaining > 0) {
+		Position top = next.top();
+		next.pop();
+		appendRow(shards[top.first].rows, top.second, result);
+		--remaining;
+		if (top.second + 1 < shards[top.first].rows.size()) {
+			next.push(Position(top.first, top.second + 1));
+		}
+	}
+}
+
+
+int gre90r::ShardedDatabase::combine(const std::vector<ShardRows>& shards, const std::vector<Aggregate>& columns,
+                                     SqlResult& result)
+{
+	// a group: where its Group values are, and its combined aggregates
+	struct Group {
+		std::size_t shard;
+		std::size_t row;
+		std::vector<ShardValue> values;
+	};
+	std::map<std::vector<ShardValue>, Group, KeyLess> groups;
+
+	for (std::size_t s = 0; s < shards.size(); ++s) {
+		const ShardRows& shard = shards[s];
+		if (shard.rows.empty()) {
+			continue;
+		}
+		if (shard.rows.getColumnCount() != columns.size()) {
+			logError("the query returns " << shard.rows.getColumnCount() << " columns, "
+			         << columns.size() << " are combined.");
+			return SQLITE_MISMATCH;
+		}
+		for (std::size_t row = 0; row < shard.rows.size(); ++row) {
+			const ShardValue* values = &shard.keys[row * columns.size()];
+			std::vector<ShardValue> key;
+			for (std::size_t i = 0; i < columns.size(); ++i) {
+				if (columns[i] == Aggregate::Group) {
+					key.push_back(values[i]);
+				}
+			}
+			std::map<std::vector<ShardValue>, Group, KeyLess>::iterator found = groups.find(key);
+			if (found == groups.end()) {
+				Group group = { s, row, std::vector<ShardValue>(values, values + columns.size()) };
+				groups.emplace(std::move(key), std::move(group));
+				continue;
+			}
+			for (std::size_t i = 0; i < columns.size(); ++i) {
+				ShardValue& total = found->second.values[i];
+				if (columns[i] == Aggregate::Count || columns[i] == Aggregate::Sum) {
+					add(total, values[i]);
+				}
+				else if (values[i].type == SQLITE_NULL) {
+					// MIN() and MAX() ignore NULL
+				}
+				else if (total.type == SQLITE_NULL
+				         || (columns[i] == Aggregate::Min && ShardValue::compare(values[i], total) < 0)
+				         || (columns[i] == Aggregate::Max && ShardValue::compare(values[i], total) > 0)) {
+					total = values[i];
+				}
+			}
+		}
+	}
+
+	copyColumns(shards, result);
+	std::vector<std::string> texts(columns.size());
+	std::vector<const char*> values(columns.size());
+	std::vector<std::size_t> lengths(columns.size());
+	for (const std::pair<const std::vector<ShardValue>, Group>& entry : groups) {
+		const Group& group = entry.second;
+		for (std::size_t i = 0; i < columns.size(); ++i) {
+			if (columns[i] == Aggregate::Group) {
+				// the group value as the shard returned it
+				values[i] = shards[group.shard].rows.getValue(group.row, i);
+				lengths[i] = shards[group.shard].rows.getLength(group.row, i);
+				continue;
+			}
+			texts[i] = toText(group.values[i]);
+			values[i] = group.values[i].type == SQLITE_NULL ? NULL : texts[i].c_str();
+			lengths[i] = texts[i].size();
+		}
+		result.appendRow(static_cast<int>(columns.size()), values.data(), lengths.data());
+	}
+	return SQLITE_OK;
+}
+
+
+std::uint64_t gre90r::ShardedDatabase::hashBytes(const void* data, std::size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	std::uint64_t hash = 14695981039346656037ULL;
+	for (std::size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+std::uint64_t gre90r::ShardedDatabase::hashInteger(std::uint64_t value) {
+	// finalizer of splitmix64
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
@@ -0,0 +1,397 @@
+#ifndef SQLITESHARDEDDATABASE_H
+#define SQLITESHARDEDDATABASE_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "AsyncExecutor.h"
+#include "Cursor.h"
+#include "SqlResult.h"
+#include "Sqlite.h"
+
+
+namespace gre90r {
+
+	/**
+	 * connections of a ShardedDatabase
+	 */
+	struct ShardedDatabaseOptions {
+		/**
+		 * worker threads per shard, each owns one connection to the shard.
+		 * with 1 the writes of a shard run in the order they were made.
+		 * more only pay off for reads of shards in WAL mode.
+		 */
+		std::size_t workersPerShard = 1;
+
+		/**
+		 * sqlite3_open_v2() flags of each connection
+		 */
+		int openFlags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+	};
+
+	/**
+	 * a column of the ORDER BY of a query run with ShardedDatabase::selectOrdered()
+	 */
+	struct OrderBy {
+		std::size_t column; // index in the result
+		bool descending = false;
+	};
+
+	/**
+	 * how ShardedDatabase::aggregate() combines a column of the shard results
+	 */
+	enum class Aggregate {
+		Group, // GROUP BY column, rows with equal values are combined
+		Count, // COUNT(), the partial counts are added
+		Sum, // SUM(), the partial sums are added
+		Min, // MIN()
+		Max // MAX()
+	};
+
+	/**
+	 * a value read from a shard, compared in the order sqlite sorts:
+	 * NULL, numbers, text, blobs. text and blobs compare like BINARY.
+	 */
+	struct ShardValue {
+		int type = SQLITE_NULL;
+		sqlite3_int64 integer = 0;
+		double real = 0;
+		std::string bytes; // text or blob
+
+		/**
+		 * @return < 0, 0 or > 0 as a is sorted before, with or after b
+		 */
+		static int compare(const ShardValue& a, const ShardValue& b);
+	};
+
+	/**
+	 * the rows one shard returned for a query
+	 */
+	struct ShardRows {
+		int rc = SQLITE_OK;
+		SqlResult rows;
+		std::vector<ShardValue> keys; // values of the key columns, row by row
+	};
+
+	/**
+	 * data spread over several database files (shards), each with its own
+	 * connections and worker threads, see AsyncExecutor.
+	 *
+	 * writes go to the shard of a key. reads run on all shards in parallel
+	 * and their rows are merged: concatenated by select(), merged in order
+	 * by selectOrdered() and combined per group by aggregate(). the shard
+	 * queries run side by side, so a scan is as fast as the slowest shard.
+	 *
+	 * there are no transactions across shards. all functions are
+	 * thread-safe, each shard runs its requests on its own workers.
+	 *
+	 * usage:
+	 *   gre90r::ShardedDatabase db({ "orders0.db", "orders1.db", "orders2.db" });
+	 *   db.executeAll("create table if not exists orders(customer text, amount real)");
+	 *   db.execute(customer, "insert into orders values (?, ?)", customer, amount);
+	 *   db.aggregate("select customer, count(*), sum(amount) from orders group by customer",
+	 *                { gre90r::Aggregate::Group, gre90r::Aggregate::Count, gre90r::Aggregate::Sum }, result);
+	 */
+	class ShardedDatabase {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		ShardedDatabase() = delete;
+
+		/**
+		 * open the shards
+		 * @param filenames one database file per shard. the order decides which
+		 * 				keys a shard holds, it must not change once data was written.
+		 */
+		explicit ShardedDatabase(const std::vector<std::string>& filenames,
+		                         const ShardedDatabaseOptions& options = ShardedDatabaseOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		ShardedDatabase(const ShardedDatabase&) = delete;
+
+		/**
+		 * runs all queued requests, then closes the shards
+		 */
+		virtual ~ShardedDatabase();
+
+		/**
+		 * forbid assignment operator
+		 */
+		ShardedDatabase& operator=(const ShardedDatabase&) = delete;
+
+		/**
+		 * @return true: there is at least one shard and all connections are open
+		 */
+		bool isValid() const;
+
+		/**
+		 * @return number of shards
+		 */
+		std::size_t getShardCount() const;
+
+		/**
+		 * @return the shard which holds key. integers and text are hashed with
+		 * 				 a fixed function, so a key maps to the same shard in every
+		 * 				 process and on every platform.
+		 */
+		template<typename Key>
+		std::size_t getShard(const Key& key) const;
+
+		/**
+		 * run a statement on the shard of key and wait for it, binding args
+		 * in order to ?1, ?2, ...
+		 * @return sql error code. 0 is ok. @see Sqlite::execute()
+		 */
+		template<typename Key, typename... Args>
+		int execute(const Key& key, const char* query, const Args&... args);
+
+		/**
+		 * run query on all shards in parallel and wait for them, e.g. to
+		 * change the schema
+		 * @return sql error code of the first failing shard. 0 is ok.
+		 */
+		int executeAll(const char* query);
+
+		/**
+		 * queue any work on a connection of shard. thread-safe.
+		 * @see AsyncExecutor::submit()
+		 */
+		template<typename Work>
+		std::future<typename std::invoke_result<Work, Sqlite&>::type> submit(std::size_t shard, Work work);
+
+		/**
+		 * run a select on all shards in parallel
+		 * @param result receives the rows of all shards, shard by shard.
+		 * 				rows are appended.
+		 * @return sql error code of the first failing shard. 0 is ok.
+		 */
+		template<typename... Args>
+		int select(const char* query, SqlResult& result, const Args&... args);
+
+		/**
+		 * run a select with an ORDER BY on all shards in parallel and merge
+		 * the sorted rows of the shards, without sorting them again.
+		 * @param orderBy the columns of the ORDER BY of query, compared with
+		 * 				the BINARY collation
+		 * @param limit max number of rows in result. 0: all. each shard stops
+		 * 				reading after limit rows, so at most shards * limit rows are
+		 * 				held. a LIMIT in query limits the rows of each shard.
+		 * @param result receives the merged rows. rows are appended.
+		 * @return sql error code of the first failing shard. 0 is ok.
+		 */
+		template<typename... Args>
+		int selectOrdered(const char* query, const std::vector<OrderBy>& orderBy, std::size_t limit,
+		                  SqlResult& result, const Args&... args);
+
+		/**
+		 * run an aggregate query on all shards in parallel and combine the
+		 * partial results per group. AVG() has to be computed from SUM()
+		 * and COUNT(). the groups are sorted by their Group columns.
+		 * @param columns how to combine each column of the result
+		 * @param result receives one row per group. rows are appended.
+		 * @return sql error code of the first failing shard. 0 is ok.
+		 * 				 SQLITE_MISMATCH if columns does not match the result.
+		 */
+		template<typename... Args>
+		int aggregate(const char* query, const std::vector<Aggregate>& columns, SqlResult& result,
+		              const Args&... args);
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		std::vector<std::unique_ptr<AsyncExecutor> > m_shards;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * @return shard of a hash value
+		 */
+		std::size_t getShardOfHash(std::uint64_t hash) const;
+
+		/**
+		 * run query on every shard and collect the rows
+		 * @param keyColumns the columns whose values are read into ShardRows::keys.
+		 * 				empty: all columns if allKeys is set, else none.
+		 * @param limit max number of rows read from each shard. 0: all.
+		 */
+		template<typename... Args>
+		std::vector<ShardRows> scatter(const char* query, const std::vector<std::size_t>& keyColumns,
+		                               bool allKeys, std::size_t limit, const Args&... args);
+
+		/**
+		 * step cursor to the end or until shard has limit rows, appending its
+		 * rows to shard
+		 */
+		static void readRows(Cursor& cursor, const std::vector<std::size_t>& keyColumns, bool allKeys,
+		                     std::size_t limit, ShardRows& shard);
+
+		/**
+		 * @return the first error code of shards. 0 if all are ok.
+		 */
+		static int getErrorCode(const std::vector<ShardRows>& shards);
+
+		/**
+		 * k-way merge of the sorted rows of shards into result
+		 */
+		static void merge(const std::vector<ShardRows>& shards, const std::vector<OrderBy>& orderBy,
+		                  std::size_t limit, SqlResult& result);
+
+		/**
+		 * combine the partial aggregates of shards into result
+		 * @return 0 is ok. SQLITE_MISMATCH if columns does not match the rows.
+		 */
+		static int combine(const std::vector<ShardRows>& shards, const std::vector<Aggregate>& columns,
+		                   SqlResult& result);
+
+		/**
+		 * @return 64 bit FNV-1a hash of data
+		 */
+		static std::uint64_t hashBytes(const void* data, std::size_t size);
+
+		/**
+		 * @return value with its bits mixed, so consecutive integers spread over the shards
+		 */
+		static std::uint64_t hashInteger(std::uint64_t value);
+	};
+
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename Key>
+	std::size_t ShardedDatabase::getShard(const Key& key) const {
+		if constexpr (std::is_integral<Key>::value) {
+			return this->getShardOfHash(hashInteger(static_cast<std::uint64_t>(key)));
+		}
+		else if constexpr (std::is_convertible<const Key&, std::string_view>::value) {
+			std::string_view text(key);
+			return this->getShardOfHash(hashBytes(text.data(), text.size()));
+		}
+		else {
+			static_assert(UnsupportedType<Key>::value, "shard keys have to be integers or text");
+		}
+	}
+
+
+	template<typename Key, typename... Args>
+	int ShardedDatabase::execute(const Key& key, const char* query, const Args&... args) {
+		if (query == NULL) {
+			return -2;
+		}
+		if (this->m_shards.empty()) {
+			return -3;
+		}
+		// the caller waits, so the arguments outlive the request
+		return this->submit(this->getShard(key), [query, &args...](Sqlite& db) {
+			return db.execute(query, args...);
+		}).get();
+	}
+
+
+	template<typename Work>
+	std::future<typename std::invoke_result<Work, Sqlite&>::type> ShardedDatabase::submit(std::size_t shard,
+	                                                                                      Work work)
+	{
+		return this->m_shards[shard]->submit(std::move(work));
+	}
+
+
+	template<typename... Args>
+	int ShardedDatabase::select(const char* query, SqlResult& result, const Args&... args) {
+		if (query == NULL) {
+			return -2;
+		}
+		std::vector<ShardRows> shards = this->scatter(query, std::vector<std::size_t>(), false, 0, args...);
+		int rc = getErrorCode(shards);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		merge(shards, std::vector<OrderBy>(), 0, result);
+		return SQLITE_OK;
+	}
+
+
+	template<typename... Args>
+	int ShardedDatabase::selectOrdered(const char* query, const std::vector<OrderBy>& orderBy, std::size_t limit,
+	                                   SqlResult& result, const Args&... args)
+	{
+		if (query == NULL) {
+			return -2;
+		}
+		std::vector<std::size_t> keyColumns;
+		for (const OrderBy& column : orderBy) {
+			keyColumns.push_back(column.column);
+		}
+		std::vector<ShardRows> shards = this->scatter(query, keyColumns, false, limit, args...);
+		int rc = getErrorCode(shards);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		merge(shards, orderBy, limit, result);
+		return SQLITE_OK;
+	}
+
+
+	template<typename... Args>
+	int ShardedDatabase::aggregate(const char* query, const std::vector<Aggregate>& columns, SqlResult& result,
+	                               const Args&... args)
+	{
+		if (query == NULL) {
+			return -2;
+		}
+		std::vector<ShardRows> shards = this->scatter(query, std::vector<std::size_t>(), true, 0, args...);
+		int rc = getErrorCode(shards);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		return combine(shards, columns, result);
+	}
+
+
+	template<typename... Args>
+	std::vector<ShardRows> ShardedDatabase::scatter(const char* query, const std::vector<std::size_t>& keyColumns,
+	                                                bool allKeys, std::size_t limit, const Args&... args)
+	{
+		std::vector<ShardRows> shards(this->m_shards.size());
+		if (shards.empty()) {
+			shards.resize(1);
+			shards[0].rc = -3;
+			return shards;
+		}
+
+		// each shard fills its own ShardRows. the caller waits for all of
+		// them, so the arguments outlive the requests.
+		std::vector<std::future<void> > done;
+		for (std::size_t i = 0; i < this->m_shards.size(); ++i) {
+			ShardRows* shard = &shards[i];
+			done.push_back(this->submit(i, [query, &keyColumns, allKeys, limit, shard, &args...](Sqlite& db) {
+				// a failed bind leaves the cursor without rows, readRows() reports its error
+				Cursor cursor = db.query(query, args...);
+				readRows(cursor, keyColumns, allKeys, limit, *shard);
+			}));
+		}
+		// all requests have finished before an exception of one is rethrown
+		for (std::future<void>& shard : done) {
+			shard.wait();
+		}
+		for (std::future<void>& shard : done) {
+			shard.get();
+		}
+		return shards;
+	}
+
+}
+
+#endif
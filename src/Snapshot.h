@@ -0,0 +1,28 @@
+#ifndef SQLITESNAPSHOT_H
+#define SQLITESNAPSHOT_H
+
+
+namespace gre90r {
+
+	/**
+	 * how Sqlite::loadSnapshot() brings a snapshot file into memory
+	 */
+	struct SnapshotOptions {
+		/**
+		 * true: the database reads its pages straight from a memory mapping
+		 * of the file, nothing is copied and only the pages used are loaded.
+		 * the database is read only then and the mapping is kept until
+		 * the connection is closed or another snapshot is loaded.
+		 * false: the file is copied into memory owned by sqlite.
+		 */
+		bool mapped = false;
+
+		/**
+		 * true: writes fail with SQLITE_READONLY. always the case if mapped.
+		 */
+		bool readOnly = false;
+	};
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include "SqlResult.h"
+#include <cstring>
+
+
+gre90r::SqlResult::SqlResult()
+: m_offsets(1, 0)
+{
+}
+
+
+std::size_t gre90r::SqlResult::size() const {
+	if (this->m_columns.empty()) {
+		return 0;
+	}
+	return (this->m_offsets.size() - 1) / this->m_columns.size();
+}
+
+
+bool gre90r::SqlResult::empty() const {
+	return this->size() == 0;
+}
+
+
+std::size_t gre90r::SqlResult::getColumnCount() const {
+	return this->m_columns.size();
+}
+
+
+const std::string& gre90r::SqlResult::getColumnName(std::size_t column) const {
+	return this->m_columns[column];
+}
+
+
+int gre90r::SqlResult::getColumnIndex(const char* name) const {
+	if (name == NULL) {
+		return -1;
+	}
+	for (std::size_t i = 0; i < this->m_columns.size(); i++) {
+		if (this->m_columns[i] == name) {
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+
+const char* gre90r::SqlResult::getValue(std::size_t row, std::size_t column) const {
+	std::size_t i = this->cell(row, column);
+	if (this->m_offsets[i] == this->m_offsets[i + 1]) {
+		return NULL; // sql NULL
+	}
+	return &this->m_data[this->m_offsets[i]];
+}
+
+
+const char* gre90r::SqlResult::getValue(std::size_t row, const std::string& columnName) const {
+	int column = this->getColumnIndex(columnName.c_str());
+	if (column < 0) {
+		return NULL;
+	}
+	return this->getValue(row, static_cast<std::size_t>(column));
+}
+
+
+std::size_t gre90r::SqlResult::getLength(std::size_t row, std::size_t column) const {
+	std::size_t i = this->cell(row, column);
+	std::size_t bytes = this->m_offsets[i + 1] - this->m_offsets[i];
+	return bytes == 0 ? 0 : bytes - 1; // without NUL
+}
+
+
+bool gre90r::SqlResult::isNull(std::size_t row, std::size_t column) const {
+	std::size_t i = this->cell(row, column);
+	return this->m_offsets[i] == this->m_offsets[i + 1];
+}
+
+
+void gre90r::SqlResult::setColumns(int argc, char** colNames) {
+	if (this->m_offsets.size() > 1) {
+		return; // there are rows already
+	}
+	this->m_columns.clear();
+	for (int i = 0; i < argc; i++) {
+		this->m_columns.push_back(colNames[i] ? colNames[i] : "");
+	}
+}
+
+
+bool gre90r::SqlResult::appendRow(int argc, const char* const* argv, const std::size_t* lengths) {
+	if (argc < 0 || static_cast<std::size_t>(argc) != this->m_columns.size()) {
+		return false;
+	}
+
+	for (int i = 0; i < argc; i++) {
+		if (argv[i] != NULL) {
+			std::size_t length = lengths ? lengths[i] : std::strlen(argv[i]);
+			this->m_data.insert(this->m_data.end(), argv[i], argv[i] + length);
+			this->m_data.push_back('\0');
+		}
+		this->m_offsets.push_back(this->m_data.size());
+	}
+	return true;
+}
+
+
+void gre90r::SqlResult::reserve(std::size_t rows, std::size_t bytes) {
+	this->m_offsets.reserve(rows * this->m_columns.size() + 1);
+	this->m_data.reserve(bytes);
+}
+
+
+std::size_t gre90r::SqlResult::getMemoryUsage() const {
+	std::size_t bytes = sizeof(SqlResult)
+	                  + this->m_data.capacity()
+	                  + this->m_offsets.capacity() * sizeof(std::size_t);
+	for (const std::string& column : this->m_columns) {
+		bytes += sizeof(std::string) + column.capacity();
+	}
+	return bytes;
+}
+
+
+void gre90r::SqlResult::clear() {
+	this->m_columns.clear();
+	this->m_data.clear();
+	this->m_offsets.resize(1);
+}
+
+
+std::size_t gre90r::SqlResult::cell(std::size_t row, std::size_t column) const {
+	return row * this->m_columns.size() + column;
+}
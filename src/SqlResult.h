@@ -0,0 +1,133 @@
+#ifndef SQLRESULT_H
+#define SQLRESULT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace gre90r {
+
+	/**
+	 * the rows an sql statement returns.
+	 *
+	 * the column names are stored once. all values are stored as text
+	 * one after another in a single buffer, a cell is found by its offset.
+	 * so reading any cell is O(1) and a query only needs a few
+	 * allocations, no matter how many rows it returns.
+	 */
+	class SqlResult {
+	public:
+		/**
+		 * an empty result without columns
+		 */
+		SqlResult();
+
+		/**
+		 * @return number of rows
+		 */
+		std::size_t size() const;
+
+		/**
+		 * @return true: there are no rows
+		 */
+		bool empty() const;
+
+		/**
+		 * @return number of columns each row has
+		 */
+		std::size_t getColumnCount() const;
+
+		/**
+		 * @return name of column. column has to be < getColumnCount().
+		 */
+		const std::string& getColumnName(std::size_t column) const;
+
+		/**
+		 * @param name column name
+		 * @return index of the first column with that name. -1 if there is none.
+		 */
+		int getColumnIndex(const char* name) const;
+
+		/**
+		 * read a cell. row has to be < size() and column < getColumnCount().
+		 * @return text of the cell. NULL if the value is sql NULL.
+		 * 				 valid until the result is changed or destroyed.
+		 */
+		const char* getValue(std::size_t row, std::size_t column) const;
+
+		/**
+		 * read a cell by column name
+		 * @return text of the cell. NULL if the value is sql NULL or
+		 * 				 there is no column with that name.
+		 */
+		const char* getValue(std::size_t row, const std::string& columnName) const;
+
+		/**
+		 * @return number of bytes of the cell, without terminating NUL.
+		 * 				 0 for sql NULL.
+		 */
+		std::size_t getLength(std::size_t row, std::size_t column) const;
+
+		/**
+		 * @return true: the cell is sql NULL
+		 */
+		bool isNull(std::size_t row, std::size_t column) const;
+
+		/**
+		 * set the column names. only allowed while there are no rows.
+		 * @param argc the number of columns
+		 * @param colNames an array of strings representing column names
+		 */
+		void setColumns(int argc, char** colNames);
+
+		/**
+		 * append a row.
+		 * @param argc the number of values. has to match getColumnCount().
+		 * @param argv values of the row, NUL terminated. NULL for sql NULL.
+		 * @param lengths byte length of each value. if NULL, strlen() is used.
+		 * @return false: number of values does not match the columns.
+		 * 				 the row has not been added then.
+		 */
+		bool appendRow(int argc, const char* const* argv, const std::size_t* lengths = NULL);
+
+		/**
+		 * reserve memory up front to avoid growing the buffers
+		 * @param rows expected number of rows
+		 * @param bytes expected number of bytes of all values together
+		 */
+		void reserve(std::size_t rows, std::size_t bytes);
+
+		/**
+		 * @return bytes of memory held by the result, about
+		 */
+		std::size_t getMemoryUsage() const;
+
+		/**
+		 * remove all rows and columns. keeps the memory for reuse.
+		 */
+		void clear();
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		std::vector<std::string> m_columns; // column names
+		// all non-NULL values, each followed by a NUL. NULL values take no space.
+		std::vector<char> m_data;
+		// cell i is m_data[m_offsets[i] .. m_offsets[i+1]). cells are stored
+		// row by row. an empty range marks sql NULL.
+		std::vector<std::size_t> m_offsets;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * @return index of the cell in m_offsets
+		 */
+		std::size_t cell(std::size_t row, std::size_t column) const;
+	};
+
+}
+
+#endif
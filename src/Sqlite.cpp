@@ -1,28 +1,66 @@
 #include "Sqlite.h"
-#include <iostream>
+#include "Log.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
 
-#define print(s) {  std::cout << s; }
-#define println(s) {  std::cout << s << std::endl; }
-#define printError(s) {  std::cout << s; }
-#define printlnError(s) {  std::cerr << s << std::endl; }
+#define logTrace(s) GRE90R_LOG(gre90r::LogLevel::Trace, s)
+#define logInfo(s) GRE90R_LOG(gre90r::LogLevel::Info, s)
+#define logWarning(s) GRE90R_LOG(gre90r::LogLevel::Warning, s)
+#define logError(s) GRE90R_LOG(gre90r::LogLevel::Error, s)
 
 #define UNUSED(variable) { (void)(variable); }
 
 
+namespace {
+
+	/**
+	 * @return true: the database header says WAL mode, which a database in
+	 * 				 memory cannot use. file format bytes 18 and 19 are 2 then.
+	 */
+	bool isWalHeader(const unsigned char* data, std::size_t size) {
+		return size >= 100 && data[18] == 2 && data[19] == 2;
+	}
+
+}
+
+
 gre90r::Sqlite::Sqlite(const char* filename)
-: m_db(NULL), m_connected(false), m_name(filename)
+: Sqlite(filename, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)
+{
+}
+
+
+gre90r::Sqlite::Sqlite(const char* filename, int flags, const BusyPolicy& busyPolicy)
+: m_db(NULL), m_connected(false), m_name(filename), m_savepointDepth(0),
+  m_busyRandom(std::random_device()())
 {
 	// connect to DB
-	int rc = sqlite3_open(filename, &this->m_db);
+	int rc = sqlite3_open_v2(filename, &this->m_db, flags, NULL);
 	if (rc == SQLITE_OK) {
 		this->m_connected = true;
-		println("connected to DB");
+		this->setBusyPolicy(busyPolicy);
+		logInfo("connected to DB: " << (filename ? filename : ""));
 	}
 	else {
+		logError("failed to connect to DB. rc = " << rc << ". "
+		         << "filename was: " << (filename ? filename : "") << ". "
+		         << "sqlite error message: " << sqlite3_errmsg(this->m_db));
 		this->close(); // free resources if there have been reserved any
-		printError("[ERROR] failed to connect to DB. rc = " << rc << ".");
-		printlnError("filename was: " << filename);
-		printlnError("sqlite error message: " << sqlite3_errmsg(this->m_db));
+	}
+}
+
+
+gre90r::Sqlite::Sqlite(const char* filename, const OpenOptions& options)
+: Sqlite(filename, options.flags, options.busyPolicy)
+{
+	if (this->isConnected()) {
+		this->applyOptions(options);
 	}
 }
 
@@ -30,13 +68,26 @@ gre90r::Sqlite::Sqlite(const char* filename)
 gre90r::Sqlite::~Sqlite() {
 	// force closing db
 	if (this->m_db != NULL) {
-		int rc = sqlite3_close(this->m_db);
+		// cached statements have to be finalized before closing
+		this->m_statementCache.clear();
+		// the hook must not fire for statements finalized after this object
+		this->m_instrumentation.reset();
+		this->m_resultCache.reset();
+		this->m_changeCapture.reset();
+		// sqlite3_close_v2: statements still held by the user are
+		// finalized later, the connection is freed after them.
+		if (this->m_snapshot && sqlite3_next_stmt(this->m_db, NULL) != NULL) {
+			// they still read the mapped snapshot, unmapping it would pull the pages away
+			logWarning("statements are still in use. the mapped snapshot stays mapped until the process ends.");
+			this->m_snapshot.release();
+		}
+		int rc = sqlite3_close_v2(this->m_db);
 		if (rc == SQLITE_OK) {
-			std::cout << "disconnected from DB" << std::endl;
+			logInfo("disconnected from DB");
 		}
 		else {
-			printlnError("[ERROR] failed to force disconnect from DB: rc = " << rc << ". "
-									 << "sqlite error message: " << sqlite3_errmsg(this->m_db));
+			logError("failed to force disconnect from DB: rc = " << rc << ". "
+			         << "sqlite error message: " << sqlite3_errmsg(this->m_db));
 		}
 	}
 }
@@ -52,31 +103,66 @@ const char* gre90r::Sqlite::getName() const {
 }
 
 
+sqlite3* gre90r::Sqlite::getHandle() const {
+	return this->m_db;
+}
+
+
+sqlite3_int64 gre90r::Sqlite::getLastInsertRowId() const {
+	return this->m_db != NULL ? sqlite3_last_insert_rowid(this->m_db) : 0;
+}
+
+
+bool gre90r::Sqlite::isInTransaction() const {
+	// sqlite3_get_autocommit returns 0 if autocommit is disabled, which
+	// means that a transaction has been started with "BEGIN TRANSACTION".
+	return this->m_db != NULL && sqlite3_get_autocommit(this->m_db) == 0;
+}
+
+
 void gre90r::Sqlite::close() {
 	// check if db connection exists
 	if (this->m_db == NULL) {
-		println("[INFO] DB has already been closed.");
+		logInfo("DB has already been closed.");
 		return;
 	}
 
-	// check if a transaction is currently open
-	// sqlite3_get_autocommit returns 0 if autocommit is disabled, which
-	// means that a transaction has been started with "BEGIN TRANSACTION".
+	// check if a transaction is currently open.
 	// autocommit is automatically enabled with a "COMMIT" or "ROLLBACK".
-	if (sqlite3_get_autocommit(this->m_db) == 0) {
-		println("[INFO] will not close DB. please finish your transaction.");
+	if (this->isInTransaction()) {
+		logInfo("will not close DB. please finish your transaction.");
 		return;
 	}
 
+	// cached statements have to be finalized before closing
+	this->m_statementCache.clear();
+
+	// statements held by the user keep sqlite3_close() from closing. check
+	// before the hooks are removed, they stay on if the connection stays open.
+	for (sqlite3_stmt* statement = sqlite3_next_stmt(this->m_db, NULL); statement != NULL;
+	     statement = sqlite3_next_stmt(this->m_db, statement)) {
+		// the result cache finalizes its own statement when it is removed
+		if (!this->m_resultCache || statement != this->m_resultCache->m_dataVersion) {
+			logInfo("will not close DB. statements are still in use, e.g. by a Cursor or PreparedStatements.");
+			return;
+		}
+	}
+
+	// removes the trace hook while the connection is still open
+	this->m_instrumentation.reset();
+	this->m_resultCache.reset();
+	this->m_changeCapture.reset();
+
 	int rc = sqlite3_close(this->m_db);
 	if (rc == SQLITE_OK) {
 		this->m_connected = false;
 		this->m_db = NULL;
-		std::cout << "disconnected from DB" << std::endl;
+		this->m_snapshot.reset();
+		logInfo("disconnected from DB");
 	}
 	else {
-		printError("[ERROR] failed to disconnect from DB: rc = " << rc << ". ");
-		printlnError("sqlite error message: " << sqlite3_errmsg(this->m_db));
+		logError("failed to disconnect from DB: rc = " << rc << ". "
+		         << "sqlite error message: " << sqlite3_errmsg(this->m_db));
 	}
 }
 
@@ -98,14 +184,16 @@ int gre90r::Sqlite::callbackPrintQueryResults(
 		return 3; // RC 3: column names missing
 	}
 
-	// ignore 4th argument which is passed by sqlite3_exec.
+	// ignore 3rd argument which is passed by exec().
 	// there are no arguments needed for this call
 	UNUSED(data);
 
-	// prints every column of row. if attribute is not set
-	// then it will be marked as NULL.
-	for (int i = 0; i < argc; i++) {
-		println(colNames[i] << " -> " << (argv[i] ? argv[i] : "NULL"));
+	// logs every column of row. if attribute is not set
+	// then it will be marked as NULL. only with LogLevel::Trace.
+	if (gre90r::Log::isEnabled(gre90r::LogLevel::Trace)) {
+		for (int i = 0; i < argc; i++) {
+			logTrace(colNames[i] << " -> " << (argv[i] ? argv[i] : "NULL"));
+		}
 	}
 
 	return 0;
@@ -120,25 +208,15 @@ int gre90r::Sqlite::execute(const char* query) {
 	}
 
 	if (this->isConnected()) {
-		char* errmsg = 0;
-		/**
-		 *  sqlite3_exec(
-		 * 		sqlite3*,
-		 * 		const char *sql,
-		 * 		sqlite_callback,
-		 * 		void *data,				// ! only pass (const char*)
-		 * 		char **errmsg
-		 * 	)
-		 */
-		// 4th arg = NULL -> no data is passed to the callback
-		rc = sqlite3_exec(this->m_db, query, callbackPrintQueryResults, &this->m_resultSet, &errmsg);
-
-		if (errmsg) {
-			printlnError("[ERROR] query execution returned: " << errmsg << ". rc = " << rc << ".");
-		}
+		// rows are only logged with LogLevel::Trace. without a callback
+		// the column values are not even converted to text.
+		// 3rd arg = NULL -> no data is passed to the callback
+		rc = this->exec(query,
+		                gre90r::Log::isEnabled(gre90r::LogLevel::Trace) ? callbackPrintQueryResults : NULL,
+		                NULL);
 	}
 	else {
-		printlnError("[ERROR] cannot execute query. not connected to DB.");
+		logError("cannot execute query. not connected to DB.");
 		return -3;
 	}
 
@@ -165,44 +243,807 @@ int gre90r::Sqlite::callbackSaveQueryResults(void* resultsetBuffer, int argc,
 
 	gre90r::SqlResult* results = static_cast<SqlResult*>(resultsetBuffer);
 
-	// prints every column of row. if attribute is not set
-	// it will be marked as NULL. each row is buffered in this->resultSet
-	println("<ResultSet>");
-	for (int i = 0; i < argc; i++) {
-		println("  " << colNames[i] << " -> " << (argv[i] ? argv[i] : "NULL"));
-		results->insert( std::pair<const char*,const char*>(colNames[i], argv[i]) );
+	// header is stored once, taken from the first row
+	if (results->getColumnCount() == 0) {
+		results->setColumns(argc, colNames);
+	}
+
+	// logs every column of row. if attribute is not set
+	// it will be marked as NULL. only with LogLevel::Trace.
+	if (gre90r::Log::isEnabled(gre90r::LogLevel::Trace)) {
+		logTrace("<ResultSet>");
+		for (int i = 0; i < argc; i++) {
+			logTrace("  " << colNames[i] << " -> " << (argv[i] ? argv[i] : "NULL"));
+		}
+		logTrace("</ResultSet>");
+	}
+
+	// each row is appended to results
+
+	if (!results->appendRow(argc, argv)) {
+		return 5; // RC 5: number of columns differs from previous rows
 	}
-	println("</ResultSet>");
 
 	return 0;
 }
 
 
 gre90r::SqlResult gre90r::Sqlite::select(const char* query) {
+	gre90r::SqlResult resultSet;
+	this->select(query, resultSet);
+	return resultSet; // moved, not copied
+}
 
-	if (this->isConnected()) {
-		char* errmsg = 0;
-		/**
-		 *  sqlite3_exec(
-		 * 		sqlite3*,
-		 * 		const char *sql,
-		 * 		sqlite_callback,
-		 * 		void *data,					// !!! only pass SqlResult objects !!!
-		 * 		char **errmsg
-		 * 	)
-		 */
-		// &this->m_resultSet : give a resultset object where the results will be written to.
-		// callbackSaveQueryResults writes to this->m_resultSet.
-		int rc = sqlite3_exec(this->m_db, query, callbackSaveQueryResults, &this->m_resultSet, &errmsg);
-
-		if (errmsg) {
-			printlnError("[ERROR] query execution returned: " << errmsg << ". rc = " << rc);
+
+int gre90r::Sqlite::select(const char* query, SqlResult& result) {
+	if (query == NULL) {
+		return -2;
+	}
+	if (!this->isConnected()) {
+		logError("cannot execute query. not connected to DB.");
+		return -3;
+	}
+
+	std::string key;
+	bool cached = this->m_resultCache && result.getColumnCount() == 0 && result.empty();
+	if (cached) {
+		key = ResultCache::makeKey(query);
+		if (this->m_resultCache->lookup(key, result)) {
+			return SQLITE_OK;
+		}
+	}
+
+	// &result : give a resultset object where the results will be written to.
+	// callbackSaveQueryResults appends each row to it.
+	int rc = this->exec(query, callbackSaveQueryResults, &result);
+	if (cached && rc == SQLITE_OK) {
+		this->m_resultCache->store(key, query, result);
+	}
+	return rc;
+}
+
+
+gre90r::BulkInserter gre90r::Sqlite::bulkInsert(const std::string& table,
+                                                const std::vector<std::string>& columns,
+                                                const BulkInsertOptions& options)
+{
+	return BulkInserter(*this, table, columns, options);
+}
+
+
+gre90r::BlobStream gre90r::Sqlite::openBlob(const std::string& table, const std::string& column,
+                                            sqlite3_int64 rowid, bool writable)
+{
+	return BlobStream(*this, table, column, rowid, writable);
+}
+
+
+int gre90r::Sqlite::backup(const char* filename, const BackupOptions& options, BackupProgress* result) {
+	if (filename == NULL) {
+		return -2;
+	}
+	if (!this->isConnected()) {
+		logError("cannot back up to " << filename << ". not connected to DB.");
+		return -3;
+	}
+
+	sqlite3* destination = NULL;
+	int rc = sqlite3_open_v2(filename, &destination, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+	if (rc == SQLITE_OK) {
+		Backup backup(destination, this->m_db, options);
+		rc = backup.run();
+		if (result != NULL) {
+			*result = backup.getProgress();
 		}
 	}
 	else {
-		printlnError("[ERROR] cannot execute query. not connected to DB.");
-		return gre90r::SqlResult(); // empty resultset
+		logError("cannot back up to " << filename << ". rc = " << rc << ".");
+	}
+	sqlite3_close(destination);
+	return rc;
+}
+
+
+int gre90r::Sqlite::backup(Sqlite& destination, const BackupOptions& options, BackupProgress* result) {
+	if (!this->isConnected() || !destination.isConnected()) {
+		logError("cannot back up. not connected to DB.");
+		return -3;
+	}
+
+	Backup backup(destination.m_db, this->m_db, options);
+	int rc = backup.run();
+	if (result != NULL) {
+		*result = backup.getProgress();
+	}
+	// the pages were replaced without the update hook seeing them
+	destination.clearResultCache();
+	return rc;
+}
+
+
+int gre90r::Sqlite::restore(const char* filename, const BackupOptions& options, BackupProgress* result) {
+	if (filename == NULL) {
+		return -2;
+	}
+	if (!this->isConnected()) {
+		logError("cannot restore " << filename << ". not connected to DB.");
+		return -3;
+	}
+
+	sqlite3* source = NULL;
+	int rc = sqlite3_open_v2(filename, &source, SQLITE_OPEN_READONLY, NULL);
+	if (rc == SQLITE_OK) {
+		Backup backup(this->m_db, source, options);
+		rc = backup.run();
+		if (result != NULL) {
+			*result = backup.getProgress();
+		}
+	}
+	else {
+		logError("cannot restore " << filename << ". rc = " << rc << ".");
+	}
+	sqlite3_close(source);
+	this->clearResultCache();
+	return rc;
+}
+
+
+int gre90r::Sqlite::saveSnapshot(const char* filename) {
+	if (filename == NULL) {
+		return -2;
+	}
+	if (!this->isConnected()) {
+		logError("cannot save snapshot to " << filename << ". not connected to DB.");
+		return -3;
+	}
+
+	sqlite3_int64 size = 0;
+	bool copied = false;
+	unsigned char* data = this->serializeMain(size, copied);
+	if (data == NULL && size > 0) {
+		return SQLITE_NOMEM;
+	}
+
+	// a new file, so mappings of the old one stay valid
+	std::string temporary = std::string(filename) + ".tmp";
+	int rc = SQLITE_OK;
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			rc = SQLITE_CANTOPEN;
+		}
+		else if (!file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size))
+		         || !file.flush()) {
+			rc = SQLITE_IOERR;
+		}
+	}
+	if (copied) {
+		sqlite3_free(data);
+	}
+	if (rc == SQLITE_OK && std::rename(temporary.c_str(), filename) != 0) {
+		rc = SQLITE_IOERR;
+	}
+	if (rc != SQLITE_OK) {
+		logError("cannot save snapshot to " << filename << ". rc = " << rc << ".");
+		std::remove(temporary.c_str());
+	}
+	return rc;
+}
+
+
+int gre90r::Sqlite::loadSnapshot(const char* filename, const SnapshotOptions& options) {
+	if (filename == NULL) {
+		return -2;
+	}
+	if (!this->isConnected()) {
+		logError("cannot load snapshot " << filename << ". not connected to DB.");
+		return -3;
+	}
+
+	std::unique_ptr<MappedFile> file(new MappedFile(filename));
+	if (!file->isOpen()) {
+		logError("cannot load snapshot " << filename << ". the file cannot be read.");
+		return SQLITE_CANTOPEN;
+	}
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(file->getData());
+	std::size_t size = file->getSize();
+	if (!options.mapped || size == 0 || isWalHeader(data, size)) {
+		if (options.mapped) {
+			logWarning("snapshot " << filename << " is empty or in WAL mode. it is copied instead of mapped.");
+		}
+		std::string_view content(file->getData(), size);
+		return this->deserialize(content, options.readOnly || options.mapped);
+	}
+
+	// sqlite only reads the buffer, it is not freed or resized
+	int rc = this->loadMain(const_cast<unsigned char*>(data), size, SQLITE_DESERIALIZE_READONLY);
+	if (rc == SQLITE_OK) {
+		this->m_snapshot = std::move(file);
+	}
+	return rc;
+}
+
+
+int gre90r::Sqlite::serialize(std::string& data) {
+	data.clear();
+	if (!this->isConnected()) {
+		logError("cannot serialize. not connected to DB.");
+		return -3;
+	}
+
+	sqlite3_int64 size = 0;
+	bool copied = false;
+	unsigned char* buffer = this->serializeMain(size, copied);
+	if (buffer == NULL && size > 0) {
+		return SQLITE_NOMEM;
+	}
+	data.assign(reinterpret_cast<const char*>(buffer), static_cast<std::size_t>(size));
+	if (copied) {
+		sqlite3_free(buffer);
+	}
+	return SQLITE_OK;
+}
+
+
+int gre90r::Sqlite::deserialize(std::string_view data, bool readOnly) {
+	if (!this->isConnected()) {
+		logError("cannot deserialize. not connected to DB.");
+		return -3;
+	}
+
+	// sqlite takes over the buffer, it has to come from sqlite3_malloc()
+	unsigned char* buffer = static_cast<unsigned char*>(sqlite3_malloc64(std::max<std::size_t>(data.size(), 1)));
+	if (buffer == NULL) {
+		return SQLITE_NOMEM;
+	}
+	std::copy(data.begin(), data.end(), buffer);
+	if (isWalHeader(buffer, data.size())) {
+		// back to the rollback journal format
+		buffer[18] = 1;
+		buffer[19] = 1;
+	}
+	unsigned int flags = SQLITE_DESERIALIZE_FREEONCLOSE
+	                     | (readOnly ? SQLITE_DESERIALIZE_READONLY : SQLITE_DESERIALIZE_RESIZEABLE);
+	return this->loadMain(buffer, data.size(), flags);
+}
+
+
+int gre90r::Sqlite::importCsv(const char* filename, const std::string& table,
+                              const CsvImportOptions& options, CsvImportProgress* result)
+{
+	if (filename == NULL) {
+		return -2;
+	}
+	if (!this->isConnected()) {
+		logError("cannot import " << filename << ". not connected to DB.");
+		return -3;
+	}
+	CsvImporter importer(*this, table, options);
+	int rc = importer.importFile(filename);
+	if (result != NULL) {
+		*result = importer.getProgress();
+	}
+	return rc;
+}
+
+
+gre90r::Cursor gre90r::Sqlite::query(const char* query) {
+	return Cursor(this->prepare(query));
+}
+
+
+std::shared_ptr<gre90r::Statement> gre90r::Sqlite::prepare(const char* query) {
+	if (!this->isConnected()) {
+		logError("cannot prepare query. not connected to DB.");
+		return std::make_shared<Statement>(static_cast<sqlite3*>(NULL), query);
+	}
+
+	// changes committed by statements run without Sqlite, e.g. through a Cursor
+	this->publishChanges();
+	std::shared_ptr<Statement> statement = this->m_statementCache.acquire(this->m_db, query);
+	if (statement->getErrorCode() != SQLITE_OK) {
+		logError("failed to prepare query: " << sqlite3_errmsg(this->m_db)
+		             << ". rc = " << statement->getErrorCode() << ".");
+	}
+	return statement;
+}
+
+
+int gre90r::Sqlite::checkpoint(CheckpointMode mode, int* logFrames, int* checkpointedFrames) {
+	if (!this->isConnected()) {
+		logError("cannot run checkpoint. not connected to DB.");
+		return -3;
+	}
+
+	int sqliteMode = SQLITE_CHECKPOINT_PASSIVE;
+	switch (mode) {
+		case CheckpointMode::Passive: sqliteMode = SQLITE_CHECKPOINT_PASSIVE; break;
+		case CheckpointMode::Full: sqliteMode = SQLITE_CHECKPOINT_FULL; break;
+		case CheckpointMode::Restart: sqliteMode = SQLITE_CHECKPOINT_RESTART; break;
+		case CheckpointMode::Truncate: sqliteMode = SQLITE_CHECKPOINT_TRUNCATE; break;
+	}
+
+	// NULL: checkpoint all attached databases
+	int rc = sqlite3_wal_checkpoint_v2(this->m_db, NULL, sqliteMode, logFrames, checkpointedFrames);
+	if (rc != SQLITE_OK && rc != SQLITE_BUSY) {
+		logError("checkpoint failed: " << sqlite3_errmsg(this->m_db) << ". rc = " << rc << ".");
+	}
+	return rc;
+}
+
+
+int gre90r::Sqlite::applyOptions(const OpenOptions& options) {
+	if (!this->isConnected()) {
+		logError("cannot apply options. not connected to DB.");
+		return -3;
+	}
+
+	std::vector<std::string> pragmas;
+	// page_size first, it can not be changed any more in WAL mode
+	if (options.pageSize > 0) {
+		pragmas.push_back("PRAGMA page_size=" + std::to_string(options.pageSize) + ";");
 	}
+	if (options.journalMode != JournalMode::Keep) {
+		pragmas.push_back(std::string("PRAGMA journal_mode=") + toString(options.journalMode) + ";");
+	}
+	if (options.synchronous != SynchronousMode::Keep) {
+		pragmas.push_back(std::string("PRAGMA synchronous=") + toString(options.synchronous) + ";");
+	}
+	if (options.cacheSize != 0) {
+		pragmas.push_back("PRAGMA cache_size=" + std::to_string(options.cacheSize) + ";");
+	}
+	if (options.mmapSize >= 0) {
+		pragmas.push_back("PRAGMA mmap_size=" + std::to_string(options.mmapSize) + ";");
+	}
+	if (options.tempStore != TempStore::Keep) {
+		pragmas.push_back(std::string("PRAGMA temp_store=") + toString(options.tempStore) + ";");
+	}
+
+	for (const std::string& pragma : pragmas) {
+		int rc = this->execute(pragma.c_str());
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+	}
+
+	// sqlite silently keeps another value if a setting is not possible,
+	// e.g. WAL for an in-memory database or mmap_size above its limit
+	OpenSettings settings = this->getSettings();
+	if (options.pageSize > 0 && settings.pageSize != options.pageSize) {
+		logWarning("page_size is " << settings.pageSize << " instead of " << options.pageSize
+		           << ". it can only be set on a new database.");
+	}
+	if (options.journalMode != JournalMode::Keep) {
+		std::string expected = toString(options.journalMode);
+		for (char& c : expected) {
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+		if (settings.journalMode != expected) {
+			logWarning("journal_mode is " << settings.journalMode << " instead of " << expected << ".");
+		}
+	}
+	if (options.synchronous != SynchronousMode::Keep
+	    && settings.synchronous != static_cast<int>(options.synchronous) - 1) {
+		logWarning("synchronous is " << settings.synchronous << " instead of "
+		           << toString(options.synchronous) << ".");
+	}
+	if (options.cacheSize != 0 && settings.cacheSize != options.cacheSize) {
+		logWarning("cache_size is " << settings.cacheSize << " instead of " << options.cacheSize << ".");
+	}
+	if (options.mmapSize >= 0 && settings.mmapSize != options.mmapSize) {
+		logWarning("mmap_size is " << settings.mmapSize << " instead of " << options.mmapSize << ".");
+	}
+	if (options.tempStore != TempStore::Keep && settings.tempStore != static_cast<int>(options.tempStore)) {
+		logWarning("temp_store is " << settings.tempStore << " instead of "
+		           << toString(options.tempStore) << ".");
+	}
+	return SQLITE_OK;
+}
+
+
+gre90r::OpenSettings gre90r::Sqlite::getSettings() {
+	OpenSettings settings;
+	if (!this->isConnected()) {
+		return settings;
+	}
+
+	settings.journalMode = this->pragmaValue("PRAGMA journal_mode;");
+	settings.synchronous = std::atoi(this->pragmaValue("PRAGMA synchronous;").c_str());
+	settings.cacheSize = std::atoll(this->pragmaValue("PRAGMA cache_size;").c_str());
+	settings.mmapSize = std::atoll(this->pragmaValue("PRAGMA mmap_size;").c_str());
+	settings.tempStore = std::atoi(this->pragmaValue("PRAGMA temp_store;").c_str());
+	settings.pageSize = std::atoi(this->pragmaValue("PRAGMA page_size;").c_str());
+	return settings;
+}
+
+
+void gre90r::Sqlite::setBusyPolicy(const BusyPolicy& busyPolicy) {
+	this->m_busyPolicy = busyPolicy;
+	if (this->m_db == NULL) {
+		return;
+	}
+	// replaces any busy timeout or handler set before
+	if (busyPolicy.maxWait.count() > 0) {
+		sqlite3_busy_handler(this->m_db, busyHandler, this);
+	}
+	else {
+		sqlite3_busy_handler(this->m_db, NULL, NULL);
+	}
+}
+
+
+const gre90r::BusyPolicy& gre90r::Sqlite::getBusyPolicy() const {
+	return this->m_busyPolicy;
+}
+
+
+const gre90r::BusyStats& gre90r::Sqlite::getBusyStats() const {
+	return this->m_busyStats;
+}
+
+
+void gre90r::Sqlite::resetBusyStats() {
+	this->m_busyStats = BusyStats();
+}
+
+
+void gre90r::Sqlite::setInstrumentation(bool enabled) {
+	if (!enabled) {
+		this->m_instrumentation.reset();
+	}
+	else if (!this->m_instrumentation && this->m_db != NULL) {
+		this->m_instrumentation.reset(new Instrumentation(this->m_db));
+	}
+}
+
+
+bool gre90r::Sqlite::isInstrumented() const {
+	return this->m_instrumentation != nullptr;
+}
+
+
+gre90r::ConnectionMetrics gre90r::Sqlite::getMetrics() const {
+	if (!this->m_instrumentation) {
+		return ConnectionMetrics();
+	}
+	return this->m_instrumentation->getMetrics();
+}
+
+
+void gre90r::Sqlite::resetMetrics() {
+	if (this->m_instrumentation) {
+		this->m_instrumentation->reset();
+	}
+}
+
+
+gre90r::StatementCache& gre90r::Sqlite::getStatementCache() {
+	return this->m_statementCache;
+}
+
+
+void gre90r::Sqlite::setResultCache(bool enabled, const ResultCacheOptions& options) {
+	// the old cache removes its hooks before the new one installs them
+	this->m_resultCache.reset();
+	if (enabled && this->m_db != NULL) {
+		this->m_resultCache.reset(new ResultCache(this->m_db, options));
+		for (const std::string& name : this->m_volatileFunctions) {
+			this->m_resultCache->addVolatileFunction(name);
+		}
+	}
+	this->installHooks();
+}
+
+
+bool gre90r::Sqlite::hasResultCache() const {
+	return this->m_resultCache != nullptr;
+}
+
+
+gre90r::ResultCacheStats gre90r::Sqlite::getResultCacheStats() const {
+	if (!this->m_resultCache) {
+		return ResultCacheStats();
+	}
+	return this->m_resultCache->getStats();
+}
+
+
+void gre90r::Sqlite::clearResultCache() {
+	if (this->m_resultCache) {
+		this->m_resultCache->clear();
+	}
+}
+
+
+void gre90r::Sqlite::setChangeCapture(const std::shared_ptr<ChangeStream>& stream,
+                                      const ChangeCaptureOptions& options)
+{
+	// the old capture removes its hooks before the new one installs them
+	this->m_changeCapture.reset();
+	if (stream && this->m_db != NULL) {
+		this->m_changeCapture.reset(new ChangeCapture(this->m_db, stream, options));
+	}
+	this->installHooks();
+}
+
+
+bool gre90r::Sqlite::hasChangeCapture() const {
+	return this->m_changeCapture != nullptr;
+}
+
+
+int gre90r::Sqlite::exec(const char* query,
+                         int (*callback)(void*, int, char**, char**),
+                         void* data)
+{
+	if (query == NULL) {
+		return SQLITE_MISUSE;
+	}
+
+	// column values and names of the current row. they are passed
+	// to the callback the same way sqlite3_exec() does.
+	std::vector<char*> values;
+	std::vector<char*> colNames;
+
+	const char* sql = query;
+	while (*sql != '\0') {
+		std::shared_ptr<Statement> statement = this->prepare(sql);
+		if (statement->getErrorCode() != SQLITE_OK) {
+			return statement->getErrorCode();
+		}
+		if (statement->getSqlLength() == 0) {
+			break; // nothing left to compile
+		}
+		sql += statement->getSqlLength();
+		if (!statement->isValid()) {
+			continue; // only whitespace or comment, no statement
+		}
+
+		int columns = 0;
+		int rc;
+		while ((rc = statement->step()) == SQLITE_ROW) {
+			if (callback == NULL) {
+				continue;
+			}
+			// the names are read after the first step. an expired statement,
+			// e.g. after a schema change or a new authorizer, is compiled again
+			// by it, which frees the names and may change the columns.
+			if (columns == 0) {
+				columns = statement->getColumnCount();
+				values.resize(columns);
+				colNames.resize(columns);
+				for (int i = 0; i < columns; i++) {
+					colNames[i] = const_cast<char*>(statement->getColumnName(i));
+				}
+			}
+			for (int i = 0; i < columns; i++) {
+				values[i] = const_cast<char*>(statement->getColumnText(i));
+			}
+			if (callback(data, columns, values.data(), colNames.data()) != 0) {
+				statement->reset();
+				return SQLITE_ABORT;
+			}
+		}
+		this->publishChanges();
+
+		if (rc != SQLITE_DONE) {
+			logError("query execution returned: " << sqlite3_errmsg(this->m_db)
+			             << ". rc = " << rc << ".");
+			statement->reset();
+			return rc;
+		}
+		// release locks held by the statement
+		statement->reset();
+	}
+
+	return SQLITE_OK;
+}
+
+
+unsigned char* gre90r::Sqlite::serializeMain(sqlite3_int64& size, bool& copied) {
+	// an in-memory database hands out its own buffer
+	copied = false;
+	unsigned char* data = sqlite3_serialize(this->m_db, "main", &size, SQLITE_SERIALIZE_NOCOPY);
+	if (data == NULL) {
+		copied = true;
+		data = sqlite3_serialize(this->m_db, "main", &size, 0);
+		if (data != NULL && isWalHeader(data, static_cast<std::size_t>(size))) {
+			data[18] = 1;
+			data[19] = 1;
+		}
+	}
+	return data;
+}
+
+
+int gre90r::Sqlite::loadMain(unsigned char* data, std::size_t size, unsigned int flags) {
+	// cached statements of the old database would keep it in use
+	this->m_statementCache.clear();
+	sqlite3_int64 bytes = static_cast<sqlite3_int64>(size);
+	int rc = sqlite3_deserialize(this->m_db, "main", data, bytes, bytes, flags);
+	if (rc != SQLITE_OK) {
+		logError("cannot load database into memory. rc = " << rc << ". "
+		         << "sqlite error message: " << sqlite3_errmsg(this->m_db));
+		return rc;
+	}
+	// the old snapshot is not used anymore, the update hook did not see the new content
+	this->m_snapshot.reset();
+	this->clearResultCache();
+	return SQLITE_OK;
+}
+
+
+void gre90r::Sqlite::functionRegistered(const char* name, const FunctionOptions& options, int rc) {
+	if (rc != SQLITE_OK) {
+		logError("cannot register function " << name << ". rc = " << rc << ". "
+		         << "sqlite error message: " << sqlite3_errmsg(this->m_db));
+		return;
+	}
+	if (!options.deterministic) {
+		this->m_volatileFunctions.push_back(name);
+		if (this->m_resultCache) {
+			this->m_resultCache->addVolatileFunction(name);
+		}
+	}
+}
+
+
+int gre90r::Sqlite::dropTable(const char* name) {
+	if (name == NULL) {
+		return -2;
+	}
+	if (!this->isConnected()) {
+		logError("cannot drop table " << name << ". not connected to DB.");
+		return -3;
+	}
+	std::string drop = "drop table if exists temp." + quoteIdentifier(name);
+	int rc = this->execute(drop.c_str());
+	if (rc == SQLITE_OK) {
+		// frees the container table
+		std::string module = std::string("gre90r_") + name;
+		rc = sqlite3_create_module_v2(this->m_db, module.c_str(), NULL, NULL, NULL);
+	}
+	return rc;
+}
+
+
+int gre90r::Sqlite::createTable(const char* name, const sqlite3_module* module, void* data,
+                                void (*destroy)(void*))
+{
+	// the module has its own name, so it does not replace one of sqlite
+	std::string moduleName = std::string("gre90r_") + name;
+	std::string table = "temp." + quoteIdentifier(name);
+	std::string drop = "drop table if exists " + table;
+	int rc = this->execute(drop.c_str());
+	if (rc != SQLITE_OK) {
+		destroy(data);
+		return rc;
+	}
+	rc = sqlite3_create_module_v2(this->m_db, moduleName.c_str(), module, data, destroy);
+	if (rc == SQLITE_OK) {
+		std::string create = "create virtual table " + table + " using " + quoteIdentifier(moduleName);
+		rc = this->execute(create.c_str());
+	}
+	if (rc != SQLITE_OK) {
+		logError("cannot register table " << name << ". rc = " << rc << ". "
+		         << "sqlite error message: " << sqlite3_errmsg(this->m_db));
+	}
+	return rc;
+}
+
+
+std::string gre90r::Sqlite::pragmaValue(const char* pragma) {
+	std::string value;
+	for (const Row& row : this->query(pragma)) {
+		value = row.toString(0);
+	}
+	return value;
+}
+
+
+int gre90r::Sqlite::readRows(Statement& statement, SqlResult& result) {
+	sqlite3_stmt* handle = statement.getHandle();
+	int columns = statement.getColumnCount();
+	std::vector<const char*> values(static_cast<std::size_t>(columns));
+	std::vector<std::size_t> lengths(static_cast<std::size_t>(columns));
+
+	int rc;
+	while ((rc = statement.step()) == SQLITE_ROW) {
+		// header is stored once, taken from the first row
+		if (result.getColumnCount() == 0) {
+			std::vector<char*> colNames(static_cast<std::size_t>(columns));
+			for (int i = 0; i < columns; i++) {
+				colNames[i] = const_cast<char*>(statement.getColumnName(i));
+			}
+			result.setColumns(columns, colNames.data());
+		}
+		for (int i = 0; i < columns; i++) {
+			values[i] = reinterpret_cast<const char*>(sqlite3_column_text(handle, i));
+			lengths[i] = static_cast<std::size_t>(sqlite3_column_bytes(handle, i));
+		}
+		if (!result.appendRow(columns, values.data(), lengths.data())) {
+			rc = SQLITE_ABORT; // number of columns differs from previous rows
+			break;
+		}
+	}
+	statement.reset();
+	return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+
+int gre90r::Sqlite::busyHandler(void* connection, int count) {
+	Sqlite* self = static_cast<Sqlite*>(connection);
+	const BusyPolicy& policy = self->m_busyPolicy;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	// count is 0 on the first call for a lock
+	if (count == 0) {
+		self->m_busyStats.busyEvents++;
+		self->m_busySince = now;
+	}
+
+	std::chrono::microseconds waited =
+		std::chrono::duration_cast<std::chrono::microseconds>(now - self->m_busySince);
+	std::chrono::microseconds remaining = policy.maxWait - waited;
+	if (remaining.count() <= 0) {
+		self->m_busyStats.timeouts++;
+		logError("database is locked. gave up after " << waited.count() / 1000 << " ms.");
+		return 0;
+	}
+
+	// exponential backoff, capped and with jitter
+	double backoff = static_cast<double>(policy.initialBackoff.count());
+	for (int i = 0; i < count && backoff < policy.maxBackoff.count(); i++) {
+		backoff *= policy.backoffFactor;
+	}
+	backoff = std::min(backoff, static_cast<double>(policy.maxBackoff.count()));
+	if (policy.jitter > 0) {
+		std::uniform_real_distribution<double> fraction(0.0, std::min(policy.jitter, 1.0));
+		backoff -= backoff * fraction(self->m_busyRandom);
+	}
+	std::chrono::microseconds sleep(static_cast<long long>(backoff));
+	sleep = std::max(std::min(sleep, remaining), std::chrono::microseconds(1));
+
+	std::this_thread::sleep_for(sleep);
+	self->m_busyStats.retries++;
+	self->m_busyStats.totalWaitMicros += static_cast<unsigned long long>(sleep.count());
+	return 1;
+}
+
+
+void gre90r::Sqlite::installHooks() {
+	if (this->m_changeCapture) {
+		this->m_changeCapture->installHooks();
+	}
+	// the authorizer of the cache replaces the one of the capture, see installHooks() in Sqlite.h
+	if (this->m_resultCache) {
+		this->m_resultCache->installHooks();
+	}
+	if (this->m_resultCache && this->m_changeCapture) {
+		sqlite3_update_hook(this->m_db, updateHook, this);
+		sqlite3_rollback_hook(this->m_db, rollbackHook, this);
+	}
+}
+
+
+void gre90r::Sqlite::publishChanges() {
+	if (this->m_changeCapture) {
+		this->m_changeCapture->publishCommitted();
+	}
+}
+
+
+void gre90r::Sqlite::updateHook(void* connection, int operation, const char* database, const char* table,
+                                sqlite3_int64 rowid)
+{
+	Sqlite* self = static_cast<Sqlite*>(connection);
+	ResultCache::updateHook(self->m_resultCache.get(), operation, database, table, rowid);
+	ChangeCapture::updateHook(self->m_changeCapture.get(), operation, database, table, rowid);
+}
+
 
-	return this->m_resultSet;
+void gre90r::Sqlite::rollbackHook(void* connection) {
+	Sqlite* self = static_cast<Sqlite*>(connection);
+	ResultCache::rollbackHook(self->m_resultCache.get());
+	ChangeCapture::rollbackHook(self->m_changeCapture.get());
 }
@@ -2,22 +2,62 @@
 #define SQLITEWRAPPER_H
 
 #include <sqlite3.h>
+#include <chrono>
 #include <string>
-#include <map>
+#include <string_view>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Backup.h"
+#include "BlobStream.h"
+#include "BulkInserter.h"
+#include "ChangeCapture.h"
+#include "ColumnarResult.h"
+#include "CsvImport.h"
+#include "Cursor.h"
+#include "Function.h"
+#include "Instrumentation.h"
+#include "Log.h"
+#include "OpenOptions.h"
+#include "ResultCache.h"
+#include "Transaction.h"
+#include "Snapshot.h"
+#include "SqlResult.h"
+#include "Statement.h"
+#include "VirtualTable.h"
 
 
 namespace gre90r {
 
+	class MappedFile;
+
 	/**
-	 * the rows an sql statement returns
-	 * std::map<column,value>
+	 * how a WAL checkpoint copies the write-ahead log into the database.
+	 * @see https://www.sqlite.org/c3ref/wal_checkpoint_v2.html
 	 */
-	typedef std::map<std::string,std::string> SqlResult;
+	enum class CheckpointMode {
+		Passive, // copy as much as possible without waiting for readers or writers
+		Full, // wait for the writer, then copy everything
+		Restart, // like Full, then wait for readers so the log restarts from the beginning
+		Truncate // like Restart, then truncate the log file to zero bytes
+	};
+
+	/**
+	 * lock contention of a connection
+	 */
+	struct BusyStats {
+		unsigned long long busyEvents = 0; // statements which found the database locked
+		unsigned long long retries = 0; // sleeps before retrying
+		unsigned long long timeouts = 0; // busy events which gave up after maxWait
+		unsigned long long totalWaitMicros = 0; // time spent sleeping
+	};
 
 	/**
 	 * sqlite3 wrapper
 	 */
 	class Sqlite {
+		friend class Savepoint; // tracks the savepoint depth and the captured changes
+
 	public:
 		/**
 		 * forbid standard constructor
@@ -30,9 +70,28 @@ namespace gre90r {
 		 * will create a new database
 		 * @param filename filename of the database. if NULL it will create
 		 * 				a database only in memory
+		 * waits for a locked database as set by the default BusyPolicy.
 		 */
 		Sqlite(const char* filename);
 
+		/**
+		 * open sqlite database by filename with sqlite3_open_v2() flags.
+		 * @param filename filename of the database. if NULL it will create
+		 * 				a database only in memory
+		 * @param flags SQLITE_OPEN_* flags, e.g. SQLITE_OPEN_READONLY.
+		 * 				Sqlite(filename) uses SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE.
+		 * @param busyPolicy how long and how to wait for a locked database
+		 */
+		Sqlite(const char* filename, int flags, const BusyPolicy& busyPolicy = BusyPolicy());
+
+		/**
+		 * open sqlite database by filename and tune it with options,
+		 * e.g. OpenOptions::forProfile(OpenProfile::ReadHeavy).
+		 * settings which did not take effect are logged as warnings.
+		 * @see applyOptions()
+		 */
+		Sqlite(const char* filename, const OpenOptions& options);
+
 		/**
 		 * forbid copy constructor
 		 */
@@ -60,11 +119,29 @@ namespace gre90r {
 		 */
 		const char* getName() const;
 
+		/**
+		 * @return the underlying sqlite connection handle, for sqlite3_* calls
+		 * 				 this class does not wrap. NULL if not connected.
+		 */
+		sqlite3* getHandle() const;
+
+		/**
+		 * @return rowid of the last row inserted on this connection. 0 if none.
+		 */
+		sqlite3_int64 getLastInsertRowId() const;
+
+		/**
+		 * @return true: a transaction has been started and is not finished yet
+		 */
+		bool isInTransaction() const;
+
 		/**
 		 * close db connection.
 		 * 
 		 * does not close on open transaction. COMMIT or ROLLBACK
-		 * your transaction first.
+		 * your transaction first. does not close while statements are
+		 * in use, e.g. by a Cursor or PreparedStatements. the connection
+		 * then stays open with all its features.
 		 */
 		void close();
 
@@ -80,30 +157,388 @@ namespace gre90r {
 		 */
 		int execute(const char* query);
 
+		/**
+		 * run a single sql statement with parameters. the values are bound
+		 * in order to ?1, ?2, ... with the type picked at compile time,
+		 * see Statement::bind(). rows returned are dropped.
+		 * @return sql error code. 0 is ok. same negative codes as execute(const char*).
+		 */
+		template<typename... Args>
+		int execute(const char* query, const Args&... args);
+
 		/**
 		 * an sql select statement which returns rows
 		 * @param query an sql select statement
-		 * @return sql result set. an SqlResult array
+		 * @return sql result set. all rows of the query. empty if the query
+		 * 				 failed or if not connected.
 		 */
 		SqlResult select(const char* query);
 
+		/**
+		 * same as select(const char*), but reports the sql error code.
+		 * the result cache is used if it is on and result is empty.
+		 * @param query an sql select statement
+		 * @param result receives all rows of the query. rows are appended.
+		 * @return sql error code. 0 is ok. same negative codes as execute(const char*).
+		 */
+		int select(const char* query, SqlResult& result);
+
+		/**
+		 * same as select(const char*, SqlResult&) for a single statement,
+		 * binding args in order to ?1, ?2, ...
+		 */
+		template<typename... Args>
+		int select(const char* query, SqlResult& result, const Args&... args);
+
+		/**
+		 * run a select statement into typed column-major buffers, binding args
+		 * in order to ?1, ?2, ...
+		 * @param result receives the rows. the old content is replaced.
+		 * @return sql error code. 0 is ok. -2: query is NULL. -3: not connected to database.
+		 */
+		template<typename... Args>
+		int selectColumnar(const char* query, ColumnarResult& result, const Args&... args);
+
+		/**
+		 * run a select statement and stream its rows. unlike select() the
+		 * rows are not copied, only the current row is held in memory.
+		 * @param query a single sql statement
+		 * @return cursor over the rows. use it in a range-based for loop.
+		 * 				 the cursor is empty if the query failed or if not connected.
+		 */
+		Cursor query(const char* query);
+
+		/**
+		 * same as query(const char*), binding args in order to ?1, ?2, ...
+		 * if binding fails the cursor has no rows and reports the bind error.
+		 */
+		template<typename... Args>
+		Cursor query(const char* query, const Args&... args);
+
+		/**
+		 * create a writer which inserts many rows into table in batched
+		 * transactions with one reused prepared statement.
+		 * @param table the table to insert into
+		 * @param columns the columns which get a value in each row
+		 * @param options rows or bytes per committed batch
+		 * @return the writer. call finish() on it when done.
+		 */
+		BulkInserter bulkInsert(const std::string& table,
+		                        const std::vector<std::string>& columns,
+		                        const BulkInsertOptions& options = BulkInsertOptions());
+
+		/**
+		 * open a blob for reading or writing in chunks
+		 * @param table the table of the blob
+		 * @param column the column of the blob
+		 * @param rowid the row of the blob
+		 * @param writable false: read only
+		 * @return the stream. check isOpen() before using it.
+		 */
+		BlobStream openBlob(const std::string& table, const std::string& column,
+		                    sqlite3_int64 rowid, bool writable = false);
+
+		/**
+		 * copy the database into filename while it stays in use, see Backup.
+		 * the file is created or overwritten.
+		 * @param options pages per step, pause between the steps and progress callback
+		 * @param result if not NULL, receives pages, steps and restarts
+		 * @return sql error code. 0 is ok. -2: filename is NULL. -3: not connected to database.
+		 */
+		int backup(const char* filename, const BackupOptions& options = BackupOptions(),
+		           BackupProgress* result = NULL);
+
+		/**
+		 * same as backup(const char*), into another connection, e.g. an
+		 * in-memory database. its old content is replaced.
+		 */
+		int backup(Sqlite& destination, const BackupOptions& options = BackupOptions(),
+		           BackupProgress* result = NULL);
+
+		/**
+		 * replace the content of this database by a copy of filename, e.g.
+		 * to load a file into an in-memory database. there must be no open
+		 * transaction.
+		 * @return sql error code. 0 is ok. -2: filename is NULL. -3: not connected to database.
+		 */
+		int restore(const char* filename, const BackupOptions& options = BackupOptions(),
+		            BackupProgress* result = NULL);
+
+		/**
+		 * write the main database to filename as a plain database file, with
+		 * sqlite3_serialize(). an in-memory database is written straight from
+		 * its buffer. the file is written under a temporary name and renamed,
+		 * so processes which have the old file mapped keep a consistent copy.
+		 * @return sql error code. 0 is ok. SQLITE_CANTOPEN or SQLITE_IOERR if writing failed.
+		 * 				 -2: filename is NULL. -3: not connected to database.
+		 */
+		int saveSnapshot(const char* filename);
+
+		/**
+		 * replace the main database by the content of filename, e.g. one written
+		 * by saveSnapshot() or backup(). the connection works on it in memory
+		 * afterwards, the file is never written.
+		 * @param options copy or map the file, read only
+		 * @return sql error code. 0 is ok. SQLITE_CANTOPEN if the file cannot be read.
+		 * 				 -2: filename is NULL. -3: not connected to database.
+		 */
+		int loadSnapshot(const char* filename, const SnapshotOptions& options = SnapshotOptions());
+
+		/**
+		 * @param data receives the main database in the file format
+		 * @return sql error code. 0 is ok. -3: not connected to database.
+		 */
+		int serialize(std::string& data);
+
+		/**
+		 * replace the main database by a copy of data, as written by serialize()
+		 * @param readOnly true: writes fail with SQLITE_READONLY
+		 * @return sql error code. 0 is ok. -3: not connected to database.
+		 */
+		int deserialize(std::string_view data, bool readOnly = false);
+
+		/**
+		 * import a CSV or TSV file into table, see CsvImporter
+		 * @param options format of the file, batch size and progress callback
+		 * @param result if not NULL, receives rows, malformed rows and throughput
+		 * @return sql error code. 0 is ok. SQLITE_CANTOPEN if the file cannot be read.
+		 * 				 -2: filename is NULL. -3: not connected to database.
+		 */
+		int importCsv(const char* filename, const std::string& table,
+		              const CsvImportOptions& options = CsvImportOptions(),
+		              CsvImportProgress* result = NULL);
+
+		/**
+		 * get a compiled statement for query. repeated calls with the same
+		 * sql text are served from the statement cache of this connection.
+		 * @param query a single sql statement. use ?, ?NNN or :name for parameters.
+		 * @return compiled statement. check isValid() before using it.
+		 * 				 reset() it when done, so it does not keep the db locked.
+		 */
+		std::shared_ptr<Statement> prepare(const char* query);
+
+		/**
+		 * run a checkpoint on a database in WAL mode.
+		 * must not be called inside a transaction.
+		 * @param mode how much to copy and whether to wait
+		 * @param logFrames if not NULL, receives the number of frames in the log
+		 * @param checkpointedFrames if not NULL, receives the number of frames copied
+		 * @return sql error code. 0 is ok. SQLITE_BUSY if a reader or writer
+		 * 				 prevented a complete checkpoint. -3: not connected to database.
+		 */
+		int checkpoint(CheckpointMode mode = CheckpointMode::Passive,
+		               int* logFrames = NULL, int* checkpointedFrames = NULL);
+
+		/**
+		 * run the PRAGMAs of options and check them with getSettings().
+		 * options.flags are only used when opening.
+		 * @return sql error code. 0 is ok, also if sqlite kept another value
+		 * 				 for a setting, which is logged as a warning.
+		 * 				 -3: not connected to database.
+		 */
+		int applyOptions(const OpenOptions& options);
+
+		/**
+		 * @return the tuning settings in effect, read back from sqlite.
+		 * 				 defaults if not connected.
+		 */
+		OpenSettings getSettings();
+
+		/**
+		 * change how this connection waits for a locked database
+		 */
+		void setBusyPolicy(const BusyPolicy& busyPolicy);
+
+		/**
+		 * @return how this connection waits for a locked database
+		 */
+		const BusyPolicy& getBusyPolicy() const;
+
+		/**
+		 * @return lock contention counters of this connection. only read
+		 * 				 them from the thread which uses the connection.
+		 */
+		const BusyStats& getBusyStats() const;
+
+		/**
+		 * set the lock contention counters to 0
+		 */
+		void resetBusyStats();
+
+		/**
+		 * switch the collection of statement metrics on or off. off by default.
+		 * switching it off drops the metrics collected so far.
+		 * @see Instrumentation
+		 */
+		void setInstrumentation(bool enabled);
+
+		/**
+		 * @return true: statement metrics are collected
+		 */
+		bool isInstrumented() const;
+
+		/**
+		 * @return snapshot of the statement metrics and page cache counters.
+		 * 				 empty if instrumentation is off. may be called from another
+		 * 				 thread, unless the connection was opened with SQLITE_OPEN_NOMUTEX.
+		 */
+		ConnectionMetrics getMetrics() const;
+
+		/**
+		 * forget the statement metrics collected so far
+		 */
+		void resetMetrics();
+
+		/**
+		 * @return statement cache of this connection. used to read hit
+		 * 				 and miss counters and to change its capacity.
+		 */
+		StatementCache& getStatementCache();
+
+		/**
+		 * make function callable from sql as name. the number and types of the
+		 * sql arguments are taken from the signature of function, see
+		 * FunctionAdapter for the supported types. a function with the same
+		 * name and number of arguments is replaced.
+		 *
+		 * usage:
+		 *   db.registerFunction("distance", [](double x, double y) { return std::sqrt(x * x + y * y); });
+		 *   db.select("select name from point where distance(x, y) < 1");
+		 * @param function function pointer, lambda or functor. copied.
+		 * @return sql error code. 0 is ok. -2: name is NULL. -3: not connected to database.
+		 */
+		template<typename F>
+		int registerFunction(const char* name, F function, const FunctionOptions& options = FunctionOptions());
+
+		/**
+		 * make an aggregate callable from sql as name. Aggregate is a class with
+		 * 	void step(Args...) called for each row of a group,
+		 * 	R finalize() returning the result of the group.
+		 * each group works on its own copy of prototype. if Aggregate also has
+		 * 	void inverse(Args...) removing a row added by step(),
+		 * 	R value() returning the current result without ending the group,
+		 * it is registered as a window function and can be used with OVER.
+		 * @return sql error code. 0 is ok. -2: name is NULL. -3: not connected to database.
+		 */
+		template<typename Aggregate>
+		int registerAggregate(const char* name, const Aggregate& prototype = Aggregate(),
+		                      const FunctionOptions& options = FunctionOptions());
+
+		/**
+		 * make container readable from sql as table name in the temp schema,
+		 * without copying its elements, see ContainerTable. a table with the
+		 * same name in the temp schema is replaced.
+		 *
+		 * usage:
+		 *   std::vector<Point> points = ...;
+		 *   gre90r::TableColumns<Point> columns;
+		 *   columns.add("x", &Point::x).add("y", &Point::y);
+		 *   db.registerTable("points", points, columns);
+		 *   db.select("select p.rowid, c.name from points p join city c on c.x = p.x");
+		 * @param container a sequence or map. has to outlive the table or the
+		 * 				connection, and must not be changed while a statement reads it.
+		 * @param columns the columns of the elements. copied.
+		 * @param options writable
+		 * @return sql error code. 0 is ok. -2: name is NULL. -3: not connected to database.
+		 */
+		template<typename Container>
+		int registerTable(const char* name, Container& container,
+		                  const TableColumns<typename ContainerTable<Container>::Row>& columns,
+		                  const VirtualTableOptions& options = VirtualTableOptions());
+
+		/**
+		 * drop a table made by registerTable(). the container is not touched.
+		 * @return sql error code. 0 is ok. -2: name is NULL. -3: not connected to database.
+		 */
+		int dropTable(const char* name);
+
+		/**
+		 * switch the cache of select() results on or off. off by default.
+		 * switching it off or changing options drops the cached results.
+		 * the cache takes over the authorizer, update hook and rollback
+		 * hook of the connection, shared with the change capture.
+		 * @see ResultCache
+		 */
+		void setResultCache(bool enabled, const ResultCacheOptions& options = ResultCacheOptions());
+
+		/**
+		 * @return true: select() results are cached
+		 */
+		bool hasResultCache() const;
+
+		/**
+		 * @return counters of the result cache. empty if it is off.
+		 */
+		ResultCacheStats getResultCacheStats() const;
+
+		/**
+		 * drop all cached select() results, e.g. after the database was
+		 * changed in a way the cache can not see
+		 */
+		void clearResultCache();
+
+		/**
+		 * publish the rows changed by each commit through this connection to
+		 * stream. NULL switches it off, which drops the events of the open
+		 * transaction. the capture takes over the authorizer, update, commit,
+		 * rollback and preupdate hook of the connection, shared with the
+		 * result cache.
+		 *
+		 * usage:
+		 *   std::shared_ptr<gre90r::ChangeStream> stream = std::make_shared<gre90r::ChangeStream>(4096);
+		 *   db.setChangeCapture(stream);
+		 *   db.execute("update account set balance = 0 where id = ?", 7);
+		 *   std::vector<gre90r::ChangeEvent> batch;
+		 *   stream->poll(batch); // table account, ChangeOperation::Update, rowid 7
+		 * @see ChangeCapture
+		 */
+		void setChangeCapture(const std::shared_ptr<ChangeStream>& stream,
+		                      const ChangeCaptureOptions& options = ChangeCaptureOptions());
+
+		/**
+		 * @return true: committed changes are published to a ChangeStream
+		 */
+		bool hasChangeCapture() const;
+
 	private:
 		/**************/
 		/* Attributes */
 		/**************/
 		sqlite3* m_db; // the database
 		bool m_connected; // status if this application is currently connected to a database 
-		SqlResult m_resultSet; // saves the last query result
 		const char* m_name;
+		StatementCache m_statementCache; // compiled statements by sql text
+		unsigned int m_savepointDepth; // number of open Savepoint objects
+		BusyPolicy m_busyPolicy;
+		BusyStats m_busyStats;
+		std::chrono::steady_clock::time_point m_busySince; // start of the current busy event
+		std::minstd_rand m_busyRandom; // jitter of the busy backoff
+		std::unique_ptr<Instrumentation> m_instrumentation; // NULL if off
+		std::unique_ptr<ResultCache> m_resultCache; // NULL if off
+		std::unique_ptr<ChangeCapture> m_changeCapture; // NULL if off
+		std::vector<std::string> m_volatileFunctions; // registered without FunctionOptions::deterministic
+		std::unique_ptr<MappedFile> m_snapshot; // mapping of a snapshot loaded with SnapshotOptions::mapped
 
 		/*******************/
 		/* private Methods */
 		/*******************/
 		/**
-		 * used as callback for sqlite query executions.
-		 * prints each row returned by the query.
+		 * runs every statement of query using the statement cache. replacement
+		 * for sqlite3_exec() which compiles the sql on every call.
+		 * @param query one or more sql statements
+		 * @param callback called once for each row, same as for sqlite3_exec().
+		 * 				may be NULL.
+		 * @param data passed to the callback as first argument
+		 * @return sql error code. 0 is ok. SQLITE_ABORT if the callback
+		 * 				 returned != 0.
+		 */
+		int exec(const char* query, int (*callback)(void*, int, char**, char**), void* data);
+
+		/**
+		 * used as callback for exec().
+		 * logs each row returned by the query with LogLevel::Trace.
 		 * runs once for each line returned.
-		 * @param data Data provided in the 4th argument of sqlite3_exec().
+		 * @param data Data provided in the 3rd argument of exec().
 		 * 				this is not used.
 		 * @param argc the number of columns in row
 		 * @param argv value of column
@@ -116,10 +551,10 @@ namespace gre90r {
 		static int callbackPrintQueryResults(void* data, int argc, char** argv, char** colNames);
 
 		/**
-		 * saves each row from the query result in the class attribute 'm_resultSet', one
-		 * element the 'm_resultSet' array represents one row.
+		 * appends each row from the query result to an SqlResult. the column
+		 * names are taken from the first row.
 		 * @param resultsetBuffer the result set of the query will be written in here.
-		 * 				this parameter equals the data provided in the 4th argument of sqlite3_exec().
+		 * 				this parameter equals the data provided in the 3rd argument of exec().
 		 * @param argc the number of columns in row
 		 * @param argv values of columns. argv[i] is the value of one column
 		 * @param colNames an array of strings representing column names
@@ -128,10 +563,267 @@ namespace gre90r {
 		 * 				 RC 2: no rows to process
 		 * 				 RC 3: column names missing
 		 *				 RC 4: no resultset buffer
+		 *				 RC 5: number of columns differs from previous rows
 		 */
 		static int callbackSaveQueryResults(void* resultsetBuffer, int argc, char** argv, char** colNames);
+
+		/**
+		 * sqlite3_busy_handler() callback. sleeps with exponential backoff
+		 * and jitter until m_busyPolicy.maxWait has passed.
+		 * @param connection the Sqlite object
+		 * @param count number of times the handler has been called for this lock
+		 * @return 1: retry. 0: give up, the statement fails with SQLITE_BUSY.
+		 */
+		static int busyHandler(void* connection, int count);
+
+		/**
+		 * install the hooks of the result cache and the change capture.
+		 * sqlite keeps one hook of each kind, so if both are on the update
+		 * and rollback hook go to updateHook() and rollbackHook(), which call
+		 * both. the authorizer is then only the one of the cache, the capture
+		 * needs nothing from its own but the TruncateGuard both have. the
+		 * commit and preupdate hook are only used by the capture. called
+		 * after one of them was created or removed.
+		 */
+		void installHooks();
+
+		/**
+		 * publish the events of the change capture whose commit has finished.
+		 * called after each statement and before compiling the next one.
+		 */
+		void publishChanges();
+
+		/**
+		 * sqlite3_update_hook() callback calling the ones of the result cache
+		 * and the change capture
+		 * @param connection the Sqlite object
+		 */
+		static void updateHook(void* connection, int operation, const char* database, const char* table,
+		                       sqlite3_int64 rowid);
+
+		/**
+		 * sqlite3_rollback_hook() callback calling the ones of the result
+		 * cache and the change capture
+		 * @param connection the Sqlite object
+		 */
+		static void rollbackHook(void* connection);
+
+		/**
+		 * @param pragma a PRAGMA statement which returns one value
+		 * @return the value as text. empty if the PRAGMA failed.
+		 */
+		std::string pragmaValue(const char* pragma);
+
+		/**
+		 * step statement to the end, appending its rows to result. the column
+		 * names are taken from the first row. the statement is reset afterwards.
+		 * @return sql error code. 0 is ok. SQLITE_ABORT if the number of columns
+		 * 				 differs from the rows already in result.
+		 */
+		int readRows(Statement& statement, SqlResult& result);
+
+		/**
+		 * @param size receives the size of the main database in bytes
+		 * @param copied receives true if the buffer has to be freed with sqlite3_free()
+		 * @return the main database in the file format. NULL if it is empty or
+		 * 				 out of memory.
+		 */
+		unsigned char* serializeMain(sqlite3_int64& size, bool& copied);
+
+		/**
+		 * replace the main database by data with sqlite3_deserialize()
+		 * @param flags SQLITE_DESERIALIZE_* flags
+		 * @return sql error code. 0 is ok.
+		 */
+		int loadMain(unsigned char* data, std::size_t size, unsigned int flags);
+
+		/**
+		 * log the result of registering a function and tell the result cache
+		 * about functions which are not deterministic
+		 */
+		void functionRegistered(const char* name, const FunctionOptions& options, int rc);
+
+		/**
+		 * replace table name in the temp schema by a virtual table of module
+		 * @param data client data of the module. destroyed with destroy, also on failure.
+		 * @return sql error code. 0 is ok.
+		 */
+		int createTable(const char* name, const sqlite3_module* module, void* data, void (*destroy)(void*));
 	};
 
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename... Args>
+	int Sqlite::execute(const char* query, const Args&... args) {
+		if (query == NULL) {
+			return -2;
+		}
+		if (!this->isConnected()) {
+			GRE90R_LOG(LogLevel::Error, "cannot execute query. not connected to DB.");
+			return -3;
+		}
+
+		std::shared_ptr<Statement> statement = this->prepare(query);
+		if (!statement->isValid()) {
+			return statement->getErrorCode() != SQLITE_OK ? statement->getErrorCode() : -1;
+		}
+
+		int rc = statement->bindAll(args...);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		while ((rc = statement->step()) == SQLITE_ROW) {
+			// rows are not needed
+		}
+		statement->reset();
+		this->publishChanges();
+		return rc == SQLITE_DONE ? SQLITE_OK : rc;
+	}
+
+
+	template<typename... Args>
+	int Sqlite::select(const char* query, SqlResult& result, const Args&... args) {
+		if (query == NULL) {
+			return -2;
+		}
+		if (!this->isConnected()) {
+			GRE90R_LOG(LogLevel::Error, "cannot execute query. not connected to DB.");
+			return -3;
+		}
+
+		std::string key;
+		bool cached = this->m_resultCache && result.getColumnCount() == 0 && result.empty();
+		if (cached) {
+			key = ResultCache::makeKey(query, args...);
+			if (this->m_resultCache->lookup(key, result)) {
+				return SQLITE_OK;
+			}
+		}
+
+		std::shared_ptr<Statement> statement = this->prepare(query);
+		if (!statement->isValid()) {
+			return statement->getErrorCode() != SQLITE_OK ? statement->getErrorCode() : -1;
+		}
+		int rc = statement->bindAll(args...);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		rc = this->readRows(*statement, result);
+		if (cached && rc == SQLITE_OK) {
+			this->m_resultCache->store(key, query, result);
+		}
+		return rc;
+	}
+
+
+	template<typename... Args>
+	int Sqlite::selectColumnar(const char* query, ColumnarResult& result, const Args&... args) {
+		result.clear();
+		if (query == NULL) {
+			return -2;
+		}
+		if (!this->isConnected()) {
+			GRE90R_LOG(LogLevel::Error, "cannot execute query. not connected to DB.");
+			return -3;
+		}
+
+		std::shared_ptr<Statement> statement = this->prepare(query);
+		if (!statement->isValid()) {
+			return statement->getErrorCode() != SQLITE_OK ? statement->getErrorCode() : -1;
+		}
+		int rc = statement->bindAll(args...);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		return result.load(*statement);
+	}
+
+
+	template<typename F>
+	int Sqlite::registerFunction(const char* name, F function, const FunctionOptions& options) {
+		if (name == NULL) {
+			return -2;
+		}
+		if (!this->isConnected()) {
+			GRE90R_LOG(LogLevel::Error, "cannot register function " << name << ". not connected to DB.");
+			return -3;
+		}
+
+		// sqlite owns the copy and deletes it with FunctionAdapter::destroy, also if registering fails
+		int rc = sqlite3_create_function_v2(this->m_db, name, static_cast<int>(FunctionTraits<F>::arity),
+		                                    FunctionAdapter::getFlags(options), new F(std::move(function)),
+		                                    FunctionAdapter::call<F>, NULL, NULL, FunctionAdapter::destroy<F>);
+		this->functionRegistered(name, options, rc);
+		return rc;
+	}
+
+
+	template<typename Aggregate>
+	int Sqlite::registerAggregate(const char* name, const Aggregate& prototype, const FunctionOptions& options) {
+		if (name == NULL) {
+			return -2;
+		}
+		if (!this->isConnected()) {
+			GRE90R_LOG(LogLevel::Error, "cannot register aggregate " << name << ". not connected to DB.");
+			return -3;
+		}
+
+		int arity = static_cast<int>(FunctionTraits<decltype(&Aggregate::step)>::arity);
+		int rc;
+		if constexpr (IsWindowFunction<Aggregate>::value) {
+			rc = sqlite3_create_window_function(this->m_db, name, arity, FunctionAdapter::getFlags(options),
+			                                    new Aggregate(prototype),
+			                                    FunctionAdapter::step<Aggregate>,
+			                                    FunctionAdapter::finalize<Aggregate>,
+			                                    FunctionAdapter::value<Aggregate>,
+			                                    FunctionAdapter::inverse<Aggregate>,
+			                                    FunctionAdapter::destroy<Aggregate>);
+		}
+		else {
+			rc = sqlite3_create_function_v2(this->m_db, name, arity, FunctionAdapter::getFlags(options),
+			                                new Aggregate(prototype), NULL,
+			                                FunctionAdapter::step<Aggregate>,
+			                                FunctionAdapter::finalize<Aggregate>,
+			                                FunctionAdapter::destroy<Aggregate>);
+		}
+		this->functionRegistered(name, options, rc);
+		return rc;
+	}
+
+
+	template<typename Container>
+	int Sqlite::registerTable(const char* name, Container& container,
+	                          const TableColumns<typename ContainerTable<Container>::Row>& columns,
+	                          const VirtualTableOptions& options)
+	{
+		if (name == NULL) {
+			return -2;
+		}
+		if (!this->isConnected()) {
+			GRE90R_LOG(LogLevel::Error, "cannot register table " << name << ". not connected to DB.");
+			return -3;
+		}
+		return this->createTable(name, ContainerTable<Container>::getModule(options.writable),
+		                         new ContainerTable<Container>(container, columns, options),
+		                         ContainerTable<Container>::destroy);
+	}
+
+
+	template<typename... Args>
+	Cursor Sqlite::query(const char* query, const Args&... args) {
+		std::shared_ptr<Statement> statement = this->prepare(query);
+		if (statement->isValid()) {
+			int rc = statement->bindAll(args...);
+			if (rc != SQLITE_OK) {
+				return Cursor(statement, rc);
+			}
+		}
+		return Cursor(statement);
+	}
+
 }
 
 #endif
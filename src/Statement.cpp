@@ -0,0 +1,287 @@
+#include "Statement.h"
+#include <cctype>
+#include <cstring>
+
+
+std::string gre90r::quoteIdentifier(const std::string& name) {
+	std::string quoted = "\"";
+	for (char c : name) {
+		if (c == '"') {
+			quoted += '"';
+		}
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+
+/*************/
+/* Statement */
+/*************/
+gre90r::Statement::Statement(sqlite3* db, const char* query, unsigned int prepareFlags)
+: m_stmt(NULL), m_errorCode(SQLITE_MISUSE), m_sqlLength(0)
+{
+	if (db == NULL || query == NULL) {
+		return;
+	}
+
+	const char* tail = NULL;
+	// -1: read query up to the terminating NUL
+	this->m_errorCode = sqlite3_prepare_v3(db, query, -1, prepareFlags, &this->m_stmt, &tail);
+	if (tail != NULL) {
+		this->m_sqlLength = static_cast<std::size_t>(tail - query);
+	}
+}
+
+
+gre90r::Statement::~Statement() {
+	// finalizing NULL is a harmless no-op
+	sqlite3_finalize(this->m_stmt);
+}
+
+
+bool gre90r::Statement::isValid() const {
+	return this->m_errorCode == SQLITE_OK && this->m_stmt != NULL;
+}
+
+
+int gre90r::Statement::getErrorCode() const {
+	return this->m_errorCode;
+}
+
+
+std::size_t gre90r::Statement::getSqlLength() const {
+	return this->m_sqlLength;
+}
+
+
+const char* gre90r::Statement::getSql() const {
+	return sqlite3_sql(this->m_stmt);
+}
+
+
+sqlite3_stmt* gre90r::Statement::getHandle() const {
+	return this->m_stmt;
+}
+
+
+int gre90r::Statement::bindInt(int index, int value) {
+	return sqlite3_bind_int(this->m_stmt, index, value);
+}
+
+
+int gre90r::Statement::bindInt64(int index, sqlite3_int64 value) {
+	return sqlite3_bind_int64(this->m_stmt, index, value);
+}
+
+
+int gre90r::Statement::bindDouble(int index, double value) {
+	return sqlite3_bind_double(this->m_stmt, index, value);
+}
+
+
+int gre90r::Statement::bindText(int index, std::string_view value) {
+	return sqlite3_bind_text64(this->m_stmt, index, value.data(), value.size(),
+	                           SQLITE_TRANSIENT, SQLITE_UTF8);
+}
+
+
+int gre90r::Statement::bindStaticText(int index, std::string_view value) {
+	return sqlite3_bind_text64(this->m_stmt, index, value.data(), value.size(),
+	                           SQLITE_STATIC, SQLITE_UTF8);
+}
+
+
+int gre90r::Statement::bindBlob(int index, const BlobView& value) {
+	if (value.data == NULL) {
+		// sqlite would bind NULL for a NULL pointer. keep it an empty blob.
+		return sqlite3_bind_zeroblob64(this->m_stmt, index, 0);
+	}
+	return sqlite3_bind_blob64(this->m_stmt, index, value.data, value.size, SQLITE_TRANSIENT);
+}
+
+
+int gre90r::Statement::bindZeroBlob(int index, const ZeroBlob& value) {
+	return sqlite3_bind_zeroblob64(this->m_stmt, index, value.size);
+}
+
+
+int gre90r::Statement::bindNull(int index) {
+	return sqlite3_bind_null(this->m_stmt, index);
+}
+
+
+int gre90r::Statement::getParameterCount() const {
+	return sqlite3_bind_parameter_count(this->m_stmt);
+}
+
+
+int gre90r::Statement::getParameterIndex(const char* name) const {
+	return sqlite3_bind_parameter_index(this->m_stmt, name);
+}
+
+
+int gre90r::Statement::step() {
+	if (this->m_stmt == NULL) {
+		return SQLITE_MISUSE;
+	}
+	return sqlite3_step(this->m_stmt);
+}
+
+
+int gre90r::Statement::reset() {
+	return sqlite3_reset(this->m_stmt);
+}
+
+
+int gre90r::Statement::clearBindings() {
+	if (this->m_stmt == NULL) {
+		return SQLITE_OK;
+	}
+	return sqlite3_clear_bindings(this->m_stmt);
+}
+
+
+int gre90r::Statement::getColumnCount() const {
+	return sqlite3_column_count(this->m_stmt);
+}
+
+
+const char* gre90r::Statement::getColumnName(int column) const {
+	return sqlite3_column_name(this->m_stmt, column);
+}
+
+
+const char* gre90r::Statement::getColumnText(int column) const {
+	return reinterpret_cast<const char*>(sqlite3_column_text(this->m_stmt, column));
+}
+
+
+/******************/
+/* StatementCache */
+/******************/
+const std::size_t gre90r::StatementCache::DEFAULT_CAPACITY;
+
+
+bool gre90r::StatementCache::SqlKey::operator==(const SqlKey& other) const {
+	return this->length == other.length
+	    && std::memcmp(this->text, other.text, this->length) == 0;
+}
+
+
+std::size_t gre90r::StatementCache::SqlKeyHash::operator()(const SqlKey& key) const {
+	// FNV-1a
+	std::size_t hash = 14695981039346656037ULL;
+	for (std::size_t i = 0; i < key.length; i++) {
+		hash ^= static_cast<unsigned char>(key.text[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+gre90r::StatementCache::StatementCache(std::size_t capacity)
+: m_capacity(capacity), m_hits(0), m_misses(0)
+{
+}
+
+
+std::shared_ptr<gre90r::Statement> gre90r::StatementCache::acquire(sqlite3* db, const char* query) {
+	if (query == NULL) {
+		return std::make_shared<Statement>(db, query);
+	}
+
+	SqlKey key = { query, std::strlen(query) };
+	std::unordered_map<SqlKey, LruList::iterator, SqlKeyHash>::iterator found = this->m_index.find(key);
+	if (found != this->m_index.end()) {
+		std::shared_ptr<Statement> statement = found->second->second;
+		// only hand out statements which are not in use right now.
+		// use_count: one owner is the cache, one is the local copy.
+		if (statement.use_count() <= 2) {
+			this->m_hits++;
+			this->m_lru.splice(this->m_lru.begin(), this->m_lru, found->second);
+			statement->reset();
+			statement->clearBindings();
+			return statement;
+		}
+		// statement is busy, e.g. a nested query with the same sql.
+		// compile a private copy which is not cached.
+		this->m_misses++;
+		return std::make_shared<Statement>(db, query);
+	}
+
+	this->m_misses++;
+	if (this->m_capacity == 0) {
+		return std::make_shared<Statement>(db, query);
+	}
+
+	// SQLITE_PREPARE_PERSISTENT: statement is going to be reused many times
+	std::shared_ptr<Statement> statement =
+		std::make_shared<Statement>(db, query, SQLITE_PREPARE_PERSISTENT);
+
+	// only cache statements which compiled and which are the whole query.
+	// multi-statement queries would fill the cache with each tail.
+	if (!statement->isValid()) {
+		return statement;
+	}
+	for (const char* c = query + statement->getSqlLength(); *c != '\0'; c++) {
+		if (!std::isspace(static_cast<unsigned char>(*c))) {
+			return statement;
+		}
+	}
+
+	this->m_lru.push_front(Entry(std::string(query, key.length), statement));
+	SqlKey storedKey = { this->m_lru.front().first.data(), key.length };
+	this->m_index[storedKey] = this->m_lru.begin();
+	this->evict();
+
+	return statement;
+}
+
+
+void gre90r::StatementCache::clear() {
+	this->m_index.clear();
+	this->m_lru.clear();
+}
+
+
+void gre90r::StatementCache::setCapacity(std::size_t capacity) {
+	this->m_capacity = capacity;
+	this->evict();
+}
+
+
+std::size_t gre90r::StatementCache::getCapacity() const {
+	return this->m_capacity;
+}
+
+
+std::size_t gre90r::StatementCache::size() const {
+	return this->m_index.size();
+}
+
+
+unsigned long long gre90r::StatementCache::getHits() const {
+	return this->m_hits;
+}
+
+
+unsigned long long gre90r::StatementCache::getMisses() const {
+	return this->m_misses;
+}
+
+
+void gre90r::StatementCache::resetCounters() {
+	this->m_hits = 0;
+	this->m_misses = 0;
+}
+
+
+void gre90r::StatementCache::evict() {
+	while (this->m_lru.size() > this->m_capacity) {
+		const Entry& oldest = this->m_lru.back();
+		SqlKey key = { oldest.first.data(), oldest.first.size() };
+		this->m_index.erase(key);
+		this->m_lru.pop_back();
+	}
+}
@@ -0,0 +1,456 @@
+#ifndef SQLITESTATEMENT_H
+#define SQLITESTATEMENT_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+
+namespace gre90r {
+
+	/**
+	 * binary value which is not owned. used to bind and read blobs.
+	 */
+	struct BlobView {
+		const void* data;
+		std::size_t size;
+	};
+
+	/**
+	 * blob of size zero bytes, bound without allocating it. reserves the
+	 * space which BlobStream then writes in chunks.
+	 */
+	struct ZeroBlob {
+		sqlite3_uint64 size;
+	};
+
+	/**
+	 * text which is bound without copying it. the characters have to stay
+	 * valid until the statement has been stepped and reset, e.g. fields
+	 * pointing into a memory mapped file.
+	 */
+	struct StaticText {
+		std::string_view text;
+	};
+
+	/**
+	 * used in static_assert to reject unsupported types at compile time
+	 */
+	template<typename T>
+	struct UnsupportedType : std::false_type {};
+
+	/**
+	 * true for std::optional<T>
+	 */
+	template<typename T>
+	struct IsOptional : std::false_type {};
+	template<typename T>
+	struct IsOptional<std::optional<T> > : std::true_type {};
+
+	/**
+	 * how a C++ type is passed to and from sqlite. Statement::bind(),
+	 * Row::get() and FunctionAdapter dispatch on it, so they agree on
+	 * every type.
+	 */
+	enum class ValueKind {
+		Unsupported,
+		Null, // std::nullptr_t, std::nullopt_t
+		Bool, // 0 or 1
+		Int, // integers whose values all fit into an int
+		Int64, // the other integers, e.g. unsigned int. unsigned values above INT64_MAX wrap.
+		Real, // floating point
+		CString, // const char*, char*. NULL is sql NULL.
+		Text, // convertible to std::string_view
+		StaticText,
+		Blob, // BlobView
+		ZeroBlob,
+		Optional // std::optional, empty is sql NULL
+	};
+
+	/**
+	 * @return kind of T
+	 */
+	template<typename T>
+	constexpr ValueKind getValueKind() {
+		if constexpr (std::is_same<T, std::nullptr_t>::value || std::is_same<T, std::nullopt_t>::value) {
+			return ValueKind::Null;
+		}
+		else if constexpr (std::is_same<T, bool>::value) {
+			return ValueKind::Bool;
+		}
+		else if constexpr (std::is_integral<T>::value
+		                   && (sizeof(T) < sizeof(int) || (std::is_signed<T>::value && sizeof(T) == sizeof(int)))) {
+			return ValueKind::Int;
+		}
+		else if constexpr (std::is_integral<T>::value) {
+			return ValueKind::Int64;
+		}
+		else if constexpr (std::is_floating_point<T>::value) {
+			return ValueKind::Real;
+		}
+		else if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+			return ValueKind::CString;
+		}
+		else if constexpr (std::is_convertible<const T&, std::string_view>::value) {
+			return ValueKind::Text;
+		}
+		else if constexpr (std::is_same<T, StaticText>::value) {
+			return ValueKind::StaticText;
+		}
+		else if constexpr (std::is_same<T, BlobView>::value) {
+			return ValueKind::Blob;
+		}
+		else if constexpr (std::is_same<T, ZeroBlob>::value) {
+			return ValueKind::ZeroBlob;
+		}
+		else if constexpr (IsOptional<T>::value) {
+			return ValueKind::Optional;
+		}
+		else {
+			return ValueKind::Unsupported;
+		}
+	}
+
+	/**
+	 * quote an identifier for sql: "name", with embedded quotes doubled.
+	 * for table and column names which cannot be bound as parameters.
+	 */
+	std::string quoteIdentifier(const std::string& name);
+
+	/**
+	 * a compiled sql statement. wraps sqlite3_stmt.
+	 *
+	 * parameters are set with bind(), the statement is run with step()
+	 * and reset() makes it ready for the next run without compiling
+	 * the sql text again.
+	 */
+	class Statement {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		Statement() = delete;
+
+		/**
+		 * compile the first sql statement of query.
+		 * @param db the database connection the statement belongs to
+		 * @param query sql text. only the first statement is compiled. the number
+		 * 				of characters compiled can be read with getSqlLength().
+		 * @param prepareFlags SQLITE_PREPARE_* flags for sqlite3_prepare_v3()
+		 */
+		Statement(sqlite3* db, const char* query, unsigned int prepareFlags = 0);
+
+		/**
+		 * forbid copy constructor
+		 */
+		Statement(const Statement&) = delete;
+
+		/**
+		 * finalize the statement
+		 */
+		virtual ~Statement();
+
+		/**
+		 * forbid assignment operator
+		 */
+		Statement& operator=(const Statement&) = delete;
+
+		/**
+		 * @return true: statement compiled and can be run.
+		 * 				 false: compiling failed or the query contained no statement
+		 * 				 (only whitespace or comments). check getErrorCode().
+		 */
+		bool isValid() const;
+
+		/**
+		 * @return sql error code of sqlite3_prepare_v3(). 0 is ok.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * @return number of characters of the query which have been compiled.
+		 * 				 the next statement of a multi-statement query starts there.
+		 */
+		std::size_t getSqlLength() const;
+
+		/**
+		 * @return sql text of the compiled statement. NULL if not valid.
+		 */
+		const char* getSql() const;
+
+		/**
+		 * @return the underlying sqlite statement handle. NULL if not valid.
+		 */
+		sqlite3_stmt* getHandle() const;
+
+		/**
+		 * bind a value to a parameter. parameter indices start at 1.
+		 * the sqlite3_bind_* function is picked at compile time from the type:
+		 * 	integers and bool -> int / int64, floating point -> double,
+		 * 	anything convertible to std::string_view -> text, BlobView -> blob,
+		 * 	ZeroBlob -> blob of zeros, nullptr and empty std::optional -> NULL. a NULL const char* binds NULL.
+		 * text and blobs are copied by sqlite, so they do not have to outlive the call.
+		 * @return sql error code. 0 is ok.
+		 */
+		template<typename T>
+		int bind(int index, const T& value);
+
+		/**
+		 * bind all values in order, starting at parameter 1.
+		 * e.g. bindAll(1, "John Paul") for "insert into employee values (?, ?)"
+		 * @return sql error code of the first failing bind. 0 is ok.
+		 */
+		template<typename... Args>
+		int bindAll(const Args&... args);
+
+		int bindNull(int index);
+
+		/**
+		 * @return number of parameters of the statement
+		 */
+		int getParameterCount() const;
+
+		/**
+		 * @param name parameter name including its prefix, e.g. ":id"
+		 * @return parameter index. 0 if there is no such parameter.
+		 */
+		int getParameterIndex(const char* name) const;
+
+		/**
+		 * run the statement until the next row is available.
+		 * @return SQLITE_ROW: a row is ready to be read.
+		 * 				 SQLITE_DONE: statement has finished.
+		 * 				 anything else is an sql error code.
+		 */
+		int step();
+
+		/**
+		 * make the statement ready to run again. bound values are kept.
+		 * @return sql error code of the last step(). 0 is ok.
+		 */
+		int reset();
+
+		/**
+		 * set all parameters back to NULL
+		 * @return sql error code. 0 is ok.
+		 */
+		int clearBindings();
+
+		/**
+		 * @return number of columns a row of this statement has
+		 */
+		int getColumnCount() const;
+
+		/**
+		 * @return name of column. NULL if column is out of range.
+		 */
+		const char* getColumnName(int column) const;
+
+		/**
+		 * read a column of the current row as text.
+		 * the text is valid until the next step(), reset() or destruction.
+		 * @return text of column. NULL if the value is sql NULL.
+		 */
+		const char* getColumnText(int column) const;
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		sqlite3_stmt* m_stmt; // the compiled statement
+		int m_errorCode; // result of sqlite3_prepare_v3
+		std::size_t m_sqlLength; // number of characters compiled
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		int bindInt(int index, int value);
+		int bindInt64(int index, sqlite3_int64 value);
+		int bindDouble(int index, double value);
+		int bindText(int index, std::string_view value);
+		int bindStaticText(int index, std::string_view value);
+		int bindBlob(int index, const BlobView& value);
+		int bindZeroBlob(int index, const ZeroBlob& value);
+	};
+
+
+	/**
+	 * per-connection LRU cache of compiled statements keyed by sql text.
+	 *
+	 * a statement handed out by acquire() stays valid as long as the caller
+	 * holds it, even if it is evicted from the cache meanwhile. a cached
+	 * statement which is still held by someone else is not handed out twice,
+	 * a new one is compiled instead.
+	 */
+	class StatementCache {
+	public:
+		/**
+		 * number of statements kept by default
+		 */
+		static const std::size_t DEFAULT_CAPACITY = 32;
+
+		/**
+		 * @param capacity max number of cached statements. 0 disables caching.
+		 */
+		explicit StatementCache(std::size_t capacity = DEFAULT_CAPACITY);
+
+		/**
+		 * forbid copy constructor
+		 */
+		StatementCache(const StatementCache&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		StatementCache& operator=(const StatementCache&) = delete;
+
+		/**
+		 * get a compiled statement for the first sql statement of query.
+		 * only single-statement queries are cached. the returned statement
+		 * has been reset and has no bound values.
+		 * @param db the database connection to compile on
+		 * @param query sql text
+		 * @return the statement. check isValid() before using it.
+		 */
+		std::shared_ptr<Statement> acquire(sqlite3* db, const char* query);
+
+		/**
+		 * drop all cached statements. needs to be called before closing
+		 * the database connection.
+		 */
+		void clear();
+
+		/**
+		 * change the max number of cached statements. least recently used
+		 * statements are dropped if there are too many.
+		 */
+		void setCapacity(std::size_t capacity);
+		std::size_t getCapacity() const;
+
+		/**
+		 * @return number of statements currently cached
+		 */
+		std::size_t size() const;
+
+		/**
+		 * @return number of acquire() calls served from the cache
+		 */
+		unsigned long long getHits() const;
+
+		/**
+		 * @return number of acquire() calls which had to compile the sql
+		 */
+		unsigned long long getMisses() const;
+
+		/**
+		 * set hits and misses back to 0
+		 */
+		void resetCounters();
+
+	private:
+		/**
+		 * sql text which is not owned. points into the key
+		 * stored in m_lru, so lookups do not need to copy the query.
+		 */
+		struct SqlKey {
+			const char* text;
+			std::size_t length;
+			bool operator==(const SqlKey& other) const;
+		};
+		struct SqlKeyHash {
+			std::size_t operator()(const SqlKey& key) const;
+		};
+
+		typedef std::pair<std::string, std::shared_ptr<Statement> > Entry;
+		typedef std::list<Entry> LruList;
+
+		/**************/
+		/* Attributes */
+		/**************/
+		std::size_t m_capacity;
+		LruList m_lru; // most recently used statement first
+		std::unordered_map<SqlKey, LruList::iterator, SqlKeyHash> m_index;
+		unsigned long long m_hits;
+		unsigned long long m_misses;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * drop least recently used statements until capacity is met
+		 */
+		void evict();
+	};
+
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename T>
+	int Statement::bind(int index, const T& value) {
+		constexpr ValueKind kind = getValueKind<T>();
+		if constexpr (kind == ValueKind::Null) {
+			return this->bindNull(index);
+		}
+		else if constexpr (kind == ValueKind::Bool) {
+			return this->bindInt(index, value ? 1 : 0);
+		}
+		else if constexpr (kind == ValueKind::Int) {
+			return this->bindInt(index, static_cast<int>(value));
+		}
+		else if constexpr (kind == ValueKind::Int64) {
+			return this->bindInt64(index, static_cast<sqlite3_int64>(value));
+		}
+		else if constexpr (kind == ValueKind::Real) {
+			return this->bindDouble(index, static_cast<double>(value));
+		}
+		else if constexpr (kind == ValueKind::CString) {
+			if (value == NULL) {
+				return this->bindNull(index);
+			}
+			return this->bindText(index, std::string_view(value));
+		}
+		else if constexpr (kind == ValueKind::Text) {
+			return this->bindText(index, std::string_view(value));
+		}
+		else if constexpr (kind == ValueKind::Blob) {
+			return this->bindBlob(index, value);
+		}
+		else if constexpr (kind == ValueKind::ZeroBlob) {
+			return this->bindZeroBlob(index, value);
+		}
+		else if constexpr (kind == ValueKind::StaticText) {
+			return this->bindStaticText(index, value.text);
+		}
+		else if constexpr (kind == ValueKind::Optional) {
+			if (!value) {
+				return this->bindNull(index);
+			}
+			return this->bind(index, *value);
+		}
+		else {
+			static_assert(UnsupportedType<T>::value, "type cannot be bound to an sql parameter");
+			return SQLITE_MISUSE;
+		}
+	}
+
+
+	template<typename... Args>
+	int Statement::bindAll(const Args&... args) {
+		int rc = SQLITE_OK;
+		int index = 0;
+		// binds in order and stops at the first error
+		((rc = (rc == SQLITE_OK ? this->bind(++index, args) : rc)), ...);
+		return rc;
+	}
+
+}
+
+#endif
@@ -0,0 +1,35 @@
+#include "StatementRegistry.h"
+#include "Log.h"
+#include "Sqlite.h"
+
+#define logError(s) GRE90R_LOG(gre90r::LogLevel::Error, s)
+
+
+std::shared_ptr<gre90r::Statement> gre90r::StatementRegistryBase::compile(Sqlite& db, const char* sql,
+                                                                         int parameters, int columns,
+                                                                         int& errorCode)
+{
+	if (!db.isConnected()) {
+		logError("cannot compile statement. not connected to DB.");
+		errorCode = SQLITE_MISUSE;
+		return NULL;
+	}
+
+	// kept for the lifetime of the connection
+	std::shared_ptr<Statement> statement = std::make_shared<Statement>(db.getHandle(), sql,
+	                                                                   SQLITE_PREPARE_PERSISTENT);
+	if (!statement->isValid()) {
+		errorCode = statement->getErrorCode() != SQLITE_OK ? statement->getErrorCode() : SQLITE_MISUSE;
+		return NULL;
+	}
+	if (statement->getParameterCount() != parameters || statement->getColumnCount() != columns) {
+		logError("statement does not match its declaration: " << sql << ". "
+		         << "declared parameters: " << parameters << ", columns: " << columns << ". "
+		         << "compiled parameters: " << statement->getParameterCount()
+		         << ", columns: " << statement->getColumnCount() << ".");
+		errorCode = SQLITE_MISMATCH;
+		return NULL;
+	}
+	errorCode = SQLITE_OK;
+	return statement;
+}
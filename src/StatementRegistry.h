@@ -0,0 +1,702 @@
+#ifndef SQLITESTATEMENTREGISTRY_H
+#define SQLITESTATEMENTREGISTRY_H
+
+#include <sqlite3.h>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Cursor.h"
+#include "Statement.h"
+
+
+namespace gre90r {
+
+	class Sqlite;
+
+	/**
+	 * parameter types of a statement declared with SqlStatement
+	 */
+	template<typename... T>
+	struct Params {};
+
+	/**
+	 * result column types of a statement declared with SqlStatement
+	 */
+	template<typename... T>
+	struct Columns {};
+
+	/**
+	 * base of a statement declared at compile time, with the types of its
+	 * parameters and result columns. the derived type holds the sql text:
+	 *
+	 *   struct SelectEmployeeName : gre90r::SqlStatement<gre90r::Params<int>, gre90r::Columns<std::string> > {
+	 *     static constexpr const char* sql = "select name from employee where id = ?";
+	 *   };
+	 *
+	 * the types are the ones Statement::bind() and Row::get() accept.
+	 * @see StatementRegistry
+	 */
+	template<typename P, typename C = Columns<> >
+	struct SqlStatement {
+		typedef P Parameters;
+		typedef C Results;
+	};
+
+	/**
+	 * true if an argument of type A may be passed for a declared parameter
+	 * of type P: the same type, or text for a std::string or
+	 * std::string_view parameter. conversions which change the value, e.g.
+	 * double to int or long long to int, are not allowed.
+	 */
+	template<typename A, typename P>
+	struct IsParameterArgument
+	: std::integral_constant<bool, std::is_same<typename std::decay<A>::type, P>::value
+	                               || ((std::is_same<P, std::string>::value || std::is_same<P, std::string_view>::value)
+	                                   && (std::is_same<typename std::decay<A>::type, const char*>::value
+	                                       || std::is_same<typename std::decay<A>::type, char*>::value
+	                                       || std::is_same<typename std::decay<A>::type, std::string>::value
+	                                       || std::is_same<typename std::decay<A>::type, std::string_view>::value))> {};
+	/**
+	 * an optional parameter also takes std::nullopt and the arguments of its value type
+	 */
+	template<typename A, typename T>
+	struct IsParameterArgument<A, std::optional<T> >
+	: std::integral_constant<bool, std::is_same<typename std::decay<A>::type, std::optional<T> >::value
+	                               || std::is_same<typename std::decay<A>::type, std::nullopt_t>::value
+	                               || IsParameterArgument<A, T>::value> {};
+
+	/**
+	 * number of declared parameters and columns of a statement
+	 */
+	template<typename P, typename C>
+	struct StatementShape;
+	template<typename... P, typename... C>
+	struct StatementShape<Params<P...>, Columns<C...> > {
+		static const int parameters = static_cast<int>(sizeof...(P));
+		static const int columns = static_cast<int>(sizeof...(C));
+	};
+
+	/**
+	 * @return number of parameters of sql as sqlite counts them: ? takes the
+	 * 				 next number, ?NNN the number NNN. :name, @name and $name count
+	 * 				 once per occurrence, so each name should be used only once.
+	 * 				 quoted text and comments are skipped.
+	 */
+	constexpr int countParameters(const char* sql) {
+		int count = 0;
+		char quote = '\0';
+		for (std::size_t i = 0; sql[i] != '\0'; ++i) {
+			char c = sql[i];
+			if (quote != '\0') {
+				// a doubled quote leaves and enters the quoted text again
+				if (c == quote) {
+					quote = '\0';
+				}
+			}
+			else if (c == '\'' || c == '"' || c == '`') {
+				quote = c;
+			}
+			else if (c == '[') {
+				quote = ']';
+			}
+			else if (c == '-' && sql[i + 1] == '-') {
+				while (sql[i + 1] != '\0' && sql[i + 1] != '\n') {
+					++i;
+				}
+			}
+			else if (c == '/' && sql[i + 1] == '*') {
+				for (i += 2; sql[i] != '\0' && !(sql[i] == '*' && sql[i + 1] == '/'); ++i) {
+				}
+				if (sql[i] == '\0') {
+					break;
+				}
+				++i;
+			}
+			else if (c == '?') {
+				int number = 0;
+				while (sql[i + 1] >= '0' && sql[i + 1] <= '9') {
+					number = number * 10 + (sql[++i] - '0');
+				}
+				count = number == 0 ? count + 1 : (number > count ? number : count);
+			}
+			else if ((c == ':' || c == '@' || c == '$')
+			         && ((sql[i + 1] >= 'a' && sql[i + 1] <= 'z') || (sql[i + 1] >= 'A' && sql[i + 1] <= 'Z')
+			             || sql[i + 1] == '_')) {
+				++count;
+				while ((sql[i + 1] >= 'a' && sql[i + 1] <= 'z') || (sql[i + 1] >= 'A' && sql[i + 1] <= 'Z')
+				       || (sql[i + 1] >= '0' && sql[i + 1] <= '9') || sql[i + 1] == '_') {
+					++i;
+				}
+			}
+		}
+		return count;
+	}
+
+	/**
+	 * the statements an application runs, declared at compile time. each
+	 * statement has a fixed slot, its position in the list, so a connection
+	 * keeps them in a flat array and finds them without hashing the sql.
+	 * the number of parameters in the sql text is checked at compile time.
+	 *
+	 *   typedef gre90r::StatementRegistry<InsertEmployee, SelectEmployeeName> Queries;
+	 *   gre90r::PreparedStatements<Queries> statements(db);
+	 *   statements.execute<InsertEmployee>(1, "John Paul");
+	 */
+	template<typename... Statements>
+	struct StatementRegistry {
+		static const std::size_t size = sizeof...(Statements);
+
+		/**
+		 * @return slot of statement S. a statement which is not registered
+		 * 				 does not compile.
+		 */
+		template<typename S>
+		static constexpr std::size_t indexOf() {
+			constexpr bool found[] = { std::is_same<S, Statements>::value..., false };
+			std::size_t index = 0;
+			while (index < size && !found[index]) {
+				++index;
+			}
+			return index;
+		}
+
+		/**
+		 * @return sql text of each slot
+		 */
+		static std::array<const char*, sizeof...(Statements)> getSql() {
+			return { { Statements::sql... } };
+		}
+
+		/**
+		 * @return declared number of parameters of each slot
+		 */
+		static std::array<int, sizeof...(Statements)> getParameterCounts() {
+			return { { StatementShape<typename Statements::Parameters, typename Statements::Results>::parameters... } };
+		}
+
+		/**
+		 * @return declared number of result columns of each slot
+		 */
+		static std::array<int, sizeof...(Statements)> getColumnCounts() {
+			return { { StatementShape<typename Statements::Parameters, typename Statements::Results>::columns... } };
+		}
+
+		static_assert(((countParameters(Statements::sql)
+		                == StatementShape<typename Statements::Parameters, typename Statements::Results>::parameters)
+		               && ...),
+		              "number of parameters in the sql text differs from the declared Params");
+	};
+
+	/**
+	 * the current row of a TypedCursor. the column types are the declared
+	 * ones, so reading a column as another type does not compile.
+	 * views are valid until the statement steps to the next row.
+	 */
+	template<typename... C>
+	class TypedRow : public Row {
+	public:
+		typedef std::tuple<C...> Tuple;
+
+		explicit TypedRow(sqlite3_stmt* stmt);
+
+		/**
+		 * @return column I as its declared type
+		 */
+		template<std::size_t I>
+		typename std::tuple_element<I, Tuple>::type get() const;
+
+		/**
+		 * @return all columns
+		 */
+		Tuple toTuple() const;
+
+	private:
+		template<std::size_t... I>
+		Tuple toTuple(std::index_sequence<I...>) const;
+	};
+
+	/**
+	 * streams the rows of a declared statement as TypedRow
+	 *
+	 *   for (const auto& row : statements.query<SelectEmployeeName>(1)) {
+	 *     std::string name = row.get<0>();
+	 *   }
+	 */
+	template<typename... C>
+	class TypedCursor {
+	public:
+		/**
+		 * input iterator over the rows. advancing it steps the statement.
+		 */
+		class Iterator {
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef const TypedRow<C...> value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const TypedRow<C...>* pointer;
+			typedef const TypedRow<C...>& reference;
+
+			explicit Iterator(TypedCursor* cursor);
+			const TypedRow<C...>& operator*() const;
+			const TypedRow<C...>* operator->() const;
+			Iterator& operator++();
+			bool operator==(const Iterator& other) const;
+			bool operator!=(const Iterator& other) const;
+
+		private:
+			TypedCursor* m_cursor; // NULL for the end iterator
+		};
+
+		/**
+		 * @param statement compiled statement with its parameters already bound.
+		 * 				NULL: the cursor is empty.
+		 */
+		explicit TypedCursor(std::shared_ptr<Statement> statement);
+
+		/**
+		 * cursor which failed before its first step, see Cursor
+		 */
+		TypedCursor(std::shared_ptr<Statement> statement, int errorCode);
+
+		/**
+		 * @return true: statement is valid and can be stepped
+		 */
+		bool isValid() const;
+
+		/**
+		 * step to the next row
+		 * @return true: a row is available with getRow().
+		 * 				 false: no more rows or an error. check getErrorCode().
+		 */
+		bool next();
+
+		/**
+		 * @return the current row. only valid after next() returned true.
+		 */
+		const TypedRow<C...>& getRow() const;
+
+		/**
+		 * @return same as Cursor::getErrorCode()
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * steps to the first row
+		 */
+		Iterator begin();
+		Iterator end();
+
+	private:
+		Cursor m_cursor;
+		TypedRow<C...> m_row;
+	};
+
+	/**
+	 * a declared statement compiled for one connection. its functions take
+	 * the declared parameter types, so an argument of another type does
+	 * not compile. cheap to copy, it points into PreparedStatements.
+	 */
+	template<typename S, typename P = typename S::Parameters, typename C = typename S::Results>
+	class TypedStatement;
+
+	template<typename S, typename... P, typename... C>
+	class TypedStatement<S, Params<P...>, Columns<C...> > {
+	public:
+		typedef std::tuple<C...> Tuple;
+
+		/**
+		 * @param statement NULL if compiling failed
+		 * @param errorCode why compiling failed
+		 */
+		TypedStatement(const std::shared_ptr<Statement>& statement, int errorCode);
+
+		/**
+		 * @return true: compiled and matching the declared types
+		 */
+		bool isValid() const;
+
+		/**
+		 * @return sql error code of compiling. SQLITE_MISMATCH if the number of
+		 * 				 parameters or columns differs from the declaration.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * run the statement, rows are dropped. the arguments must have the
+		 * declared types, see IsParameterArgument.
+		 * @return sql error code. 0 is ok. -1: not compiled.
+		 */
+		template<typename... Args>
+		int execute(const Args&... params);
+
+		/**
+		 * run the statement and stream its rows
+		 * @return cursor over the rows. empty if not compiled, without rows
+		 * 				 and with the error code if binding failed.
+		 */
+		template<typename... Args>
+		TypedCursor<C...> query(const Args&... params);
+
+		/**
+		 * run the statement and copy its rows
+		 * @param rows receives the rows. rows are appended.
+		 * @return sql error code. 0 is ok. -1: not compiled.
+		 */
+		template<typename... Args>
+		int select(std::vector<Tuple>& rows, const Args&... params);
+
+	private:
+		/**
+		 * fails to compile if Args are not the declared parameter types
+		 */
+		template<typename... Args>
+		static constexpr void checkArguments();
+
+		const std::shared_ptr<Statement>* m_statement;
+		int m_errorCode;
+	};
+
+	/**
+	 * the statements of Registry compiled once for a connection, in a flat
+	 * array indexed by slot. compiled with SQLITE_PREPARE_PERSISTENT, the
+	 * statement cache of the connection is not used.
+	 *
+	 * has to be destroyed before the connection is closed with
+	 * Sqlite::close(). not thread-safe, used by the thread which uses the
+	 * connection.
+	 */
+	template<typename Registry>
+	class PreparedStatements {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		PreparedStatements() = delete;
+
+		/**
+		 * compile all statements of Registry. failures are logged.
+		 */
+		explicit PreparedStatements(Sqlite& db);
+
+		/**
+		 * forbid copy constructor
+		 */
+		PreparedStatements(const PreparedStatements&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		PreparedStatements& operator=(const PreparedStatements&) = delete;
+
+		/**
+		 * @return true: all statements compiled and match their declaration
+		 */
+		bool isValid() const;
+
+		/**
+		 * @return the compiled statement S
+		 */
+		template<typename S>
+		TypedStatement<S> get() const;
+
+		/**
+		 * same as get<S>().execute(params...)
+		 */
+		template<typename S, typename... Args>
+		int execute(const Args&... params);
+
+		/**
+		 * same as get<S>().query(params...)
+		 */
+		template<typename S, typename... Args>
+		auto query(const Args&... params);
+
+	private:
+		std::array<std::shared_ptr<Statement>, Registry::size> m_statements; // NULL if compiling failed
+		std::array<int, Registry::size> m_errorCodes;
+	};
+
+	/**
+	 * the parts of PreparedStatements which do not depend on the registry
+	 */
+	class StatementRegistryBase {
+	public:
+		/**
+		 * compile sql and check its number of parameters and columns
+		 * @param errorCode receives the sql error code. SQLITE_MISMATCH if the
+		 * 				numbers differ from the declaration.
+		 * @return the statement. NULL if it failed, which is logged.
+		 */
+		static std::shared_ptr<Statement> compile(Sqlite& db, const char* sql, int parameters,
+		                                          int columns, int& errorCode);
+	};
+
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename... C>
+	TypedRow<C...>::TypedRow(sqlite3_stmt* stmt)
+	: Row(stmt)
+	{
+	}
+
+
+	template<typename... C>
+	template<std::size_t I>
+	typename std::tuple_element<I, typename TypedRow<C...>::Tuple>::type TypedRow<C...>::get() const {
+		return Row::get<typename std::tuple_element<I, Tuple>::type>(static_cast<int>(I));
+	}
+
+
+	template<typename... C>
+	typename TypedRow<C...>::Tuple TypedRow<C...>::toTuple() const {
+		return this->toTuple(std::index_sequence_for<C...>());
+	}
+
+
+	template<typename... C>
+	template<std::size_t... I>
+	typename TypedRow<C...>::Tuple TypedRow<C...>::toTuple(std::index_sequence<I...>) const {
+		return Tuple(this->get<I>()...);
+	}
+
+
+	template<typename... C>
+	TypedCursor<C...>::Iterator::Iterator(TypedCursor* cursor)
+	: m_cursor(cursor)
+	{
+	}
+
+
+	template<typename... C>
+	const TypedRow<C...>& TypedCursor<C...>::Iterator::operator*() const {
+		return this->m_cursor->getRow();
+	}
+
+
+	template<typename... C>
+	const TypedRow<C...>* TypedCursor<C...>::Iterator::operator->() const {
+		return &this->m_cursor->getRow();
+	}
+
+
+	template<typename... C>
+	typename TypedCursor<C...>::Iterator& TypedCursor<C...>::Iterator::operator++() {
+		if (!this->m_cursor->next()) {
+			this->m_cursor = NULL;
+		}
+		return *this;
+	}
+
+
+	template<typename... C>
+	bool TypedCursor<C...>::Iterator::operator==(const Iterator& other) const {
+		return this->m_cursor == other.m_cursor;
+	}
+
+
+	template<typename... C>
+	bool TypedCursor<C...>::Iterator::operator!=(const Iterator& other) const {
+		return this->m_cursor != other.m_cursor;
+	}
+
+
+	template<typename... C>
+	TypedCursor<C...>::TypedCursor(std::shared_ptr<Statement> statement)
+	: m_cursor(statement), m_row(statement ? statement->getHandle() : NULL)
+	{
+	}
+
+
+	template<typename... C>
+	TypedCursor<C...>::TypedCursor(std::shared_ptr<Statement> statement, int errorCode)
+	: m_cursor(statement, errorCode), m_row(statement ? statement->getHandle() : NULL)
+	{
+	}
+
+
+	template<typename... C>
+	bool TypedCursor<C...>::isValid() const {
+		return this->m_cursor.isValid();
+	}
+
+
+	template<typename... C>
+	bool TypedCursor<C...>::next() {
+		return this->m_cursor.next();
+	}
+
+
+	template<typename... C>
+	const TypedRow<C...>& TypedCursor<C...>::getRow() const {
+		return this->m_row;
+	}
+
+
+	template<typename... C>
+	int TypedCursor<C...>::getErrorCode() const {
+		return this->m_cursor.getErrorCode();
+	}
+
+
+	template<typename... C>
+	typename TypedCursor<C...>::Iterator TypedCursor<C...>::begin() {
+		return Iterator(this->next() ? this : NULL);
+	}
+
+
+	template<typename... C>
+	typename TypedCursor<C...>::Iterator TypedCursor<C...>::end() {
+		return Iterator(NULL);
+	}
+
+
+	template<typename S, typename... P, typename... C>
+	TypedStatement<S, Params<P...>, Columns<C...> >::TypedStatement(const std::shared_ptr<Statement>& statement,
+	                                                                  int errorCode)
+	: m_statement(&statement), m_errorCode(errorCode)
+	{
+	}
+
+
+	template<typename S, typename... P, typename... C>
+	bool TypedStatement<S, Params<P...>, Columns<C...> >::isValid() const {
+		return *this->m_statement != NULL;
+	}
+
+
+	template<typename S, typename... P, typename... C>
+	int TypedStatement<S, Params<P...>, Columns<C...> >::getErrorCode() const {
+		return this->m_errorCode;
+	}
+
+
+	template<typename S, typename... P, typename... C>
+	template<typename... Args>
+	constexpr void TypedStatement<S, Params<P...>, Columns<C...> >::checkArguments() {
+		static_assert(sizeof...(Args) == sizeof...(P), "number of arguments differs from the declared Params");
+		if constexpr (sizeof...(Args) == sizeof...(P)) {
+			static_assert((IsParameterArgument<Args, P>::value && ...),
+			              "argument type differs from the declared parameter type, convert it explicitly");
+		}
+	}
+
+
+	template<typename S, typename... P, typename... C>
+	template<typename... Args>
+	int TypedStatement<S, Params<P...>, Columns<C...> >::execute(const Args&... params) {
+		checkArguments<Args...>();
+		Statement* statement = this->m_statement->get();
+		if (statement == NULL) {
+			return -1;
+		}
+		int rc = statement->bindAll(static_cast<const P&>(params)...);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		while ((rc = statement->step()) == SQLITE_ROW) {
+			// rows are not needed
+		}
+		statement->reset();
+		return rc == SQLITE_DONE ? SQLITE_OK : rc;
+	}
+
+
+	template<typename S, typename... P, typename... C>
+	template<typename... Args>
+	TypedCursor<C...> TypedStatement<S, Params<P...>, Columns<C...> >::query(const Args&... params) {
+		checkArguments<Args...>();
+		const std::shared_ptr<Statement>& statement = *this->m_statement;
+		if (statement == NULL) {
+			return TypedCursor<C...>(NULL);
+		}
+		int rc = statement->bindAll(static_cast<const P&>(params)...);
+		if (rc != SQLITE_OK) {
+			return TypedCursor<C...>(statement, rc);
+		}
+		return TypedCursor<C...>(statement);
+	}
+
+
+	template<typename S, typename... P, typename... C>
+	template<typename... Args>
+	int TypedStatement<S, Params<P...>, Columns<C...> >::select(std::vector<Tuple>& rows, const Args&... params) {
+		checkArguments<Args...>();
+		static_assert(((!std::is_same<C, std::string_view>::value && !std::is_same<C, const char*>::value
+		                && !std::is_same<C, BlobView>::value) && ...),
+		              "views are only valid for the current row, use query() or std::string");
+		Statement* statement = this->m_statement->get();
+		if (statement == NULL) {
+			return -1;
+		}
+		int rc = statement->bindAll(static_cast<const P&>(params)...);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		TypedRow<C...> row(statement->getHandle());
+		while ((rc = statement->step()) == SQLITE_ROW) {
+			rows.push_back(row.toTuple());
+		}
+		statement->reset();
+		return rc == SQLITE_DONE ? SQLITE_OK : rc;
+	}
+
+
+	template<typename Registry>
+	PreparedStatements<Registry>::PreparedStatements(Sqlite& db) {
+		std::array<const char*, Registry::size> sql = Registry::getSql();
+		std::array<int, Registry::size> parameters = Registry::getParameterCounts();
+		std::array<int, Registry::size> columns = Registry::getColumnCounts();
+		for (std::size_t i = 0; i < Registry::size; ++i) {
+			this->m_statements[i] = StatementRegistryBase::compile(db, sql[i], parameters[i], columns[i],
+			                                                       this->m_errorCodes[i]);
+		}
+	}
+
+
+	template<typename Registry>
+	bool PreparedStatements<Registry>::isValid() const {
+		for (const std::shared_ptr<Statement>& statement : this->m_statements) {
+			if (statement == NULL) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+
+	template<typename Registry>
+	template<typename S>
+	TypedStatement<S> PreparedStatements<Registry>::get() const {
+		constexpr std::size_t index = Registry::template indexOf<S>();
+		static_assert(index < Registry::size, "statement is not in the registry");
+		return TypedStatement<S>(this->m_statements[index], this->m_errorCodes[index]);
+	}
+
+
+	template<typename Registry>
+	template<typename S, typename... Args>
+	int PreparedStatements<Registry>::execute(const Args&... params) {
+		return this->get<S>().execute(params...);
+	}
+
+
+	template<typename Registry>
+	template<typename S, typename... Args>
+	auto PreparedStatements<Registry>::query(const Args&... params) {
+		return this->get<S>().query(params...);
+	}
+
+}
+
+#endif
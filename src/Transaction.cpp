@@ -0,0 +1,145 @@
+#include "Transaction.h"
+#include "Log.h"
+#include "Sqlite.h"
+
+
+namespace {
+
+	const char* beginQuery(gre90r::TransactionMode mode) {
+		switch (mode) {
+			case gre90r::TransactionMode::Immediate: return "BEGIN IMMEDIATE TRANSACTION;";
+			case gre90r::TransactionMode::Exclusive: return "BEGIN EXCLUSIVE TRANSACTION;";
+			case gre90r::TransactionMode::Deferred: break;
+		}
+		return "BEGIN DEFERRED TRANSACTION;";
+	}
+
+}
+
+
+/***************/
+/* Transaction */
+/***************/
+gre90r::Transaction::Transaction(Sqlite& db, TransactionMode mode)
+: m_db(db), m_active(false), m_errorCode(SQLITE_OK)
+{
+	this->m_errorCode = this->m_db.execute(beginQuery(mode));
+	this->m_active = this->m_errorCode == SQLITE_OK;
+}
+
+
+gre90r::Transaction::~Transaction() {
+	if (this->m_active) {
+		GRE90R_LOG(LogLevel::Debug, "transaction left scope without commit. rolling back.");
+		this->rollback();
+	}
+}
+
+
+bool gre90r::Transaction::isActive() const {
+	return this->m_active;
+}
+
+
+int gre90r::Transaction::getErrorCode() const {
+	return this->m_errorCode;
+}
+
+
+int gre90r::Transaction::commit() {
+	if (!this->m_active) {
+		return SQLITE_MISUSE;
+	}
+	int rc = this->m_db.execute("COMMIT;");
+	if (rc == SQLITE_OK) {
+		this->m_active = false;
+	}
+	return rc;
+}
+
+
+int gre90r::Transaction::rollback() {
+	if (!this->m_active) {
+		return SQLITE_MISUSE;
+	}
+	int rc = this->m_db.execute("ROLLBACK;");
+	// on failure sqlite may have rolled back already (e.g. after SQLITE_FULL)
+	this->m_active = this->m_db.isInTransaction() && rc != SQLITE_OK;
+	return rc;
+}
+
+
+/*************/
+/* Savepoint */
+/*************/
+gre90r::Savepoint::Savepoint(Sqlite& db)
+: m_db(db), m_depth(0), m_active(false), m_errorCode(SQLITE_OK), m_changes(0)
+{
+	// savepoints are named by nesting depth. so there are only a few
+	// distinct statements, which stay in the statement cache.
+	if (!this->m_db.isInTransaction()) {
+		this->m_db.m_savepointDepth = 0;
+	}
+	this->m_depth = this->m_db.m_savepointDepth + 1;
+	this->m_name = "gre90r_savepoint_" + std::to_string(this->m_depth);
+
+	this->m_errorCode = this->m_db.execute(("SAVEPOINT " + this->m_name + ";").c_str());
+	this->m_active = this->m_errorCode == SQLITE_OK;
+	if (this->m_active) {
+		this->m_db.m_savepointDepth = this->m_depth;
+		this->m_changes = this->m_db.m_changeCapture ? this->m_db.m_changeCapture->getPending() : 0;
+	}
+}
+
+
+gre90r::Savepoint::~Savepoint() {
+	if (this->m_active) {
+		GRE90R_LOG(LogLevel::Debug, "savepoint " << this->m_name << " left scope without release. rolling back.");
+		this->rollback();
+	}
+}
+
+
+bool gre90r::Savepoint::isActive() const {
+	return this->m_active;
+}
+
+
+int gre90r::Savepoint::getErrorCode() const {
+	return this->m_errorCode;
+}
+
+
+const std::string& gre90r::Savepoint::getName() const {
+	return this->m_name;
+}
+
+
+int gre90r::Savepoint::release() {
+	if (!this->m_active) {
+		return SQLITE_MISUSE;
+	}
+	int rc = this->m_db.execute(("RELEASE SAVEPOINT " + this->m_name + ";").c_str());
+	if (rc == SQLITE_OK) {
+		this->m_active = false;
+		this->m_db.m_savepointDepth = this->m_depth - 1;
+	}
+	return rc;
+}
+
+
+int gre90r::Savepoint::rollback() {
+	if (!this->m_active) {
+		return SQLITE_MISUSE;
+	}
+	// ROLLBACK TO keeps the savepoint on the stack, RELEASE removes it
+	int rc = this->m_db.execute(("ROLLBACK TO SAVEPOINT " + this->m_name + ";").c_str());
+	if (rc == SQLITE_OK && this->m_db.m_changeCapture) {
+		// sqlite reports no hook for the rows undone
+		this->m_db.m_changeCapture->discardPending(this->m_changes);
+	}
+	int releaseRc = this->m_db.execute(("RELEASE SAVEPOINT " + this->m_name + ";").c_str());
+	this->m_active = false;
+	this->m_db.m_savepointDepth = this->m_depth - 1;
+	return rc != SQLITE_OK ? rc : releaseRc;
+}
@@ -0,0 +1,171 @@
+#ifndef SQLITETRANSACTION_H
+#define SQLITETRANSACTION_H
+
+#include <cstddef>
+#include <string>
+
+
+namespace gre90r {
+
+	class Sqlite;
+
+	/**
+	 * when a transaction takes its locks.
+	 * @see https://www.sqlite.org/lang_transaction.html
+	 */
+	enum class TransactionMode {
+		Deferred, // on first read or write
+		Immediate, // write lock right away
+		Exclusive // exclusive lock right away
+	};
+
+	/**
+	 * a transaction which is rolled back when it goes out of scope
+	 * unless it has been committed.
+	 *
+	 * usage:
+	 *   gre90r::Transaction transaction(sqlite, gre90r::TransactionMode::Immediate);
+	 *   sqlite.execute(...);
+	 *   transaction.commit();
+	 */
+	class Transaction {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		Transaction() = delete;
+
+		/**
+		 * begin a transaction. check isActive() whether it started.
+		 * @param db connected database without an open transaction
+		 * @param mode when to take the locks
+		 */
+		explicit Transaction(Sqlite& db, TransactionMode mode = TransactionMode::Deferred);
+
+		/**
+		 * forbid copy constructor
+		 */
+		Transaction(const Transaction&) = delete;
+
+		/**
+		 * rolls back if neither commit() nor rollback() has been called
+		 */
+		virtual ~Transaction();
+
+		/**
+		 * forbid assignment operator
+		 */
+		Transaction& operator=(const Transaction&) = delete;
+
+		/**
+		 * @return true: transaction has begun and is not finished yet
+		 */
+		bool isActive() const;
+
+		/**
+		 * @return sql error code of BEGIN. 0 is ok.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * commit the transaction. if it fails, e.g. with SQLITE_BUSY, the
+		 * transaction stays active and commit() can be retried.
+		 * @return sql error code. 0 is ok. SQLITE_MISUSE if not active.
+		 */
+		int commit();
+
+		/**
+		 * roll back the transaction
+		 * @return sql error code. 0 is ok. SQLITE_MISUSE if not active.
+		 */
+		int rollback();
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		Sqlite& m_db;
+		bool m_active;
+		int m_errorCode; // result of BEGIN
+	};
+
+
+	/**
+	 * a savepoint which can be nested inside transactions and other savepoints.
+	 * it is rolled back when it goes out of scope unless it has been released.
+	 * outside of a transaction it starts one, like BEGIN DEFERRED.
+	 */
+	class Savepoint {
+	public:
+		/**
+		 * forbid standard constructor
+		 */
+		Savepoint() = delete;
+
+		/**
+		 * create a savepoint. it is named after its nesting depth,
+		 * so savepoints have to be finished in reverse order of creation.
+		 * @param db connected database
+		 */
+		explicit Savepoint(Sqlite& db);
+
+		/**
+		 * forbid copy constructor
+		 */
+		Savepoint(const Savepoint&) = delete;
+
+		/**
+		 * rolls back to the savepoint if neither release() nor rollback()
+		 * has been called
+		 */
+		virtual ~Savepoint();
+
+		/**
+		 * forbid assignment operator
+		 */
+		Savepoint& operator=(const Savepoint&) = delete;
+
+		/**
+		 * @return true: savepoint has been created and is not finished yet
+		 */
+		bool isActive() const;
+
+		/**
+		 * @return sql error code of SAVEPOINT. 0 is ok.
+		 */
+		int getErrorCode() const;
+
+		/**
+		 * @return name of the savepoint
+		 */
+		const std::string& getName() const;
+
+		/**
+		 * keep the changes made since the savepoint. they are committed
+		 * with the enclosing transaction.
+		 * @return sql error code. 0 is ok. SQLITE_MISUSE if not active.
+		 */
+		int release();
+
+		/**
+		 * undo all changes made since the savepoint. the change capture
+		 * forgets them too.
+		 * @return sql error code. 0 is ok. SQLITE_MISUSE if not active.
+		 */
+		int rollback();
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		Sqlite& m_db;
+		unsigned int m_depth; // 1 for the outermost savepoint
+		std::string m_name;
+		bool m_active;
+		int m_errorCode; // result of SAVEPOINT
+		std::size_t m_changes; // captured changes of the transaction before the savepoint
+	};
+
+}
+
+#endif
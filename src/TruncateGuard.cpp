@@ -0,0 +1,26 @@
+#include "TruncateGuard.h"
+#include <sqlite3.h>
+
+
+int gre90r::TruncateGuard::authorize(int action, const char* table) {
+	switch (action) {
+	case SQLITE_DELETE:
+		// SQLITE_IGNORE turns off the truncate optimization, which would skip the update hook.
+		// a DROP asks for the schema table and the dropped table, it would be skipped.
+		if (table != NULL && sqlite3_strnicmp(table, "sqlite_", 7) != 0 && this->dropping != table) {
+			return SQLITE_IGNORE;
+		}
+		this->dropping.clear();
+		break;
+	case SQLITE_DROP_TABLE:
+	case SQLITE_DROP_TEMP_TABLE:
+	case SQLITE_DROP_VIEW:
+	case SQLITE_DROP_TEMP_VIEW:
+	case SQLITE_DROP_VTABLE:
+		this->dropping = table != NULL ? table : "";
+		break;
+	default:
+		break;
+	}
+	return SQLITE_OK;
+}
@@ -0,0 +1,28 @@
+#ifndef SQLITETRUNCATEGUARD_H
+#define SQLITETRUNCATEGUARD_H
+
+#include <string>
+
+
+namespace gre90r {
+
+	/**
+	 * turns off the truncate optimization of DELETE without WHERE, which
+	 * empties a table without calling the update hook for its rows. used
+	 * by the authorizers of ResultCache and ChangeCapture, which need to
+	 * see every deleted row.
+	 */
+	struct TruncateGuard {
+		std::string dropping; // table of the DROP being compiled, its rows must not be deleted one by one
+
+		/**
+		 * call from the authorizer for every action
+		 * @return SQLITE_IGNORE for a DELETE which must not be truncated,
+		 * 				 else SQLITE_OK
+		 */
+		int authorize(int action, const char* table);
+	};
+
+}
+
+#endif
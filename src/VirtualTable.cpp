@@ -0,0 +1,113 @@
+#include "VirtualTable.h"
+
+
+int gre90r::ContainerTableBase::planIndex(sqlite3_index_info* info, int keyColumn, bool ranges, bool textKey,
+                                          bool unique, double rows)
+{
+	int equal = -1;
+	int lower = -1;
+	int upper = -1;
+	for (int i = 0; i < info->nConstraint; ++i) {
+		const sqlite3_index_info::sqlite3_index_constraint& constraint = info->aConstraint[i];
+		if (!constraint.usable || constraint.iColumn != keyColumn) {
+			continue;
+		}
+		// the container compares text like the BINARY collation
+		if (textKey && sqlite3_stricmp(sqlite3_vtab_collation(info, i), "BINARY") != 0) {
+			continue;
+		}
+		switch (constraint.op) {
+			case SQLITE_INDEX_CONSTRAINT_EQ:
+				equal = i;
+				break;
+			case SQLITE_INDEX_CONSTRAINT_GT:
+			case SQLITE_INDEX_CONSTRAINT_GE:
+				lower = ranges ? i : lower;
+				break;
+			case SQLITE_INDEX_CONSTRAINT_LT:
+			case SQLITE_INDEX_CONSTRAINT_LE:
+				upper = ranges ? i : upper;
+				break;
+			default:
+				break;
+		}
+	}
+
+	// the arguments of xFilter are passed in the order of the Constraint flags
+	int idxNum = 0;
+	double cost = rows;
+	if (equal >= 0) {
+		idxNum = Equal;
+		info->aConstraintUsage[equal].argvIndex = 1;
+		info->estimatedRows = 1;
+		cost = 1.0;
+		if (unique) {
+			info->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+		}
+	}
+	else {
+		int argument = 0;
+		if (lower >= 0) {
+			idxNum |= info->aConstraint[lower].op == SQLITE_INDEX_CONSTRAINT_GT ? Greater : GreaterEqual;
+			info->aConstraintUsage[lower].argvIndex = ++argument;
+			cost /= 4.0;
+		}
+		if (upper >= 0) {
+			idxNum |= info->aConstraint[upper].op == SQLITE_INDEX_CONSTRAINT_LT ? Less : LessEqual;
+			info->aConstraintUsage[upper].argvIndex = ++argument;
+			cost /= 4.0;
+		}
+		info->estimatedRows = static_cast<sqlite3_int64>(cost) + 1;
+	}
+	info->idxNum = idxNum;
+	info->estimatedCost = cost + 1.0;
+
+	if (ranges && info->nOrderBy == 1 && info->aOrderBy[0].iColumn == keyColumn && !info->aOrderBy[0].desc) {
+		info->orderByConsumed = 1;
+	}
+	return SQLITE_OK;
+}
+
+
+std::string gre90r::ContainerTableBase::declaration(const char* keyName, const char* keyType,
+                                                    const std::vector<std::pair<std::string, const char*> >& columns)
+{
+	std::string sql = "CREATE TABLE x(";
+	if (keyType != NULL) {
+		sql += quoteIdentifier(keyName) + " " + keyType + " PRIMARY KEY";
+	}
+	for (std::size_t i = 0; i < columns.size(); ++i) {
+		if (i > 0 || keyType != NULL) {
+			sql += ", ";
+		}
+		sql += quoteIdentifier(columns[i].first) + " " + columns[i].second;
+	}
+	sql += ")";
+	if (keyType != NULL) {
+		sql += " WITHOUT ROWID";
+	}
+	return sql;
+}
+
+
+void gre90r::ContainerTableBase::setError(sqlite3_vtab* table, const std::string& message) {
+	sqlite3_free(table->zErrMsg);
+	table->zErrMsg = sqlite3_mprintf("%s", message.c_str());
+}
+
+
+int gre90r::ContainerTableBase::setError(sqlite3_vtab* table) {
+	try {
+		throw;
+	}
+	catch (const std::bad_alloc&) {
+		return SQLITE_NOMEM;
+	}
+	catch (const std::exception& e) {
+		setError(table, e.what());
+	}
+	catch (...) {
+		setError(table, "unknown exception in virtual table");
+	}
+	return SQLITE_ERROR;
+}
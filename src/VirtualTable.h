@@ -0,0 +1,926 @@
+#ifndef SQLITEVIRTUALTABLE_H
+#define SQLITEVIRTUALTABLE_H
+
+#include <sqlite3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Function.h"
+#include "Statement.h"
+
+
+namespace gre90r {
+
+	/**
+	 * how a container is exposed by Sqlite::registerTable()
+	 */
+	struct VirtualTableOptions {
+		/**
+		 * true: INSERT, UPDATE and DELETE change the container. ignored for
+		 * const containers. changes are made at once and are not undone by
+		 * a ROLLBACK.
+		 */
+		bool writable = false;
+	};
+
+	/**
+	 * the sql columns of a container element of type Row. each column reads
+	 * a data member or calls a getter, declared with its sql type, e.g.
+	 *
+	 *   gre90r::TableColumns<Point> columns;
+	 *   columns.add("x", &Point::x).add("y", &Point::y).add("label", &Point::getLabel);
+	 *
+	 * data members can be written through a writable table, getters are
+	 * read only. the types are the ones FunctionAdapter supports.
+	 */
+	template<typename Row>
+	class TableColumns {
+	public:
+		/**
+		 * one column
+		 */
+		struct Column {
+			std::string name;
+			const char* type; // declared sql type
+			std::function<void(sqlite3_context*, const Row&)> read;
+			std::function<void(Row&, sqlite3_value*)> write; // empty: read only
+			bool nullable; // std::optional member, sql NULL can be written
+		};
+
+		/**
+		 * @param keyName name of the key column of maps. not used for sequences,
+		 * 				whose elements are addressed by rowid, their position.
+		 */
+		explicit TableColumns(std::string keyName = "key");
+
+		/**
+		 * add a column
+		 * @param accessor pointer to a data member, pointer to a const member
+		 * 				function or a callable taking const Row&
+		 * @return this, to chain calls
+		 */
+		template<typename Accessor>
+		TableColumns& add(std::string name, Accessor accessor);
+
+		/**
+		 * @return the columns in the order they were added
+		 */
+		const std::vector<Column>& getColumns() const;
+
+		/**
+		 * @return name of the key column of maps
+		 */
+		const std::string& getKeyName() const;
+
+	private:
+		std::vector<Column> m_columns;
+		std::string m_keyName;
+	};
+
+	/**
+	 * true for maps, which have a key and a mapped type
+	 */
+	template<typename C, typename = void>
+	struct IsMapContainer : std::false_type {};
+	template<typename C>
+	struct IsMapContainer<C, std::void_t<typename C::key_type, typename C::mapped_type> > : std::true_type {};
+
+	/**
+	 * element type of a container, the mapped type for maps
+	 */
+	template<typename C, bool = IsMapContainer<C>::value>
+	struct ContainerRow {
+		typedef typename C::value_type Type;
+	};
+	template<typename C>
+	struct ContainerRow<C, true> {
+		typedef typename C::mapped_type Type;
+	};
+
+	/**
+	 * true for containers which can append elements
+	 */
+	template<typename C, typename = void>
+	struct HasPushBack : std::false_type {};
+	template<typename C>
+	struct HasPushBack<C, std::void_t<decltype(std::declval<C&>().push_back(std::declval<typename C::value_type>()))> >
+	: std::true_type {};
+
+	/**
+	 * the parts of ContainerTable which do not depend on the container
+	 */
+	class ContainerTableBase {
+	public:
+		/**
+		 * key constraints used by xFilter, set in idxNum
+		 */
+		enum Constraint {
+			Equal = 1,
+			Greater = 2,
+			GreaterEqual = 4,
+			Less = 8,
+			LessEqual = 16
+		};
+
+		/**
+		 * what a constraint value means for the scanned keys
+		 */
+		enum Bound {
+			Limited, // the key was read, the scan is limited by it
+			Unlimited, // the value does not limit the keys, sqlite filters the rows
+			Nothing // no key matches, e.g. a comparison with NULL
+		};
+
+		/**
+		 * xBestIndex. uses an equality constraint on the key column, else
+		 * a lower and an upper bound if ranges is set. the constraints are
+		 * checked by sqlite again, so a bound may be wider than the constraint.
+		 * @param keyColumn -1: the rowid. 0: the key column of a map.
+		 * @param ranges true: the keys are scanned in ascending order
+		 * @param textKey true: constraints with a collation other than BINARY are not used
+		 * @param unique true: a lookup of one key is reported as SQLITE_INDEX_SCAN_UNIQUE
+		 * @param rows number of elements in the container
+		 */
+		static int planIndex(sqlite3_index_info* info, int keyColumn, bool ranges, bool textKey,
+		                     bool unique, double rows);
+
+		/**
+		 * @return sql for sqlite3_declare_vtab(), e.g.
+		 * 				 CREATE TABLE x("key" INTEGER PRIMARY KEY, "a" TEXT) WITHOUT ROWID
+		 * @param keyType declared type of the key column. NULL: the table has no key column.
+		 */
+		static std::string declaration(const char* keyName, const char* keyType,
+		                               const std::vector<std::pair<std::string, const char*> >& columns);
+
+		/**
+		 * set the error message of table, replacing the previous one
+		 */
+		static void setError(sqlite3_vtab* table, const std::string& message);
+
+		/**
+		 * report the exception being handled as error of table.
+		 * has to be called in a catch block.
+		 * @return SQLITE_NOMEM or SQLITE_ERROR
+		 */
+		static int setError(sqlite3_vtab* table);
+
+		/**
+		 * @return declared sql type of a column of type T
+		 */
+		template<typename T>
+		static const char* getSqlType();
+
+		/**
+		 * read a key constraint value as K
+		 * @param op Constraint. a lower bound may be changed into GreaterEqual,
+		 * 				an upper bound into LessEqual, if the value is not a K.
+		 */
+		template<typename K>
+		static Bound readBound(sqlite3_value* value, int& op, K& key);
+
+		/**
+		 * @return declared sql type of a column of type T without std::optional
+		 */
+		template<typename T>
+		static const char* getValueType();
+	};
+
+	/**
+	 * exposes a container to sql as a virtual table in the temp schema,
+	 * without copying the elements. created by Sqlite::registerTable().
+	 *
+	 * sequences with random access iterators (std::vector, std::deque,
+	 * std::array) have the element position as rowid, constraints and
+	 * ORDER BY on the rowid are served by the index range. maps have a key
+	 * column as PRIMARY KEY, std::map serves equality, ranges and ORDER BY
+	 * of the key, std::unordered_map and maps with other comparators serve
+	 * equality. columns are read straight from the elements, text members
+	 * without copying them.
+	 *
+	 * writable tables append to sequences and change their elements, rows of
+	 * a sequence can not be deleted. maps also insert, delete and change keys.
+	 *
+	 * the container has to outlive the table and must not be changed while a
+	 * statement reads the table. not thread-safe, the container is only
+	 * accessed from the thread which uses the connection.
+	 */
+	template<typename Container>
+	class ContainerTable : public ContainerTableBase {
+	public:
+		typedef typename ContainerRow<typename std::remove_const<Container>::type>::Type Row;
+		static const bool isMap = IsMapContainer<typename std::remove_const<Container>::type>::value;
+
+		/**
+		 * forbid standard constructor
+		 */
+		ContainerTable() = delete;
+
+		ContainerTable(Container& container, const TableColumns<Row>& columns,
+		               const VirtualTableOptions& options);
+
+		/**
+		 * forbid copy constructor
+		 */
+		ContainerTable(const ContainerTable&) = delete;
+
+		/**
+		 * forbid assignment operator
+		 */
+		ContainerTable& operator=(const ContainerTable&) = delete;
+
+		/**
+		 * @return the module with the callbacks for sqlite3_create_module_v2().
+		 * 				 the client data is a ContainerTable.
+		 */
+		static const sqlite3_module* getModule(bool writable);
+
+		/**
+		 * xDestroy of the module. deletes the client data.
+		 */
+		static void destroy(void* data);
+
+	private:
+		typedef typename std::remove_const<Container>::type Mutable;
+		typedef decltype(std::declval<Container&>().begin()) Iterator;
+
+		/**
+		 * the key of maps. elements of sequences are addressed by position.
+		 */
+		template<typename C, bool = isMap>
+		struct KeyOf {
+			typedef sqlite3_int64 Type;
+		};
+		template<typename C>
+		struct KeyOf<C, true> {
+			typedef typename std::remove_const<typename C::key_type>::type Type;
+		};
+		typedef typename KeyOf<Mutable>::Type Key;
+
+		/**
+		 * true: iterating yields the keys in ascending sql order
+		 */
+		template<typename C, typename = void>
+		struct IsOrdered : std::integral_constant<bool, !isMap> {};
+		template<typename C>
+		struct IsOrdered<C, std::void_t<typename C::key_compare> >
+		: std::integral_constant<bool, std::is_same<typename C::key_compare, std::less<Key> >::value
+		                               || std::is_same<typename C::key_compare, std::less<> >::value> {};
+		static const bool isOrdered = IsOrdered<Mutable>::value;
+
+		static_assert(isMap || std::is_base_of<std::random_access_iterator_tag,
+		              typename std::iterator_traits<Iterator>::iterator_category>::value,
+		              "sequences need random access iterators");
+		static_assert(!isMap || std::is_arithmetic<Key>::value || std::is_same<Key, std::string>::value,
+		              "map keys have to be numbers or std::string");
+
+		struct Table {
+			sqlite3_vtab base; // first member, sqlite only knows this part
+			ContainerTable* owner;
+		};
+
+		struct Cursor {
+			sqlite3_vtab_cursor base; // first member, sqlite only knows this part
+			Iterator current;
+			Iterator last;
+		};
+
+		/**************/
+		/* Attributes */
+		/**************/
+		Container& m_container;
+		TableColumns<Row> m_columns;
+		VirtualTableOptions m_options;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * xCreate and xConnect, called by CREATE VIRTUAL TABLE and when the
+		 * schema is loaded
+		 */
+		static int create(sqlite3* db, void* data, int argc, const char* const* argv,
+		                  sqlite3_vtab** table, char** error);
+		static int connect(sqlite3* db, void* data, int argc, const char* const* argv,
+		                   sqlite3_vtab** table, char** error);
+		static int disconnect(sqlite3_vtab* table);
+		static int bestIndex(sqlite3_vtab* table, sqlite3_index_info* info);
+		static int open(sqlite3_vtab* table, sqlite3_vtab_cursor** cursor);
+		static int close(sqlite3_vtab_cursor* cursor);
+		static int filter(sqlite3_vtab_cursor* cursor, int idxNum, const char* idxStr,
+		                  int argc, sqlite3_value** argv);
+		static int next(sqlite3_vtab_cursor* cursor);
+		static int eof(sqlite3_vtab_cursor* cursor);
+		static int column(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int index);
+		static int rowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid);
+		static int update(sqlite3_vtab* table, int argc, sqlite3_value** argv, sqlite3_int64* rowid);
+
+		/**
+		 * limit the scan of cursor to the keys matching op and key
+		 */
+		void limit(Cursor& cursor, int op, const Key& key);
+
+		/**
+		 * set the columns of row to the values of an INSERT or UPDATE
+		 * @param values one value per column, without the key column
+		 * @return SQLITE_CONSTRAINT if NULL is written to a column which is
+		 * 				 not std::optional
+		 */
+		int assign(sqlite3_vtab* table, Row& row, sqlite3_value** values);
+
+		/**
+		 * xUpdate of maps and sequences
+		 */
+		int updateMap(sqlite3_vtab* table, int argc, sqlite3_value** argv);
+		int updateSequence(sqlite3_vtab* table, int argc, sqlite3_value** argv, sqlite3_int64* rowid);
+	};
+
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	template<typename Row>
+	TableColumns<Row>::TableColumns(std::string keyName)
+	: m_keyName(std::move(keyName))
+	{
+	}
+
+
+	template<typename Row>
+	template<typename Accessor>
+	TableColumns<Row>& TableColumns<Row>::add(std::string name, Accessor accessor) {
+		typedef decltype(std::invoke(accessor, std::declval<const Row&>())) Result;
+		typedef typename std::decay<Result>::type T;
+
+		Column column;
+		column.name = std::move(name);
+		column.type = ContainerTableBase::getSqlType<T>();
+		column.nullable = IsOptional<T>::value;
+		column.read = [accessor](sqlite3_context* context, const Row& row) {
+			const Result& value = std::invoke(accessor, row);
+			// text stored in the element is handed to sqlite without copying it
+			if constexpr (std::is_lvalue_reference<Result>::value && std::is_same<T, std::string>::value) {
+				FunctionAdapter::setResult(context, StaticText{ value });
+			}
+			else if constexpr (std::is_lvalue_reference<Result>::value
+			                   && std::is_same<T, std::optional<std::string> >::value) {
+				if (!value) {
+					sqlite3_result_null(context);
+				}
+				else {
+					FunctionAdapter::setResult(context, StaticText{ *value });
+				}
+			}
+			else {
+				FunctionAdapter::setResult(context, value);
+			}
+		};
+		if constexpr (std::is_member_object_pointer<Accessor>::value
+		              && !std::is_same<T, std::string_view>::value && !std::is_same<T, const char*>::value
+		              && !std::is_same<T, BlobView>::value) {
+			column.write = [accessor](Row& row, sqlite3_value* value) {
+				row.*accessor = FunctionAdapter::getValue<T>(value);
+			};
+		}
+		this->m_columns.push_back(std::move(column));
+		return *this;
+	}
+
+
+	template<typename Row>
+	const std::vector<typename TableColumns<Row>::Column>& TableColumns<Row>::getColumns() const {
+		return this->m_columns;
+	}
+
+
+	template<typename Row>
+	const std::string& TableColumns<Row>::getKeyName() const {
+		return this->m_keyName;
+	}
+
+
+	template<typename T>
+	const char* ContainerTableBase::getSqlType() {
+		if constexpr (IsOptional<T>::value) {
+			return getValueType<typename T::value_type>();
+		}
+		else {
+			return getValueType<T>();
+		}
+	}
+
+
+	template<typename T>
+	const char* ContainerTableBase::getValueType() {
+		if constexpr (std::is_integral<T>::value) {
+			return "INTEGER";
+		}
+		else if constexpr (std::is_floating_point<T>::value) {
+			return "REAL";
+		}
+		else if constexpr (std::is_same<T, BlobView>::value) {
+			return "BLOB";
+		}
+		else {
+			return "TEXT";
+		}
+	}
+
+
+	template<typename K>
+	ContainerTableBase::Bound ContainerTableBase::readBound(sqlite3_value* value, int& op, K& key) {
+		int type = sqlite3_value_type(value);
+		if (type == SQLITE_NULL) {
+			return Nothing;
+		}
+
+		if constexpr (std::is_same<K, std::string>::value) {
+			// numbers sort before all text, blobs after it
+			if (type != SQLITE_TEXT) {
+				return Unlimited;
+			}
+			key = FunctionAdapter::getValue<std::string>(value);
+			return Limited;
+		}
+		else if constexpr (std::is_floating_point<K>::value) {
+			type = sqlite3_value_numeric_type(value);
+			if (type != SQLITE_INTEGER && type != SQLITE_FLOAT) {
+				return Unlimited;
+			}
+			key = static_cast<K>(sqlite3_value_double(value));
+			return Limited;
+		}
+		else {
+			bool lower = (op & (Greater | GreaterEqual)) != 0;
+			bool upper = (op & (Less | LessEqual)) != 0;
+			type = sqlite3_value_numeric_type(value);
+			double number;
+			if (type == SQLITE_INTEGER) {
+				sqlite3_int64 integer = sqlite3_value_int64(value);
+				if constexpr (std::numeric_limits<K>::digits >= 63) {
+					if (std::is_unsigned<K>::value && integer < 0) {
+						return lower ? Unlimited : Nothing;
+					}
+					key = static_cast<K>(integer);
+					return Limited;
+				}
+				number = static_cast<double>(integer);
+			}
+			else if (type == SQLITE_FLOAT) {
+				number = sqlite3_value_double(value);
+				if (std::isnan(number)) {
+					return Unlimited;
+				}
+				// the next whole number inside the constraint, inclusive
+				if (lower) {
+					number = std::floor(number);
+					op = GreaterEqual;
+				}
+				else if (upper) {
+					number = std::ceil(number);
+					op = LessEqual;
+				}
+				else if (number != std::floor(number)) {
+					return Nothing;
+				}
+			}
+			else {
+				return Unlimited;
+			}
+
+			double limit = std::ldexp(1.0, std::numeric_limits<K>::digits);
+			double minimum = std::is_signed<K>::value ? -limit : 0.0;
+			if (number < minimum) {
+				return lower ? Unlimited : Nothing;
+			}
+			if (number >= limit) {
+				return upper ? Unlimited : Nothing;
+			}
+			key = static_cast<K>(number);
+			return Limited;
+		}
+	}
+
+
+	template<typename Container>
+	ContainerTable<Container>::ContainerTable(Container& container, const TableColumns<Row>& columns,
+	                                          const VirtualTableOptions& options)
+	: m_container(container), m_columns(columns), m_options(options)
+	{
+		if constexpr (std::is_const<Container>::value) {
+			this->m_options.writable = false;
+		}
+	}
+
+
+	template<typename Container>
+	const sqlite3_module* ContainerTable<Container>::getModule(bool writable) {
+		// xCreate differs from xConnect, so the module has no eponymous table
+		static const sqlite3_module readOnly = {
+			0, create, connect, bestIndex, disconnect, disconnect,
+			open, close, filter, next, eof, column, rowid,
+			NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+		};
+		if constexpr (std::is_const<Container>::value) {
+			(void)writable;
+			return &readOnly;
+		}
+		else {
+			static const sqlite3_module readWrite = {
+				0, create, connect, bestIndex, disconnect, disconnect,
+				open, close, filter, next, eof, column, rowid,
+				update, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+			};
+			return writable ? &readWrite : &readOnly;
+		}
+	}
+
+
+	template<typename Container>
+	void ContainerTable<Container>::destroy(void* data) {
+		delete static_cast<ContainerTable*>(data);
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::create(sqlite3* db, void* data, int argc, const char* const* argv,
+	                                      sqlite3_vtab** table, char** error)
+	{
+		return connect(db, data, argc, argv, table, error);
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::connect(sqlite3* db, void* data, int argc, const char* const* argv,
+	                                       sqlite3_vtab** table, char** error)
+	{
+		(void)argc;
+		(void)argv;
+		ContainerTable* owner = static_cast<ContainerTable*>(data);
+		try {
+			std::vector<std::pair<std::string, const char*> > columns;
+			for (const typename TableColumns<Row>::Column& column : owner->m_columns.getColumns()) {
+				columns.push_back(std::make_pair(column.name, column.type));
+			}
+			std::string sql = declaration(owner->m_columns.getKeyName().c_str(),
+			                              isMap ? getSqlType<Key>() : NULL, columns);
+			int rc = sqlite3_declare_vtab(db, sql.c_str());
+			if (rc != SQLITE_OK) {
+				*error = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+				return rc;
+			}
+		}
+		catch (const std::bad_alloc&) {
+			return SQLITE_NOMEM;
+		}
+
+		Table* created = static_cast<Table*>(sqlite3_malloc(sizeof(Table)));
+		if (created == NULL) {
+			return SQLITE_NOMEM;
+		}
+		created->base.pModule = NULL;
+		created->base.nRef = 0;
+		created->base.zErrMsg = NULL;
+		created->owner = owner;
+		*table = &created->base;
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::disconnect(sqlite3_vtab* table) {
+		sqlite3_free(table);
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::bestIndex(sqlite3_vtab* table, sqlite3_index_info* info) {
+		ContainerTable& owner = *reinterpret_cast<Table*>(table)->owner;
+		// a writable map may delete the row a unique lookup is positioned on
+		return planIndex(info, isMap ? 0 : -1, isOrdered, std::is_same<Key, std::string>::value,
+		                 !owner.m_options.writable, static_cast<double>(owner.m_container.size()));
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::open(sqlite3_vtab* table, sqlite3_vtab_cursor** cursor) {
+		Cursor* opened = new (std::nothrow) Cursor();
+		if (opened == NULL) {
+			return SQLITE_NOMEM;
+		}
+		ContainerTable& owner = *reinterpret_cast<Table*>(table)->owner;
+		opened->current = owner.m_container.end();
+		opened->last = owner.m_container.end();
+		*cursor = &opened->base;
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::close(sqlite3_vtab_cursor* cursor) {
+		delete reinterpret_cast<Cursor*>(cursor);
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::filter(sqlite3_vtab_cursor* cursor, int idxNum, const char* idxStr,
+	                                      int argc, sqlite3_value** argv)
+	{
+		(void)idxStr;
+		Cursor& scan = *reinterpret_cast<Cursor*>(cursor);
+		ContainerTable& owner = *reinterpret_cast<Table*>(cursor->pVtab)->owner;
+		scan.current = owner.m_container.begin();
+		scan.last = owner.m_container.end();
+
+		try {
+			// the constraints are passed in the order of the flags
+			int argument = 0;
+			for (int op = Equal; op <= LessEqual && argument < argc; op <<= 1) {
+				if ((idxNum & op) == 0) {
+					continue;
+				}
+				int bound = op;
+				Key key = Key();
+				Bound read = readBound(argv[argument++], bound, key);
+				if (read == Nothing) {
+					scan.current = scan.last;
+					return SQLITE_OK;
+				}
+				if (read == Limited) {
+					owner.limit(scan, bound, key);
+				}
+			}
+		}
+		catch (...) {
+			return setError(cursor->pVtab);
+		}
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	void ContainerTable<Container>::limit(Cursor& cursor, int op, const Key& key) {
+		Container& container = this->m_container;
+		if constexpr (!isMap) {
+			// the rowid is the position, bounds become an index range
+			sqlite3_int64 size = static_cast<sqlite3_int64>(container.size());
+			sqlite3_int64 first = cursor.current - container.begin();
+			sqlite3_int64 last = cursor.last - container.begin();
+			if (op == Equal || op == GreaterEqual) {
+				first = std::max(first, key);
+			}
+			else if (op == Greater) {
+				first = key >= size ? size : std::max(first, key + 1);
+			}
+			if (op == Equal || op == LessEqual) {
+				last = key >= size ? last : std::min(last, key + 1);
+			}
+			else if (op == Less) {
+				last = std::min(last, key);
+			}
+			first = std::min(std::max<sqlite3_int64>(first, 0), size);
+			last = std::max(std::min(last, size), first);
+			cursor.current = container.begin() + first;
+			cursor.last = container.begin() + last;
+		}
+		else if (op == Equal) {
+			Iterator found = container.find(key);
+			cursor.current = found;
+			cursor.last = found == container.end() ? found : std::next(found);
+		}
+		else if constexpr (isOrdered) {
+			if (op == Greater || op == GreaterEqual) {
+				cursor.current = op == Greater ? container.upper_bound(key) : container.lower_bound(key);
+			}
+			else {
+				cursor.last = op == Less ? container.lower_bound(key) : container.upper_bound(key);
+			}
+			// the upper bound lies before the lower bound
+			if (cursor.current == container.end()
+			    || (cursor.last != container.end() && cursor.last->first < cursor.current->first)) {
+				cursor.current = cursor.last;
+			}
+		}
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::next(sqlite3_vtab_cursor* cursor) {
+		++reinterpret_cast<Cursor*>(cursor)->current;
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::eof(sqlite3_vtab_cursor* cursor) {
+		Cursor& scan = *reinterpret_cast<Cursor*>(cursor);
+		return scan.current == scan.last ? 1 : 0;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::column(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int index) {
+		Cursor& scan = *reinterpret_cast<Cursor*>(cursor);
+		ContainerTable& owner = *reinterpret_cast<Table*>(cursor->pVtab)->owner;
+		try {
+			const std::vector<typename TableColumns<Row>::Column>& columns = owner.m_columns.getColumns();
+			std::size_t position = static_cast<std::size_t>(index) - (isMap ? 1 : 0);
+			// the old value of a read only column is not needed by an UPDATE
+			if ((!isMap || index > 0) && !columns[position].write && sqlite3_vtab_nochange(context)) {
+				return SQLITE_OK;
+			}
+			if constexpr (isMap) {
+				if (index == 0) {
+					if constexpr (std::is_same<Key, std::string>::value) {
+						FunctionAdapter::setResult(context, StaticText{ scan.current->first });
+					}
+					else {
+						FunctionAdapter::setResult(context, scan.current->first);
+					}
+					return SQLITE_OK;
+				}
+				columns[position].read(context, scan.current->second);
+			}
+			else {
+				columns[position].read(context, *scan.current);
+			}
+		}
+		catch (...) {
+			FunctionAdapter::setError(context);
+		}
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::rowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid) {
+		Cursor& scan = *reinterpret_cast<Cursor*>(cursor);
+		if constexpr (isMap) {
+			// WITHOUT ROWID, not called by sqlite
+			*rowid = 0;
+		}
+		else {
+			*rowid = scan.current - reinterpret_cast<Table*>(cursor->pVtab)->owner->m_container.begin();
+		}
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::update(sqlite3_vtab* table, int argc, sqlite3_value** argv,
+	                                      sqlite3_int64* rowid)
+	{
+		ContainerTable& owner = *reinterpret_cast<Table*>(table)->owner;
+		try {
+			if constexpr (isMap) {
+				(void)rowid;
+				return owner.updateMap(table, argc, argv);
+			}
+			else {
+				return owner.updateSequence(table, argc, argv, rowid);
+			}
+		}
+		catch (...) {
+			return setError(table);
+		}
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::assign(sqlite3_vtab* table, Row& row, sqlite3_value** values) {
+		const std::vector<typename TableColumns<Row>::Column>& columns = this->m_columns.getColumns();
+		for (std::size_t i = 0; i < columns.size(); ++i) {
+			if (!columns[i].write) {
+				// getters can not be written, a missing or unchanged value is ignored
+				if (sqlite3_value_nochange(values[i]) || sqlite3_value_type(values[i]) == SQLITE_NULL) {
+					continue;
+				}
+				setError(table, "column " + columns[i].name + " is read only");
+				return SQLITE_CONSTRAINT;
+			}
+			if (!columns[i].nullable && sqlite3_value_type(values[i]) == SQLITE_NULL) {
+				setError(table, "NOT NULL constraint failed: " + columns[i].name);
+				return SQLITE_CONSTRAINT;
+			}
+			columns[i].write(row, values[i]);
+		}
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::updateMap(sqlite3_vtab* table, int argc, sqlite3_value** argv) {
+		// argv[0]: key of the changed row, argv[2]: new key, argv[3...]: columns
+		Mutable& container = this->m_container;
+		int op = Equal;
+		Key oldKey = Key();
+		if (sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+			oldKey = FunctionAdapter::getValue<Key>(argv[0]);
+		}
+		if (argc == 1) {
+			container.erase(oldKey);
+			return SQLITE_OK;
+		}
+
+		Key newKey = Key();
+		if (readBound(argv[2], op, newKey) != Limited) {
+			setError(table, "invalid value for " + this->m_columns.getKeyName());
+			return SQLITE_CONSTRAINT;
+		}
+
+		typename Mutable::iterator found = container.end();
+		if (sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+			found = container.find(oldKey);
+			if (found == container.end()) {
+				return SQLITE_OK;
+			}
+		}
+		bool moved = found == container.end() || !(found->first == newKey);
+		if (moved && container.find(newKey) != container.end()) {
+			setError(table, "UNIQUE constraint failed: " + this->m_columns.getKeyName());
+			return SQLITE_CONSTRAINT;
+		}
+
+		// written to a copy, so the new values may be read from the old ones
+		Row row = found != container.end() ? found->second : Row();
+		int rc = this->assign(table, row, argv + 3);
+		if (rc != SQLITE_OK) {
+			return rc;
+		}
+		if (!moved) {
+			found->second = std::move(row);
+			return SQLITE_OK;
+		}
+		if (found != container.end()) {
+			container.erase(found);
+		}
+		container.emplace(std::move(newKey), std::move(row));
+		return SQLITE_OK;
+	}
+
+
+	template<typename Container>
+	int ContainerTable<Container>::updateSequence(sqlite3_vtab* table, int argc, sqlite3_value** argv,
+	                                              sqlite3_int64* rowid)
+	{
+		// argv[0]: rowid of the changed row, argv[1]: new rowid, argv[2...]: columns
+		Mutable& container = this->m_container;
+		sqlite3_int64 size = static_cast<sqlite3_int64>(container.size());
+		if (argc == 1) {
+			setError(table, "rows can not be deleted from a sequence");
+			return SQLITE_CONSTRAINT;
+		}
+
+		if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+			if constexpr (std::is_default_constructible<Row>::value) {
+				if constexpr (HasPushBack<Mutable>::value) {
+					if (sqlite3_value_type(argv[1]) != SQLITE_NULL && sqlite3_value_int64(argv[1]) != size) {
+						setError(table, "rows can only be appended to a sequence");
+						return SQLITE_CONSTRAINT;
+					}
+					Row row = Row();
+					int rc = this->assign(table, row, argv + 2);
+					if (rc != SQLITE_OK) {
+						return rc;
+					}
+					container.push_back(std::move(row));
+					*rowid = size;
+					return SQLITE_OK;
+				}
+			}
+			setError(table, "rows can not be inserted into this container");
+			return SQLITE_CONSTRAINT;
+		}
+
+		sqlite3_int64 position = sqlite3_value_int64(argv[0]);
+		if (sqlite3_value_int64(argv[1]) != position) {
+			setError(table, "the rowid of a sequence can not be changed");
+			return SQLITE_CONSTRAINT;
+		}
+		if (position < 0 || position >= size) {
+			return SQLITE_OK;
+		}
+		Row row = container[static_cast<std::size_t>(position)];
+		int rc = this->assign(table, row, argv + 2);
+		if (rc == SQLITE_OK) {
+			container[static_cast<std::size_t>(position)] = std::move(row);
+		}
+		return rc;
+	}
+
+}
+
+#endif
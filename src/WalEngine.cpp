@@ -0,0 +1,129 @@
+#include "WalEngine.h"
+#include "Log.h"
+
+
+gre90r::WalEngine::WalEngine(const char* filename, const WalEngineOptions& options)
+: m_filename(filename ? filename : ""),
+  m_options(options),
+  m_walEnabled(false),
+  m_writes(0)
+{
+	// journal_mode=WAL is stored in the database file, so it has to
+	// be set before the readers open it
+	this->m_walEnabled = this->enableWal();
+
+	GroupCommitOptions writerOptions;
+	writerOptions.window = this->m_options.writeWindow;
+	writerOptions.maxGroupSize = this->m_options.maxWriteBatch;
+	writerOptions.mode = TransactionMode::Immediate;
+	this->m_writer.reset(new GroupCommit(this->m_filename.c_str(), writerOptions));
+
+	// connection settings of the writer, outside of any transaction
+	int autoCheckpointPages = this->m_options.autoCheckpointPages;
+	bool synchronousNormal = this->m_options.synchronousNormal;
+	this->m_writer->submitStandalone([autoCheckpointPages, synchronousNormal](Sqlite& db) {
+		int rc = db.execute(("PRAGMA wal_autocheckpoint=" + std::to_string(autoCheckpointPages) + ";").c_str());
+		if (rc == SQLITE_OK && synchronousNormal) {
+			rc = db.execute("PRAGMA synchronous=NORMAL;");
+		}
+		return rc;
+	}).wait();
+
+	ConnectionPoolOptions readerOptions;
+	readerOptions.minSize = this->m_options.readers;
+	readerOptions.maxSize = this->m_options.readers;
+	readerOptions.openFlags = SQLITE_OPEN_READONLY;
+	this->m_readers.reset(new ConnectionPool(this->m_filename.c_str(), readerOptions));
+}
+
+
+gre90r::WalEngine::~WalEngine() {
+	// readers first, the writer commits the remaining writes when it stops
+	this->m_readers.reset();
+	this->m_writer.reset();
+}
+
+
+bool gre90r::WalEngine::isValid() const {
+	return this->m_walEnabled
+	    && this->m_writer->isValid()
+	    && this->m_readers->size() == this->m_options.readers;
+}
+
+
+std::future<int> gre90r::WalEngine::write(Work work) {
+	std::future<int> result = this->m_writer->submit(std::move(work));
+	this->countWrite();
+	return result;
+}
+
+
+gre90r::PooledConnection gre90r::WalEngine::acquireReader() {
+	return this->m_readers->acquire();
+}
+
+
+gre90r::SqlResult gre90r::WalEngine::select(const char* query) {
+	PooledConnection reader = this->m_readers->acquire();
+	if (!reader.isValid()) {
+		GRE90R_LOG(LogLevel::Error, "WAL engine: no reader available.");
+		return SqlResult();
+	}
+	return reader->select(query);
+}
+
+
+std::future<int> gre90r::WalEngine::checkpoint(CheckpointMode mode) {
+	return this->m_writer->submitStandalone([mode](Sqlite& db) {
+		return db.checkpoint(mode);
+	});
+}
+
+
+unsigned long long gre90r::WalEngine::getWriteCount() const {
+	return this->m_writes.load();
+}
+
+
+unsigned long long gre90r::WalEngine::getCommitCount() const {
+	return this->m_writer->getCommitCount();
+}
+
+
+gre90r::ConnectionPool& gre90r::WalEngine::getReaders() {
+	return *this->m_readers;
+}
+
+
+bool gre90r::WalEngine::enableWal() {
+	Sqlite setup(this->m_filename.c_str());
+	if (!setup.isConnected()) {
+		return false;
+	}
+
+	// the pragma returns the journal mode in effect afterwards
+	std::string mode;
+	for (const Row& row : setup.query("PRAGMA journal_mode=WAL;")) {
+		mode = row.toString(0);
+	}
+	if (mode != "wal") {
+		GRE90R_LOG(LogLevel::Error, "WAL engine: could not enable WAL mode, journal mode is '"
+		           << mode << "'.");
+		return false;
+	}
+	return true;
+}
+
+
+void gre90r::WalEngine::countWrite() {
+	unsigned long long writes = ++this->m_writes;
+	std::size_t every = this->m_options.checkpointEveryWrites;
+	if (every > 0 && writes % every == 0) {
+		CheckpointMode mode = this->m_options.checkpointMode;
+		// runs after the queued writes. the result is only of interest
+		// if the checkpoint fails, which is logged by Sqlite::checkpoint().
+		this->m_writer->submitStandalone([mode](Sqlite& db) {
+			return db.checkpoint(mode);
+		});
+	}
+}
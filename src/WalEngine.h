@@ -0,0 +1,222 @@
+#ifndef SQLITEWALENGINE_H
+#define SQLITEWALENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include "ConnectionPool.h"
+#include "GroupCommit.h"
+#include "Sqlite.h"
+
+
+namespace gre90r {
+
+	/**
+	 * connections and checkpoint policy of a WalEngine
+	 */
+	struct WalEngineOptions {
+		/**
+		 * number of read-only connections
+		 */
+		std::size_t readers = 4;
+
+		/**
+		 * PRAGMA wal_autocheckpoint of the writer: run a passive checkpoint
+		 * when the log has this many pages. 0 disables automatic checkpoints.
+		 */
+		int autoCheckpointPages = 1000;
+
+		/**
+		 * additionally run a checkpoint with checkpointMode after this many
+		 * writes. 0: only automatic checkpoints.
+		 */
+		std::size_t checkpointEveryWrites = 0;
+
+		/**
+		 * mode of the checkpoints run after checkpointEveryWrites writes
+		 */
+		CheckpointMode checkpointMode = CheckpointMode::Passive;
+
+		/**
+		 * PRAGMA synchronous=NORMAL on the writer. in WAL mode this stays
+		 * consistent, only the last commits may be lost on power failure.
+		 * false keeps FULL.
+		 */
+		bool synchronousNormal = true;
+
+		/**
+		 * how long the writer waits for more writes to put into the same
+		 * transaction. 0: take whatever is queued right now.
+		 */
+		std::chrono::microseconds writeWindow = std::chrono::microseconds(0);
+
+		/**
+		 * max number of writes in one transaction
+		 */
+		std::size_t maxWriteBatch = 256;
+	};
+
+	/**
+	 * single writer / multiple readers on a database in WAL mode.
+	 *
+	 * all writes go through one writer thread, which is fed by a queue
+	 * from any number of threads and commits whatever is queued in one
+	 * transaction (@see GroupCommit). reads run on a pool of read-only
+	 * connections and do not wait for the writer, so read throughput
+	 * scales with the number of cores.
+	 *
+	 * usage:
+	 *   gre90r::WalEngine engine("app.db");
+	 *   engine.write([](gre90r::Sqlite& db) { return db.execute("insert ..."); });
+	 *   gre90r::PooledConnection reader = engine.acquireReader();
+	 *   reader->select("select ...");
+	 */
+	class WalEngine {
+	public:
+		typedef GroupCommit::Work Work;
+
+		/**
+		 * forbid standard constructor
+		 */
+		WalEngine() = delete;
+
+		/**
+		 * switch the database to WAL mode, start the writer and open the readers
+		 * @param filename database file. in-memory databases have no WAL.
+		 */
+		explicit WalEngine(const char* filename, const WalEngineOptions& options = WalEngineOptions());
+
+		/**
+		 * forbid copy constructor
+		 */
+		WalEngine(const WalEngine&) = delete;
+
+		/**
+		 * commits all queued writes, then closes the connections
+		 */
+		virtual ~WalEngine();
+
+		/**
+		 * forbid assignment operator
+		 */
+		WalEngine& operator=(const WalEngine&) = delete;
+
+		/**
+		 * @return true: database is in WAL mode, writer and readers are connected
+		 */
+		bool isValid() const;
+
+		/**
+		 * queue a write for the writer thread. thread-safe.
+		 * @see GroupCommit::submit()
+		 */
+		std::future<int> write(Work work);
+
+		/**
+		 * queue a single sql statement with parameters for the writer thread
+		 * @see Sqlite::execute()
+		 */
+		template<typename... Args>
+		std::future<int> execute(const std::string& query, const Args&... args);
+
+		/**
+		 * lease a read-only connection. thread-safe.
+		 */
+		PooledConnection acquireReader();
+
+		/**
+		 * run a select on a read-only connection. thread-safe.
+		 */
+		SqlResult select(const char* query);
+
+		/**
+		 * run a checkpoint on the writer thread after all queued writes
+		 * @return sql error code. 0 is ok. SQLITE_BUSY if readers prevented a complete checkpoint.
+		 */
+		std::future<int> checkpoint(CheckpointMode mode);
+
+		/**
+		 * @return number of writes queued so far
+		 */
+		unsigned long long getWriteCount() const;
+
+		/**
+		 * @return number of write transactions committed by the writer
+		 */
+		unsigned long long getCommitCount() const;
+
+		/**
+		 * @return the read-only connection pool, e.g. for its wait metrics
+		 */
+		ConnectionPool& getReaders();
+
+	private:
+		/**************/
+		/* Attributes */
+		/**************/
+		std::string m_filename;
+		WalEngineOptions m_options;
+		bool m_walEnabled;
+		std::unique_ptr<GroupCommit> m_writer;
+		std::unique_ptr<ConnectionPool> m_readers;
+		std::atomic<unsigned long long> m_writes;
+
+		/*******************/
+		/* private Methods */
+		/*******************/
+		/**
+		 * set journal_mode=WAL on the database file
+		 * @return true: database is in WAL mode
+		 */
+		bool enableWal();
+
+		/**
+		 * queue a checkpoint if checkpointEveryWrites writes have been queued
+		 */
+		void countWrite();
+	};
+
+
+	/***************************/
+	/* template implementation */
+	/***************************/
+	/**
+	 * copy of a value which does not point to the caller's memory.
+	 * text is copied into a std::string, NULL text stays sql NULL.
+	 */
+	template<typename T>
+	auto ownedValue(const T& value) {
+		if constexpr (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) {
+			return value ? std::optional<std::string>(value) : std::optional<std::string>();
+		}
+		else if constexpr (std::is_convertible<const T&, std::string_view>::value) {
+			return std::string(std::string_view(value));
+		}
+		else {
+			return value;
+		}
+	}
+
+
+	template<typename... Args>
+	std::future<int> WalEngine::execute(const std::string& query, const Args&... args) {
+		// values are copied into the work, the caller's may be gone when it runs.
+		// BlobView is not copied, its data has to outlive the write.
+		auto values = std::make_tuple(ownedValue(args)...);
+		return this->write([query, values](Sqlite& db) {
+			return std::apply([&db, &query](const auto&... value) {
+				return db.execute(query.c_str(), value...);
+			}, values);
+		});
+	}
+
+}
+
+#endif
@@ -7,7 +7,11 @@
  * test sqlite
  */
 int main()  {
-  gre90r::Sqlite sqlite(Config::DB_NAME);
+  gre90r::OpenOptions options;
+  if (!gre90r::OpenOptions::forProfile(Config::DB_PROFILE, options)) {
+    std::cerr << "unknown db profile: " << Config::DB_PROFILE << std::endl;
+  }
+  gre90r::Sqlite sqlite(Config::DB_NAME, options);
   
   if (sqlite.isConnected()) {
     std::cout << "sqlite is working" << std::endl;
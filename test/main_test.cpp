@@ -1,9 +1,22 @@
 #include "gtest/gtest.h"
 #include "../src/Sqlite.h"
+#include "../src/AsyncExecutor.h"
+#include "../src/ConnectionPool.h"
+#include "../src/GroupCommit.h"
+#include "../src/ShardedDatabase.h"
+#include "../src/WalEngine.h"
 #include "util.cpp"
 #include "queries.cpp"
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
 #include <thread>
+#include <unordered_map>
 
 /**
  * this time is used to keep
@@ -26,6 +39,9 @@ const char* TEST_DB_FILENAMENAME = "test.db";
 const char* GENERAL_PURPOSE_DB_FILENAME = "sharedTest.db";
 static gre90r::Sqlite* db = NULL;
 
+// WAL mode is stored in the file, so the WAL tests have their own
+const char* WAL_TEST_DB_FILENAME = "walTest.db";
+
 
 /********************/
 /* prepare testcase */
@@ -136,6 +152,7 @@ class Environment : public ::testing::Environment {
       // delete db files
       deleteFile(TEST_DB_FILENAMENAME);
       deleteFile(GENERAL_PURPOSE_DB_FILENAME);
+      deleteFile(WAL_TEST_DB_FILENAME);
     }
 };
 
@@ -221,6 +238,25 @@ TEST(dbClose, currentlyNotConnected) {
   sqlite.close();
   ASSERT_EQ(false, sqlite.isConnected());
 }
+/**
+ * a statement still in use keeps the connection and its features open
+ */
+TEST(dbClose, statementInUse) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.setResultCache(true);
+  std::shared_ptr<gre90r::ChangeStream> stream = std::make_shared<gre90r::ChangeStream>(16);
+  sqlite.setChangeCapture(stream);
+  {
+    gre90r::Cursor cursor = sqlite.query("select 1");
+    sqlite.close();
+    ASSERT_TRUE(sqlite.isConnected());
+    ASSERT_TRUE(sqlite.hasResultCache());
+    ASSERT_TRUE(sqlite.hasChangeCapture());
+  }
+  sqlite.close();
+  ASSERT_FALSE(sqlite.isConnected());
+  ASSERT_FALSE(sqlite.hasChangeCapture());
+}
 /**
  * close when db file has been deleted meanwhile
  */
@@ -339,12 +375,43 @@ TEST(dbSelect, legitSelects) {
   db->execute(QUERY_INSERT_INTO_EMPLOYEE_JOHN);
   resultSet = db->select(QUERY_SELECT_NAME_FROM_EMPLOYEE);
   ASSERT_EQ(1, resultSet.size());
-  
-  for (auto result : resultSet) {
-    // reads only first element and we only added one, so it is the inserted employee.
-    ASSERT_EQ(EMPLOYEE_JOHN, result.second );
-    break;
-  }
+  ASSERT_STREQ(EMPLOYEE_JOHN, resultSet.getValue(0, 0));
+}
+/**
+ * all rows of a multi-row select are returned
+ */
+TEST(dbSelect, multipleRows) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  db->execute(QUERY_INSERT_INTO_EMPLOYEE_JOHN);
+  db->execute(QUERY_INSERT_INTO_EMPLOYEE_JEFF);
+  gre90r::SqlResult resultSet = db->select(QUERY_SELECT_ID_AND_NAME_FROM_EMPLOYEE);
+
+  ASSERT_EQ(2, resultSet.size());
+  ASSERT_EQ(2, resultSet.getColumnCount());
+  ASSERT_EQ("id", resultSet.getColumnName(0));
+  ASSERT_EQ("name", resultSet.getColumnName(1));
+  ASSERT_STREQ(EMPLOYEE_JOHN_ID, resultSet.getValue(0, 0));
+  ASSERT_STREQ(EMPLOYEE_JOHN, resultSet.getValue(0, "name"));
+  ASSERT_STREQ(EMPLOYEE_JEFF_ID, resultSet.getValue(1, 0));
+  ASSERT_STREQ(EMPLOYEE_JEFF, resultSet.getValue(1, "name"));
+  ASSERT_EQ(strlen(EMPLOYEE_JEFF), resultSet.getLength(1, 1));
+}
+/**
+ * sql NULL values are kept apart from empty text
+ */
+TEST(dbSelect, nullValues) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::SqlResult resultSet = sqlite.select("select null, '' union all select 'a', null");
+
+  ASSERT_EQ(2, resultSet.size());
+  ASSERT_TRUE(resultSet.isNull(0, 0));
+  ASSERT_EQ(NULL, resultSet.getValue(0, 0));
+  ASSERT_FALSE(resultSet.isNull(0, 1));
+  ASSERT_STREQ("", resultSet.getValue(0, 1));
+  ASSERT_STREQ("a", resultSet.getValue(1, 0));
+  ASSERT_TRUE(resultSet.isNull(1, 1));
 }
 /**
  * call a select statement when not connected
@@ -358,6 +425,2610 @@ TEST(dbSelect, notConnected) {
 }
 
 
+/*************************************/
+/* Test Suite: prepared statements */
+/*************************************/
+/**
+ * insert with bound parameters and read it back
+ */
+TEST(dbStatement, bindAndStep) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  std::shared_ptr<gre90r::Statement> insert = db->prepare(QUERY_INSERT_INTO_EMPLOYEE_PARAMS);
+  ASSERT_TRUE(insert->isValid());
+  ASSERT_EQ(2, insert->getParameterCount());
+  ASSERT_EQ(SQLITE_OK, insert->bind(1, 1));
+  ASSERT_EQ(SQLITE_OK, insert->bind(2, EMPLOYEE_JOHN));
+  ASSERT_EQ(SQLITE_DONE, insert->step());
+  insert->reset();
+
+  std::shared_ptr<gre90r::Statement> select = db->prepare(QUERY_SELECT_NAME_FROM_EMPLOYEE_BY_ID);
+  ASSERT_TRUE(select->isValid());
+  select->bind(1, 1);
+  ASSERT_EQ(SQLITE_ROW, select->step());
+  ASSERT_STREQ(EMPLOYEE_JOHN, select->getColumnText(0));
+  ASSERT_EQ(SQLITE_DONE, select->step());
+  select->reset();
+}
+/**
+ * preparing invalid sql returns an invalid statement
+ */
+TEST(dbStatement, invalidSql) {
+  std::shared_ptr<gre90r::Statement> statement = db->prepare("selec name frm employee");
+  ASSERT_FALSE(statement->isValid());
+  ASSERT_NE(SQLITE_OK, statement->getErrorCode());
+}
+/**
+ * identifiers are quoted with their quotes doubled
+ */
+TEST(dbStatement, quoteIdentifier) {
+  ASSERT_EQ("\"employee\"", gre90r::quoteIdentifier("employee"));
+  ASSERT_EQ("\"a\"\"b\"", gre90r::quoteIdentifier("a\"b"));
+  ASSERT_EQ("\"\"", gre90r::quoteIdentifier(""));
+}
+/**
+ * executing the same sql twice is served from the statement cache
+ */
+TEST(dbStatement, cacheHit) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute(QUERY_CREATE_TABLE_EMPLOYEE);
+
+  gre90r::StatementCache& cache = sqlite.getStatementCache();
+  cache.resetCounters();
+  sqlite.execute(QUERY_SELECT_NAME_FROM_EMPLOYEE);
+  sqlite.execute(QUERY_SELECT_NAME_FROM_EMPLOYEE);
+  ASSERT_EQ(1u, cache.getMisses());
+  ASSERT_EQ(1u, cache.getHits());
+}
+/**
+ * least recently used statements are evicted when the cache is full
+ */
+TEST(dbStatement, cacheEviction) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::StatementCache& cache = sqlite.getStatementCache();
+  cache.setCapacity(1);
+  sqlite.execute("select 1");
+  sqlite.execute("select 2");
+  ASSERT_EQ(1u, cache.size());
+  sqlite.execute("select 1"); // evicted, compiled again
+  ASSERT_EQ(3u, cache.getMisses());
+  ASSERT_EQ(0u, cache.getHits());
+}
+/**
+ * a statement which is still in use is not handed out twice
+ */
+TEST(dbStatement, statementInUse) {
+  gre90r::Sqlite sqlite(NULL);
+  std::shared_ptr<gre90r::Statement> first = sqlite.prepare("select 1");
+  std::shared_ptr<gre90r::Statement> second = sqlite.prepare("select 1");
+  ASSERT_NE(first.get(), second.get());
+}
+/**
+ * multiple statements in one query are all executed
+ */
+TEST(dbStatement, multipleStatements) {
+  gre90r::Sqlite sqlite(NULL);
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("create table t(x int); insert into t values (1); insert into t values (2);"));
+  std::shared_ptr<gre90r::Statement> count = sqlite.prepare("select count(*) from t");
+  ASSERT_EQ(SQLITE_ROW, count->step());
+  ASSERT_STREQ("2", count->getColumnText(0));
+  count->reset();
+}
+/**
+ * a cached statement compiled again on its first step, because the schema
+ * changed, reports the columns of the new compilation
+ */
+TEST(dbStatement, recompiledColumns) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table t(x int); insert into t values (1);");
+  ASSERT_EQ(1u, sqlite.select("select * from t").getColumnCount());
+  sqlite.execute("alter table t add column y int default 2");
+  gre90r::SqlResult result = sqlite.select("select * from t");
+  ASSERT_EQ(2u, result.getColumnCount());
+  ASSERT_EQ("y", result.getColumnName(1));
+  ASSERT_STREQ("2", result.getValue(0, 1));
+}
+
+
+/**********************/
+/* Test Suite: cursor */
+/**********************/
+/**
+ * iterate over all rows with a range-based for loop
+ */
+TEST(dbCursor, rangeBasedFor) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  db->execute(QUERY_INSERT_INTO_EMPLOYEE_JOHN);
+  db->execute(QUERY_INSERT_INTO_EMPLOYEE_JEFF);
+
+  std::vector<std::string> names;
+  for (const gre90r::Row& row : db->query(QUERY_SELECT_ID_AND_NAME_FROM_EMPLOYEE)) {
+    ASSERT_EQ(2, row.getColumnCount());
+    ASSERT_STREQ("name", row.getColumnName(1));
+    names.push_back(row.toString(1));
+  }
+  ASSERT_EQ(2u, names.size());
+  ASSERT_EQ(EMPLOYEE_JOHN, names[0]);
+  ASSERT_EQ(EMPLOYEE_JEFF, names[1]);
+}
+/**
+ * step through rows by hand and read the final state
+ */
+TEST(dbCursor, next) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::Cursor cursor = sqlite.query("select 1 union all select null");
+
+  ASSERT_TRUE(cursor.next());
+  ASSERT_STREQ("1", cursor.getRow().getText(0));
+  ASSERT_EQ(1u, cursor.getRow().getLength(0));
+  ASSERT_TRUE(cursor.next());
+  ASSERT_TRUE(cursor.getRow().isNull(0));
+  ASSERT_FALSE(cursor.next());
+  ASSERT_EQ(SQLITE_DONE, cursor.getErrorCode());
+}
+/**
+ * a cursor over invalid sql has no rows
+ */
+TEST(dbCursor, invalidSql) {
+  gre90r::Cursor cursor = db->query("selec name frm employee");
+  ASSERT_FALSE(cursor.isValid());
+  ASSERT_TRUE(cursor.begin() == cursor.end());
+  ASSERT_NE(SQLITE_OK, cursor.getErrorCode());
+}
+/**
+ * a parameter which cannot be bound fails the cursor instead of running the query
+ */
+TEST(dbCursor, bindError) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::Cursor cursor = sqlite.query("select ?", 1, 2);
+  ASSERT_TRUE(cursor.begin() == cursor.end());
+  ASSERT_EQ(SQLITE_RANGE, cursor.getErrorCode());
+}
+/**
+ * a cursor which is left early does not keep the db locked,
+ * so the connection can be closed afterwards.
+ */
+TEST(dbCursor, leaveEarly) {
+  gre90r::Sqlite sqlite(TEST_DB_FILENAMENAME);
+  sqlite.execute("create table if not exists numbers(x int)");
+  sqlite.execute("insert into numbers values (1), (2), (3)");
+  for (const gre90r::Row& row : sqlite.query("select x from numbers")) {
+    ASSERT_FALSE(row.isNull(0));
+    break;
+  }
+  sqlite.close();
+  ASSERT_FALSE(sqlite.isConnected());
+}
+
+
+/****************************/
+/* Test Suite: typed values */
+/****************************/
+/**
+ * bind values with their native types and read them back typed
+ */
+TEST(dbTyped, bindAndGet) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table t(i int, d real, s text, b blob, n int)");
+
+  const char blobData[] = { 'a', '\0', 'b' };
+  gre90r::BlobView blob = { blobData, sizeof(blobData) };
+  int64_t big = 1LL << 40;
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("insert into t values (?, ?, ?, ?, ?)",
+                                      big, 2.5, std::string("text"), blob, nullptr));
+
+  gre90r::Cursor cursor = sqlite.query("select i, d, s, b, n from t where i = ?", big);
+  ASSERT_TRUE(cursor.next());
+  const gre90r::Row& row = cursor.getRow();
+  ASSERT_EQ(big, row.get<int64_t>(0));
+  ASSERT_DOUBLE_EQ(2.5, row.get<double>(1));
+  ASSERT_EQ(std::string_view("text"), row.get<std::string_view>(2));
+  ASSERT_EQ("text", row.get<std::string>(2));
+  gre90r::BlobView readBlob = row.get<gre90r::BlobView>(3);
+  ASSERT_EQ(sizeof(blobData), readBlob.size);
+  ASSERT_EQ(0, memcmp(blobData, readBlob.data, sizeof(blobData)));
+  ASSERT_FALSE(row.get<std::optional<int> >(4).has_value());
+  ASSERT_EQ(0, row.get<int>(4));
+  ASSERT_FALSE(cursor.next());
+}
+/**
+ * optional and NULL pointers bind sql NULL
+ */
+TEST(dbTyped, bindNull) {
+  gre90r::Sqlite sqlite(NULL);
+  std::shared_ptr<gre90r::Statement> statement = sqlite.prepare("select ? is null, ? is null, ?");
+  const char* noText = NULL;
+  ASSERT_EQ(SQLITE_OK, statement->bindAll(std::optional<int>(), noText, std::optional<int>(7)));
+  ASSERT_EQ(SQLITE_ROW, statement->step());
+  gre90r::Row row(statement->getHandle());
+  ASSERT_TRUE(row.get<bool>(0));
+  ASSERT_TRUE(row.get<bool>(1));
+  ASSERT_EQ(7, row.get<std::optional<int> >(2).value());
+  statement->reset();
+}
+/**
+ * unsigned values above INT_MAX keep their value
+ */
+TEST(dbTyped, unsignedRoundTrip) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table t(u int, s int)");
+  uint32_t large = 3000000000u;
+  unsigned short small = 65535;
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("insert into t values (?, ?)", large, small));
+  ASSERT_STREQ("3000000000", sqlite.select("select u from t").getValue(0, 0));
+
+  gre90r::Cursor cursor = sqlite.query("select u, s from t where u = ?", large);
+  ASSERT_TRUE(cursor.next());
+  ASSERT_EQ(large, cursor.getRow().get<uint32_t>(0));
+  ASSERT_EQ(large, cursor.getRow().get<unsigned int>(0));
+  ASSERT_EQ(small, cursor.getRow().get<unsigned short>(1));
+  ASSERT_FALSE(cursor.next());
+}
+/**
+ * binding too many values reports the sqlite error
+ */
+TEST(dbTyped, bindOutOfRange) {
+  gre90r::Sqlite sqlite(NULL);
+  ASSERT_EQ(SQLITE_RANGE, sqlite.execute("select ?", 1, 2));
+}
+
+
+/***********************/
+/* Test Suite: logging */
+/***********************/
+/**
+ * collects log messages in a test
+ */
+static std::vector<std::pair<gre90r::LogLevel, std::string> > logMessages;
+static void collectLogMessage(gre90r::LogLevel level, const std::string& message) {
+  logMessages.push_back(std::make_pair(level, message));
+}
+
+/**
+ * connect and disconnect are written to the installed sink
+ */
+TEST(dbLog, customSink) {
+  logMessages.clear();
+  gre90r::Log::setSink(collectLogMessage);
+  {
+    gre90r::Sqlite sqlite(NULL);
+  }
+  gre90r::Log::setSink(gre90r::LogSink());
+
+  ASSERT_EQ(2u, logMessages.size());
+  ASSERT_EQ(gre90r::LogLevel::Info, logMessages[0].first);
+  ASSERT_EQ(gre90r::LogLevel::Info, logMessages[1].first);
+  ASSERT_EQ("disconnected from DB", logMessages[1].second);
+}
+/**
+ * rows are only logged if trace is enabled
+ */
+TEST(dbLog, rowsOnlyOnTrace) {
+  gre90r::Sqlite sqlite(NULL);
+  logMessages.clear();
+  gre90r::Log::setSink(collectLogMessage);
+
+  sqlite.select("select 1 as x");
+  ASSERT_TRUE(logMessages.empty());
+
+  gre90r::Log::setLevel(gre90r::LogLevel::Trace);
+  sqlite.select("select 1 as x");
+  gre90r::Log::setLevel(gre90r::LogLevel::Info);
+  gre90r::Log::setSink(gre90r::LogSink());
+
+  ASSERT_EQ(3u, logMessages.size());
+  ASSERT_EQ(gre90r::LogLevel::Trace, logMessages[1].first);
+  ASSERT_EQ("  x -> 1", logMessages[1].second);
+}
+/**
+ * errors are written even if the connection is unused otherwise
+ */
+TEST(dbLog, errorLevel) {
+  gre90r::Sqlite sqlite(NULL);
+  logMessages.clear();
+  gre90r::Log::setSink(collectLogMessage);
+  gre90r::Log::setLevel(gre90r::LogLevel::Error);
+
+  sqlite.close(); // info, not logged
+  sqlite.execute(QUERY_SELECT_NAME_FROM_EMPLOYEE); // error, logged
+
+  gre90r::Log::setLevel(gre90r::LogLevel::Info);
+  gre90r::Log::setSink(gre90r::LogSink());
+
+  ASSERT_EQ(1u, logMessages.size());
+  ASSERT_EQ(gre90r::LogLevel::Error, logMessages[0].first);
+}
+
+
+/***************************/
+/* Test Suite: bulk insert */
+/***************************/
+/**
+ * rows are committed in batches of the configured size
+ */
+TEST(dbBulkInsert, batchesByRows) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  gre90r::BulkInsertOptions options;
+  options.batchRows = 10;
+  gre90r::BulkInserter inserter = db->bulkInsert("employee", { "id", "name" }, options);
+  ASSERT_TRUE(inserter.isValid());
+  for (int id = 1; id <= 25; id++) {
+    ASSERT_EQ(SQLITE_OK, inserter.insert(id, "Employee " + std::to_string(id)));
+  }
+  ASSERT_EQ(2u, inserter.getBatchCount());
+  ASSERT_TRUE(db->isInTransaction()); // 5 rows pending
+  ASSERT_EQ(SQLITE_OK, inserter.finish());
+  ASSERT_FALSE(db->isInTransaction());
+  ASSERT_EQ(3u, inserter.getBatchCount());
+  ASSERT_EQ(25u, inserter.getRowCount());
+  ASSERT_GT(inserter.getRowsPerSecond(), 0.0);
+
+  gre90r::SqlResult resultSet = db->select(QUERY_SELECT_NAME_FROM_EMPLOYEE);
+  ASSERT_EQ(25u, resultSet.size());
+}
+/**
+ * rows are committed once the batch has enough bytes
+ */
+TEST(dbBulkInsert, batchesByBytes) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table t(x text)");
+
+  gre90r::BulkInsertOptions options;
+  options.batchRows = 0;
+  options.batchBytes = 100;
+  gre90r::BulkInserter inserter(sqlite, "t", { "x" }, options);
+  std::vector<std::tuple<std::string> > rows(10, std::make_tuple(std::string(50, 'x')));
+  ASSERT_EQ(SQLITE_OK, inserter.insertAll(rows));
+  ASSERT_EQ(5u, inserter.getBatchCount());
+}
+/**
+ * a failing row is reported and the batch can be rolled back
+ */
+TEST(dbBulkInsert, failingRow) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  gre90r::BulkInserter inserter = db->bulkInsert("employee", { "id", "name" });
+  ASSERT_EQ(SQLITE_OK, inserter.insert(1, EMPLOYEE_JOHN));
+  ASSERT_EQ(SQLITE_CONSTRAINT, inserter.insert(1, EMPLOYEE_JEFF)); // duplicate id
+  ASSERT_EQ(SQLITE_RANGE, inserter.insert(2)); // too few values
+  ASSERT_EQ(SQLITE_OK, inserter.rollback());
+  ASSERT_EQ(0u, inserter.getRowCount());
+  ASSERT_EQ(0u, db->select(QUERY_SELECT_NAME_FROM_EMPLOYEE).size());
+}
+/**
+ * inserting into a table which does not exist
+ */
+TEST(dbBulkInsert, unknownTable) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::BulkInserter inserter = sqlite.bulkInsert("missing", { "x" });
+  ASSERT_FALSE(inserter.isValid());
+  ASSERT_EQ(SQLITE_MISUSE, inserter.insert(1));
+}
+
+
+/****************************/
+/* Test Suite: transactions */
+/****************************/
+/**
+ * a transaction which is not committed is rolled back at scope exit
+ */
+TEST(dbTransaction, rollbackOnScopeExit) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  {
+    gre90r::Transaction transaction(*db, gre90r::TransactionMode::Immediate);
+    ASSERT_TRUE(transaction.isActive());
+    ASSERT_TRUE(db->isInTransaction());
+    db->execute(QUERY_INSERT_INTO_EMPLOYEE_JOHN);
+  }
+  ASSERT_FALSE(db->isInTransaction());
+  ASSERT_EQ(0u, db->select(QUERY_SELECT_NAME_FROM_EMPLOYEE).size());
+}
+/**
+ * a committed transaction keeps its changes
+ */
+TEST(dbTransaction, commit) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  {
+    gre90r::Transaction transaction(*db, gre90r::TransactionMode::Exclusive);
+    db->execute(QUERY_INSERT_INTO_EMPLOYEE_JOHN);
+    ASSERT_EQ(SQLITE_OK, transaction.commit());
+    ASSERT_FALSE(transaction.isActive());
+    ASSERT_EQ(SQLITE_MISUSE, transaction.commit());
+  }
+  ASSERT_EQ(1u, db->select(QUERY_SELECT_NAME_FROM_EMPLOYEE).size());
+}
+/**
+ * a transaction cannot begin inside another one
+ */
+TEST(dbTransaction, nested) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::Transaction outer(sqlite);
+  gre90r::Transaction inner(sqlite);
+  ASSERT_TRUE(outer.isActive());
+  ASSERT_FALSE(inner.isActive());
+  ASSERT_NE(SQLITE_OK, inner.getErrorCode());
+}
+/**
+ * nested savepoints only undo their own changes
+ */
+TEST(dbTransaction, savepoints) {
+  // reset test db to initial state
+  testDbFreshStart();
+
+  gre90r::Transaction transaction(*db);
+  db->execute(QUERY_INSERT_INTO_EMPLOYEE_JOHN);
+  {
+    gre90r::Savepoint outer(*db);
+    ASSERT_TRUE(outer.isActive());
+    db->execute(QUERY_INSERT_INTO_EMPLOYEE_JEFF);
+    {
+      gre90r::Savepoint inner(*db);
+      ASSERT_NE(outer.getName(), inner.getName());
+      db->execute("delete from employee");
+    } // rolled back: employees are back
+    ASSERT_EQ(2u, db->select(QUERY_SELECT_NAME_FROM_EMPLOYEE).size());
+  } // rolled back: Jeff is gone
+  ASSERT_EQ(SQLITE_OK, transaction.commit());
+
+  gre90r::SqlResult resultSet = db->select(QUERY_SELECT_NAME_FROM_EMPLOYEE);
+  ASSERT_EQ(1u, resultSet.size());
+  ASSERT_STREQ(EMPLOYEE_JOHN, resultSet.getValue(0, 0));
+}
+/**
+ * writes of many threads are merged into few commits.
+ * a failing write does not affect the others.
+ */
+TEST(dbTransaction, groupCommit) {
+  {
+    gre90r::Sqlite setup(TEST_DB_FILENAMENAME);
+    setup.execute("drop table if exists numbers");
+    setup.execute("create table numbers(x int primary key)");
+  }
+
+  gre90r::GroupCommitOptions options;
+  options.window = std::chrono::milliseconds(50);
+  gre90r::GroupCommit writer(TEST_DB_FILENAMENAME, options);
+  ASSERT_TRUE(writer.isValid());
+
+  std::vector<std::future<int> > results;
+  std::mutex resultsMutex;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(std::thread([&, t] {
+      for (int i = 0; i < 10; i++) {
+        int x = t * 10 + i;
+        std::future<int> result = writer.submit([x](gre90r::Sqlite& sqlite) {
+          return sqlite.execute("insert into numbers values (?)", x);
+        });
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        results.push_back(std::move(result));
+      }
+    }));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  std::future<int> duplicate = writer.submit([](gre90r::Sqlite& sqlite) {
+    return sqlite.execute("insert into numbers values (?)", 0);
+  });
+
+  for (std::future<int>& result : results) {
+    ASSERT_EQ(SQLITE_OK, result.get());
+  }
+  ASSERT_EQ(SQLITE_CONSTRAINT, duplicate.get());
+  ASSERT_EQ(41u, writer.getWorkCount());
+  ASSERT_LT(writer.getCommitCount(), 41u);
+
+  gre90r::Sqlite reader(TEST_DB_FILENAMENAME);
+  ASSERT_EQ(40u, reader.select("select x from numbers").size());
+}
+/**
+ * a work whose savepoint cannot be opened is not run
+ * and fails with the error of the savepoint
+ */
+TEST(dbTransaction, groupCommitSavepointFails) {
+  {
+    gre90r::Sqlite setup(TEST_DB_FILENAMENAME);
+    setup.execute("drop table if exists numbers");
+    setup.execute("create table numbers(x int primary key)");
+  }
+
+  gre90r::GroupCommit writer(TEST_DB_FILENAMENAME);
+  ASSERT_TRUE(writer.isValid());
+
+  // deny opening savepoints from now on
+  std::future<int> deny = writer.submit([](gre90r::Sqlite& sqlite) {
+    return sqlite3_set_authorizer(sqlite.getHandle(),
+      [](void*, int action, const char* operation, const char*, const char*, const char*) {
+        bool opening = action == SQLITE_SAVEPOINT && strcmp(operation, "BEGIN") == 0;
+        return opening ? SQLITE_DENY : SQLITE_OK;
+      }, NULL);
+  });
+  ASSERT_EQ(SQLITE_OK, deny.get());
+
+  bool ran = false;
+  std::future<int> insert = writer.submit([&ran](gre90r::Sqlite& sqlite) {
+    ran = true;
+    return sqlite.execute("insert into numbers values (1)");
+  });
+  ASSERT_EQ(SQLITE_AUTH, insert.get());
+  ASSERT_FALSE(ran);
+  ASSERT_EQ(1u, writer.getWorkCount());
+}
+
+
+/*******************************/
+/* Test Suite: connection pool */
+/*******************************/
+/**
+ * leases are given back when they go out of scope
+ */
+TEST(dbConnectionPool, leaseAndRelease) {
+  gre90r::ConnectionPoolOptions options;
+  options.minSize = 2;
+  options.maxSize = 2;
+  gre90r::ConnectionPool pool(TEST_DB_FILENAMENAME, options);
+  ASSERT_EQ(2u, pool.size());
+
+  {
+    gre90r::PooledConnection first = pool.acquire();
+    gre90r::PooledConnection second = pool.acquire();
+    ASSERT_TRUE(first.isValid());
+    ASSERT_TRUE(second.isValid());
+    ASSERT_NE(first.get(), second.get());
+    ASSERT_FALSE(pool.tryAcquire().isValid()); // all in use
+  }
+  ASSERT_EQ(2u, pool.getStats().idle);
+  ASSERT_EQ(2u, pool.getStats().acquires);
+}
+/**
+ * the pool opens more connections on demand up to maxSize
+ */
+TEST(dbConnectionPool, elastic) {
+  gre90r::ConnectionPoolOptions options;
+  options.minSize = 0;
+  options.maxSize = 2;
+  options.acquireTimeout = std::chrono::milliseconds(10);
+  gre90r::ConnectionPool pool(TEST_DB_FILENAMENAME, options);
+  ASSERT_EQ(0u, pool.size());
+
+  gre90r::PooledConnection first = pool.acquire();
+  gre90r::PooledConnection second = pool.acquire();
+  ASSERT_EQ(2u, pool.size());
+  gre90r::PooledConnection third = pool.acquire(); // times out
+  ASSERT_FALSE(third.isValid());
+  ASSERT_EQ(1u, pool.getStats().timeouts);
+}
+/**
+ * a waiting thread gets the connection another thread gives back
+ * and the wait is recorded
+ */
+TEST(dbConnectionPool, waitForRelease) {
+  gre90r::ConnectionPoolOptions options;
+  options.minSize = 1;
+  options.maxSize = 1;
+  gre90r::ConnectionPool pool(TEST_DB_FILENAMENAME, options);
+
+  gre90r::PooledConnection lease = pool.acquire();
+  std::thread releaser([&lease] {
+    sleepMilliseconds(20);
+    lease.release();
+  });
+  gre90r::PooledConnection waited = pool.acquire();
+  releaser.join();
+
+  ASSERT_TRUE(waited.isValid());
+  gre90r::ConnectionPoolStats stats = pool.getStats();
+  ASSERT_EQ(1u, stats.waits);
+  ASSERT_GT(stats.maxWaitMicros, 0u);
+}
+/**
+ * new connections have the warm statements cached and the result cache
+ * enabled. a connection with an open transaction is rolled back on release
+ */
+TEST(dbConnectionPool, warmStatementsAndCleanup) {
+  gre90r::ConnectionPoolOptions options;
+  options.minSize = 1;
+  options.maxSize = 1;
+  options.warmStatements.push_back("select 1");
+  options.enableResultCache = true;
+  gre90r::ConnectionPool pool(TEST_DB_FILENAMENAME, options);
+
+  {
+    gre90r::PooledConnection db = pool.acquire();
+    db->getStatementCache().resetCounters();
+    db->execute("select 1");
+    ASSERT_EQ(1u, db->getStatementCache().getHits());
+    db->execute("BEGIN TRANSACTION;");
+  }
+  gre90r::PooledConnection db = pool.acquire();
+  ASSERT_FALSE(db->isInTransaction());
+  ASSERT_TRUE(db->hasResultCache());
+}
+
+
+/**************************/
+/* Test Suite: WAL engine */
+/**************************/
+/**
+ * start a WAL engine on an empty numbers table
+ */
+static void walTestFreshStart() {
+  gre90r::Sqlite setup(WAL_TEST_DB_FILENAME);
+  setup.execute("drop table if exists numbers");
+  setup.execute("create table numbers(x int primary key)");
+}
+TEST(dbWalEngine, walMode) {
+  walTestFreshStart();
+  gre90r::WalEngineOptions options;
+  options.readers = 2;
+  gre90r::WalEngine engine(WAL_TEST_DB_FILENAME, options);
+  ASSERT_TRUE(engine.isValid());
+  ASSERT_EQ(2u, engine.getReaders().size());
+
+  gre90r::SqlResult result = engine.select("PRAGMA journal_mode;");
+  ASSERT_STREQ("wal", result.getValue(0, 0));
+}
+/**
+ * writes of several threads are committed by the writer
+ * and visible to the readers
+ */
+TEST(dbWalEngine, writeThenRead) {
+  walTestFreshStart();
+  gre90r::WalEngineOptions options;
+  options.writeWindow = std::chrono::milliseconds(20);
+  gre90r::WalEngine engine(WAL_TEST_DB_FILENAME, options);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(std::thread([&engine, t] {
+      for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(SQLITE_OK, engine.execute("insert into numbers values (?)", t * 10 + i).get());
+      }
+    }));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(40u, engine.getWriteCount());
+  ASSERT_LE(engine.getCommitCount(), 40u);
+  gre90r::SqlResult result = engine.select("select count(*) from numbers");
+  ASSERT_STREQ("40", result.getValue(0, 0));
+}
+/**
+ * a reader sees its snapshot while the writer commits
+ */
+TEST(dbWalEngine, readDuringWrite) {
+  walTestFreshStart();
+  gre90r::WalEngine engine(WAL_TEST_DB_FILENAME);
+  ASSERT_EQ(SQLITE_OK, engine.execute("insert into numbers values (?)", 1).get());
+
+  gre90r::PooledConnection reader = engine.acquireReader();
+  gre90r::Transaction snapshot(*reader);
+  ASSERT_STREQ("1", reader->select("select count(*) from numbers").getValue(0, 0));
+
+  // the writer is not blocked by the open read transaction
+  ASSERT_EQ(SQLITE_OK, engine.execute("insert into numbers values (?)", 2).get());
+  ASSERT_STREQ("1", reader->select("select count(*) from numbers").getValue(0, 0));
+  snapshot.commit();
+  ASSERT_STREQ("2", reader->select("select count(*) from numbers").getValue(0, 0));
+}
+/**
+ * text parameters are copied, checkpoints run on the writer
+ */
+TEST(dbWalEngine, checkpoint) {
+  walTestFreshStart();
+  gre90r::WalEngineOptions options;
+  options.checkpointEveryWrites = 2;
+  gre90r::WalEngine engine(WAL_TEST_DB_FILENAME, options);
+
+  std::future<int> write;
+  {
+    std::string value = "7";
+    write = engine.execute("insert into numbers values (?)", value.c_str());
+  }
+  ASSERT_EQ(SQLITE_OK, write.get());
+  ASSERT_EQ(SQLITE_OK, engine.execute("insert into numbers values (?)", 8).get());
+  ASSERT_EQ(SQLITE_OK, engine.checkpoint(gre90r::CheckpointMode::Truncate).get());
+  ASSERT_STREQ("15", engine.select("select sum(x) from numbers").getValue(0, 0));
+}
+
+
+/*******************************/
+/* Test Suite: async execution */
+/*******************************/
+/**
+ * pipelined requests of one worker run in the order they were queued
+ */
+TEST(dbAsync, futures) {
+  gre90r::AsyncExecutor executor(NULL);
+  ASSERT_TRUE(executor.isValid());
+
+  std::future<int> created = executor.executeAsync("create table numbers(x int)");
+  std::vector<std::future<int> > inserts;
+  for (int i = 1; i <= 10; i++) {
+    inserts.push_back(executor.executeAsync("insert into numbers values (" + std::to_string(i) + ")"));
+  }
+  std::future<gre90r::SqlResult> sum = executor.selectAsync("select sum(x) from numbers");
+
+  ASSERT_EQ(SQLITE_OK, created.get());
+  for (std::future<int>& insert : inserts) {
+    ASSERT_EQ(SQLITE_OK, insert.get());
+  }
+  ASSERT_STREQ("55", sum.get().getValue(0, 0));
+  ASSERT_EQ(0u, executor.getPending());
+  ASSERT_GE(executor.getCompleted(), 11u); // the last one may still be counting
+}
+/**
+ * completion callbacks get the error code and the rows
+ */
+TEST(dbAsync, callbacks) {
+  gre90r::AsyncExecutor executor(NULL);
+  std::promise<int> failed;
+  executor.executeAsync("select * from missing", [&failed](int rc) {
+    failed.set_value(rc);
+  });
+  std::promise<std::string> value;
+  executor.selectAsync("select 'hello' as greeting", [&value](int rc, gre90r::SqlResult result) {
+    value.set_value(rc == SQLITE_OK ? result.getValue(0, "greeting") : "");
+  });
+
+  ASSERT_EQ(SQLITE_ERROR, failed.get_future().get());
+  ASSERT_EQ("hello", value.get_future().get());
+}
+/**
+ * any work with parameters can be queued and returns its own type
+ */
+TEST(dbAsync, submit) {
+  gre90r::AsyncExecutor executor(NULL);
+  std::future<std::string> name = executor.submit([](gre90r::Sqlite& sqlite) {
+    std::string result;
+    for (const gre90r::Row& row : sqlite.query("select upper(?)", "jeff")) {
+      result = row.toString(0);
+    }
+    return result;
+  });
+  ASSERT_EQ("JEFF", name.get());
+}
+/**
+ * several workers share the queue. a worker without connection answers with -3.
+ */
+TEST(dbAsync, workers) {
+  {
+    gre90r::Sqlite setup(TEST_DB_FILENAMENAME);
+    setup.execute("drop table if exists numbers");
+    setup.execute("create table numbers(x int)");
+    setup.execute("insert into numbers values (1)");
+  }
+  gre90r::AsyncExecutorOptions options;
+  options.workers = 3;
+  options.openFlags = SQLITE_OPEN_READONLY;
+  gre90r::AsyncExecutor readers(TEST_DB_FILENAMENAME, options);
+  ASSERT_TRUE(readers.isValid());
+
+  std::vector<std::future<gre90r::SqlResult> > results;
+  for (int i = 0; i < 30; i++) {
+    results.push_back(readers.selectAsync("select x from numbers"));
+  }
+  for (std::future<gre90r::SqlResult>& result : results) {
+    ASSERT_STREQ("1", result.get().getValue(0, 0));
+  }
+
+  gre90r::AsyncExecutor missing("missing/missing.db", options);
+  ASSERT_FALSE(missing.isValid());
+  ASSERT_EQ(-3, missing.executeAsync("select 1").get());
+}
+
+
+/*****************************/
+/* Test Suite: busy handling */
+/*****************************/
+/**
+ * lock test.db with a write transaction on locker
+ */
+static void lockTestDb(gre90r::Sqlite& locker) {
+  locker.execute("drop table if exists numbers");
+  locker.execute("create table numbers(x int)");
+  locker.execute("BEGIN IMMEDIATE;");
+}
+TEST(dbBusy, waitForLock) {
+  gre90r::Sqlite locker(TEST_DB_FILENAMENAME);
+  lockTestDb(locker);
+  std::thread unlocker([&locker] {
+    sleepMilliseconds(50);
+    locker.execute("COMMIT;");
+  });
+
+  gre90r::Sqlite waiter(TEST_DB_FILENAMENAME);
+  int rc = waiter.execute("insert into numbers values (1)");
+  unlocker.join();
+
+  ASSERT_EQ(SQLITE_OK, rc);
+  const gre90r::BusyStats& stats = waiter.getBusyStats();
+  ASSERT_EQ(1u, stats.busyEvents);
+  ASSERT_GT(stats.retries, 0u);
+  ASSERT_EQ(0u, stats.timeouts);
+  ASSERT_GT(stats.totalWaitMicros, 0u);
+}
+/**
+ * gives up with SQLITE_BUSY after maxWait
+ */
+TEST(dbBusy, timeout) {
+  gre90r::Sqlite locker(TEST_DB_FILENAMENAME);
+  lockTestDb(locker);
+
+  gre90r::BusyPolicy policy;
+  policy.maxWait = std::chrono::milliseconds(30);
+  gre90r::Sqlite waiter(TEST_DB_FILENAMENAME, SQLITE_OPEN_READWRITE, policy);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  ASSERT_EQ(SQLITE_BUSY, waiter.execute("insert into numbers values (1)"));
+  ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(30));
+
+  ASSERT_EQ(1u, waiter.getBusyStats().timeouts);
+  ASSERT_GE(waiter.getBusyStats().totalWaitMicros, 20000u);
+  locker.execute("ROLLBACK;");
+}
+/**
+ * maxWait 0 fails right away without waiting
+ */
+TEST(dbBusy, noWait) {
+  gre90r::Sqlite locker(TEST_DB_FILENAMENAME);
+  lockTestDb(locker);
+
+  gre90r::Sqlite waiter(TEST_DB_FILENAMENAME);
+  gre90r::BusyPolicy policy;
+  policy.maxWait = std::chrono::milliseconds(0);
+  waiter.setBusyPolicy(policy);
+  ASSERT_EQ(SQLITE_BUSY, waiter.execute("insert into numbers values (1)"));
+  ASSERT_EQ(0u, waiter.getBusyStats().busyEvents);
+  locker.execute("ROLLBACK;");
+}
+
+
+/****************************/
+/* Test Suite: open options */
+/****************************/
+TEST(dbOpenOptions, profileByName) {
+  gre90r::OpenOptions options;
+  ASSERT_TRUE(gre90r::OpenOptions::forProfile("read-heavy", options));
+  ASSERT_EQ(gre90r::JournalMode::Wal, options.journalMode);
+  ASSERT_TRUE(options.flags & SQLITE_OPEN_NOMUTEX);
+  ASSERT_FALSE(gre90r::OpenOptions::forProfile("fast", options));
+  ASSERT_FALSE(gre90r::OpenOptions::forProfile(NULL, options));
+}
+/**
+ * the PRAGMAs of a profile are in effect after opening
+ */
+TEST(dbOpenOptions, readHeavy) {
+  gre90r::Sqlite sqlite(TEST_DB_FILENAMENAME,
+                        gre90r::OpenOptions::forProfile(gre90r::OpenProfile::ReadHeavy));
+  ASSERT_TRUE(sqlite.isConnected());
+
+  gre90r::OpenSettings settings = sqlite.getSettings();
+  ASSERT_EQ("wal", settings.journalMode);
+  ASSERT_EQ(1, settings.synchronous); // NORMAL
+  ASSERT_EQ(-65536, settings.cacheSize);
+  ASSERT_EQ(2, settings.tempStore); // MEMORY
+
+  // back to the default journal, test.db is shared with other tests
+  sqlite.execute("PRAGMA journal_mode=DELETE;");
+}
+/**
+ * settings can be applied to an open connection
+ */
+TEST(dbOpenOptions, applyOptions) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::OpenOptions options;
+  options.synchronous = gre90r::SynchronousMode::Off;
+  options.cacheSize = 500;
+  options.pageSize = 8192; // new database, so it can still be set
+  ASSERT_EQ(SQLITE_OK, sqlite.applyOptions(options));
+
+  gre90r::OpenSettings settings = sqlite.getSettings();
+  ASSERT_EQ(0, settings.synchronous);
+  ASSERT_EQ(500, settings.cacheSize);
+  ASSERT_EQ(8192, settings.pageSize);
+}
+/**
+ * an in-memory database keeps its journal in memory
+ * even if WAL is asked for. it is not an error.
+ */
+TEST(dbOpenOptions, settingNotTaken) {
+  gre90r::OpenOptions options = gre90r::OpenOptions::forProfile(gre90r::OpenProfile::InMemoryCache);
+  options.journalMode = gre90r::JournalMode::Wal;
+  gre90r::Sqlite sqlite("cache", options);
+  ASSERT_TRUE(sqlite.isConnected());
+  ASSERT_EQ("memory", sqlite.getSettings().journalMode);
+  ASSERT_FALSE(fileExists("cache"));
+}
+
+
+/*******************************/
+/* Test Suite: instrumentation */
+/*******************************/
+TEST(dbInstrumentation, normalize) {
+  ASSERT_EQ("select * from t1 where a = ? and b = ?",
+            gre90r::Instrumentation::normalize("select *  from t1\n where a = 42 and b = 'it''s'"));
+  ASSERT_EQ("insert into \"t 2\" values (?, ?1, :name)",
+            gre90r::Instrumentation::normalize("insert into \"t 2\" values (1.5e3, ?1, :name)"));
+}
+TEST(dbInstrumentation, histogram) {
+  gre90r::LatencyHistogram histogram;
+  for (std::uint64_t i = 1; i <= 1000; i++) {
+    histogram.record(i * 1000);
+  }
+  ASSERT_EQ(1000u, histogram.getCount());
+  ASSERT_EQ(1000000u, histogram.getMax());
+  // buckets are at most 12.5% wide
+  ASSERT_NEAR(500000.0, static_cast<double>(histogram.getPercentile(50)), 500000 * 0.125);
+  ASSERT_NEAR(990000.0, static_cast<double>(histogram.getPercentile(99)), 990000 * 0.125);
+  ASSERT_EQ(1000000u, histogram.getPercentile(100));
+}
+/**
+ * runs, rows and scan counters are collected per normalized statement
+ */
+TEST(dbInstrumentation, statementMetrics) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table numbers(x int)");
+  ASSERT_FALSE(sqlite.isInstrumented());
+  sqlite.setInstrumentation(true);
+  ASSERT_TRUE(sqlite.isInstrumented());
+
+  for (int i = 0; i < 10; i++) {
+    sqlite.execute(("insert into numbers values (" + std::to_string(i) + ")").c_str());
+  }
+  sqlite.select("select x from numbers order by x");
+
+  gre90r::ConnectionMetrics metrics = sqlite.getMetrics();
+  ASSERT_EQ(2u, metrics.statements.size());
+  for (const gre90r::StatementMetrics& statement : metrics.statements) {
+    if (statement.sql == "insert into numbers values (?)") {
+      ASSERT_EQ(10u, statement.calls);
+      ASSERT_EQ(0u, statement.rows);
+    }
+    else {
+      ASSERT_EQ("select x from numbers order by x", statement.sql);
+      ASSERT_EQ(1u, statement.calls);
+      ASSERT_EQ(10u, statement.rows);
+      ASSERT_EQ(9u, statement.fullscanSteps);
+      ASSERT_EQ(1u, statement.sorts);
+      ASSERT_GT(statement.vmSteps, 0u);
+    }
+    ASSERT_GE(statement.maxNanos, statement.p50Nanos);
+  }
+  ASSERT_GT(metrics.cacheHits + metrics.cacheMisses, 0);
+
+  sqlite.resetMetrics();
+  ASSERT_TRUE(sqlite.getMetrics().statements.empty());
+}
+/**
+ * the snapshot can be exported for a metrics scraper
+ */
+TEST(dbInstrumentation, json) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.setInstrumentation(true);
+  sqlite.execute("select \"a\"");
+  std::string json = sqlite.getMetrics().toJson();
+  ASSERT_EQ(0u, json.find("{\"cacheHits\":"));
+  ASSERT_NE(std::string::npos, json.find("\"sql\":\"select \\\"a\\\"\",\"calls\":1,\"rows\":1"));
+
+  sqlite.setInstrumentation(false);
+  ASSERT_EQ("{\"cacheHits\":0,\"cacheMisses\":0,\"cacheWrites\":0,\"cacheUsedBytes\":0,\"statements\":[]}",
+            sqlite.getMetrics().toJson());
+}
+
+
+/****************************/
+/* Test Suite: blob streams */
+/****************************/
+/**
+ * create the files table on sqlite
+ */
+static void createFilesTable(gre90r::Sqlite& sqlite) {
+  sqlite.execute("create table files(name text, data blob)");
+}
+/**
+ * a preallocated blob is written and read in chunks, NUL bytes included
+ */
+TEST(dbBlob, chunks) {
+  gre90r::Sqlite sqlite(NULL);
+  createFilesTable(sqlite);
+  const int size = 1 << 20;
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("insert into files values (?, ?)", "big", gre90r::ZeroBlob{ size }));
+
+  gre90r::BlobStream writer = sqlite.openBlob("files", "data", sqlite.getLastInsertRowId(), true);
+  ASSERT_TRUE(writer.isOpen());
+  ASSERT_EQ(size, writer.getSize());
+  std::vector<char> chunk(4096);
+  for (int offset = 0; offset < size; offset += static_cast<int>(chunk.size())) {
+    for (std::size_t i = 0; i < chunk.size(); i++) {
+      chunk[i] = static_cast<char>((offset + i) % 256);
+    }
+    ASSERT_EQ(SQLITE_OK, writer.write(chunk.data(), static_cast<int>(chunk.size())));
+  }
+  ASSERT_EQ(SQLITE_ERROR, writer.write("x", 1)); // the size is fixed
+  writer.close();
+
+  gre90r::BlobStream reader = sqlite.openBlob("files", "data", sqlite.getLastInsertRowId());
+  std::vector<char> buffer(5000);
+  int total = 0;
+  int count;
+  while ((count = reader.read(buffer.data(), static_cast<int>(buffer.size()))) > 0) {
+    for (int i = 0; i < count; i++) {
+      ASSERT_EQ(static_cast<char>((total + i) % 256), buffer[i]);
+    }
+    total += count;
+  }
+  ASSERT_EQ(0, count);
+  ASSERT_EQ(size, total);
+}
+/**
+ * copy between a blob and std streams
+ */
+TEST(dbBlob, streams) {
+  gre90r::Sqlite sqlite(NULL);
+  createFilesTable(sqlite);
+  std::string payload("binary\0payload\0", 16);
+  sqlite.execute("insert into files values (?, ?)", "payload", gre90r::ZeroBlob{ payload.size() });
+  sqlite3_int64 rowid = sqlite.getLastInsertRowId();
+
+  std::istringstream in(payload);
+  ASSERT_EQ(SQLITE_OK, sqlite.openBlob("files", "data", rowid, true).writeFrom(in, 5));
+
+  std::ostringstream out;
+  gre90r::BlobStream reader = sqlite.openBlob("files", "data", rowid);
+  ASSERT_EQ(SQLITE_OK, reader.seek(7));
+  ASSERT_EQ(SQLITE_OK, reader.readTo(out, 3));
+  ASSERT_EQ(payload.substr(7), out.str());
+
+  // input shorter than the blob
+  std::istringstream shortIn("abc");
+  ASSERT_EQ(SQLITE_IOERR, sqlite.openBlob("files", "data", rowid, true).writeFrom(shortIn));
+}
+/**
+ * the stream moves from row to row
+ */
+TEST(dbBlob, reopen) {
+  gre90r::Sqlite sqlite(NULL);
+  createFilesTable(sqlite);
+  sqlite.execute("insert into files values ('a', x'0102')");
+  sqlite.execute("insert into files values ('b', x'030405')");
+
+  gre90r::BlobStream blob = sqlite.openBlob("files", "data", 1);
+  char buffer[3] = { 0, 0, 0 };
+  ASSERT_EQ(2, blob.read(buffer, 3));
+  ASSERT_EQ(2, buffer[1]);
+
+  ASSERT_EQ(SQLITE_OK, blob.reopen(2));
+  ASSERT_EQ(3, blob.getSize());
+  ASSERT_EQ(3, blob.read(buffer, 3));
+  ASSERT_EQ(5, buffer[2]);
+
+  ASSERT_NE(SQLITE_OK, blob.reopen(3)); // no such row
+  ASSERT_FALSE(blob.isOpen());
+}
+/**
+ * read only streams, missing rows and rows changed behind the stream
+ */
+TEST(dbBlob, errors) {
+  gre90r::Sqlite sqlite(NULL);
+  createFilesTable(sqlite);
+  sqlite.execute("insert into files values ('a', x'0102')");
+
+  ASSERT_FALSE(sqlite.openBlob("files", "data", 42).isOpen());
+  ASSERT_FALSE(sqlite.openBlob("files", "missing", 1).isOpen());
+
+  gre90r::BlobStream blob = sqlite.openBlob("files", "data", 1);
+  ASSERT_EQ(SQLITE_READONLY, blob.write("x", 1));
+  ASSERT_EQ(SQLITE_RANGE, blob.seek(3));
+
+  sqlite.execute("update files set data = x'09' where rowid = 1");
+  char buffer[2];
+  ASSERT_EQ(-SQLITE_ABORT, blob.read(buffer, 2));
+}
+
+
+/**************************/
+/* Test Suite: csv import */
+/**************************/
+const char* CSV_TEST_FILENAME = "import.csv";
+/**
+ * write text to CSV_TEST_FILENAME
+ */
+static void writeCsvFile(const std::string& text) {
+  std::ofstream file(CSV_TEST_FILENAME, std::ios::binary);
+  file << text;
+}
+/**
+ * quoted fields with delimiters, line breaks and doubled quotes,
+ * line endings and a byte order mark
+ */
+TEST(dbCsvImport, reader) {
+  std::string text = "\xEF\xBB\xBF" "a,\"b,c\",\"say \"\"hi\"\"\"\r\n"
+                     "\"multi\nline\",,x\r\r\n"
+                     "last,";
+  gre90r::CsvReader reader(text.data(), text.size());
+  std::vector<std::string_view> fields;
+
+  ASSERT_TRUE(reader.next(fields));
+  ASSERT_EQ(3u, fields.size());
+  ASSERT_EQ("a", fields[0]);
+  ASSERT_EQ("b,c", fields[1]);
+  ASSERT_EQ("say \"hi\"", fields[2]);
+
+  ASSERT_TRUE(reader.next(fields));
+  ASSERT_EQ(3u, fields.size());
+  ASSERT_EQ("multi\nline", fields[0]);
+  ASSERT_EQ("", fields[1]);
+  ASSERT_EQ("x", fields[2]);
+
+  ASSERT_TRUE(reader.next(fields)); // empty line skipped
+  ASSERT_EQ(2u, fields.size());
+  ASSERT_EQ("last", fields[0]);
+  ASSERT_EQ("", fields[1]);
+  ASSERT_FALSE(reader.isMalformed());
+  ASSERT_FALSE(reader.next(fields));
+  ASSERT_EQ(text.size(), reader.getPosition());
+
+  std::string broken = "\"open,field";
+  gre90r::CsvReader brokenReader(broken.data(), broken.size());
+  ASSERT_TRUE(brokenReader.next(fields));
+  ASSERT_EQ("open,field", fields[0]);
+  ASSERT_TRUE(brokenReader.isMalformed());
+}
+/**
+ * a file with a header is imported into an existing table. values get
+ * the affinity of their column.
+ */
+TEST(dbCsvImport, file) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table people(name text, age integer, score real)");
+  // columns in another order than in the table
+  writeCsvFile("age,name,score\n42,\"Doe, John\",1.5\n7,Jane,\n");
+
+  gre90r::CsvImportOptions options;
+  options.emptyIsNull = true;
+  int progressCalls = 0;
+  options.progress = [&progressCalls](const gre90r::CsvImportProgress& progress) {
+    progressCalls++;
+    return progress.bytesRead <= progress.bytesTotal;
+  };
+  gre90r::CsvImportProgress result;
+  ASSERT_EQ(SQLITE_OK, sqlite.importCsv(CSV_TEST_FILENAME, "people", options, &result));
+  std::remove(CSV_TEST_FILENAME);
+
+  ASSERT_EQ(2u, result.rows);
+  ASSERT_EQ(0u, result.malformedRows);
+  ASSERT_EQ(result.bytesTotal, result.bytesRead);
+  ASSERT_EQ(1, progressCalls);
+  ASSERT_EQ(1u, sqlite.select("select * from people where name = 'Doe, John' and age = 42 and score = 1.5").size());
+  ASSERT_EQ(1u, sqlite.select("select * from people where name = 'Jane' and typeof(age) = 'integer' and score is null").size());
+}
+/**
+ * TSV without a header in many small batches. the table is created
+ * from the given columns.
+ */
+TEST(dbCsvImport, batches) {
+  gre90r::Sqlite sqlite(NULL);
+  std::string text;
+  for (int i = 0; i < 1000; i++) {
+    text += std::to_string(i) + "\tname " + std::to_string(i) + "\n";
+  }
+
+  gre90r::CsvImportOptions options;
+  options.delimiter = '\t';
+  options.header = false;
+  options.columns = { "id", "name" };
+  options.createTable = true;
+  options.batch.batchRows = 64;
+  options.progressBytes = 1024;
+  std::vector<std::size_t> positions;
+  options.progress = [&positions](const gre90r::CsvImportProgress& progress) {
+    positions.push_back(progress.bytesRead);
+    return true;
+  };
+  gre90r::CsvImporter importer(sqlite, "imported", options);
+  ASSERT_EQ(SQLITE_OK, importer.importText(text));
+
+  ASSERT_EQ(1000u, importer.getProgress().rows);
+  ASSERT_GT(positions.size(), 5u);
+  ASSERT_EQ(text.size(), positions.back());
+  gre90r::SqlResult result = sqlite.select("select count(*), sum(id) from imported where name = 'name ' || id");
+  ASSERT_STREQ("1000", result.getValue(0, 0));
+  ASSERT_STREQ("499500", result.getValue(0, 1));
+}
+/**
+ * missing files and tables, records with the wrong number of fields
+ * and an import stopped by the progress callback
+ */
+TEST(dbCsvImport, errors) {
+  gre90r::Sqlite sqlite(NULL);
+  ASSERT_EQ(SQLITE_CANTOPEN, sqlite.importCsv("missing.csv", "t"));
+  ASSERT_EQ(-2, sqlite.importCsv(NULL, "t"));
+
+  gre90r::CsvImporter noTable(sqlite, "t");
+  ASSERT_EQ(SQLITE_ERROR, noTable.importText("a,b\n1,2\n"));
+  ASSERT_EQ(-2, noTable.importFile(NULL));
+
+  sqlite.execute("create table t(a integer, b integer)");
+  gre90r::CsvImportOptions options;
+  options.header = false;
+  gre90r::CsvImporter aborted(sqlite, "t", options);
+  ASSERT_EQ(SQLITE_MISMATCH, aborted.importText("5,6\n1\n2,3\n"));
+  ASSERT_EQ(0u, aborted.getProgress().rows);
+  ASSERT_EQ(1u, aborted.getProgress().malformedRows);
+  ASSERT_EQ(0u, sqlite.select("select * from t").size());
+
+  options.onMalformed = gre90r::CsvMalformed::Skip;
+  gre90r::CsvImporter skipped(sqlite, "t", options);
+  ASSERT_EQ(SQLITE_OK, skipped.importText("1\n2,3,4\n5,6\n\"7,8\n"));
+  ASSERT_EQ(1u, skipped.getProgress().rows);
+  ASSERT_EQ(3u, skipped.getProgress().malformedRows);
+  ASSERT_EQ(1u, sqlite.select("select * from t").size());
+  ASSERT_EQ(1u, sqlite.select("select * from t where a = 5 and b = 6").size());
+
+  options.onMalformed = gre90r::CsvMalformed::Pad;
+  gre90r::CsvImporter padded(sqlite, "t", options);
+  ASSERT_EQ(SQLITE_OK, padded.importText("1\n2,3,4\n5,6\n"));
+  ASSERT_EQ(3u, padded.getProgress().rows);
+  ASSERT_EQ(2u, padded.getProgress().malformedRows);
+  ASSERT_EQ(1u, sqlite.select("select * from t where a = 1 and b is null").size());
+  ASSERT_EQ(1u, sqlite.select("select * from t where a = 2 and b = 3").size());
+
+  options.progressBytes = 1;
+  options.progress = [](const gre90r::CsvImportProgress&) {
+    return false;
+  };
+  gre90r::CsvImporter stopped(sqlite, "t", options);
+  ASSERT_EQ(SQLITE_ABORT, stopped.importText("7,8\n9,10\n"));
+  ASSERT_EQ(1u, stopped.getProgress().rows);
+  ASSERT_EQ(5u, sqlite.select("select * from t").size());
+}
+
+
+/********************************/
+/* Test Suite: columnar results */
+/********************************/
+const char* COLUMNAR_TEST_FILENAME = "result.col";
+/**
+ * create a table with numbers, text and NULLs
+ */
+static void createMeasurementTable(gre90r::Sqlite& sqlite) {
+  sqlite.execute("create table measurement(id integer, value real, city text, note text)");
+  sqlite.execute("insert into measurement values (1, 0.5, 'Berlin', null)");
+  sqlite.execute("insert into measurement values (2, null, 'Paris', null)");
+  sqlite.execute("insert into measurement values (3, 2.25, 'Berlin', null)");
+  sqlite.execute("insert into measurement values (4, 8.0, 'Berlin', 'late')");
+}
+/**
+ * numbers are stored as typed arrays, NULLs in the validity bitmap
+ */
+TEST(dbColumnar, types) {
+  gre90r::Sqlite sqlite(NULL);
+  createMeasurementTable(sqlite);
+  gre90r::ColumnarResult result;
+  ASSERT_EQ(SQLITE_OK, sqlite.selectColumnar("select id, value, null as empty from measurement where id <= ?",
+                                             result, 3));
+  ASSERT_EQ(3u, result.size());
+  ASSERT_EQ(3u, result.getColumnCount());
+
+  const gre90r::ColumnarColumn& id = result.getColumn(0);
+  ASSERT_EQ("id", id.getName());
+  ASSERT_EQ(gre90r::ColumnType::Integer, id.getType());
+  ASSERT_EQ(NULL, id.getValidity());
+  ASSERT_EQ(3, id.getIntegers()[2]);
+
+  const gre90r::ColumnarColumn& value = result.getColumn(result.getColumnIndex("value"));
+  ASSERT_EQ(gre90r::ColumnType::Real, value.getType());
+  ASSERT_EQ(1u, value.getNullCount());
+  ASSERT_EQ(0x05, value.getValidity()[0]); // rows 0 and 2
+  ASSERT_TRUE(value.isNull(1));
+  ASSERT_DOUBLE_EQ(2.25, value.getReals()[2]);
+
+  const gre90r::ColumnarColumn& empty = result.getColumn(2);
+  ASSERT_EQ(gre90r::ColumnType::Null, empty.getType());
+  ASSERT_EQ(3u, empty.getNullCount());
+  ASSERT_EQ(-1, result.getColumnIndex("missing"));
+}
+/**
+ * repeated strings are dictionary encoded, distinct ones are not
+ */
+TEST(dbColumnar, dictionary) {
+  gre90r::Sqlite sqlite(NULL);
+  createMeasurementTable(sqlite);
+  gre90r::ColumnarResult result;
+  ASSERT_EQ(SQLITE_OK, sqlite.selectColumnar("select city, note, id || 'x' from measurement", result));
+
+  const gre90r::ColumnarColumn& city = result.getColumn(0);
+  ASSERT_EQ(gre90r::ColumnType::Text, city.getType());
+  ASSERT_EQ(gre90r::ColumnEncoding::Dictionary, city.getEncoding());
+  ASSERT_EQ(2u, city.getDictionarySize());
+  ASSERT_EQ(0, city.getIndices()[0]);
+  ASSERT_EQ(1, city.getIndices()[1]);
+  ASSERT_EQ(0, city.getIndices()[3]);
+  ASSERT_EQ("Paris", city.getText(1));
+  ASSERT_EQ("late", result.getColumn(1).getText(3));
+  ASSERT_EQ("", result.getColumn(1).getText(0));
+
+  const gre90r::ColumnarColumn& distinct = result.getColumn(2);
+  ASSERT_EQ(gre90r::ColumnEncoding::Plain, distinct.getEncoding());
+  ASSERT_EQ(0u, distinct.getDictionarySize());
+  ASSERT_EQ(6, distinct.getOffsets()[3]);
+  ASSERT_EQ("4x", distinct.getText(3));
+
+  gre90r::ColumnarOptions options;
+  options.dictionary = false;
+  gre90r::ColumnarResult plain(options);
+  ASSERT_EQ(SQLITE_OK, sqlite.selectColumnar("select city from measurement", plain));
+  ASSERT_EQ(gre90r::ColumnEncoding::Plain, plain.getColumn(0).getEncoding());
+  ASSERT_EQ(NULL, plain.getColumn(0).getIndices());
+  ASSERT_EQ("Berlin", plain.getColumn(0).getText(3));
+}
+/**
+ * a column with values of different types is widened
+ */
+TEST(dbColumnar, mixedTypes) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table mixed(a, b, c)");
+  sqlite.execute("insert into mixed values (1, null, 'x')");
+  sqlite.execute("insert into mixed values (2.5, 7, x'00ff')");
+  sqlite.execute("insert into mixed values (null, 'seven', 3)");
+  gre90r::ColumnarResult result;
+  ASSERT_EQ(SQLITE_OK, sqlite.selectColumnar("select a, b, c from mixed order by rowid", result));
+
+  ASSERT_EQ(gre90r::ColumnType::Real, result.getColumn(0).getType());
+  ASSERT_DOUBLE_EQ(1.0, result.getColumn(0).getReal(0));
+  ASSERT_TRUE(result.getColumn(0).isNull(2));
+
+  const gre90r::ColumnarColumn& b = result.getColumn(1);
+  ASSERT_EQ(gre90r::ColumnType::Text, b.getType());
+  ASSERT_TRUE(b.isNull(0));
+  ASSERT_EQ("7", b.getText(1));
+  ASSERT_EQ("seven", b.getText(2));
+
+  const gre90r::ColumnarColumn& c = result.getColumn(2);
+  ASSERT_EQ(gre90r::ColumnType::Blob, c.getType());
+  ASSERT_EQ(std::string("\x00\xff", 2), c.getText(1));
+  ASSERT_EQ("3", c.getText(2));
+
+  ASSERT_NE(SQLITE_OK, sqlite.selectColumnar("select * from missing", result));
+  ASSERT_EQ(0u, result.size());
+}
+/**
+ * a written file is mapped with the same content, damaged files are rejected
+ */
+TEST(dbColumnar, file) {
+  gre90r::Sqlite sqlite(NULL);
+  createMeasurementTable(sqlite);
+  gre90r::ColumnarResult result;
+  ASSERT_EQ(SQLITE_OK, sqlite.selectColumnar("select id, value, city, note from measurement", result));
+  ASSERT_EQ(SQLITE_OK, result.writeFile(COLUMNAR_TEST_FILENAME));
+
+  {
+    gre90r::ColumnarFile file(COLUMNAR_TEST_FILENAME);
+    ASSERT_EQ(SQLITE_OK, file.getErrorCode());
+    ASSERT_EQ(4u, file.size());
+    ASSERT_EQ(4u, file.getColumnCount());
+    ASSERT_EQ(2, file.getColumnIndex("city"));
+    ASSERT_EQ(4, file.getColumn(0).getIntegers()[3]);
+    ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(file.getColumn(0).getIntegers()) % 8);
+    ASSERT_TRUE(file.getColumn(1).isNull(1));
+    ASSERT_DOUBLE_EQ(8.0, file.getColumn(1).getReal(3));
+    ASSERT_EQ(gre90r::ColumnEncoding::Dictionary, file.getColumn(2).getEncoding());
+    ASSERT_EQ("Paris", file.getColumn(2).getText(1));
+    ASSERT_EQ("late", file.getColumn(3).getText(3));
+    ASSERT_TRUE(file.getColumn(3).isNull(0));
+  }
+
+  // cut off the last byte
+  std::ostringstream content;
+  result.writeTo(content);
+  std::string truncated = content.str().substr(0, content.str().size() - 1);
+  std::ofstream(COLUMNAR_TEST_FILENAME, std::ios::binary) << truncated;
+  ASSERT_EQ(SQLITE_CORRUPT, gre90r::ColumnarFile(COLUMNAR_TEST_FILENAME).getErrorCode());
+  std::remove(COLUMNAR_TEST_FILENAME);
+  ASSERT_EQ(SQLITE_CANTOPEN, gre90r::ColumnarFile(COLUMNAR_TEST_FILENAME).getErrorCode());
+}
+
+
+/****************************/
+/* Test Suite: result cache */
+/****************************/
+/**
+ * create a table with two cities and enable the result cache
+ */
+static void createCityTable(gre90r::Sqlite& sqlite) {
+  sqlite.execute("create table city(name text, country text)");
+  sqlite.execute("insert into city values ('Berlin', 'DE'), ('Paris', 'FR')");
+  sqlite.setResultCache(true);
+}
+/**
+ * a repeated query is answered from the cache, keyed by its parameters
+ */
+TEST(dbResultCache, hit) {
+  gre90r::Sqlite sqlite(NULL);
+  createCityTable(sqlite);
+  gre90r::SqlResult first;
+  ASSERT_EQ(SQLITE_OK, sqlite.select("select name from city where country = ?", first, "DE"));
+  gre90r::SqlResult second;
+  ASSERT_EQ(SQLITE_OK, sqlite.select("select name from city where country = ?", second, "DE"));
+  ASSERT_EQ(1u, second.size());
+  ASSERT_STREQ("Berlin", second.getValue(0, "name"));
+  gre90r::SqlResult other;
+  ASSERT_EQ(SQLITE_OK, sqlite.select("select name from city where country = ?", other, "FR"));
+  ASSERT_STREQ("Paris", other.getValue(0, 0));
+  ASSERT_EQ(2u, sqlite.select("select * from city").size());
+  ASSERT_EQ(2u, sqlite.select("select * from city").size());
+
+  gre90r::ResultCacheStats stats = sqlite.getResultCacheStats();
+  ASSERT_EQ(2u, stats.hits);
+  ASSERT_EQ(3u, stats.misses);
+  ASSERT_EQ(3u, stats.entries);
+  ASSERT_GT(stats.bytes, 0u);
+  sqlite.setResultCache(false);
+  ASSERT_FALSE(sqlite.hasResultCache());
+  ASSERT_EQ(0u, sqlite.getResultCacheStats().entries);
+}
+/**
+ * changes of a table drop the results which read it, including views
+ */
+TEST(dbResultCache, invalidation) {
+  gre90r::Sqlite sqlite(NULL);
+  createCityTable(sqlite);
+  sqlite.execute("create table other(x)");
+  sqlite.execute("create view german as select name from city where country = 'DE'");
+  ASSERT_EQ(1u, sqlite.select("select * from german").size());
+  ASSERT_EQ(0u, sqlite.select("select * from other").size());
+
+  sqlite.execute("insert into city values ('Hamburg', 'DE')");
+  ASSERT_EQ(2u, sqlite.select("select * from german").size());
+  ASSERT_EQ(0u, sqlite.select("select * from other").size());
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().stale);
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().hits);
+
+  // without WHERE sqlite would empty the table without reporting the rows
+  sqlite.execute("delete from city");
+  ASSERT_EQ(0u, sqlite.select("select * from german").size());
+
+  ASSERT_EQ(0u, sqlite.select("select * from other").size());
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("drop table other"));
+  gre90r::SqlResult result;
+  ASSERT_NE(SQLITE_OK, sqlite.select("select * from other", result));
+}
+/**
+ * queries whose result can change without a table changing are not cached
+ */
+TEST(dbResultCache, notCached) {
+  gre90r::Sqlite sqlite(NULL);
+  createCityTable(sqlite);
+  sqlite.select("select random()");
+  sqlite.select("select name, datetime('now') from city");
+  sqlite.select("select 1; select 2");
+  ASSERT_EQ(0u, sqlite.getResultCacheStats().entries);
+
+  // changed in the open transaction, a rollback would undo it
+  sqlite.execute("begin");
+  sqlite.execute("insert into city values ('Rome', 'IT')");
+  ASSERT_EQ(3u, sqlite.select("select * from city").size());
+  ASSERT_EQ(0u, sqlite.getResultCacheStats().entries);
+  sqlite.execute("rollback");
+  ASSERT_EQ(2u, sqlite.select("select * from city").size());
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().entries);
+}
+/**
+ * commits of other connections drop the cache, limits evict old results
+ */
+TEST(dbResultCache, externalChangesAndEviction) {
+  deleteFile(TEST_DB_FILENAMENAME);
+  {
+    gre90r::Sqlite sqlite(TEST_DB_FILENAMENAME);
+    createCityTable(sqlite);
+    ASSERT_EQ(2u, sqlite.select("select * from city").size());
+    gre90r::Sqlite other(TEST_DB_FILENAMENAME);
+    ASSERT_EQ(SQLITE_OK, other.execute("insert into city values ('Rome', 'IT')"));
+    ASSERT_EQ(3u, sqlite.select("select * from city").size());
+    ASSERT_EQ(0u, sqlite.getResultCacheStats().hits);
+  }
+  deleteFile(TEST_DB_FILENAMENAME);
+
+  gre90r::Sqlite sqlite(NULL);
+  createCityTable(sqlite);
+  gre90r::ResultCacheOptions options;
+  options.maxEntries = 2;
+  sqlite.setResultCache(true, options);
+  gre90r::SqlResult result;
+  for (int limit = 0; limit < 3; limit++) {
+    result.clear();
+    sqlite.select("select name from city limit ?", result, limit);
+  }
+  ASSERT_EQ(2u, sqlite.getResultCacheStats().entries);
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().evictions);
+
+  options.maxBytes = 64;
+  sqlite.setResultCache(true, options);
+  sqlite.select("select * from city");
+  ASSERT_EQ(0u, sqlite.getResultCacheStats().entries);
+}
+
+
+/*****************************/
+/* Test Suite: online backup */
+/*****************************/
+const char* BACKUP_TEST_DB_FILENAME = "backup.db";
+/**
+ * fill a table with about 100 pages
+ */
+static void createPayloadTable(gre90r::Sqlite& sqlite) {
+  sqlite.execute("create table payload(id integer primary key, data blob)");
+  sqlite.execute("with recursive n(i) as (select 1 union all select i + 1 from n where i < 100) "
+                 "insert into payload select i, zeroblob(4000) from n");
+}
+/**
+ * an in-memory database is copied to a file in several steps
+ */
+TEST(dbBackup, memoryToFile) {
+  deleteFile(BACKUP_TEST_DB_FILENAME);
+  gre90r::Sqlite sqlite(NULL);
+  createPayloadTable(sqlite);
+  gre90r::BackupOptions options;
+  options.pagesPerStep = 10;
+  options.stepDelay = std::chrono::milliseconds(0);
+  std::vector<double> fractions;
+  options.progress = [&fractions](const gre90r::BackupProgress& progress) {
+    fractions.push_back(progress.getFraction());
+    return true;
+  };
+  gre90r::BackupProgress progress;
+  ASSERT_EQ(SQLITE_OK, sqlite.backup(BACKUP_TEST_DB_FILENAME, options, &progress));
+  ASSERT_GT(progress.steps, 10u);
+  ASSERT_EQ(0, progress.remainingPages);
+  ASSERT_EQ(0u, progress.restarts);
+  ASSERT_EQ(progress.steps, fractions.size());
+  ASSERT_LT(fractions.front(), fractions.back());
+  ASSERT_DOUBLE_EQ(1.0, fractions.back());
+
+  gre90r::Sqlite copy(BACKUP_TEST_DB_FILENAME);
+  ASSERT_STREQ("100", copy.select("select count(*) from payload").getValue(0, 0));
+  copy.close();
+  deleteFile(BACKUP_TEST_DB_FILENAME);
+}
+/**
+ * a file is loaded into memory and copied between two connections
+ */
+TEST(dbBackup, restoreAndConnection) {
+  deleteFile(BACKUP_TEST_DB_FILENAME);
+  {
+    gre90r::Sqlite file(BACKUP_TEST_DB_FILENAME);
+    createPayloadTable(file);
+  }
+  gre90r::Sqlite memory(NULL);
+  memory.execute("create table old(x)");
+  ASSERT_EQ(SQLITE_OK, memory.restore(BACKUP_TEST_DB_FILENAME));
+  ASSERT_STREQ("100", memory.select("select count(*) from payload").getValue(0, 0));
+  ASSERT_NE(SQLITE_OK, memory.execute("select * from old"));
+
+  gre90r::Sqlite other(NULL);
+  other.setResultCache(true);
+  ASSERT_EQ(0u, other.select("select name from sqlite_master").size());
+  ASSERT_EQ(SQLITE_OK, memory.backup(other));
+  ASSERT_EQ(1u, other.select("select name from sqlite_master").size());
+  deleteFile(BACKUP_TEST_DB_FILENAME);
+}
+/**
+ * a write of another connection restarts the copy, a write of the
+ * source connection does not. the progress callback can stop it.
+ */
+TEST(dbBackup, restartAndAbort) {
+  deleteFile(BACKUP_TEST_DB_FILENAME);
+  gre90r::Sqlite source(BACKUP_TEST_DB_FILENAME);
+  createPayloadTable(source);
+  gre90r::Sqlite writer(BACKUP_TEST_DB_FILENAME);
+  gre90r::Sqlite copy(NULL);
+
+  gre90r::BackupOptions options;
+  options.pagesPerStep = 10;
+  gre90r::Backup backup(copy.getHandle(), source.getHandle(), options);
+  ASSERT_EQ(SQLITE_OK, backup.getErrorCode());
+  ASSERT_EQ(SQLITE_OK, backup.step());
+  ASSERT_EQ(SQLITE_OK, backup.step());
+  ASSERT_EQ(SQLITE_OK, source.execute("update payload set data = zeroblob(10) where id = 1"));
+  ASSERT_EQ(SQLITE_OK, backup.step());
+  ASSERT_EQ(0u, backup.getProgress().restarts);
+  ASSERT_EQ(SQLITE_OK, writer.execute("update payload set data = zeroblob(20) where id = 2"));
+  int rc;
+  while ((rc = backup.step()) == SQLITE_OK) {
+  }
+  ASSERT_EQ(SQLITE_DONE, rc);
+  ASSERT_TRUE(backup.isFinished());
+  ASSERT_EQ(1u, backup.getProgress().restarts);
+  ASSERT_STREQ("10", copy.select("select length(data) from payload where id = 1").getValue(0, 0));
+  ASSERT_STREQ("20", copy.select("select length(data) from payload where id = 2").getValue(0, 0));
+
+  options.progress = [](const gre90r::BackupProgress& progress) {
+    return progress.steps < 2;
+  };
+  gre90r::BackupProgress progress;
+  ASSERT_EQ(SQLITE_ABORT, source.backup(copy, options, &progress));
+  ASSERT_EQ(2u, progress.steps);
+  deleteFile(BACKUP_TEST_DB_FILENAME);
+}
+/**
+ * errors are reported without copying anything
+ */
+TEST(dbBackup, errors) {
+  gre90r::Sqlite sqlite(NULL);
+  ASSERT_EQ(-2, sqlite.backup(static_cast<const char*>(NULL)));
+  ASSERT_EQ(-2, sqlite.restore(NULL));
+  ASSERT_EQ(SQLITE_CANTOPEN, sqlite.restore("missing/backup.db"));
+  ASSERT_EQ(SQLITE_CANTOPEN, sqlite.backup("missing/backup.db"));
+
+  sqlite.execute("begin; create table t(x);");
+  gre90r::Sqlite other(NULL);
+  ASSERT_NE(SQLITE_OK, other.backup(sqlite));
+  sqlite.execute("rollback");
+  sqlite.close();
+  ASSERT_EQ(-3, sqlite.backup(BACKUP_TEST_DB_FILENAME));
+}
+
+
+/*************************/
+/* Test Suite: snapshots */
+/*************************/
+const char* SNAPSHOT_TEST_FILENAME = "snapshot.db";
+/**
+ * an in-memory database is saved and loaded into another one as a copy
+ */
+TEST(dbSnapshot, saveAndLoad) {
+  gre90r::Sqlite sqlite(NULL);
+  createPayloadTable(sqlite);
+  ASSERT_EQ(SQLITE_OK, sqlite.saveSnapshot(SNAPSHOT_TEST_FILENAME));
+  ASSERT_FALSE(fileExists((std::string(SNAPSHOT_TEST_FILENAME) + ".tmp").c_str()));
+
+  gre90r::Sqlite replica(NULL);
+  replica.execute("create table old(x)");
+  ASSERT_EQ(SQLITE_OK, replica.loadSnapshot(SNAPSHOT_TEST_FILENAME));
+  ASSERT_STREQ("100", replica.select("select count(*) from payload").getValue(0, 0));
+  ASSERT_NE(SQLITE_OK, replica.execute("select * from old"));
+  ASSERT_EQ(SQLITE_OK, replica.execute("insert into payload(data) values (zeroblob(8000))"));
+  ASSERT_STREQ("101", replica.select("select count(*) from payload").getValue(0, 0));
+  deleteFile(SNAPSHOT_TEST_FILENAME);
+}
+/**
+ * a mapped snapshot is read only, another snapshot replaces it
+ */
+TEST(dbSnapshot, mapped) {
+  deleteFile(TEST_DB_FILENAMENAME);
+  {
+    gre90r::OpenOptions options;
+    options.journalMode = gre90r::JournalMode::Wal;
+    gre90r::Sqlite file(TEST_DB_FILENAMENAME, options);
+    createPayloadTable(file);
+    ASSERT_EQ(SQLITE_OK, file.saveSnapshot(SNAPSHOT_TEST_FILENAME));
+  }
+  gre90r::SnapshotOptions options;
+  options.mapped = true;
+  gre90r::Sqlite replica(NULL);
+  ASSERT_EQ(SQLITE_OK, replica.loadSnapshot(SNAPSHOT_TEST_FILENAME, options));
+  ASSERT_STREQ("400000", replica.select("select sum(length(data)) from payload").getValue(0, 0));
+  ASSERT_EQ(SQLITE_READONLY, replica.execute("delete from payload where id = 1"));
+
+  ASSERT_EQ(SQLITE_OK, replica.loadSnapshot(SNAPSHOT_TEST_FILENAME));
+  ASSERT_EQ(SQLITE_OK, replica.execute("delete from payload where id = 1"));
+  ASSERT_STREQ("99", replica.select("select count(*) from payload").getValue(0, 0));
+
+  // a statement which outlives the connection still reads the mapping
+  std::shared_ptr<gre90r::Statement> count;
+  {
+    gre90r::Sqlite mapped(NULL);
+    ASSERT_EQ(SQLITE_OK, mapped.loadSnapshot(SNAPSHOT_TEST_FILENAME, options));
+    count = mapped.prepare("select count(*) from payload");
+  }
+  ASSERT_EQ(SQLITE_ROW, count->step());
+  ASSERT_STREQ("100", count->getColumnText(0));
+  count.reset();
+  deleteFile(SNAPSHOT_TEST_FILENAME);
+  deleteFile(TEST_DB_FILENAMENAME);
+}
+/**
+ * serialize() and deserialize() copy the database through memory
+ */
+TEST(dbSnapshot, serialize) {
+  gre90r::Sqlite sqlite(NULL);
+  std::string empty;
+  ASSERT_EQ(SQLITE_OK, sqlite.serialize(empty));
+  createPayloadTable(sqlite);
+  std::string data;
+  ASSERT_EQ(SQLITE_OK, sqlite.serialize(data));
+  ASSERT_GT(data.size(), 400000u);
+  ASSERT_EQ(0, data.compare(0, 15, "SQLite format 3"));
+
+  gre90r::Sqlite copy(NULL);
+  ASSERT_EQ(SQLITE_OK, copy.deserialize(data, true));
+  ASSERT_STREQ("100", copy.select("select count(*) from payload").getValue(0, 0));
+  ASSERT_EQ(SQLITE_READONLY, copy.execute("delete from payload"));
+  ASSERT_EQ(SQLITE_OK, copy.deserialize(empty));
+  ASSERT_EQ(SQLITE_OK, copy.execute("create table t(x)"));
+}
+/**
+ * errors are reported, the database is kept
+ */
+TEST(dbSnapshot, errors) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table t(x)");
+  ASSERT_EQ(-2, sqlite.saveSnapshot(NULL));
+  ASSERT_EQ(-2, sqlite.loadSnapshot(NULL));
+  ASSERT_EQ(SQLITE_CANTOPEN, sqlite.loadSnapshot("missing.db"));
+  ASSERT_EQ(SQLITE_CANTOPEN, sqlite.saveSnapshot("missing/snapshot.db"));
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("select * from t"));
+
+  ASSERT_EQ(SQLITE_OK, sqlite.deserialize("not a database"));
+  ASSERT_EQ(SQLITE_NOTADB, sqlite.execute("select * from sqlite_master"));
+  sqlite.close();
+  std::string data;
+  ASSERT_EQ(-3, sqlite.serialize(data));
+  ASSERT_EQ(-3, sqlite.deserialize(data));
+}
+
+
+/*********************************************/
+/* Test Suite: application-defined functions */
+/*********************************************/
+/**
+ * plain function used as sql function
+ */
+static std::string repeatText(std::string_view text, int count) {
+  std::string result;
+  for (int i = 0; i < count; i++) {
+    result += text;
+  }
+  return result;
+}
+/**
+ * sum of the squares of the values of a group
+ */
+struct SumOfSquares {
+  double sum = 0;
+  void step(double value) {
+    sum += value * value;
+  }
+  double finalize() const {
+    return sum;
+  }
+};
+/**
+ * concatenation of the texts of a group or window frame
+ */
+struct Joined {
+  std::string separator;
+  std::deque<std::string> parts;
+  void step(std::optional<std::string> text) {
+    parts.push_back(text.value_or("?"));
+  }
+  void inverse(std::optional<std::string>) {
+    parts.pop_front();
+  }
+  std::string value() const {
+    std::string result;
+    for (const std::string& part : parts) {
+      result += (result.empty() ? "" : separator) + part;
+    }
+    return result;
+  }
+  std::optional<std::string> finalize() const {
+    if (parts.empty()) {
+      return std::nullopt;
+    }
+    return value();
+  }
+};
+/**
+ * lambdas and function pointers are called with typed arguments
+ */
+TEST(dbFunction, scalar) {
+  gre90r::Sqlite sqlite(NULL);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerFunction("add_one", [](long long x) { return x + 1; },
+                                               gre90r::FunctionOptions{ true, false }));
+  ASSERT_EQ(SQLITE_OK, sqlite.registerFunction("repeat", repeatText));
+  ASSERT_EQ(SQLITE_OK, sqlite.registerFunction("is_null", [](std::optional<double> x) { return !x; }));
+  ASSERT_EQ(SQLITE_OK, sqlite.registerFunction("blob_size", [](gre90r::BlobView blob) { return blob.size; }));
+  ASSERT_EQ(SQLITE_OK, sqlite.registerFunction("no_result", []() {}));
+
+  gre90r::SqlResult result = sqlite.select("select add_one(41), repeat('ab', 3), is_null(null), is_null(1.5), "
+                                           "blob_size(x'0102'), no_result(), typeof(add_one(1))");
+  ASSERT_STREQ("42", result.getValue(0, 0));
+  ASSERT_STREQ("ababab", result.getValue(0, 1));
+  ASSERT_STREQ("1", result.getValue(0, 2));
+  ASSERT_STREQ("0", result.getValue(0, 3));
+  ASSERT_STREQ("2", result.getValue(0, 4));
+  ASSERT_TRUE(result.isNull(0, 5));
+  ASSERT_STREQ("integer", result.getValue(0, 6));
+
+  // the number of arguments is part of the function
+  ASSERT_NE(SQLITE_OK, sqlite.execute("select add_one(1, 2)"));
+  // deterministic functions can be used in indexes
+  sqlite.execute("create table t(x)");
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("create index t_x on t(add_one(x))"));
+  ASSERT_NE(SQLITE_OK, sqlite.execute("create index t_r on t(repeat(x, 2))"));
+}
+/**
+ * unsigned arguments and results above INT_MAX keep their value
+ */
+TEST(dbFunction, unsignedValues) {
+  gre90r::Sqlite sqlite(NULL);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerFunction("next_u32", [](uint32_t x) { return x + 1u; }));
+  gre90r::SqlResult result = sqlite.select("select next_u32(2999999999), next_u32(4294967294)");
+  ASSERT_STREQ("3000000000", result.getValue(0, 0));
+  ASSERT_STREQ("4294967295", result.getValue(0, 1));
+}
+/**
+ * an exception becomes the sql error of the statement
+ */
+TEST(dbFunction, exception) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.registerFunction("checked_sqrt", [](double x) {
+    if (x < 0) {
+      throw std::domain_error("negative argument");
+    }
+    return std::sqrt(x);
+  });
+  ASSERT_STREQ("3.0", sqlite.select("select checked_sqrt(9)").getValue(0, 0));
+  ASSERT_EQ(SQLITE_ERROR, sqlite.execute("select checked_sqrt(-1)"));
+  ASSERT_STREQ("negative argument", sqlite3_errmsg(sqlite.getHandle()));
+  ASSERT_EQ(-2, sqlite.registerFunction(NULL, []() { return 1; }));
+  sqlite.close();
+  ASSERT_EQ(-3, sqlite.registerFunction("f", []() { return 1; }));
+}
+/**
+ * aggregates work on one copy of the prototype per group, window
+ * functions also remove rows from the frame
+ */
+TEST(dbFunction, aggregateAndWindow) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table v(g text, x real)");
+  sqlite.execute("insert into v values ('a', 1), ('a', 2), ('b', 3), ('b', null)");
+  ASSERT_EQ(SQLITE_OK, sqlite.registerAggregate<SumOfSquares>("sum_sq"));
+  gre90r::SqlResult groups = sqlite.select("select g, sum_sq(x) from v group by g order by g");
+  ASSERT_STREQ("5.0", groups.getValue(0, 1));
+  ASSERT_STREQ("9.0", groups.getValue(1, 1));
+  ASSERT_STREQ("0.0", sqlite.select("select sum_sq(x) from v where 0").getValue(0, 0));
+  ASSERT_NE(SQLITE_OK, sqlite.execute("select sum_sq(x) over () from v"));
+
+  Joined prototype;
+  prototype.separator = "+";
+  ASSERT_EQ(SQLITE_OK, sqlite.registerAggregate("joined", prototype));
+  ASSERT_STREQ("1.0+2.0+3.0+?", sqlite.select("select joined(x) from v").getValue(0, 0));
+  ASSERT_TRUE(sqlite.select("select joined(x) from v where 0").isNull(0, 0));
+  gre90r::SqlResult window = sqlite.select("select joined(x) over (order by rowid rows between 1 preceding "
+                                           "and current row) from v");
+  ASSERT_EQ(4u, window.size());
+  ASSERT_STREQ("1.0", window.getValue(0, 0));
+  ASSERT_STREQ("1.0+2.0", window.getValue(1, 0));
+  ASSERT_STREQ("3.0+?", window.getValue(3, 0));
+}
+/**
+ * queries calling functions which are not deterministic are not cached
+ */
+TEST(dbFunction, resultCache) {
+  gre90r::Sqlite sqlite(NULL);
+  int calls = 0;
+  sqlite.registerFunction("counter", [&calls]() { return ++calls; });
+  sqlite.registerFunction("twice", [](int x) { return 2 * x; }, gre90r::FunctionOptions{ true, false });
+  sqlite.setResultCache(true);
+  ASSERT_STREQ("1", sqlite.select("select counter()").getValue(0, 0));
+  ASSERT_STREQ("2", sqlite.select("select COUNTER()").getValue(0, 0));
+  ASSERT_STREQ("4", sqlite.select("select twice(2)").getValue(0, 0));
+  ASSERT_STREQ("4", sqlite.select("select twice(2)").getValue(0, 0));
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().entries);
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().hits);
+}
+
+/**
+ * element of the containers exposed as virtual tables
+ */
+struct Sensor {
+  std::string name;
+  double value = 0;
+  std::optional<long long> group = std::nullopt;
+  std::string getUnit() const {
+    return "mV";
+  }
+};
+/**
+ * @return the query plan of query, one detail per line
+ */
+static std::string queryPlan(gre90r::Sqlite& sqlite, const std::string& query) {
+  std::string plan;
+  gre90r::SqlResult result = sqlite.select(("explain query plan " + query).c_str());
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    plan += std::string(result.getValue(i, 3)) + "\n";
+  }
+  return plan;
+}
+/**
+ * elements of a vector are read in place, the rowid is their position
+ */
+TEST(dbVirtualTable, sequence) {
+  gre90r::Sqlite sqlite(NULL);
+  std::vector<Sensor> sensors = { { "a", 1.5, 1 }, { "b", 2.5, std::nullopt }, { "c", 3.5, 1 }, { "d", 4.5, 2 } };
+  gre90r::TableColumns<Sensor> columns;
+  columns.add("name", &Sensor::name).add("value", &Sensor::value).add("grp", &Sensor::group)
+         .add("unit", &Sensor::getUnit).add("twice", [](const Sensor& s) { return 2 * s.value; });
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("sensor", sensors, columns));
+
+  gre90r::SqlResult all = sqlite.select("select rowid, name, value, grp, unit, twice from sensor");
+  ASSERT_EQ(4u, all.size());
+  ASSERT_STREQ("0", all.getValue(0, 0));
+  ASSERT_STREQ("a", all.getValue(0, 1));
+  ASSERT_STREQ("1.5", all.getValue(0, 2));
+  ASSERT_TRUE(all.isNull(1, 3));
+  ASSERT_STREQ("mV", all.getValue(2, 4));
+  ASSERT_STREQ("9.0", all.getValue(3, 5));
+
+  // constraints on the rowid limit the scan to a range of positions
+  ASSERT_STREQ("c", sqlite.select("select name from sensor where rowid = 2").getValue(0, 0));
+  ASSERT_EQ(0u, sqlite.select("select name from sensor where rowid = 7").size());
+  ASSERT_EQ(0u, sqlite.select("select name from sensor where rowid = null").size());
+  gre90r::SqlResult range = sqlite.select("select name from sensor where rowid > 0.5 and rowid <= 2 order by rowid");
+  ASSERT_EQ(2u, range.size());
+  ASSERT_STREQ("b", range.getValue(0, 0));
+  ASSERT_STREQ("c", range.getValue(1, 0));
+  ASSERT_NE(std::string::npos, queryPlan(sqlite, "select name from sensor where rowid = 2").find("INDEX 1:"));
+  ASSERT_EQ(std::string::npos, queryPlan(sqlite, "select name from sensor order by rowid").find("ORDER BY"));
+
+  // joined with a table of the database, the container is not copied
+  sqlite.execute("create table sensor_group(id integer primary key, label text)");
+  sqlite.execute("insert into sensor_group values (1, 'left'), (2, 'right')");
+  gre90r::SqlResult joined = sqlite.select("select g.label, sum(s.value) from sensor s join sensor_group g "
+                                           "on g.id = s.grp group by g.label order by g.label");
+  ASSERT_EQ(2u, joined.size());
+  ASSERT_STREQ("5.0", joined.getValue(0, 1));
+  ASSERT_STREQ("4.5", joined.getValue(1, 1));
+
+  // read only
+  ASSERT_NE(SQLITE_OK, sqlite.execute("update sensor set value = 0"));
+  ASSERT_EQ(1.5, sensors[0].value);
+  // the container is read on each query
+  sensors[0].name = "z";
+  ASSERT_STREQ("z", sqlite.select("select name from sensor where rowid = 0").getValue(0, 0));
+}
+/**
+ * maps have a key column, std::map also serves ranges and ORDER BY of the key
+ */
+TEST(dbVirtualTable, map) {
+  gre90r::Sqlite sqlite(NULL);
+  std::map<std::string, Sensor> byName = { { "b", { "b", 2 } }, { "a", { "a", 1 } }, { "c", { "c", 3 } } };
+  gre90r::TableColumns<Sensor> columns("name");
+  columns.add("value", &Sensor::value);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("by_name", byName, columns));
+
+  gre90r::SqlResult all = sqlite.select("select name, value from by_name order by name");
+  ASSERT_EQ(3u, all.size());
+  ASSERT_STREQ("a", all.getValue(0, 0));
+  ASSERT_STREQ("c", all.getValue(2, 0));
+  ASSERT_EQ(std::string::npos, queryPlan(sqlite, "select name from by_name order by name").find("ORDER BY"));
+  ASSERT_STREQ("2.0", sqlite.select("select value from by_name where name = 'b'").getValue(0, 0));
+  ASSERT_EQ(2u, sqlite.select("select value from by_name where name >= 'b' and name < 'd'").size());
+  ASSERT_EQ(0u, sqlite.select("select value from by_name where name > 'c'").size());
+  // other collations and types are checked by sqlite
+  ASSERT_EQ(1u, sqlite.select("select value from by_name where name = 'B' collate nocase").size());
+  ASSERT_EQ(3u, sqlite.select("select value from by_name where name > 1").size());
+
+  std::unordered_map<int, Sensor> byId = { { 10, { "x", 1 } }, { 20, { "y", 2 } } };
+  gre90r::TableColumns<Sensor> idColumns("id");
+  idColumns.add("name", &Sensor::name);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("by_id", byId, idColumns));
+  ASSERT_STREQ("y", sqlite.select("select name from by_id where id = 20").getValue(0, 0));
+  ASSERT_STREQ("y", sqlite.select("select name from by_id where id = 20.0").getValue(0, 0));
+  ASSERT_EQ(0u, sqlite.select("select name from by_id where id = 20.5").size());
+  ASSERT_EQ(1u, sqlite.select("select name from by_id where id > 15").size());
+  ASSERT_NE(std::string::npos, queryPlan(sqlite, "select name from by_id where id = 20").find("INDEX 1:"));
+}
+/**
+ * writable tables change the container
+ */
+TEST(dbVirtualTable, writable) {
+  gre90r::Sqlite sqlite(NULL);
+  std::vector<Sensor> sensors = { { "a", 1 } };
+  gre90r::TableColumns<Sensor> columns;
+  columns.add("name", &Sensor::name).add("value", &Sensor::value).add("grp", &Sensor::group)
+         .add("unit", &Sensor::getUnit);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("sensor", sensors, columns, gre90r::VirtualTableOptions{ true }));
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("insert into sensor(name, value) values ('b', 2), ('c', 3)"));
+  ASSERT_EQ(3u, sensors.size());
+  ASSERT_EQ(2, sqlite.getLastInsertRowId());
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("update sensor set value = value * 10, grp = 7 where rowid >= 1"));
+  ASSERT_EQ(1.0, sensors[0].value);
+  ASSERT_EQ(30.0, sensors[2].value);
+  ASSERT_EQ(7, sensors[1].group.value());
+  // swapped text values are read before they are written
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("update sensor set name = (select name from sensor where rowid = 1) "
+                                      "where rowid = 0"));
+  ASSERT_EQ("b", sensors[0].name);
+  ASSERT_EQ(SQLITE_CONSTRAINT, sqlite.execute("update sensor set unit = 'V'"));
+  ASSERT_EQ(SQLITE_CONSTRAINT, sqlite.execute("update sensor set value = null"));
+  ASSERT_EQ(SQLITE_CONSTRAINT, sqlite.execute("delete from sensor"));
+  ASSERT_EQ(3u, sensors.size());
+
+  std::map<long long, Sensor> byId;
+  gre90r::TableColumns<Sensor> idColumns("id");
+  idColumns.add("name", &Sensor::name);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("by_id", byId, idColumns, gre90r::VirtualTableOptions{ true }));
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("insert into by_id select rowid + 1, name from sensor"));
+  ASSERT_EQ(3u, byId.size());
+  ASSERT_EQ("c", byId[3].name);
+  ASSERT_EQ(SQLITE_CONSTRAINT, sqlite.execute("insert into by_id values (1, 'x')"));
+  ASSERT_EQ(SQLITE_CONSTRAINT, sqlite.execute("insert into by_id values (null, 'x')"));
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("update by_id set id = 10, name = 'moved' where id = 2"));
+  ASSERT_EQ(0u, byId.count(2));
+  ASSERT_EQ("moved", byId[10].name);
+  ASSERT_EQ(SQLITE_OK, sqlite.execute("delete from by_id where id < 5"));
+  ASSERT_EQ(1u, byId.size());
+
+  // const containers are never written
+  const std::vector<Sensor>& constant = sensors;
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("constant", constant, columns, gre90r::VirtualTableOptions{ true }));
+  ASSERT_NE(SQLITE_OK, sqlite.execute("update constant set value = 0"));
+  ASSERT_EQ(30.0, sensors[2].value);
+}
+/**
+ * tables can be replaced and dropped
+ */
+TEST(dbVirtualTable, registerAndDrop) {
+  gre90r::Sqlite sqlite(NULL);
+  std::vector<Sensor> first = { { "a", 1 } };
+  std::vector<Sensor> second = { { "b", 2 }, { "c", 3 } };
+  gre90r::TableColumns<Sensor> columns;
+  columns.add("name", &Sensor::name);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("sensor", first, columns));
+  ASSERT_EQ(1u, sqlite.select("select name from sensor").size());
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("sensor", second, columns));
+  ASSERT_EQ(2u, sqlite.select("select name from sensor").size());
+  ASSERT_EQ(SQLITE_OK, sqlite.dropTable("sensor"));
+  ASSERT_NE(SQLITE_OK, sqlite.execute("select name from sensor"));
+
+  // virtual tables are not cached
+  sqlite.setResultCache(true);
+  ASSERT_EQ(SQLITE_OK, sqlite.registerTable("sensor", second, columns));
+  ASSERT_EQ(2u, sqlite.select("select name from sensor").size());
+  second.push_back({ "d", 4 });
+  ASSERT_EQ(3u, sqlite.select("select name from sensor").size());
+
+  ASSERT_EQ(-2, sqlite.registerTable(NULL, first, columns));
+  ASSERT_EQ(-2, sqlite.dropTable(NULL));
+  sqlite.close();
+  ASSERT_EQ(-3, sqlite.registerTable("sensor", first, columns));
+  ASSERT_EQ(-3, sqlite.dropTable("sensor"));
+}
+
+/**
+ * parameters are counted at compile time, quoted text and comments skipped
+ */
+static_assert(gre90r::countParameters("select ?, ?, '?', \"?\" -- ?\n /* ? */") == 2, "");
+static_assert(gre90r::countParameters("select ?3, ?, :name, @x_1, $y") == 7, "");
+static_assert(EmployeeStatements::indexOf<SelectEmployees>() == 2, "");
+// arguments of another type than the declared one do not compile, not even narrowing ones
+static_assert(gre90r::IsParameterArgument<int, int>::value, "");
+static_assert(gre90r::IsParameterArgument<char[10], std::string_view>::value, "");
+static_assert(gre90r::IsParameterArgument<std::string, std::string_view>::value, "");
+static_assert(gre90r::IsParameterArgument<std::string_view, std::string>::value, "");
+static_assert(gre90r::IsParameterArgument<std::nullopt_t, std::optional<long long> >::value, "");
+static_assert(gre90r::IsParameterArgument<long long, std::optional<long long> >::value, "");
+static_assert(!gre90r::IsParameterArgument<double, int>::value, "");
+static_assert(!gre90r::IsParameterArgument<long long, int>::value, "");
+static_assert(!gre90r::IsParameterArgument<int, long long>::value, "");
+static_assert(!gre90r::IsParameterArgument<const char*, int>::value, "");
+static_assert(!gre90r::IsParameterArgument<int, std::string_view>::value, "");
+static_assert(std::is_same<std::string, decltype(std::declval<gre90r::TypedRow<int, std::string> >().get<1>())>::value, "");
+/**
+ * declared statements are compiled once and called by slot
+ */
+TEST(dbStatementRegistry, executeAndQuery) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute(QUERY_CREATE_TABLE_EMPLOYEE);
+  std::size_t cached = sqlite.getStatementCache().size();
+  gre90r::PreparedStatements<EmployeeStatements> statements(sqlite);
+  ASSERT_TRUE(statements.isValid());
+  ASSERT_EQ(SQLITE_OK, statements.execute<InsertEmployee>(2, EMPLOYEE_JEFF));
+  ASSERT_EQ(SQLITE_OK, statements.get<InsertEmployee>().execute(1, EMPLOYEE_JOHN));
+  ASSERT_EQ(SQLITE_CONSTRAINT, statements.execute<InsertEmployee>(1, "duplicate"));
+  // the statement cache of the connection is not used
+  ASSERT_EQ(cached, sqlite.getStatementCache().size());
+
+  int rows = 0;
+  for (const auto& row : statements.query<SelectEmployeeName>(2)) {
+    std::string name = row.get<0>();
+    ASSERT_EQ(EMPLOYEE_JEFF, name);
+    ++rows;
+  }
+  ASSERT_EQ(1, rows);
+
+  std::vector<std::tuple<int, std::optional<std::string> > > employees;
+  ASSERT_EQ(SQLITE_OK, statements.get<SelectEmployees>().select(employees));
+  ASSERT_EQ(2u, employees.size());
+  ASSERT_EQ(1, std::get<0>(employees[0]));
+  ASSERT_EQ(EMPLOYEE_JEFF, std::get<1>(employees[1]).value());
+
+  // the statements are reused
+  ASSERT_EQ(SQLITE_OK, statements.get<SelectEmployees>().select(employees));
+  ASSERT_EQ(4u, employees.size());
+}
+/**
+ * statements which do not compile or do not match their declaration are reported
+ */
+struct SelectTwoColumns : gre90r::SqlStatement<gre90r::Params<>, gre90r::Columns<int> > {
+  static constexpr const char* sql = "select 1, 2";
+};
+struct SelectMissingTable : gre90r::SqlStatement<gre90r::Params<>, gre90r::Columns<int> > {
+  static constexpr const char* sql = "select id from no_such_table";
+};
+TEST(dbStatementRegistry, errors) {
+  gre90r::Sqlite sqlite(NULL);
+  gre90r::PreparedStatements<gre90r::StatementRegistry<SelectTwoColumns, SelectMissingTable> > statements(sqlite);
+  ASSERT_FALSE(statements.isValid());
+  ASSERT_EQ(SQLITE_MISMATCH, statements.get<SelectTwoColumns>().getErrorCode());
+  ASSERT_EQ(SQLITE_ERROR, statements.get<SelectMissingTable>().getErrorCode());
+  ASSERT_EQ(-1, statements.execute<SelectMissingTable>());
+  ASSERT_FALSE(statements.query<SelectTwoColumns>().isValid());
+  std::vector<std::tuple<int> > rows;
+  ASSERT_EQ(-1, statements.get<SelectTwoColumns>().select(rows));
+}
+struct SelectEmployeeByName : gre90r::SqlStatement<gre90r::Params<std::string_view>, gre90r::Columns<int> > {
+  static constexpr const char* sql = "select id from employee where name = ?";
+};
+/**
+ * a failing bind is reported by the cursor instead of running the query unbound
+ */
+TEST(dbStatementRegistry, bindError) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute(QUERY_CREATE_TABLE_EMPLOYEE);
+  gre90r::PreparedStatements<EmployeeStatements> statements(sqlite);
+  gre90r::PreparedStatements<gre90r::StatementRegistry<SelectEmployeeByName> > byName(sqlite);
+  ASSERT_EQ(SQLITE_OK, statements.execute<InsertEmployee>(1, EMPLOYEE_JOHN));
+  sqlite3_limit(sqlite.getHandle(), SQLITE_LIMIT_LENGTH, 4);
+  ASSERT_EQ(SQLITE_TOOBIG, statements.execute<InsertEmployee>(2, EMPLOYEE_JEFF));
+  auto cursor = byName.query<SelectEmployeeByName>(EMPLOYEE_JOHN);
+  ASSERT_FALSE(cursor.next());
+  ASSERT_EQ(SQLITE_TOOBIG, cursor.getErrorCode());
+}
+
+
+/*********************************/
+/* Test Suite: sharded databases */
+/*********************************/
+/**
+ * @return a sharded database of 3 in-memory shards with an orders table
+ */
+static std::unique_ptr<gre90r::ShardedDatabase> createOrderShards() {
+  std::unique_ptr<gre90r::ShardedDatabase> shards(
+    new gre90r::ShardedDatabase({ ":memory:", ":memory:", ":memory:" }));
+  shards->executeAll("create table orders(id int, customer text, amount real)");
+  const char* customers[] = { "ann", "bob", "cid", "dan" };
+  for (int id = 1; id <= 20; ++id) {
+    shards->execute(id, "insert into orders values (?, ?, ?)", id, customers[id % 4], id * 1.5);
+  }
+  return shards;
+}
+/**
+ * keys are routed to a fixed shard, reads see the rows of all shards
+ */
+TEST(dbShardedDatabase, routingAndSelect) {
+  std::unique_ptr<gre90r::ShardedDatabase> shards = createOrderShards();
+  ASSERT_TRUE(shards->isValid());
+  ASSERT_EQ(3u, shards->getShardCount());
+  ASSERT_EQ(shards->getShard(7), shards->getShard(7));
+  ASSERT_EQ(shards->getShard("ann"), shards->getShard(std::string("ann")));
+
+  // the rows are spread over the shards
+  std::size_t used = 0;
+  for (std::size_t i = 0; i < shards->getShardCount(); ++i) {
+    int rows = shards->submit(i, [](gre90r::Sqlite& db) {
+      return std::atoi(db.select("select count(*) from orders").getValue(0, 0));
+    }).get();
+    used += rows > 0 ? 1 : 0;
+  }
+  ASSERT_GT(used, 1u);
+
+  // a key is read from the shard it was written to
+  int id = shards->submit(shards->getShard(7), [](gre90r::Sqlite& db) {
+    return std::atoi(db.select("select id from orders where id = 7").getValue(0, 0));
+  }).get();
+  ASSERT_EQ(7, id);
+
+  gre90r::SqlResult result;
+  ASSERT_EQ(SQLITE_OK, shards->select("select id, customer from orders where amount > ?", result, 15.0));
+  ASSERT_EQ(10u, result.size());
+  ASSERT_EQ(2u, result.getColumnCount());
+  ASSERT_EQ("customer", result.getColumnName(1));
+}
+/**
+ * sorted shard results are merged into one sorted result
+ */
+TEST(dbShardedDatabase, selectOrdered) {
+  std::unique_ptr<gre90r::ShardedDatabase> shards = createOrderShards();
+  gre90r::SqlResult result;
+  ASSERT_EQ(SQLITE_OK, shards->selectOrdered("select id, amount from orders order by amount desc",
+                                             { { 1, true } }, 5, result));
+  ASSERT_EQ(5u, result.size());
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    ASSERT_EQ(std::to_string(20 - i), result.getValue(i, 0));
+  }
+
+  gre90r::SqlResult all;
+  ASSERT_EQ(SQLITE_OK, shards->selectOrdered("select customer, id from orders order by customer, id",
+                                             { { 0 }, { 1 } }, 0, all));
+  ASSERT_EQ(20u, all.size());
+  ASSERT_STREQ("ann", all.getValue(0, 0));
+  ASSERT_STREQ("4", all.getValue(0, 1));
+  ASSERT_STREQ("8", all.getValue(1, 1));
+  ASSERT_STREQ("dan", all.getValue(19, 0));
+  ASSERT_STREQ("19", all.getValue(19, 1));
+
+  // with a limit the shards stop early and do not step to the failing row
+  gre90r::ShardedDatabase small({ ":memory:", ":memory:" });
+  small.executeAll("create table t(x int)");
+  small.executeAll("insert into t values (1), (2), (3), (-9223372036854775807 - 1)");
+  const char* query = "select rowid, abs(x) from t order by rowid";
+  gre90r::SqlResult first;
+  ASSERT_EQ(SQLITE_OK, small.selectOrdered(query, { { 0 } }, 3, first));
+  ASSERT_EQ(3u, first.size());
+  ASSERT_STREQ("2", first.getValue(2, 0));
+  ASSERT_EQ(SQLITE_ERROR, small.selectOrdered(query, { { 0 } }, 0, first));
+}
+/**
+ * partial aggregates of the shards are combined per group
+ */
+TEST(dbShardedDatabase, aggregate) {
+  std::unique_ptr<gre90r::ShardedDatabase> shards = createOrderShards();
+  gre90r::SqlResult result;
+  ASSERT_EQ(SQLITE_OK, shards->aggregate(
+    "select customer, count(*), sum(id), min(id), max(amount) from orders group by customer",
+    { gre90r::Aggregate::Group, gre90r::Aggregate::Count, gre90r::Aggregate::Sum,
+      gre90r::Aggregate::Min, gre90r::Aggregate::Max }, result));
+  ASSERT_EQ(4u, result.size());
+  // ann: 4, 8, 12, 16, 20
+  ASSERT_STREQ("ann", result.getValue(0, 0));
+  ASSERT_STREQ("5", result.getValue(0, 1));
+  ASSERT_STREQ("60", result.getValue(0, 2));
+  ASSERT_STREQ("4", result.getValue(0, 3));
+  ASSERT_STREQ("30.0", result.getValue(0, 4));
+  // bob: 1, 5, 9, 13, 17
+  ASSERT_STREQ("bob", result.getValue(1, 0));
+  ASSERT_STREQ("45", result.getValue(1, 2));
+  ASSERT_STREQ("1", result.getValue(1, 3));
+
+  gre90r::SqlResult total;
+  ASSERT_EQ(SQLITE_OK, shards->aggregate("select count(*), sum(amount) from orders",
+                                         { gre90r::Aggregate::Count, gre90r::Aggregate::Sum }, total));
+  ASSERT_EQ(1u, total.size());
+  ASSERT_STREQ("20", total.getValue(0, 0));
+  ASSERT_STREQ("315.0", total.getValue(0, 1));
+}
+/**
+ * errors of a shard are returned
+ */
+TEST(dbShardedDatabase, errors) {
+  std::unique_ptr<gre90r::ShardedDatabase> shards = createOrderShards();
+  gre90r::SqlResult result;
+  ASSERT_EQ(SQLITE_ERROR, shards->select("select * from no_such_table", result));
+  ASSERT_EQ(SQLITE_MISMATCH, shards->aggregate("select customer, count(*) from orders group by customer",
+                                               { gre90r::Aggregate::Group }, result));
+  ASSERT_EQ(SQLITE_RANGE, shards->selectOrdered("select id from orders", { { 3 } }, 0, result));
+  // a parameter which cannot be bound fails the read instead of running it unbound
+  ASSERT_EQ(SQLITE_RANGE, shards->select("select id from orders where id = ?", result, 1, 2));
+  ASSERT_EQ(SQLITE_RANGE, shards->selectOrdered("select id from orders where id = ?", { { 0 } }, 0, result, 1, 2));
+  ASSERT_EQ(SQLITE_RANGE, shards->aggregate("select count(*) from orders where id = ?",
+                                            { gre90r::Aggregate::Count }, result, 1, 2));
+  ASSERT_EQ(-2, shards->executeAll(NULL));
+  ASSERT_EQ(0u, result.size());
+
+  gre90r::ShardedDatabase none((std::vector<std::string>()));
+  ASSERT_FALSE(none.isValid());
+  ASSERT_EQ(-3, none.execute(1, "select 1"));
+  ASSERT_EQ(-3, none.select("select 1", result));
+}
+
+
+
+/***********************************/
+/* Test Suite: change data capture */
+/***********************************/
+/**
+ * changes are published when their transaction commits
+ */
+TEST(dbChangeCapture, commitAndRollback) {
+  gre90r::Sqlite sqlite(NULL);
+  std::shared_ptr<gre90r::ChangeStream> stream = std::make_shared<gre90r::ChangeStream>(100);
+  ASSERT_EQ(128u, stream->getCapacity());
+  sqlite.execute("create table account(id integer primary key, balance real)");
+  sqlite.setChangeCapture(stream);
+  ASSERT_TRUE(sqlite.hasChangeCapture());
+
+  sqlite.execute("insert into account values (7, 10)");
+  std::vector<gre90r::ChangeEvent> batch;
+  ASSERT_EQ(1u, stream->poll(batch));
+  ASSERT_EQ("main", batch[0].database);
+  ASSERT_EQ("account", batch[0].table);
+  ASSERT_EQ(gre90r::ChangeOperation::Insert, batch[0].operation);
+  ASSERT_EQ(7, batch[0].rowid);
+  ASSERT_TRUE(batch[0].newRow.empty());
+
+  // nothing is seen before the commit, nothing of a rollback
+  sqlite.execute("begin");
+  sqlite.execute("insert into account values (8, 20)");
+  ASSERT_EQ(0u, stream->poll(batch));
+  sqlite.execute("rollback");
+  sqlite.execute("begin");
+  sqlite.execute("update account set balance = 0 where id = 7");
+  sqlite.execute("insert into account values (9, 30)");
+  sqlite.execute("commit");
+  batch.clear();
+  ASSERT_EQ(2u, stream->poll(batch));
+  ASSERT_EQ(gre90r::ChangeOperation::Update, batch[0].operation);
+  ASSERT_EQ(7, batch[0].rowid);
+  ASSERT_EQ(9, batch[1].rowid);
+  ASSERT_EQ(batch[0].transaction, batch[1].transaction);
+
+  // without WHERE sqlite would empty the table without reporting the rows
+  sqlite.execute("delete from account");
+  batch.clear();
+  ASSERT_EQ(1u, stream->poll(batch, 1));
+  ASSERT_EQ(1u, stream->poll(batch));
+  ASSERT_EQ(gre90r::ChangeOperation::Delete, batch[1].operation);
+
+  gre90r::ChangeStreamStats stats = stream->getStats();
+  ASSERT_EQ(5u, stats.published);
+  ASSERT_EQ(5u, stats.consumed);
+  ASSERT_EQ(4u, stats.batches);
+  ASSERT_EQ(0u, stats.size);
+  ASSERT_EQ(2u, stats.highWatermark);
+
+  sqlite.setChangeCapture(nullptr);
+  ASSERT_FALSE(sqlite.hasChangeCapture());
+  sqlite.execute("insert into account values (1, 1)");
+  ASSERT_EQ(0u, stream->poll(batch));
+}
+/**
+ * vfs which fails to sync while failSync is set, so a commit fails after
+ * the commit hook ran. sqlite takes the locks before calling it.
+ */
+static bool failSync = false;
+struct FailingFile {
+  sqlite3_file base;
+  sqlite3_file* real;
+};
+static sqlite3_file* realFile(sqlite3_file* file) {
+  return reinterpret_cast<FailingFile*>(file)->real;
+}
+static sqlite3_io_methods failingMethods = {
+  1,
+  [](sqlite3_file* f) {
+    int rc = realFile(f)->pMethods ? realFile(f)->pMethods->xClose(realFile(f)) : SQLITE_OK;
+    sqlite3_free(realFile(f));
+    return rc;
+  },
+  [](sqlite3_file* f, void* p, int n, sqlite3_int64 o) { return realFile(f)->pMethods->xRead(realFile(f), p, n, o); },
+  [](sqlite3_file* f, const void* p, int n, sqlite3_int64 o) { return realFile(f)->pMethods->xWrite(realFile(f), p, n, o); },
+  [](sqlite3_file* f, sqlite3_int64 s) { return realFile(f)->pMethods->xTruncate(realFile(f), s); },
+  [](sqlite3_file* f, int flags) {
+    return failSync ? SQLITE_IOERR_FSYNC : realFile(f)->pMethods->xSync(realFile(f), flags);
+  },
+  [](sqlite3_file* f, sqlite3_int64* s) { return realFile(f)->pMethods->xFileSize(realFile(f), s); },
+  [](sqlite3_file* f, int l) { return realFile(f)->pMethods->xLock(realFile(f), l); },
+  [](sqlite3_file* f, int l) { return realFile(f)->pMethods->xUnlock(realFile(f), l); },
+  [](sqlite3_file* f, int* r) { return realFile(f)->pMethods->xCheckReservedLock(realFile(f), r); },
+  [](sqlite3_file* f, int op, void* a) { return realFile(f)->pMethods->xFileControl(realFile(f), op, a); },
+  [](sqlite3_file* f) { return realFile(f)->pMethods->xSectorSize(realFile(f)); },
+  [](sqlite3_file* f) { return realFile(f)->pMethods->xDeviceCharacteristics(realFile(f)); },
+  NULL, NULL, NULL, NULL, // version 1: no shared memory and no memory mapping
+  NULL, NULL
+};
+static sqlite3_vfs* getFailingVfs() {
+  static sqlite3_vfs vfs;
+  if (vfs.zName == NULL) {
+    vfs = *sqlite3_vfs_find(NULL);
+    vfs.iVersion = 1;
+    vfs.szOsFile = sizeof(FailingFile);
+    vfs.zName = "gre90r_failing";
+    vfs.pAppData = sqlite3_vfs_find(NULL);
+    vfs.xOpen = [](sqlite3_vfs* self, const char* name, sqlite3_file* file, int flags, int* outFlags) {
+      sqlite3_vfs* real = static_cast<sqlite3_vfs*>(self->pAppData);
+      FailingFile* failing = reinterpret_cast<FailingFile*>(file);
+      failing->base.pMethods = NULL;
+      failing->real = static_cast<sqlite3_file*>(sqlite3_malloc(real->szOsFile));
+      std::memset(failing->real, 0, static_cast<std::size_t>(real->szOsFile));
+      int rc = real->xOpen(real, name, failing->real, flags, outFlags);
+      failing->base.pMethods = &failingMethods;
+      return rc;
+    };
+    sqlite3_vfs_register(&vfs, 0);
+  }
+  return &vfs;
+}
+/**
+ * a commit which fails after the commit hook publishes nothing
+ */
+TEST(dbChangeCapture, failedCommit) {
+  std::remove(TEST_DB_FILENAMENAME);
+  // the connection keeps the default vfs it was opened with
+  sqlite3_vfs* defaultVfs = sqlite3_vfs_find(NULL);
+  sqlite3_vfs_register(getFailingVfs(), 1);
+  gre90r::Sqlite sqlite(TEST_DB_FILENAMENAME);
+  sqlite3_vfs_register(defaultVfs, 1);
+  sqlite.execute("create table account(id integer primary key, balance real)");
+  std::shared_ptr<gre90r::ChangeStream> stream = std::make_shared<gre90r::ChangeStream>(16);
+  sqlite.setChangeCapture(stream);
+
+  failSync = true;
+  ASSERT_EQ(SQLITE_IOERR, sqlite.execute("insert into account values (1, 10)"));
+  {
+    gre90r::Transaction transaction(sqlite);
+    sqlite.execute("insert into account values (2, 20)");
+    ASSERT_EQ(SQLITE_IOERR, transaction.commit());
+  }
+  failSync = false;
+  std::vector<gre90r::ChangeEvent> batch;
+  ASSERT_EQ(0u, stream->poll(batch));
+  ASSERT_EQ(0u, sqlite.select("select * from account").size());
+
+  sqlite.execute("insert into account values (3, 30)");
+  ASSERT_EQ(1u, stream->poll(batch));
+  ASSERT_EQ(3, batch[0].rowid);
+  sqlite.close();
+  std::remove(TEST_DB_FILENAMENAME);
+}
+/**
+ * row images hold the values before and after the change
+ */
+TEST(dbChangeCapture, rowImages) {
+#ifndef SQLITE_ENABLE_PREUPDATE_HOOK
+  GTEST_SKIP();
+#endif
+  gre90r::Sqlite sqlite(NULL);
+  std::shared_ptr<gre90r::ChangeStream> stream = std::make_shared<gre90r::ChangeStream>(16);
+  gre90r::ChangeCaptureOptions options;
+  options.rowImages = true;
+  sqlite.setChangeCapture(stream, options);
+  sqlite.execute("create table account(id integer primary key, owner text, balance real)");
+  sqlite.execute("create table tag(name text primary key, data blob) without rowid");
+  sqlite.execute("insert into account values (7, 'ann', 10)");
+  sqlite.execute("update account set balance = 2.5, id = 8 where id = 7");
+  sqlite.execute("insert into tag values ('x', null)");
+  sqlite.execute("delete from account");
+
+  std::vector<gre90r::ChangeEvent> batch;
+  ASSERT_EQ(4u, stream->poll(batch));
+  ASSERT_EQ(7, batch[0].rowid);
+  ASSERT_TRUE(batch[0].oldRow.empty());
+  ASSERT_EQ(3u, batch[0].newRow.size());
+  ASSERT_EQ(SQLITE_TEXT, batch[0].newRow[1].type);
+  ASSERT_EQ("ann", batch[0].newRow[1].bytes);
+
+  ASSERT_EQ(gre90r::ChangeOperation::Update, batch[1].operation);
+  ASSERT_EQ(8, batch[1].rowid);
+  ASSERT_EQ(7, batch[1].oldRow[0].integer);
+  ASSERT_EQ(10.0, batch[1].oldRow[2].real);
+  ASSERT_EQ(8, batch[1].newRow[0].integer);
+  ASSERT_EQ(2.5, batch[1].newRow[2].real);
+
+  ASSERT_EQ("tag", batch[2].table);
+  ASSERT_EQ(0, batch[2].rowid);
+  ASSERT_EQ("x", batch[2].newRow[0].bytes);
+  ASSERT_EQ(SQLITE_NULL, batch[2].newRow[1].type);
+
+  ASSERT_EQ(gre90r::ChangeOperation::Delete, batch[3].operation);
+  ASSERT_EQ(8, batch[3].rowid);
+  ASSERT_EQ(8, batch[3].oldRow[0].integer);
+  ASSERT_TRUE(batch[3].newRow.empty());
+}
+/**
+ * a rolled back savepoint drops its events. the result cache still sees the changes.
+ */
+TEST(dbChangeCapture, savepointAndResultCache) {
+  gre90r::Sqlite sqlite(NULL);
+  sqlite.execute("create table account(id integer primary key, balance real)");
+  gre90r::ResultCacheOptions cacheOptions;
+  cacheOptions.detectExternalChanges = false;
+  sqlite.setResultCache(true, cacheOptions);
+  std::shared_ptr<gre90r::ChangeStream> stream = std::make_shared<gre90r::ChangeStream>(16);
+  sqlite.setChangeCapture(stream);
+  ASSERT_EQ(0u, sqlite.select("select * from account").size());
+  ASSERT_EQ(0u, sqlite.select("select * from account").size());
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().hits);
+
+  {
+    gre90r::Transaction transaction(sqlite);
+    sqlite.execute("insert into account values (1, 10)");
+    {
+      gre90r::Savepoint savepoint(sqlite);
+      sqlite.execute("insert into account values (2, 20)");
+      ASSERT_EQ(SQLITE_OK, savepoint.rollback());
+    }
+    sqlite.execute("insert into account values (3, 30)");
+    ASSERT_EQ(SQLITE_OK, transaction.commit());
+  }
+  std::vector<gre90r::ChangeEvent> batch;
+  ASSERT_EQ(2u, stream->poll(batch));
+  ASSERT_EQ(1, batch[0].rowid);
+  ASSERT_EQ(3, batch[1].rowid);
+  ASSERT_EQ(2u, sqlite.select("select * from account").size());
+  ASSERT_EQ(1u, sqlite.getResultCacheStats().stale);
+
+  // either one keeps working when the other is switched off
+  sqlite.setResultCache(false);
+  sqlite.execute("delete from account where id = 1");
+  ASSERT_EQ(1u, stream->poll(batch));
+  sqlite.setResultCache(true, cacheOptions);
+  sqlite.setChangeCapture(nullptr);
+  ASSERT_EQ(1u, sqlite.select("select * from account").size());
+  sqlite.execute("delete from account");
+  ASSERT_EQ(0u, sqlite.select("select * from account").size());
+  ASSERT_EQ(0u, stream->poll(batch));
+}
+/**
+ * a full stream drops or waits. several producers feed one consumer.
+ */
+TEST(dbChangeCapture, streamOverflowAndThreads) {
+  gre90r::ChangeStream dropping(4, gre90r::ChangeOverflow::Drop);
+  for (int i = 0; i < 6; ++i) {
+    gre90r::ChangeEvent event;
+    event.rowid = i;
+    dropping.publish(std::move(event));
+  }
+  ASSERT_EQ(4u, dropping.getStats().published);
+  ASSERT_EQ(2u, dropping.getStats().dropped);
+  ASSERT_EQ(4u, dropping.getStats().size);
+  std::vector<gre90r::ChangeEvent> batch;
+  ASSERT_EQ(0u, dropping.wait(batch, 0, std::chrono::microseconds(10)));
+  ASSERT_EQ(4u, dropping.wait(batch, 10, std::chrono::microseconds(10)));
+  ASSERT_EQ(3, batch[3].rowid);
+  ASSERT_EQ(0u, dropping.wait(batch, 10, std::chrono::microseconds(100)));
+
+  // the producers wait for room, the consumer sees every event once in per-producer order
+  gre90r::ChangeStream waiting(8);
+  const int producers = 3;
+  const int events = 2000;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&waiting, p, events]() {
+      for (int i = 0; i < events; ++i) {
+        gre90r::ChangeEvent event;
+        event.transaction = static_cast<std::uint64_t>(p);
+        event.rowid = i;
+        waiting.publish(std::move(event));
+        waiting.notify();
+      }
+    });
+  }
+  std::vector<sqlite3_int64> next(producers, 0);
+  std::size_t received = 0;
+  while (received < static_cast<std::size_t>(producers * events)) {
+    batch.clear();
+    received += waiting.wait(batch, 16, std::chrono::seconds(5));
+    for (const gre90r::ChangeEvent& event : batch) {
+      ASSERT_EQ(next[event.transaction]++, event.rowid);
+    }
+    ASSERT_FALSE(batch.empty());
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  gre90r::ChangeStreamStats stats = waiting.getStats();
+  ASSERT_EQ(static_cast<unsigned long long>(producers * events), stats.consumed);
+  ASSERT_EQ(0u, stats.dropped);
+  ASSERT_LE(stats.highWatermark, 8u);
+}
+
 /********/
 /* main */
 /********/
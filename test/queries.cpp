@@ -1,4 +1,5 @@
 #include <string>
+#include "../src/StatementRegistry.h"
 
 /**
  * create table Employee
@@ -33,6 +34,10 @@ const char* QUERY_INSERT_INTO_EMPLOYEE_JEFF =
 const char* QUERY_SELECT_NAME_FROM_EMPLOYEE =
   "select name from employee";
 
+// get all employees ordered by id
+const char* QUERY_SELECT_ID_AND_NAME_FROM_EMPLOYEE =
+  "select id, name from employee order by id";
+
 /**********************/
 /* Employee deletions */
 /**********************/
@@ -42,4 +47,30 @@ const char* QUERY_CLEAR_TABLE_EMPLOYEE =
 
 // delete table employee
 const char* QUERY_DELETE_TABLE_EMPLOYEE =
-  "drop table employee";
\ No newline at end of file
+  "drop table employee";
+
+/***********************/
+/* prepared statements */
+/***********************/
+// insert an employee. ?1 = id, ?2 = name
+const char* QUERY_INSERT_INTO_EMPLOYEE_PARAMS =
+  "insert into employee (id, name) values (?, ?)";
+
+// get name of one employee. ?1 = id
+const char* QUERY_SELECT_NAME_FROM_EMPLOYEE_BY_ID =
+  "select name from employee where id = ?";
+
+/***********************/
+/* declared statements */
+/***********************/
+// the employee queries with their types, for gre90r::PreparedStatements
+struct InsertEmployee : gre90r::SqlStatement<gre90r::Params<int, std::string_view> > {
+  static constexpr const char* sql = "insert into employee (id, name) values (?, ?)";
+};
+struct SelectEmployeeName : gre90r::SqlStatement<gre90r::Params<int>, gre90r::Columns<std::string> > {
+  static constexpr const char* sql = "select name from employee where id = ?1";
+};
+struct SelectEmployees : gre90r::SqlStatement<gre90r::Params<>, gre90r::Columns<int, std::optional<std::string> > > {
+  static constexpr const char* sql = "select id, name from employee order by id -- all of them?";
+};
+typedef gre90r::StatementRegistry<InsertEmployee, SelectEmployeeName, SelectEmployees> EmployeeStatements;